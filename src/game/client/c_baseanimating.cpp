@@ -79,6 +79,11 @@ const float RUN_SPEED_ESTIMATE_SQR = 150.0f * 150.0f;
 static ConVar dbganimmodel( "dbganimmodel", "" );
 #endif
 
+#if defined( REPLAY_ENABLED )
+// Lives in the engine, read every time a ragdoll is created or destroyed
+static ConVarHandle s_replay_enable( "replay_enable" );
+#endif
+
 #if defined( STAGING_ONLY )
 	static ConVar dbg_bonestack_perturb( "dbg_bonestack_perturb", "0", 0);
 	static CInterlockedInt dbg_bonestack_reentrant_count = 0;
@@ -4759,8 +4764,7 @@ bool C_BaseAnimating::InitAsClientRagdoll( const matrix3x4_t *pDeltaBones0, cons
 
 #if defined( REPLAY_ENABLED )
 	// If Replay is enabled on server, add an entry to the ragdoll recorder for this entity
-	ConVar* pReplayEnable = (ConVar*)cvar->FindVar( "replay_enable" );
-	if ( m_pRagdoll && pReplayEnable && pReplayEnable->GetInt() && !engine->IsPlayingDemo() && !engine->IsPlayingTimeDemo() )
+	if ( m_pRagdoll && s_replay_enable.GetBool() && !engine->IsPlayingDemo() && !engine->IsPlayingTimeDemo() )
 	{
 		CReplayRagdollRecorder& RagdollRecorder = CReplayRagdollRecorder::Instance();
 		int nStartTick = TIME_TO_TICKS( engine->GetLastTimeStamp() );
@@ -5725,8 +5729,7 @@ void C_BaseAnimating::ClearRagdoll()
 
 #if defined( REPLAY_ENABLED )
 		// Delete entry from ragdoll recorder if Replay is enabled on server
-		ConVar* pReplayEnable = (ConVar*)cvar->FindVar( "replay_enable" );
-		if ( pReplayEnable && pReplayEnable->GetInt() && !engine->IsPlayingDemo() && !engine->IsPlayingTimeDemo() )
+		if ( s_replay_enable.GetBool() && !engine->IsPlayingDemo() && !engine->IsPlayingTimeDemo() )
 		{
 			CReplayRagdollRecorder& RagdollRecorder = CReplayRagdollRecorder::Instance();
 			RagdollRecorder.StopRecordingRagdoll( this );
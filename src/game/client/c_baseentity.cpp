@@ -76,6 +76,7 @@ void cc_cl_interp_all_changed( IConVar *pConVar, const char *pOldString, float f
 static ConVar  cl_extrapolate( "cl_extrapolate", "1", FCVAR_CHEAT, "Enable/disable extrapolation if interpolation history runs out." );
 static ConVar  cl_interp_npcs( "cl_interp_npcs", "0.0", FCVAR_USERINFO, "Interpolate NPC positions starting this many seconds in past (or cl_interp, if greater)" );  
 static ConVar  cl_interp_all( "cl_interp_all", "0", 0, "Disable interpolation list optimizations.", 0, 0, 0, 0, cc_cl_interp_all_changed );
+static ConVar  cl_interp_batch( "cl_interp_batch", "1", 0, "Share history searches between an entity's interpolated vars and lerp float arrays with SIMD." );
 ConVar  r_drawmodeldecals( "r_drawmodeldecals", "1" );
 extern ConVar	cl_showerror;
 int C_BaseEntity::m_nPredictionRandomSeed = -1;
@@ -867,6 +868,10 @@ inline int C_BaseEntity::Interp_Interpolate( VarMapping_t *map, float currentTim
 	}
 	map->m_lastInterpolationTime = currentTime;
 
+	// The vars are latched together, so most of them can reuse each other's history searches.
+	CInterpolationHistoryCache historyCache;
+	bool bBatch = cl_interp_batch.GetBool();
+
 	for ( int i = 0; i < map->m_nInterpolatedEntries; i++ )
 	{
 		VarMapEntry_t *e = &map->m_Entries[ i ];
@@ -877,8 +882,8 @@ inline int C_BaseEntity::Interp_Interpolate( VarMapping_t *map, float currentTim
 		IInterpolatedVar *watcher = e->watcher;
 		Assert( !( watcher->GetType() & EXCLUDE_AUTO_INTERPOLATE ) );
 
-
-		if ( watcher->Interpolate( currentTime ) )
+		int bWatcherNoMoreChanges = bBatch ? watcher->InterpolateWithCache( currentTime, &historyCache ) : watcher->Interpolate( currentTime );
+		if ( bWatcherNoMoreChanges )
 			e->m_bNeedsToInterpolate = false;
 		else
 			bNoMoreChanges = 0;
@@ -887,6 +892,53 @@ inline int C_BaseEntity::Interp_Interpolate( VarMapping_t *map, float currentTim
 	return bNoMoreChanges;
 }
 
+
+//-----------------------------------------------------------------------------
+// Purpose: Replays the interpolation of every entity's vars at a range of times
+//			inside the extra history they keep, with and without the history cache,
+//			and reports any var where the results differ.
+//-----------------------------------------------------------------------------
+CON_COMMAND_F( cl_interp_batch_verify, "Checks cl_interp_batch against the scalar interpolation. Usage: cl_interp_batch_verify [samples]", FCVAR_CHEAT )
+{
+	int nSamples = ( args.ArgC() > 1 ) ? MAX( atoi( args[1] ), 1 ) : 16;
+
+	int nVars = 0;
+	int nMismatches = 0;
+	int nHits = 0;
+	int nMisses = 0;
+
+	for ( C_BaseEntity *pEntity = ClientEntityList().FirstBaseEntity(); pEntity; pEntity = ClientEntityList().NextBaseEntity( pEntity ) )
+	{
+		VarMapping_t *map = pEntity->GetVarMapping();
+		for ( int iSample = 0; iSample < nSamples; iSample++ )
+		{
+			float flTime = gpGlobals->curtime - ( EXTRA_INTERPOLATION_HISTORY_STORED * iSample ) / nSamples;
+
+			CInterpolationHistoryCache historyCache;
+			for ( int i = 0; i < map->m_nInterpolatedEntries; i++ )
+			{
+				IInterpolatedVar *watcher = map->m_Entries[ i ].watcher;
+				++nVars;
+
+				if ( !watcher->CheckInterpolateWithCache( flTime, &historyCache ) )
+				{
+					if ( ++nMismatches <= 10 )
+					{
+						const char *pVarName = watcher->GetDebugName() ? watcher->GetDebugName() : "unnamed";
+						Warning( "cl_interp_batch_verify: %s (%d) %s differs at %.4f\n", pEntity->GetClassname(), pEntity->entindex(), pVarName, flTime );
+					}
+				}
+			}
+
+			nHits += historyCache.m_nHits;
+			nMisses += historyCache.m_nMisses;
+		}
+	}
+
+	Msg( "cl_interp_batch_verify: %d var interpolations, %d mismatches, %d shared history searches, %d searched\n",
+		nVars, nMismatches, nHits, nMisses );
+}
+
 //-----------------------------------------------------------------------------
 // Functions.
 //-----------------------------------------------------------------------------
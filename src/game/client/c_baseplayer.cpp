@@ -124,6 +124,9 @@ ConVar cl_meathook_neck_pivot_ingame_fwd( "cl_meathook_neck_pivot_ingame_fwd", "
 
 static ConVar	cl_clean_textures_on_death( "cl_clean_textures_on_death", "0", FCVAR_DEVELOPMENTONLY,  "If enabled, attempts to purge unused textures every time a freeze cam is shown" );
 
+// Lives in the engine
+static ConVarHandle s_snd_soundmixer( "snd_soundmixer" );
+
 
 void RecvProxy_LocalVelocityX( const CRecvProxyData *pData, void *pStruct, void *pOut );
 void RecvProxy_LocalVelocityY( const CRecvProxyData *pData, void *pStruct, void *pOut );
@@ -809,8 +812,7 @@ void C_BasePlayer::PostDataUpdate( DataUpdateType_t updateType )
 
 			// Reset our sound mixed in case we were in a freeze cam when we
 			// changed level, which would cause the snd_soundmixer to be left modified.
-			ConVar *pVar = (ConVar *)cvar->FindVar( "snd_soundmixer" );
-			pVar->Revert();
+			s_snd_soundmixer.Revert();
 		}
 	}
 
@@ -884,8 +886,7 @@ void C_BasePlayer::PostDataUpdate( DataUpdateType_t updateType )
 			}
 
 			// Force the sound mixer to the freezecam mixer
-			ConVar *pVar = (ConVar *)cvar->FindVar( "snd_soundmixer" );
-			pVar->SetValue( "FreezeCam_Only" );
+			s_snd_soundmixer.SetValue( "FreezeCam_Only" );
 
 			// When we start, give unused textures an opportunity to unload
 			if ( cl_clean_textures_on_death.GetBool() )
@@ -901,8 +902,7 @@ void C_BasePlayer::PostDataUpdate( DataUpdateType_t updateType )
 
 			view->FreezeFrame(0);
 
-			ConVar *pVar = (ConVar *)cvar->FindVar( "snd_soundmixer" );
-			pVar->Revert();
+			s_snd_soundmixer.Revert();
 
 			m_nForceVisionFilterFlags = 0;
 			CalculateVisionUsingCurrentFlags();
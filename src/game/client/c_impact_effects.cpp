@@ -14,6 +14,7 @@
 #include "c_te_particlesystem.h"
 #include "engine/ivmodelinfo.h"
 #include "particles_ez.h"
+#include "particles_soa.h"
 #include "c_impact_effects.h"
 #include "engine/IStaticPropMgr.h"
 #include "tier0/vprof.h"
@@ -702,47 +703,46 @@ void FX_AntlionImpact( const Vector &pos, trace_t *trace )
 	// Dust trail
 	//
 
-	SimpleParticle	*pParticle;
-
-	CSmartPtr<CSimpleEmitter> dustEmitter = CSimpleEmitter::Create( "FX_DebrisFlecks" );					
+	// One material, no sorting and nothing windblown, so the SoA emitter can simulate these
+	CSmartPtr<CSoaSimpleEmitter> dustEmitter = CSoaSimpleEmitter::Create( "FX_DebrisFlecks", g_Mat_DustPuff[0], 4 );
 	if ( !dustEmitter )
 		return;
 
 	Vector	offset = trace->endpos + ( shotDir * 4.0f );
 
 	dustEmitter->SetSortOrigin( offset );
-	dustEmitter->GetBinding().SetBBox( spawnOffset-Vector(32,32,32), spawnOffset+Vector(32,32,32), true );
+
+	SimpleParticle	particle;
+	particle.m_Pos = offset;
 
 	for ( i = 0; i < 4; i++ )
 	{
-		pParticle = (SimpleParticle *) dustEmitter->AddParticle( sizeof(SimpleParticle), g_Mat_DustPuff[0], offset );
-
-		if ( pParticle == NULL )
-			break;
-
-		pParticle->m_flLifetime	= 0.0f;
-		pParticle->m_flDieTime	= 1.0f;
+		particle.m_flLifetime	= 0.0f;
+		particle.m_flDieTime	= 1.0f;
 		
 		dir[0] = shotDir[0] + random->RandomFloat( -0.8f, 0.8f );
 		dir[1] = shotDir[1] + random->RandomFloat( -0.8f, 0.8f );
 		dir[2] = shotDir[2] + random->RandomFloat( -0.8f, 0.8f );
 
-		pParticle->m_uchStartSize	= random->RandomInt( 8, 16 );
-		pParticle->m_uchEndSize		= pParticle->m_uchStartSize * 4.0f;
+		particle.m_uchStartSize	= random->RandomInt( 8, 16 );
+		particle.m_uchEndSize	= particle.m_uchStartSize * 4.0f;
 
-		pParticle->m_vecVelocity = dir * random->RandomFloat( 4.0f, 64.0f );
+		particle.m_vecVelocity = dir * random->RandomFloat( 4.0f, 64.0f );
 
-		pParticle->m_uchStartAlpha	= random->RandomInt( 32, 64);
-		pParticle->m_uchEndAlpha	= 0;
+		particle.m_uchStartAlpha	= random->RandomInt( 32, 64);
+		particle.m_uchEndAlpha	= 0;
 		
-		pParticle->m_flRoll			= random->RandomFloat( 0, 2.0f*M_PI );
-		pParticle->m_flRollDelta	= random->RandomFloat( -0.5f, 0.5f );
+		particle.m_flRoll		= random->RandomFloat( 0, 2.0f*M_PI );
+		particle.m_flRollDelta	= random->RandomFloat( -0.5f, 0.5f );
 
 		colorRamp = random->RandomFloat( 0.5f, 1.0f );
 
-		pParticle->m_uchColor[0] = MIN( 1.0f, color[0]*colorRamp )*255.0f;
-		pParticle->m_uchColor[1] = MIN( 1.0f, color[1]*colorRamp )*255.0f;
-		pParticle->m_uchColor[2] = MIN( 1.0f, color[2]*colorRamp )*255.0f;
+		particle.m_uchColor[0] = MIN( 1.0f, color[0]*colorRamp )*255.0f;
+		particle.m_uchColor[1] = MIN( 1.0f, color[1]*colorRamp )*255.0f;
+		particle.m_uchColor[2] = MIN( 1.0f, color[2]*colorRamp )*255.0f;
+
+		if ( !dustEmitter->AddSimpleParticle( particle ) )
+			break;
 	}
 
 
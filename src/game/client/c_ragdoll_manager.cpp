@@ -5,6 +5,10 @@
 //=============================================================================//
 #include "cbase.h"
 #include "ragdoll_shared.h"
+#include "ragdoll.h"
+#include "view.h"
+#include "engine/ivdebugoverlay.h"
+#include "tier0/vprof.h"
 
 // memdbgon must be the last include file in a .cpp file!!!
 #include "tier0/memdbgon.h"
@@ -49,3 +53,162 @@ void C_RagdollManager::OnDataChanged( DataUpdateType_t updateType )
 
 	s_RagdollLRU.SetMaxRagdollCount( m_iCurrentMaxRagdollCount );
 }
+
+
+static ConVar ragdoll_lod( "ragdoll_lod", "1", 0, "Simulate distant and offscreen client ragdolls at reduced detail." );
+static ConVar ragdoll_lod_near_dist( "ragdoll_lod_near_dist", "768", 0, "Ragdolls further than this from the view use reduced detail." );
+static ConVar ragdoll_lod_far_dist( "ragdoll_lod_far_dist", "2048", 0, "Ragdolls further than this from the view, or offscreen, use distant detail." );
+static ConVar ragdoll_lod_budget_ms( "ragdoll_lod_budget_ms", "1.0", 0, "Per frame ragdoll update time (ms) above which the LOD distances shrink. 0 disables the budget." );
+static ConVar ragdoll_lod_debug( "ragdoll_lod_debug", "0", FCVAR_CHEAT, "Show ragdoll LOD tiers, counts and update time." );
+
+static const char *s_pRagdollLODNames[RAGDOLL_LOD_COUNT] =
+{
+	"full",
+	"reduced",
+	"distant",
+	"frozen",
+};
+
+// Each budget step halves the LOD distances
+#define RAGDOLL_LOD_MAX_BUDGET_STEPS	3
+// Fraction of a distance a ragdoll must come back within before it's promoted
+#define RAGDOLL_LOD_PROMOTE_SCALE		0.9f
+
+//-----------------------------------------------------------------------------
+// Purpose: Picks a LOD for every client ragdoll each frame from its distance,
+//			visibility and sleep state, and pulls the distances in while the
+//			ragdolls are over their time budget.
+//-----------------------------------------------------------------------------
+class CRagdollLODSystem : public CAutoGameSystemPerFrame
+{
+public:
+	CRagdollLODSystem( char const *name ) : CAutoGameSystemPerFrame( name )
+	{
+		m_nBudgetSteps = 0;
+		m_flSmoothedTime = 0.0f;
+	}
+
+	virtual void LevelInitPreEntity()
+	{
+		m_nBudgetSteps = 0;
+		m_flSmoothedTime = 0.0f;
+	}
+
+	virtual void Update( float frametime );
+
+private:
+	int		ComputeLOD( CRagdoll *pRagdoll, float flNearDist, float flFarDist );
+	void	UpdateBudget( float flTime );
+
+	int		m_nBudgetSteps;
+	float	m_flSmoothedTime;
+};
+
+static CRagdollLODSystem g_RagdollLODSystem( "CRagdollLODSystem" );
+
+int CRagdollLODSystem::ComputeLOD( CRagdoll *pRagdoll, float flNearDist, float flFarDist )
+{
+	if ( pRagdoll->IsAsleep() )
+		return RAGDOLL_LOD_FROZEN;
+
+	const Vector &origin = pRagdoll->GetRagdollOrigin();
+	float flDistSqr = origin.DistToSqr( MainViewOrigin() );
+
+	// Don't let ragdolls sitting right at a threshold flip between tiers
+	int nCurrent = pRagdoll->GetLOD();
+	float flNearScale = ( nCurrent > RAGDOLL_LOD_FULL ) ? RAGDOLL_LOD_PROMOTE_SCALE : 1.0f;
+	float flFarScale = ( nCurrent > RAGDOLL_LOD_REDUCED ) ? RAGDOLL_LOD_PROMOTE_SCALE : 1.0f;
+
+	if ( flDistSqr > Square( flFarDist * flFarScale ) )
+		return RAGDOLL_LOD_DISTANT;
+
+	Vector mins, maxs;
+	pRagdoll->GetRagdollBounds( mins, maxs );
+	if ( engine->CullBox( origin + mins, origin + maxs ) )
+		return RAGDOLL_LOD_DISTANT;
+
+	if ( flDistSqr > Square( flNearDist * flNearScale ) )
+		return RAGDOLL_LOD_REDUCED;
+
+	return RAGDOLL_LOD_FULL;
+}
+
+void CRagdollLODSystem::UpdateBudget( float flTime )
+{
+	m_flSmoothedTime = m_flSmoothedTime * 0.9f + flTime * 0.1f;
+
+	float flBudget = ragdoll_lod_budget_ms.GetFloat();
+	if ( flBudget <= 0.0f )
+	{
+		m_nBudgetSteps = 0;
+		return;
+	}
+
+	// Only give detail back once well under budget
+	if ( m_flSmoothedTime > flBudget )
+	{
+		if ( m_nBudgetSteps < RAGDOLL_LOD_MAX_BUDGET_STEPS )
+		{
+			++m_nBudgetSteps;
+			m_flSmoothedTime = flBudget;
+		}
+	}
+	else if ( m_flSmoothedTime < flBudget * 0.5f && m_nBudgetSteps > 0 )
+	{
+		--m_nBudgetSteps;
+		m_flSmoothedTime = flBudget * 0.75f;
+	}
+}
+
+void CRagdollLODSystem::Update( float frametime )
+{
+	VPROF( "CRagdollLODSystem::Update" );
+
+	float flTime = ConsumeRagdollUpdateTime();
+	int nCount = GetClientRagdollCount();
+
+	if ( !ragdoll_lod.GetBool() )
+	{
+		for ( int i = 0; i < nCount; i++ )
+		{
+			GetClientRagdoll( i )->SetLOD( RAGDOLL_LOD_FULL );
+		}
+		m_nBudgetSteps = 0;
+		return;
+	}
+
+	UpdateBudget( flTime );
+
+	float flScale = 1.0f / ( 1 << m_nBudgetSteps );
+	float flNearDist = ragdoll_lod_near_dist.GetFloat() * flScale;
+	float flFarDist = MAX( ragdoll_lod_far_dist.GetFloat() * flScale, flNearDist );
+
+	bool bDebug = ragdoll_lod_debug.GetBool();
+	int nTierCount[RAGDOLL_LOD_COUNT] = { 0 };
+
+	for ( int i = 0; i < nCount; i++ )
+	{
+		CRagdoll *pRagdoll = GetClientRagdoll( i );
+		if ( !pRagdoll->IsValid() )
+			continue;
+
+		int nLOD = ComputeLOD( pRagdoll, flNearDist, flFarDist );
+		pRagdoll->SetLOD( nLOD );
+		++nTierCount[nLOD];
+
+		if ( bDebug )
+		{
+			debugoverlay->AddTextOverlay( pRagdoll->GetRagdollOrigin(), 0.0f, "%s", s_pRagdollLODNames[nLOD] );
+		}
+	}
+
+	if ( bDebug )
+	{
+		engine->Con_NPrintf( 0, "ragdolls: %d  update: %.3f ms (avg %.3f)  budget steps: %d",
+			nCount, flTime, m_flSmoothedTime, m_nBudgetSteps );
+		for ( int i = 0; i < RAGDOLL_LOD_COUNT; i++ )
+		{
+			engine->Con_NPrintf( i + 1, "  %-8s %d", s_pRagdollLODNames[i], nTierCount[i] );
+		}
+	}
+}
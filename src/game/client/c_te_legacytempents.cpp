@@ -72,6 +72,9 @@ ConVar func_break_max_pieces( "func_break_max_pieces", "15", FCVAR_ARCHIVE | FCV
 
 ConVar cl_fasttempentcollision( "cl_fasttempentcollision", "5" );
 
+static ConVar cl_tempent_debug( "cl_tempent_debug", "0", FCVAR_CHEAT, "Show temp entity pool pressure on screen." );
+static ConVar cl_tempent_batch( "cl_tempent_batch", "1", 0, "Simulate and draw brass and model gibs together in one batch instead of as individual temp entities." );
+
 #if !defined( HL1_CLIENT_DLL )		// HL1 implements a derivative of CTempEnts
 // Temp entity interface
 static CTempEnts g_TempEnts;
@@ -130,6 +133,7 @@ void C_LocalTempEntity::Prepare( const model_t *pmodel, float time )
 	bounceFactor = 1;
 	m_nFlickerFrame = 0;
 	m_bParticleCollision = false;
+	m_bLeafStateValid = false;
 }
 
 //-----------------------------------------------------------------------------
@@ -765,12 +769,524 @@ void C_LocalTempEntity::OnRemoveTempEntity()
 	g_BreakableHelper.Remove( this );
 }
 
+//-----------------------------------------------------------------------------
+// Purpose: Brass and model gibs that only fly, rotate, bounce off the world and
+//  fade out don't need to be C_LocalTempEntity objects. They are kept here as
+//  arrays of their state instead, simulated together, and drawn by a single
+//  renderable that holds one leaf system entry for all of them.
+//-----------------------------------------------------------------------------
+struct BatchedTempEnt_t
+{
+	BatchedTempEnt_t()
+	{
+		m_pModel = NULL;
+		m_nBody = 0;
+		m_vecOrigin.Init();
+		m_angAngles.Init();
+		m_vecVelocity.Init();
+		m_angAngVelocity.Init();
+		m_nFlags = 0;
+		m_nHitSound = 0;
+		m_flDieTime = 0.0f;
+		m_flBounceFactor = 1.0f;
+		m_nRenderAmt = 255;
+		m_pLightingOrigin = NULL;
+	}
+
+	const model_t	*m_pModel;
+	int				m_nBody;
+	Vector			m_vecOrigin;
+	QAngle			m_angAngles;
+	Vector			m_vecVelocity;
+	QAngle			m_angAngVelocity;
+	int				m_nFlags;				// FTENT_ flags, see CTempEntBatch::IsBatchable
+	int				m_nHitSound;
+	float			m_flDieTime;
+	float			m_flBounceFactor;
+	int				m_nRenderAmt;
+	const Vector	*m_pLightingOrigin;		// Light it from here instead of its own origin
+};
+
+class CTempEntBatch : public CDefaultClientRenderable
+{
+public:
+	enum
+	{
+		MAX_BATCHED_TEMPENTS = 256,
+	};
+
+	CTempEntBatch();
+
+	// Only studio models with a single bone can be drawn from the batch
+	static bool		IsBatchable( const model_t *pModel, int nFlags );
+
+	void			Add( const BatchedTempEnt_t &params );
+	void			Clear();
+	int				Count() const		{ return m_nCount; }
+
+	// Simulates everything, then updates the one leaf system entry
+	void			Update( CTempEnts *pTempEnts, float frametime );
+
+	// Lighting origin shared by the gibs of one BreakModel run and its slaves
+	void			SetBreakLightingOrigin( const Vector &vecOrigin )	{ m_vecBreakLightingOrigin = vecOrigin; }
+	const Vector	&GetBreakLightingOrigin() const						{ return m_vecBreakLightingOrigin; }
+
+	void			PrintStats();
+	void			ResetStats();
+	int				GetDrawnCount() const		{ return m_nDrawnLastFrame; }
+	int				GetEvictedCount() const		{ return m_nEvicted; }
+
+// IClientRenderable
+public:
+	virtual const Vector&		GetRenderOrigin( void )			{ return m_vecRenderOrigin; }
+	virtual const QAngle&		GetRenderAngles( void )			{ return vec3_angle; }
+	virtual const matrix3x4_t&	RenderableToWorldTransform()	{ return m_RenderToWorld; }
+	virtual bool				ShouldDraw( void )				{ return m_nCount > 0; }
+	virtual bool				IsTransparent( void )			{ return true; }
+	virtual bool				IsTwoPass( void )				{ return true; }
+	virtual const model_t*		GetModel( ) const;
+	virtual int					DrawModel( int flags );
+	virtual bool				SetupBones( matrix3x4_t *pBoneToWorldOut, int nMaxBones, int boneMask, float currentTime );
+	virtual void				GetRenderBounds( Vector& mins, Vector& maxs );
+
+private:
+	void			RemoveAt( int i );
+	void			CopyTo( int nFrom, int nTo );
+	void			UpdateRenderable();
+
+	// Per tempent state, one array per field
+	int				m_nCount;
+	const model_t	*m_pModel[MAX_BATCHED_TEMPENTS];
+	int				m_nBody[MAX_BATCHED_TEMPENTS];
+	Vector			m_vecOrigin[MAX_BATCHED_TEMPENTS];
+	Vector			m_vecPrevOrigin[MAX_BATCHED_TEMPENTS];
+	QAngle			m_angAngles[MAX_BATCHED_TEMPENTS];
+	Vector			m_vecVelocity[MAX_BATCHED_TEMPENTS];
+	QAngle			m_angAngVelocity[MAX_BATCHED_TEMPENTS];
+	int				m_nFlags[MAX_BATCHED_TEMPENTS];
+	int				m_nHitSound[MAX_BATCHED_TEMPENTS];
+	float			m_flDieTime[MAX_BATCHED_TEMPENTS];
+	float			m_flBounceFactor[MAX_BATCHED_TEMPENTS];
+	int				m_nRenderAmt[MAX_BATCHED_TEMPENTS];
+	int				m_nAlpha[MAX_BATCHED_TEMPENTS];
+	float			m_flRadius[MAX_BATCHED_TEMPENTS];
+	bool			m_bHasLightingOrigin[MAX_BATCHED_TEMPENTS];
+	Vector			m_vecLightingOrigin[MAX_BATCHED_TEMPENTS];
+	bool			m_bCollided[MAX_BATCHED_TEMPENTS];
+
+	Vector			m_vecBreakLightingOrigin;
+
+	// The renderable covers the bounds of every tempent in the batch
+	Vector			m_vecRenderOrigin;
+	Vector			m_vecRenderMins;
+	Vector			m_vecRenderMaxs;
+	matrix3x4_t		m_RenderToWorld;
+
+	// Which tempent DrawModel is drawing, for SetupBones
+	int				m_iDrawing;
+
+	// Telemetry (cl_tempent_stats, cl_tempent_debug)
+	int				m_nAdded;
+	int				m_nEvicted;
+	int				m_nPeak;
+	int				m_nDrawn;				// Model draws since the last Update
+	int				m_nDrawnLastFrame;
+};
+
+static CTempEntBatch g_TempEntBatch;
+
+CTempEntBatch::CTempEntBatch()
+{
+	m_nCount = 0;
+	m_iDrawing = -1;
+	m_nDrawn = 0;
+	m_nDrawnLastFrame = 0;
+	m_vecBreakLightingOrigin.Init();
+	m_vecRenderOrigin.Init();
+	m_vecRenderMins.Init();
+	m_vecRenderMaxs.Init();
+	SetIdentityMatrix( m_RenderToWorld );
+	ResetStats();
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: Can a tempent with this model and these flags live in the batch?
+//-----------------------------------------------------------------------------
+bool CTempEntBatch::IsBatchable( const model_t *pModel, int nFlags )
+{
+	if ( !cl_tempent_batch.GetBool() || !pModel )
+		return false;
+
+	const int nBatchableFlags = FTENT_COLLIDEWORLD | FTENT_FADEOUT | FTENT_GRAVITY | FTENT_SLOWGRAVITY | FTENT_ROTATE;
+	if ( nFlags & ~nBatchableFlags )
+		return false;
+
+	if ( modelinfo->GetModelType( pModel ) != mod_studio )
+		return false;
+
+	// SetupBones puts every bone at the tempent's origin
+	MDLCACHE_CRITICAL_SECTION();
+	studiohdr_t *pStudioHdr = modelinfo->GetStudiomodel( pModel );
+	return pStudioHdr && pStudioHdr->numbones == 1;
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: Adds a tempent. When the batch is full, the one closest to dying
+//  makes room for it.
+//-----------------------------------------------------------------------------
+void CTempEntBatch::Add( const BatchedTempEnt_t &params )
+{
+	int i = m_nCount;
+	if ( m_nCount == MAX_BATCHED_TEMPENTS )
+	{
+		i = 0;
+		for ( int j = 1; j < m_nCount; ++j )
+		{
+			if ( m_flDieTime[j] < m_flDieTime[i] )
+			{
+				i = j;
+			}
+		}
+		++m_nEvicted;
+	}
+	else
+	{
+		++m_nCount;
+		m_nPeak = MAX( m_nPeak, m_nCount );
+	}
+	++m_nAdded;
+
+	m_pModel[i] = params.m_pModel;
+	m_nBody[i] = params.m_nBody;
+	m_vecOrigin[i] = params.m_vecOrigin;
+	m_vecPrevOrigin[i] = params.m_vecOrigin;
+	m_angAngles[i] = params.m_angAngles;
+	m_vecVelocity[i] = params.m_vecVelocity;
+	m_angAngVelocity[i] = params.m_angAngVelocity;
+	m_nFlags[i] = params.m_nFlags;
+	m_nHitSound[i] = params.m_nHitSound;
+	m_flDieTime[i] = params.m_flDieTime;
+	m_flBounceFactor[i] = params.m_flBounceFactor;
+	m_nRenderAmt[i] = params.m_nRenderAmt;
+	m_nAlpha[i] = params.m_nRenderAmt;
+	m_flRadius[i] = modelinfo->GetModelRadius( params.m_pModel );
+	m_bHasLightingOrigin[i] = ( params.m_pLightingOrigin != NULL );
+	m_vecLightingOrigin[i] = params.m_pLightingOrigin ? *params.m_pLightingOrigin : params.m_vecOrigin;
+	m_bCollided[i] = false;
+}
+
+void CTempEntBatch::CopyTo( int nFrom, int nTo )
+{
+	m_pModel[nTo] = m_pModel[nFrom];
+	m_nBody[nTo] = m_nBody[nFrom];
+	m_vecOrigin[nTo] = m_vecOrigin[nFrom];
+	m_vecPrevOrigin[nTo] = m_vecPrevOrigin[nFrom];
+	m_angAngles[nTo] = m_angAngles[nFrom];
+	m_vecVelocity[nTo] = m_vecVelocity[nFrom];
+	m_angAngVelocity[nTo] = m_angAngVelocity[nFrom];
+	m_nFlags[nTo] = m_nFlags[nFrom];
+	m_nHitSound[nTo] = m_nHitSound[nFrom];
+	m_flDieTime[nTo] = m_flDieTime[nFrom];
+	m_flBounceFactor[nTo] = m_flBounceFactor[nFrom];
+	m_nRenderAmt[nTo] = m_nRenderAmt[nFrom];
+	m_nAlpha[nTo] = m_nAlpha[nFrom];
+	m_flRadius[nTo] = m_flRadius[nFrom];
+	m_bHasLightingOrigin[nTo] = m_bHasLightingOrigin[nFrom];
+	m_vecLightingOrigin[nTo] = m_vecLightingOrigin[nFrom];
+	m_bCollided[nTo] = m_bCollided[nFrom];
+}
+
+void CTempEntBatch::RemoveAt( int i )
+{
+	--m_nCount;
+	if ( i != m_nCount )
+	{
+		CopyTo( m_nCount, i );
+	}
+}
+
+void CTempEntBatch::Clear()
+{
+	m_nCount = 0;
+	if ( m_hRenderHandle != INVALID_CLIENT_RENDER_HANDLE )
+	{
+		ClientLeafSystem()->RemoveRenderable( m_hRenderHandle );
+
+		// The leaf system may already be gone at level shutdown, and then it doesn't reset our handle
+		m_hRenderHandle = INVALID_CLIENT_RENDER_HANDLE;
+	}
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: The same motion C_LocalTempEntity::IsActive and Frame give a
+//  tempent with these flags, one pass per step over all of them
+//-----------------------------------------------------------------------------
+void CTempEntBatch::Update( CTempEnts *pTempEnts, float frametime )
+{
+	VPROF_BUDGET( "CTempEntBatch::Update", VPROF_BUDGETGROUP_CLIENT_SIM );
+
+	m_nDrawnLastFrame = m_nDrawn;
+	m_nDrawn = 0;
+
+	if ( frametime != 0 )
+	{
+		// Age and fade out
+		for ( int i = m_nCount; --i >= 0; )
+		{
+			float life = m_flDieTime[i] - gpGlobals->curtime;
+			if ( life >= 0 )
+				continue;
+
+			if ( m_nFlags[i] & FTENT_FADEOUT )
+			{
+				m_nAlpha[i] = m_nRenderAmt[i] * ( 1 + life * 0.5f );
+				if ( m_nAlpha[i] > 0 )
+					continue;
+			}
+
+			RemoveAt( i );
+		}
+
+		// Move
+		for ( int i = 0; i < m_nCount; ++i )
+		{
+			m_vecPrevOrigin[i] = m_vecOrigin[i];
+			VectorMA( m_vecOrigin[i], frametime, m_vecVelocity[i], m_vecOrigin[i] );
+		}
+
+		for ( int i = 0; i < m_nCount; ++i )
+		{
+			if ( m_nFlags[i] & FTENT_ROTATE )
+			{
+				m_angAngles[i] += m_angAngVelocity[i] * frametime;
+			}
+		}
+
+		// Bounce off the world
+		float gravity = -frametime * GetCurrentGravity();
+		CTraceFilterWorldOnly traceFilter;
+		for ( int i = 0; i < m_nCount; ++i )
+		{
+			m_bCollided[i] = false;
+			if ( !( m_nFlags[i] & FTENT_COLLIDEWORLD ) )
+				continue;
+
+			trace_t trace;
+			UTIL_TraceLine( m_vecPrevOrigin[i], m_vecOrigin[i], MASK_SOLID, &traceFilter, &trace );
+			if ( trace.fraction == 1 )
+				continue;
+
+			m_bCollided[i] = true;
+			m_vecOrigin[i] = trace.endpos;
+
+			// Damp velocity
+			float damp = m_flBounceFactor[i];
+			if ( m_nFlags[i] & ( FTENT_GRAVITY | FTENT_SLOWGRAVITY ) )
+			{
+				damp *= 0.5;
+				if ( trace.plane.normal[2] > 0.9 )		// Hit floor?
+				{
+					if ( m_vecVelocity[i][2] <= 0 && m_vecVelocity[i][2] >= gravity*3 )
+					{
+						damp = 0;		// Stop
+						m_nFlags[i] &= ~( FTENT_ROTATE | FTENT_GRAVITY | FTENT_SLOWGRAVITY | FTENT_COLLIDEWORLD );
+						m_angAngles[i][PITCH] = 0;
+						m_angAngles[i][ROLL] = 0;
+					}
+				}
+			}
+
+			if ( m_nHitSound[i] )
+			{
+				pTempEnts->PlayBounceSound( m_nHitSound[i], m_vecOrigin[i], m_vecVelocity[i][2], damp );
+			}
+
+			// Reflect velocity
+			if ( damp != 0 )
+			{
+				float proj = m_vecVelocity[i].Dot( trace.plane.normal );
+				VectorMA( m_vecVelocity[i], -proj*2, trace.plane.normal, m_vecVelocity[i] );
+				// Reflect rotation (fake)
+				m_angAngles[i][YAW] = -m_angAngles[i][YAW];
+			}
+
+			if ( damp != 1 )
+			{
+				VectorScale( m_vecVelocity[i], damp, m_vecVelocity[i] );
+				m_angAngles[i] *= 0.9;
+			}
+		}
+
+		// Add gravity if we didn't collide in this frame
+		float gravitySlow = gravity * 0.5;
+		for ( int i = 0; i < m_nCount; ++i )
+		{
+			if ( m_bCollided[i] )
+				continue;
+
+			if ( m_nFlags[i] & FTENT_GRAVITY )
+				m_vecVelocity[i][2] += gravity;
+			else if ( m_nFlags[i] & FTENT_SLOWGRAVITY )
+				m_vecVelocity[i][2] += gravitySlow;
+		}
+	}
+
+	UpdateRenderable();
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: Fits the renderable to the batch and relinks it once
+//-----------------------------------------------------------------------------
+void CTempEntBatch::UpdateRenderable()
+{
+	if ( m_nCount == 0 )
+	{
+		if ( m_hRenderHandle != INVALID_CLIENT_RENDER_HANDLE )
+		{
+			ClientLeafSystem()->RemoveRenderable( m_hRenderHandle );
+		}
+		return;
+	}
+
+	Vector vecMins( FLT_MAX, FLT_MAX, FLT_MAX );
+	Vector vecMaxs( -FLT_MAX, -FLT_MAX, -FLT_MAX );
+	for ( int i = 0; i < m_nCount; ++i )
+	{
+		Vector vecRadius( m_flRadius[i], m_flRadius[i], m_flRadius[i] );
+		VectorMin( vecMins, m_vecOrigin[i] - vecRadius, vecMins );
+		VectorMax( vecMaxs, m_vecOrigin[i] + vecRadius, vecMaxs );
+	}
+
+	Vector vecOrigin = ( vecMins + vecMaxs ) * 0.5f;
+	vecMins -= vecOrigin;
+	vecMaxs -= vecOrigin;
+
+	if ( m_hRenderHandle == INVALID_CLIENT_RENDER_HANDLE )
+	{
+		m_vecRenderOrigin = vecOrigin;
+		m_vecRenderMins = vecMins;
+		m_vecRenderMaxs = vecMaxs;
+		PositionMatrix( m_vecRenderOrigin, m_RenderToWorld );
+
+		// Two pass, so DrawModel gets an opaque pass and a translucent one for the fading tempents
+		ClientLeafSystem()->AddRenderable( this, RENDER_GROUP_TWOPASS );
+	}
+	else if ( !VectorsAreEqual( vecOrigin, m_vecRenderOrigin, 0.0f ) ||
+		!VectorsAreEqual( vecMins, m_vecRenderMins, 0.0f ) || !VectorsAreEqual( vecMaxs, m_vecRenderMaxs, 0.0f ) )
+	{
+		m_vecRenderOrigin = vecOrigin;
+		m_vecRenderMins = vecMins;
+		m_vecRenderMaxs = vecMaxs;
+		PositionMatrix( m_vecRenderOrigin, m_RenderToWorld );
+
+		ClientLeafSystem()->RenderableChanged( m_hRenderHandle );
+	}
+}
+
+void CTempEntBatch::GetRenderBounds( Vector& mins, Vector& maxs )
+{
+	mins = m_vecRenderMins;
+	maxs = m_vecRenderMaxs;
+}
+
+const model_t *CTempEntBatch::GetModel( ) const
+{
+	return ( m_iDrawing >= 0 ) ? m_pModel[m_iDrawing] : NULL;
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: Called by the engine from DrawModelEx for the tempent being drawn
+//-----------------------------------------------------------------------------
+bool CTempEntBatch::SetupBones( matrix3x4_t *pBoneToWorldOut, int nMaxBones, int boneMask, float currentTime )
+{
+	if ( m_iDrawing < 0 || nMaxBones < 1 )
+		return false;
+
+	AngleMatrix( m_angAngles[m_iDrawing], m_vecOrigin[m_iDrawing], pBoneToWorldOut[0] );
+	return true;
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: Draws the opaque tempents in the opaque pass and the fading ones in
+//  the translucent pass
+//-----------------------------------------------------------------------------
+int CTempEntBatch::DrawModel( int flags )
+{
+	VPROF_BUDGET( "CTempEntBatch::DrawModel", VPROF_BUDGETGROUP_MODEL_RENDERING );
+
+	bool bTranslucentPass = ( flags & STUDIO_TRANSPARENCY ) != 0;
+	float flBlend = render->GetBlend();
+
+	MDLCACHE_CRITICAL_SECTION();
+
+	ModelRenderInfo_t info;
+	info.flags = flags;
+	info.pRenderable = this;
+	info.instance = MODEL_INSTANCE_INVALID;
+	info.entity_index = -1;
+	info.skin = 0;
+	info.hitboxset = 0;
+
+	int nDrawn = 0;
+	for ( int i = 0; i < m_nCount; ++i )
+	{
+		if ( ( m_nAlpha[i] < 255 ) != bTranslucentPass )
+			continue;
+
+		// The leaf system only culled the bounds of the whole batch
+		Vector vecRadius( m_flRadius[i], m_flRadius[i], m_flRadius[i] );
+		if ( engine->CullBox( m_vecOrigin[i] - vecRadius, m_vecOrigin[i] + vecRadius ) )
+			continue;
+
+		if ( bTranslucentPass )
+		{
+			render->SetBlend( flBlend * m_nAlpha[i] / 255.0f );
+		}
+
+		info.origin = m_vecOrigin[i];
+		info.angles = m_angAngles[i];
+		info.pModel = m_pModel[i];
+		info.body = m_nBody[i];
+		info.pLightingOrigin = m_bHasLightingOrigin[i] ? &m_vecLightingOrigin[i] : NULL;
+
+		m_iDrawing = i;
+		if ( modelrender->DrawModelEx( info ) )
+		{
+			++nDrawn;
+		}
+	}
+	m_iDrawing = -1;
+	m_nDrawn += nDrawn;
+
+	if ( bTranslucentPass )
+	{
+		render->SetBlend( flBlend );
+	}
+
+	return nDrawn;
+}
+
+void CTempEntBatch::PrintStats()
+{
+	Msg( "  batched:      %d / %d active, peak %d, %d added, %d evicted, %d model draws last frame\n",
+		m_nCount, (int)MAX_BATCHED_TEMPENTS, m_nPeak, m_nAdded, m_nEvicted, m_nDrawnLastFrame );
+}
+
+void CTempEntBatch::ResetStats()
+{
+	m_nAdded = 0;
+	m_nEvicted = 0;
+	m_nPeak = m_nCount;
+}
+
 //-----------------------------------------------------------------------------
 // Purpose: 
 //-----------------------------------------------------------------------------
 CTempEnts::CTempEnts( void ) :
 	m_TempEntsPool( ( MAX_TEMP_ENTITIES / 20 ), CUtlMemoryPool::GROW_SLOW )
 {
+	m_nLowPriorityCount = 0;
+	memset( &m_Stats, 0, sizeof( m_Stats ) );
 }
 
 //-----------------------------------------------------------------------------
@@ -1038,6 +1554,15 @@ void CTempEnts::BreakModel( const Vector &pos, const QAngle &angles, const Vecto
 		vecLocalSpot[2] = random->RandomFloat(-0.5,0.5) * size[2];
 		VectorTransform( vecLocalSpot, transform, vecSpot );
 
+		// Batched gibs of a run light from where its first gib spawned, like g_BreakableHelper
+		if ( i == 0 && !isSlave )
+		{
+			g_TempEntBatch.SetBreakLightingOrigin( vecSpot );
+		}
+
+		if ( BreakModelBatched( vecSpot, pModel, dir, randRange, life, frameCount, flags ) )
+			continue;
+
 		pTemp = TempEntAlloc(vecSpot, pModel);
 		
 		if (!pTemp)
@@ -1097,6 +1622,48 @@ void CTempEnts::BreakModel( const Vector &pos, const QAngle &angles, const Vecto
 	}
 }
 
+//-----------------------------------------------------------------------------
+// Purpose: Spawns one BreakModel gib in g_TempEntBatch, with the same random
+//  setup the tempent gets. Returns false if the gib needs a tempent.
+//-----------------------------------------------------------------------------
+bool CTempEnts::BreakModelBatched( const Vector &vecSpot, const model_t *pModel, const Vector &dir, float randRange, float life, int frameCount, char flags )
+{
+	// Smoke trails and sprites need the tempent
+	if ( ( flags & BREAK_SMOKE ) || !CTempEntBatch::IsBatchable( pModel, FTENT_COLLIDEWORLD | FTENT_FADEOUT | FTENT_SLOWGRAVITY | FTENT_ROTATE ) )
+		return false;
+
+	BatchedTempEnt_t gib;
+	gib.m_pModel = pModel;
+	gib.m_vecOrigin = vecSpot;
+	gib.m_nHitSound = flags;
+	gib.m_nBody = random->RandomInt(0,frameCount-1);
+	gib.m_nFlags = FTENT_COLLIDEWORLD | FTENT_FADEOUT | FTENT_SLOWGRAVITY;
+
+	if ( random->RandomInt(0,255) < 200 ) 
+	{
+		gib.m_nFlags |= FTENT_ROTATE;
+		gib.m_angAngVelocity[0] = random->RandomFloat(-256,255);
+		gib.m_angAngVelocity[1] = random->RandomFloat(-256,255);
+		gib.m_angAngVelocity[2] = random->RandomFloat(-256,255);
+	}
+
+	if ((flags & BREAK_GLASS) || (flags & BREAK_TRANS))
+	{
+		gib.m_nRenderAmt = 128;
+		gib.m_flBounceFactor = 0.3f;
+	}
+
+	gib.m_vecVelocity.Init( dir[0] + random->RandomFloat(-randRange,randRange),
+		dir[1] + random->RandomFloat(-randRange,randRange),
+		dir[2] + random->RandomFloat(   0,randRange) );
+
+	gib.m_flDieTime = gpGlobals->curtime + life + random->RandomFloat(0,1);	// Add an extra 0-1 secs of life
+	gib.m_pLightingOrigin = &g_TempEntBatch.GetBreakLightingOrigin();
+
+	g_TempEntBatch.Add( gib );
+	return true;
+}
+
 void CTempEnts::PhysicsProp( int modelindex, int skin, const Vector& pos, const QAngle &angles, const Vector& vel, int flags, int effects )
 {
 	C_PhysPropClientside *pEntity = C_PhysPropClientside::CreateNew();
@@ -1649,6 +2216,30 @@ void CTempEnts::EjectBrass( const Vector &pos1, const QAngle &angles, const QAng
 	if ( pModel == NULL )
 		return;
 
+	if ( CTempEntBatch::IsBatchable( pModel, FTENT_COLLIDEWORLD | FTENT_FADEOUT | FTENT_GRAVITY | FTENT_ROTATE ) )
+	{
+		BatchedTempEnt_t shell;
+		shell.m_pModel = pModel;
+		shell.m_vecOrigin = pos1;
+		shell.m_nHitSound = ( type == 2 ) ? BOUNCE_SHOTSHELL : BOUNCE_SHELL;
+		shell.m_nFlags = FTENT_COLLIDEWORLD | FTENT_FADEOUT | FTENT_GRAVITY | FTENT_ROTATE;
+		shell.m_angAngVelocity[0] = random->RandomFloat(-1024,1024);
+		shell.m_angAngVelocity[1] = random->RandomFloat(-1024,1024);
+		shell.m_angAngVelocity[2] = random->RandomFloat(-1024,1024);
+		shell.m_angAngles = gunAngles;
+
+		Vector dir;
+		AngleVectors( angles, &dir );
+		dir *= random->RandomFloat( 150.0f, 200.0f );
+		shell.m_vecVelocity.Init( dir[0] + random->RandomFloat(-64,64),
+			dir[1] + random->RandomFloat(-64,64),
+			dir[2] + random->RandomFloat(  0,64) );
+
+		shell.m_flDieTime = gpGlobals->curtime + 1.0f + random->RandomFloat( 0.0f, 1.0f );	// Add an extra 0-1 secs of life
+		g_TempEntBatch.Add( shell );
+		return;
+	}
+
 	C_LocalTempEntity	*pTemp = TempEntAlloc( pos1, pModel );
 
 	if ( pTemp == NULL )
@@ -1939,7 +2530,10 @@ void CTempEnts::Clear( void )
 	}
 
 	m_TempEnts.RemoveAll();
+	m_PendingRelinks.RemoveAll();
+	m_nLowPriorityCount = 0;
 	g_BreakableHelper.Clear();
+	g_TempEntBatch.Clear();
 }
 
 C_LocalTempEntity *CTempEnts::FindTempEntByID( int nID, int nSubID )
@@ -1977,15 +2571,19 @@ C_LocalTempEntity *CTempEnts::TempEntAlloc( const Vector& org, const model_t *mo
 
 	if ( !pTemp )
 	{
+		++m_Stats.m_nFailedAllocs;
 		DevWarning( 1, "Overflow %d temporary ents!\n", MAX_TEMP_ENTITIES );
 		return NULL;
 	}
 
 	m_TempEnts.AddToTail( pTemp );
+	++m_Stats.m_nAllocs;
+	m_Stats.m_nPeakActive = MAX( m_Stats.m_nPeakActive, m_TempEnts.Count() );
 
 	pTemp->Prepare( model, gpGlobals->curtime );
 
 	pTemp->priority = TENTPRIORITY_LOW;
+	++m_nLowPriorityCount;
 	pTemp->SetAbsOrigin( org );
 
 	pTemp->m_RenderGroup = RENDER_GROUP_OTHER;
@@ -2027,8 +2625,17 @@ void CTempEnts::TempEntFree( int index )
 	{
 		// Remove from the active list.
 		m_TempEnts.Remove( index );
+		if ( pTemp->priority == TENTPRIORITY_LOW )
+		{
+			--m_nLowPriorityCount;
+		}
 
-		// Cleanup its data.
+		// Cleanup its data. Allocations from another tempent's Frame() can evict
+		// one that already queued its relink this update.
+		if ( m_PendingRelinks.Count() )
+		{
+			m_PendingRelinks.FindAndFastRemove( pTemp );
+		}
 		pTemp->RemoveFromLeafSystem();
 
 		// Remove the tempent from the ClientEntityList before removing it from the pool.
@@ -2052,6 +2659,10 @@ void CTempEnts::TempEntFree( int index )
 // Free the first low priority tempent it finds.
 bool CTempEnts::FreeLowPriorityTempEnt()
 {
+	// Don't walk a list full of high priority tempents
+	if ( m_nLowPriorityCount == 0 )
+		return false;
+
 	int next = 0;
 	for( int i = m_TempEnts.Head(); i != m_TempEnts.InvalidIndex(); i = next )
 	{
@@ -2062,6 +2673,7 @@ bool CTempEnts::FreeLowPriorityTempEnt()
 		if ( pActive->priority == TENTPRIORITY_LOW )
 		{
 			TempEntFree( i );
+			++m_Stats.m_nEvictions;
 			return true;
 		}
 	}
@@ -2102,11 +2714,14 @@ C_LocalTempEntity *CTempEnts::TempEntAllocHigh( const Vector& org, const model_t
 	{
 		// didn't find anything? The tent list is either full of high-priority tents
 		// or all tents in the list are still due to live for > 10 seconds. 
+		++m_Stats.m_nFailedAllocs;
 		DevWarning( 1,"Couldn't alloc a high priority TENT (max %i)!\n", MAX_TEMP_ENTITIES );
 		return NULL;
 	}
 
 	m_TempEnts.AddToTail( pTemp );
+	++m_Stats.m_nHighAllocs;
+	m_Stats.m_nPeakActive = MAX( m_Stats.m_nPeakActive, m_TempEnts.Count() );
 
 	pTemp->Prepare( model, gpGlobals->curtime );
 
@@ -2130,13 +2745,22 @@ C_LocalTempEntity *CTempEnts::TempEntAllocHigh( const Vector& org, const model_t
 //			damp - 
 //-----------------------------------------------------------------------------
 void CTempEnts::PlaySound ( C_LocalTempEntity *pTemp, float damp )
+{
+	PlayBounceSound( pTemp->hitSound, pTemp->GetAbsOrigin(), pTemp->GetVelocity()[2], damp );
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: Play the sound for a hitSound type bouncing at vecOrigin; also used
+//  by g_TempEntBatch, whose tempents aren't C_LocalTempEntity objects
+//-----------------------------------------------------------------------------
+void CTempEnts::PlayBounceSound( int hitSound, const Vector &vecOrigin, float flZVelocity, float damp )
 {
 	const char	*soundname = NULL;
 	float fvol;
 	bool isshellcasing = false;
 	int zvel;
 
-	switch ( pTemp->hitSound )
+	switch ( hitSound )
 	{
 	default:
 		return;	// null sound
@@ -2213,7 +2837,7 @@ void CTempEnts::PlaySound ( C_LocalTempEntity *pTemp, float damp )
 #endif
 	}
 
-	zvel = abs( pTemp->GetVelocity()[2] );
+	zvel = abs( flZVelocity );
 		
 	// only play one out of every n
 
@@ -2265,7 +2889,7 @@ void CTempEnts::PlaySound ( C_LocalTempEntity *pTemp, float damp )
 		ep.m_flVolume = fvol;
 		ep.m_SoundLevel = params.soundlevel;
 		ep.m_nPitch = pitch;
-		ep.m_pOrigin = &pTemp->GetAbsOrigin();
+		ep.m_pOrigin = &vecOrigin;
 
 		C_BaseEntity::EmitSound( filter, SOUND_FROM_WORLD, ep );
 	}
@@ -2302,21 +2926,49 @@ int CTempEnts::AddVisibleTempEntity( C_LocalTempEntity *pEntity )
 		// Temporary entities have no corresponding element in cl_entitylist
 		pEntity->index = -1;
 		
-		// Add to list
-		if( pEntity->m_RenderGroup == RENDER_GROUP_OTHER )
+		RenderGroup_t group = ( pEntity->m_RenderGroup == RENDER_GROUP_OTHER ) ? pEntity->GetRenderGroup() : pEntity->m_RenderGroup;
+
+		// Gibs and brass spend most of their life at rest; if nothing about
+		// this one changed since the last relink its leaves are still right.
+		if ( pEntity->m_bLeafStateValid && pEntity->GetRenderHandle() != INVALID_CLIENT_RENDER_HANDLE &&
+			pEntity->m_LeafRenderGroup == group &&
+			pEntity->m_flLeafSpriteScale == pEntity->m_flSpriteScale &&
+			VectorsAreEqual( pEntity->m_vecLeafOrigin, pEntity->GetAbsOrigin(), 0.0f ) &&
+			QAnglesAreEqual( pEntity->m_angLeafAngles, pEntity->GetAbsAngles(), 0.0f ) )
 		{
-			pEntity->AddToLeafSystem();
-		}
-		else
-		{
-			pEntity->AddToLeafSystem( pEntity->m_RenderGroup );
+			++m_Stats.m_nRelinksSkipped;
+			return 1;
 		}
 
+		// Relinked in FlushPendingRelinks, after every tempent has simulated
+		m_PendingRelinks.AddToTail( pEntity );
+		++m_Stats.m_nRelinks;
+
+		pEntity->m_bLeafStateValid = true;
+		pEntity->m_LeafRenderGroup = group;
+		pEntity->m_flLeafSpriteScale = pEntity->m_flSpriteScale;
+		pEntity->m_vecLeafOrigin = pEntity->GetAbsOrigin();
+		pEntity->m_angLeafAngles = pEntity->GetAbsAngles();
+
 		return 1;
 	}
 	return 0;
 }
 
+//-----------------------------------------------------------------------------
+// Purpose: Updates the leaf system for every tempent AddVisibleTempEntity
+//			queued, in one pass rather than between each tempent's traces
+//-----------------------------------------------------------------------------
+void CTempEnts::FlushPendingRelinks()
+{
+	FOR_EACH_VEC( m_PendingRelinks, i )
+	{
+		C_LocalTempEntity *pEntity = m_PendingRelinks[i];
+		pEntity->AddToLeafSystem( pEntity->m_LeafRenderGroup );
+	}
+	m_PendingRelinks.RemoveAll();
+}
+
 //-----------------------------------------------------------------------------
 // Purpose: Runs Temp Ent simulation routines
 //-----------------------------------------------------------------------------
@@ -2326,8 +2978,19 @@ void CTempEnts::Update(void)
 	static int gTempEntFrame = 0;
 	float		frametime;
 
+	if ( cl_tempent_debug.GetBool() )
+	{
+		engine->Con_NPrintf( 0, "tempents: %d / %d active (%d low priority), peak %d",
+			m_TempEnts.Count(), (int)MAX_TEMP_ENTITIES, m_nLowPriorityCount, m_Stats.m_nPeakActive );
+		engine->Con_NPrintf( 1, "  allocs %d low / %d high, evicted %d, failed %d, culled %d",
+			m_Stats.m_nAllocs, m_Stats.m_nHighAllocs, m_Stats.m_nEvictions, m_Stats.m_nFailedAllocs, m_Stats.m_nCulled );
+		engine->Con_NPrintf( 2, "  relinks %d, skipped at rest %d", m_Stats.m_nRelinks, m_Stats.m_nRelinksSkipped );
+		engine->Con_NPrintf( 3, "  batched %d / %d, evicted %d, %d model draws", g_TempEntBatch.Count(), (int)CTempEntBatch::MAX_BATCHED_TEMPENTS,
+			g_TempEntBatch.GetEvictedCount(), g_TempEntBatch.GetDrawnCount() );
+	}
+
 	// Don't simulate while loading
-	if ( ( m_TempEnts.Count() == 0 ) || !engine->IsInGame() )		
+	if ( ( m_TempEnts.Count() == 0 && g_TempEntBatch.Count() == 0 ) || !engine->IsInGame() )		
 	{
 		return;
 	}
@@ -2379,11 +3042,44 @@ void CTempEnts::Update(void)
 						current->flags &= ~FTENT_FADEOUT;
 
 						TempEntFree( i );
+						++m_Stats.m_nCulled;
 					}
 				}
 			}
 		}
 	}
+
+	FlushPendingRelinks();
+
+	g_TempEntBatch.Update( this, frametime );
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: Dumps pool pressure counters since the last reset
+//-----------------------------------------------------------------------------
+void CTempEnts::PrintStats( bool bReset )
+{
+	Msg( "Temp entities: %d / %d active (%d low priority), peak %d\n",
+		m_TempEnts.Count(), (int)MAX_TEMP_ENTITIES, m_nLowPriorityCount, m_Stats.m_nPeakActive );
+	Msg( "  allocations:  %d low priority, %d high priority\n", m_Stats.m_nAllocs, m_Stats.m_nHighAllocs );
+	Msg( "  evicted:      %d low priority tempents freed for high priority ones\n", m_Stats.m_nEvictions );
+	Msg( "  failed:       %d allocations with the pool full\n", m_Stats.m_nFailedAllocs );
+	Msg( "  culled:       %d freed because they couldn't be drawn\n", m_Stats.m_nCulled );
+	Msg( "  leaf relinks: %d, %d skipped for tempents at rest\n", m_Stats.m_nRelinks, m_Stats.m_nRelinksSkipped );
+	g_TempEntBatch.PrintStats();
+
+	if ( bReset )
+	{
+		memset( &m_Stats, 0, sizeof( m_Stats ) );
+		m_Stats.m_nPeakActive = m_TempEnts.Count();
+		g_TempEntBatch.ResetStats();
+	}
+}
+
+CON_COMMAND( cl_tempent_stats, "Print temp entity pool pressure since the last call. Usage: cl_tempent_stats [noreset]" )
+{
+	bool bReset = ( args.ArgC() < 2 ) || Q_stricmp( args[1], "noreset" );
+	static_cast<CTempEnts *>( tempents )->PrintStats( bReset );
 }
 
 // Recache tempents which might have been flushed
@@ -3288,6 +3984,23 @@ void CTempEnts::HL1EjectBrass( const Vector &vecPosition, const QAngle &angAngle
 	if ( pModel == NULL )
 		return;
 
+	if ( CTempEntBatch::IsBatchable( pModel, FTENT_COLLIDEWORLD | FTENT_FADEOUT | FTENT_GRAVITY | FTENT_ROTATE ) )
+	{
+		BatchedTempEnt_t shell;
+		shell.m_pModel = pModel;
+		shell.m_vecOrigin = vecPosition;
+		shell.m_nHitSound = ( nType == 1 ) ? BOUNCE_SHOTSHELL : BOUNCE_SHELL;
+		shell.m_nFlags = FTENT_COLLIDEWORLD | FTENT_FADEOUT | FTENT_GRAVITY | FTENT_ROTATE;
+		shell.m_angAngVelocity[0] = random->RandomFloat( -512,511 );
+		shell.m_angAngVelocity[1] = random->RandomFloat( -256,255 );
+		shell.m_angAngVelocity[2] = random->RandomFloat( -256,255 );
+		shell.m_angAngles = angAngles;
+		shell.m_vecVelocity = vecVelocity;
+		shell.m_flDieTime = gpGlobals->curtime + 2.5;
+		g_TempEntBatch.Add( shell );
+		return;
+	}
+
 	C_LocalTempEntity	*pTemp = TempEntAlloc( vecPosition, pModel );
 
 	if ( pTemp == NULL )
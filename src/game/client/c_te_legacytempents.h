@@ -121,6 +121,7 @@ public:
 	void					Sprite_Trail( const Vector &vecStart, const Vector &vecEnd, int modelIndex, int nCount, float flLife, float flSize, float flAmplitude, int nRenderamt, float flSpeed );
 
 	virtual void			PlaySound ( C_LocalTempEntity *pTemp, float damp );
+	void					PlayBounceSound( int hitSound, const Vector &vecOrigin, float flZVelocity, float damp );
 	virtual void			EjectBrass( const Vector &pos1, const QAngle &angles, const QAngle &gunAngles, int type );
 	virtual C_LocalTempEntity		*SpawnTempModel( const model_t *pModel, const Vector &vecOrigin, const QAngle &vecAngles, const Vector &vecVelocity, float flLifeTime, int iFlags );
 	void					RocketFlare( const Vector& pos );
@@ -129,6 +130,9 @@ public:
 	void					PhysicsProp( int modelindex, int skin, const Vector& pos, const QAngle &angles, const Vector& vel, int flags, int effects = 0 );
 	C_LocalTempEntity		*ClientProjectile( const Vector& vecOrigin, const Vector& vecVelocity, const Vector& vecAcceleration, int modelindex, int lifetime, CBaseEntity *pOwner, const char *pszImpactEffect = NULL, const char *pszParticleEffect = NULL );
 
+	// Pool pressure telemetry (cl_tempent_stats, cl_tempent_debug)
+	void					PrintStats( bool bReset );
+
 // Data
 public:
 	enum
@@ -139,9 +143,26 @@ public:
 	};
 
 private:
+	struct TempEntStats_t
+	{
+		int		m_nAllocs;
+		int		m_nHighAllocs;
+		int		m_nFailedAllocs;		// Pool full, nothing to evict
+		int		m_nEvictions;			// Low priority tempents freed to make room
+		int		m_nCulled;				// Freed because they couldn't be drawn
+		int		m_nPeakActive;
+		int		m_nRelinks;				// Leaf system updates
+		int		m_nRelinksSkipped;		// Tempents at rest that kept their leaves
+	};
+
 	// Global temp entity pool
 	CClassMemoryPool< C_LocalTempEntity >	m_TempEntsPool;
 	CUtlLinkedList< C_LocalTempEntity *, unsigned short >	m_TempEnts;
+	int						m_nLowPriorityCount;
+	TempEntStats_t			m_Stats;
+
+	// Tempents that moved this update, relinked together once simulation is done
+	CUtlVector< C_LocalTempEntity * >	m_PendingRelinks;
 
 	// Muzzle flash sprites
 	struct model_t			*m_pSpriteMuzzleFlash[10];
@@ -186,6 +207,9 @@ private:
 	bool					FreeLowPriorityTempEnt();
 
 	int						AddVisibleTempEntity( C_LocalTempEntity *pEntity );
+	void					FlushPendingRelinks();
+
+	bool					BreakModelBatched( const Vector &vecSpot, const model_t *pModel, const Vector &dir, float randRange, float life, int frameCount, char flags );
 
 	// AR2
 	void					MuzzleFlash_AR2_Player( const Vector &origin, const QAngle &angles, ClientEntityHandle_t hEntity );
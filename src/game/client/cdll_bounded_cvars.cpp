@@ -38,7 +38,7 @@ public:
 		  if ( g_bForceCLPredictOff )
 			  return 0;
 
-		  static const ConVar *pClientPredict = g_pCVar->FindVar( "sv_client_predict" );
+		  static const ConVar *pClientPredict = ConVar_FindVar( "sv_client_predict" );
 		  if ( pClientPredict && pClientPredict->GetInt() != -1 )
 		  {
 			  // Ok, the server wants to control this value.
@@ -73,8 +73,8 @@ public:
 
 	  virtual float GetFloat() const
 	  {
-		  static const ConVar *pMin = g_pCVar->FindVar( "sv_client_min_interp_ratio" );
-		  static const ConVar *pMax = g_pCVar->FindVar( "sv_client_max_interp_ratio" );
+		  static const ConVar *pMin = ConVar_FindVar( "sv_client_min_interp_ratio" );
+		  static const ConVar *pMax = ConVar_FindVar( "sv_client_max_interp_ratio" );
 		  if ( pMin && pMax && pMin->GetFloat() != -1 )
 		  {
 			  return clamp( GetBaseFloatValue(), pMin->GetFloat(), pMax->GetFloat() );
@@ -107,8 +107,8 @@ public:
 
 	  virtual float GetFloat() const
 	  {
-		  static const ConVar *pUpdateRate = g_pCVar->FindVar( "cl_updaterate" );
-		  static const ConVar *pMin = g_pCVar->FindVar( "sv_client_min_interp_ratio" );
+		  static const ConVar *pUpdateRate = ConVar_FindVar( "cl_updaterate" );
+		  static const ConVar *pMin = ConVar_FindVar( "sv_client_min_interp_ratio" );
 		  if ( pUpdateRate && pMin && pMin->GetFloat() != -1 )
 		  {
 			  return MAX( GetBaseFloatValue(), pMin->GetFloat() / pUpdateRate->GetFloat() );
@@ -125,7 +125,7 @@ ConVar_ServerBounded *cl_interp = &cl_interp_var;
 
 float GetClientInterpAmount()
 {
-	static const ConVar *pUpdateRate = g_pCVar->FindVar( "cl_updaterate" );
+	static const ConVar *pUpdateRate = ConVar_FindVar( "cl_updaterate" );
 	if ( pUpdateRate )
 	{
 		// #define FIXME_INTERP_RATIO
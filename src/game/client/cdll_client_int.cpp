@@ -75,6 +75,7 @@
 #include "game/client/IGameClientExports.h"
 #include "client_factorylist.h"
 #include "ragdoll_shared.h"
+#include "bone_setup.h"
 #include "rendertexture.h"
 #include "view_scene.h"
 #include "iclientmode.h"
@@ -983,7 +984,7 @@ int CHLClient::Init( CreateInterfaceFn appSystemFactory, CreateInterfaceFn physi
 	// Initialize the console variables.
 	ConVar_Register( FCVAR_CLIENTDLL );
 
-	g_pcv_ThreadMode = g_pCVar->FindVar( "host_thread_mode" );
+	g_pcv_ThreadMode = ConVar_FindVar( "host_thread_mode" );
 
 	if (!Initializer::InitializeAllObjects())
 		return false;
@@ -1706,6 +1707,8 @@ void CHLClient::LevelShutdown( void )
 		pClassList = pClassList->m_pNextClassList;
 	}
 
+	Studio_FlushPoseCache();
+
 	// Now do the post-entity shutdown of all systems
 	IGameSystem::LevelShutdownPostEntityAllSystems();
 
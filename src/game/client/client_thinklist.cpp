@@ -16,6 +16,7 @@ CClientThinkList g_ClientThinkList;
 
 CClientThinkList::CClientThinkList()
 {
+	RebuildWheel( 0 );
 }
 
 
@@ -65,6 +66,144 @@ void CClientThinkList::Update( float frametime )
 }
 
 
+//-----------------------------------------------------------------------------
+// Think wheel
+//-----------------------------------------------------------------------------
+int CClientThinkList::TimeToWheelTick( float flTime ) const
+{
+	// Keep absurdly distant thinks from overflowing the tick
+	flTime = clamp( flTime, 0.0f, 1.0e7f );
+	return (int)( flTime * ( 1.0f / THINK_WHEEL_RESOLUTION ) );
+}
+
+unsigned short *CClientThinkList::GetBucketHead( int nBucket )
+{
+	if ( nBucket == THINK_BUCKET_ALWAYS )
+		return &m_nAlwaysHead;
+	if ( nBucket == THINK_BUCKET_OVERFLOW )
+		return &m_nOverflowHead;
+
+	Assert( nBucket >= 0 && nBucket < THINK_WHEEL_SLOTS );
+	return &m_WheelHead[nBucket];
+}
+
+//-----------------------------------------------------------------------------
+// Links an unlinked entry into the bucket for its next think time
+//-----------------------------------------------------------------------------
+void CClientThinkList::LinkThinkEntry( unsigned short iEntry )
+{
+	ThinkEntry_t *pEntry = &m_ThinkEntries[iEntry];
+	Assert( pEntry->m_nBucket == THINK_BUCKET_NONE );
+
+	pEntry->m_nBucketPrev = m_ThinkEntries.InvalidIndex();
+	pEntry->m_nBucketNext = m_ThinkEntries.InvalidIndex();
+
+	if ( pEntry->m_flNextClientThink == CLIENT_THINK_ALWAYS )
+	{
+		pEntry->m_nBucket = THINK_BUCKET_ALWAYS;
+	}
+	else if ( pEntry->m_flNextClientThink == FLT_MAX )
+	{
+		// Not going to think again; nothing to link
+		return;
+	}
+	else
+	{
+		// Past due thinks go in the current slot
+		int nTick = MAX( TimeToWheelTick( pEntry->m_flNextClientThink ), m_nWheelTick );
+		if ( nTick - m_nWheelTick >= THINK_WHEEL_SLOTS )
+		{
+			pEntry->m_nBucket = THINK_BUCKET_OVERFLOW;
+			m_nOverflowMinTick = MIN( m_nOverflowMinTick, nTick );
+		}
+		else
+		{
+			pEntry->m_nBucket = nTick & ( THINK_WHEEL_SLOTS - 1 );
+		}
+	}
+
+	unsigned short *pHead = GetBucketHead( pEntry->m_nBucket );
+	pEntry->m_nBucketNext = *pHead;
+	if ( *pHead != m_ThinkEntries.InvalidIndex() )
+	{
+		m_ThinkEntries[*pHead].m_nBucketPrev = iEntry;
+	}
+	*pHead = iEntry;
+}
+
+void CClientThinkList::UnlinkThinkEntry( ThinkEntry_t *pEntry )
+{
+	if ( pEntry->m_nBucket == THINK_BUCKET_NONE )
+		return;
+
+	if ( pEntry->m_nBucketPrev != m_ThinkEntries.InvalidIndex() )
+	{
+		m_ThinkEntries[pEntry->m_nBucketPrev].m_nBucketNext = pEntry->m_nBucketNext;
+	}
+	else
+	{
+		*GetBucketHead( pEntry->m_nBucket ) = pEntry->m_nBucketNext;
+	}
+
+	if ( pEntry->m_nBucketNext != m_ThinkEntries.InvalidIndex() )
+	{
+		m_ThinkEntries[pEntry->m_nBucketNext].m_nBucketPrev = pEntry->m_nBucketPrev;
+	}
+
+	pEntry->m_nBucket = THINK_BUCKET_NONE;
+}
+
+void CClientThinkList::RescheduleThinkEntry( unsigned short iEntry, float flNextTime )
+{
+	ThinkEntry_t *pEntry = &m_ThinkEntries[iEntry];
+	UnlinkThinkEntry( pEntry );
+	pEntry->m_flNextClientThink = flNextTime;
+	LinkThinkEntry( iEntry );
+}
+
+//-----------------------------------------------------------------------------
+// Moves overflow entries the wheel now reaches into their slots
+//-----------------------------------------------------------------------------
+void CClientThinkList::CascadeOverflow()
+{
+	if ( m_nOverflowMinTick - m_nWheelTick >= THINK_WHEEL_SLOTS )
+		return;
+
+	// Relinking recomputes the lower bound for whatever stays behind. Entries
+	// that go back to the overflow list land in front of the walk.
+	m_nOverflowMinTick = INT_MAX;
+	unsigned short iCur = m_nOverflowHead;
+	while ( iCur != m_ThinkEntries.InvalidIndex() )
+	{
+		unsigned short iNext = m_ThinkEntries[iCur].m_nBucketNext;
+		UnlinkThinkEntry( &m_ThinkEntries[iCur] );
+		LinkThinkEntry( iCur );
+		iCur = iNext;
+	}
+}
+
+//-----------------------------------------------------------------------------
+// Rebuckets everything around a new start tick, for when time goes backwards
+//-----------------------------------------------------------------------------
+void CClientThinkList::RebuildWheel( int nTick )
+{
+	for ( int i = 0; i < THINK_WHEEL_SLOTS; ++i )
+	{
+		m_WheelHead[i] = m_ThinkEntries.InvalidIndex();
+	}
+	m_nAlwaysHead = m_ThinkEntries.InvalidIndex();
+	m_nOverflowHead = m_ThinkEntries.InvalidIndex();
+	m_nWheelTick = nTick;
+	m_nOverflowMinTick = INT_MAX;
+
+	for ( unsigned short iCur = m_ThinkEntries.Head(); iCur != m_ThinkEntries.InvalidIndex(); iCur = m_ThinkEntries.Next( iCur ) )
+	{
+		m_ThinkEntries[iCur].m_nBucket = THINK_BUCKET_NONE;
+		LinkThinkEntry( iCur );
+	}
+}
+
+
 //-----------------------------------------------------------------------------
 // Sets the client think
 //-----------------------------------------------------------------------------
@@ -89,7 +228,7 @@ void CClientThinkList::SetNextClientThink( ClientThinkHandle_t hThink, float flN
 	}
 	else
 	{
-		GetThinkEntry( hThink )->m_flNextClientThink = flNextTime;
+		RescheduleThinkEntry( (unsigned long)hThink, flNextTime );
 	}
 }
 
@@ -127,10 +266,11 @@ void CClientThinkList::SetNextClientThink( ClientEntityHandle_t hEnt, float flNe
 		pEntry->m_hEnt = hEnt;
 		pEntry->m_nIterEnum = -1;
 		pEntry->m_flLastClientThink = 0.0f;
+		pEntry->m_nBucket = THINK_BUCKET_NONE;
 	}
 
 	Assert( GetThinkEntry( hThink )->m_hEnt == hEnt );
-	GetThinkEntry( hThink )->m_flNextClientThink = flNextTime;
+	RescheduleThinkEntry( (unsigned long)hThink, flNextTime );
 }
 
 
@@ -158,6 +298,7 @@ void CClientThinkList::RemoveThinkable( ClientThinkHandle_t hThink )
 	{
 		pThink->SetThinkHandle( INVALID_THINK_HANDLE );
 	}
+	UnlinkThinkEntry( pEntry );
 	m_ThinkEntries.Remove( (unsigned long)hThink );
 }
 
@@ -207,7 +348,9 @@ void CClientThinkList::PerformThinkFunction( ThinkEntry_t *pEntry, float flCurti
 	{
 		Assert( pEntry->m_flNextClientThink <= flCurtime );
 
-		// Indicate we're not going to think again
+		// Indicate we're not going to think again. Unlinking is safe here since
+		// the frame's think list has already been built.
+		UnlinkThinkEntry( pEntry );
 		pEntry->m_flNextClientThink = FLT_MAX;
 
 		// NOTE: The Think function here could call SetNextClientThink
@@ -260,6 +403,18 @@ void CClientThinkList::AddEntityToFrameThinkList( ThinkEntry_t *pEntry, bool bAl
 }
 
 
+//-----------------------------------------------------------------------------
+// Adds every entry in one bucket to the frame think list
+//-----------------------------------------------------------------------------
+void CClientThinkList::AddBucketToFrameThinkList( unsigned short iHead, int &nCount, ThinkEntry_t **ppFrameThinkList )
+{
+	for ( unsigned short iCur = iHead; iCur != m_ThinkEntries.InvalidIndex(); iCur = m_ThinkEntries[iCur].m_nBucketNext )
+	{
+		AddEntityToFrameThinkList( &m_ThinkEntries[iCur], false, nCount, ppFrameThinkList );
+	}
+}
+
+
 //-----------------------------------------------------------------------------
 // Think for all entities that need it
 //-----------------------------------------------------------------------------
@@ -278,11 +433,26 @@ void CClientThinkList::PerformThinkFunctions()
 	// prevent bad situations where an entity can think more than once in a frame.
 	ThinkEntry_t **ppThinkEntryList = (ThinkEntry_t**)stackalloc( nMaxList * sizeof(ThinkEntry_t*) );
 	int nThinkCount = 0;
-	for ( unsigned short iCur=m_ThinkEntries.Head(); iCur != m_ThinkEntries.InvalidIndex(); iCur = m_ThinkEntries.Next( iCur ) )
+
+	// Advance the wheel to now. Only the always list and the slots passed
+	// since the last pass can hold due thinks.
+	int nTick = TimeToWheelTick( gpGlobals->curtime );
+	if ( nTick < m_nWheelTick )
+	{
+		RebuildWheel( nTick );
+	}
+
+	int nFirstTick = m_nWheelTick;
+	int nSlotCount = MIN( nTick - nFirstTick + 1, THINK_WHEEL_SLOTS );
+	m_nWheelTick = nTick;
+	CascadeOverflow();
+
+	AddBucketToFrameThinkList( m_nAlwaysHead, nThinkCount, ppThinkEntryList );
+	for ( int i = 0; i < nSlotCount; ++i )
 	{
-		AddEntityToFrameThinkList( &m_ThinkEntries[iCur], false, nThinkCount, ppThinkEntryList );
-		Assert( nThinkCount <= nMaxList );
+		AddBucketToFrameThinkList( m_WheelHead[( nFirstTick + i ) & ( THINK_WHEEL_SLOTS - 1 )], nThinkCount, ppThinkEntryList );
 	}
+	Assert( nThinkCount <= nMaxList );
 
 	// While we're in the loop, no changes to the think list are allowed
 	m_bInThinkLoop = true;
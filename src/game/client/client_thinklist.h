@@ -25,6 +25,12 @@
 
 #define INVALID_THINK_HANDLE ClientThinkList()->GetInvalidThinkHandle()
 
+// Timed thinks are bucketed in a wheel of THINK_WHEEL_SLOTS slots, each
+// THINK_WHEEL_RESOLUTION seconds wide. Thinks further out than the wheel
+// spans wait in an overflow list until it comes around.
+#define THINK_WHEEL_SLOTS		256		// Must be a power of two
+#define THINK_WHEEL_RESOLUTION	( 1.0f / 32.0f )
+
 
 class CClientThinkList : public IGameSystemPerFrame
 {
@@ -77,6 +83,18 @@ private:
 		float					m_flNextClientThink;
 		float					m_flLastClientThink;
 		int						m_nIterEnum;
+
+		// Which bucket this is linked into; a wheel slot or one of THINK_BUCKET_
+		int						m_nBucket;
+		unsigned short			m_nBucketPrev;
+		unsigned short			m_nBucketNext;
+	};
+
+	enum
+	{
+		THINK_BUCKET_NONE = -1,		// Not scheduled (FLT_MAX), only kept for hierarchy
+		THINK_BUCKET_ALWAYS = -2,
+		THINK_BUCKET_OVERFLOW = -3,
 	};
 
 	struct ThinkListChanges_t
@@ -94,12 +112,28 @@ private:
 	ThinkEntry_t*	GetThinkEntry( ClientThinkHandle_t hThink );
 	void			CleanUpDeleteList();
 
+	// Think wheel
+	int				TimeToWheelTick( float flTime ) const;
+	unsigned short	*GetBucketHead( int nBucket );
+	void			LinkThinkEntry( unsigned short iEntry );
+	void			UnlinkThinkEntry( ThinkEntry_t *pEntry );
+	void			RescheduleThinkEntry( unsigned short iEntry, float flNextTime );
+	void			CascadeOverflow();
+	void			RebuildWheel( int nTick );
+	void			AddBucketToFrameThinkList( unsigned short iHead, int &nCount, ThinkEntry_t **ppFrameThinkList );
+
 	// Add entity to frame think list
 	void			AddEntityToFrameThinkList( ThinkEntry_t *pEntry, bool bAlwaysChain, int &nCount, ThinkEntry_t **ppFrameThinkList );
 
 private:
 	CUtlLinkedList<ThinkEntry_t, unsigned short>	m_ThinkEntries;
 
+	unsigned short	m_WheelHead[THINK_WHEEL_SLOTS];
+	unsigned short	m_nAlwaysHead;
+	unsigned short	m_nOverflowHead;
+	int				m_nWheelTick;			// Earliest tick the wheel holds
+	int				m_nOverflowMinTick;		// Lower bound on the ticks in the overflow list
+
 	CUtlVector<ClientEntityHandle_t>	m_aDeleteList;
 	CUtlVector<ThinkListChanges_t>		m_aChangeList;
 
@@ -33,6 +33,8 @@ static ConVar cl_drawleaf("cl_drawleaf", "-1", FCVAR_CHEAT );
 static ConVar r_PortalTestEnts( "r_PortalTestEnts", "1", FCVAR_CHEAT, "Clip entities against portal frustums." );
 static ConVar r_portalsopenall( "r_portalsopenall", "0", FCVAR_CHEAT, "Open all portals" );
 static ConVar cl_threaded_client_leaf_system("cl_threaded_client_leaf_system", "0"  );
+static ConVar cl_leafsystem_flat_collate( "cl_leafsystem_flat_collate", "1", 0, "Collate renderables from flat per-leaf arrays, reusing each renderable's world space bounds across the views of a frame." );
+static ConVar cl_leafsystem_incremental_reinsert( "cl_leafsystem_incremental_reinsert", "1", 0, "When a renderable moves, only relink it to the leaves it entered or left instead of removing it from every leaf and reinserting it." );
 
 
 DEFINE_FIXEDSIZE_ALLOCATOR( CClientRenderablesList, 1, CUtlMemoryPool::GROW_SLOW );
@@ -112,6 +114,7 @@ public:
 	virtual void CollateViewModelRenderables( CUtlVector< IClientRenderable * >& opaque, CUtlVector< IClientRenderable * >& translucent );
 	virtual void BuildRenderablesList( const SetupRenderInfo_t &info );
 			void CollateRenderablesInLeaf( int leaf, int worldListLeafIndex, const SetupRenderInfo_t &info );
+			void CollateRenderable( ClientRenderHandle_t handle, int leaf, int worldListLeafIndex, const SetupRenderInfo_t &info, bool bPortalTestEnts, bool bCachedBounds );
 	virtual void DrawStaticProps( bool enable );
 	virtual void DrawSmallEntities( bool enable );
 	virtual void EnableAlternateSorting( ClientRenderHandle_t handle, bool bEnable );
@@ -144,6 +147,13 @@ public:
 	// Get leaves this renderable is in
 	virtual bool GetRenderableLeaf ( ClientRenderHandle_t handle, int* pOutLeaf, const int* pInIterator = 0, int* pOutIterator = 0 );
 
+	// Prints how dirty renderables were relinked since the last reset
+	void PrintReinsertStats( bool bReset );
+
+	// Times BuildRenderablesList over the next nFrames frames, alternating between
+	// the linked list collation and the flat per-leaf arrays every frame
+	void StartCollateBenchmark( int nFrames );
+
 	// Singleton instance...
 	static CClientLeafSystem s_ClientLeafSystem;
 
@@ -154,6 +164,9 @@ private:
 	// Adds a renderable to the list of renderables
 	void AddRenderableToLeaf( int leaf, ClientRenderHandle_t handle );
 
+	// Adds all shadows in a leaf to a renderable
+	void AddShadowsInLeafToRenderable( int leaf, ClientRenderHandle_t handle );
+
 	void SortEntities(  const Vector &vecRenderOrigin, const Vector &vecRenderForward, CClientRenderablesList::CEntry *pEntities, int nEntities );
 
 	// Returns -1 if the renderable spans more than one area. If it's totally in one area, then this returns the leaf.
@@ -163,6 +176,22 @@ private:
 	void InsertIntoTree( ClientRenderHandle_t &handle );
 	void RemoveFromTree( ClientRenderHandle_t handle );
 
+	// Relinks a dirty renderable, only touching the leaves it entered or left
+	void ReinsertIntoTree( ClientRenderHandle_t handle );
+
+	// Sorts the first nDirty dirty renderables by the leaf they were last in
+	void SortDirtyRenderables( int nDirty );
+
+	// Returns the renderables in a leaf as an array, rebuilding it if the leaf changed
+	const CUtlVector< ClientRenderHandle_t > &GetRenderableArrayInLeaf( int leaf );
+	void MarkRenderableArrayDirty( int leaf );
+
+	// World space bounds, computed at most once a frame unless the renderable moves
+	void GetCachedRenderableWorldSpaceAABB( ClientRenderHandle_t handle, Vector &absMins, Vector &absMaxs );
+
+	void UpdateCollateBenchmark();
+	static int __cdecl DirtySortCompare( const void *p1, const void *p2 );
+
 	// Returns if it's a view model render group
 	inline bool IsViewModelRenderGroup( RenderGroup_t group ) const;
 
@@ -238,23 +267,50 @@ private:
 		RENDER_FLAGS_STUDIO_MODEL	= 0x08,
 		RENDER_FLAGS_HASCHANGED		= 0x10,
 		RENDER_FLAGS_ALTERNATE_SORTING = 0x20,
+		RENDER_FLAGS_LINKED_BOUNDS_VALID = 0x40,	// m_vecLinkedAbsMins/Maxs are the bounds of the current leaf list
 	};
 
 	// All the information associated with a particular handle
 	struct RenderableInfo_t
 	{
+		// Everything CollateRenderablesInLeaf reads comes first, so it's packed in one cache line
 		IClientRenderable*	m_pRenderable;
-		int					m_RenderFrame;	// which frame did I render it in?
+		unsigned char		m_Flags;		// rendering flags
+		unsigned char		m_RenderGroup;	// RenderGroup_t type
+		short m_Area;	// -1 if the renderable spans multiple areas.
 		int					m_RenderFrame2;
+		unsigned int		m_RenderLeaf;	// What leaf do I render in?
+		int					m_CachedBoundsFrame;	// which frame were m_vecCachedAbsMins/Maxs computed in?
+		Vector				m_vecCachedAbsMins;
+		Vector				m_vecCachedAbsMaxs;
+
+		int					m_RenderFrame;	// which frame did I render it in?
 		int					m_EnumCount;	// Have I been added to a particular shadow yet?
 		int					m_TranslucencyCalculated;
 		unsigned int		m_LeafList;		// What leafs is it in?
-		unsigned int		m_RenderLeaf;	// What leaf do I render in?
-		unsigned char		m_Flags;		// rendering flags
-		unsigned char		m_RenderGroup;	// RenderGroup_t type
 		unsigned short		m_FirstShadow;	// The first shadow caster that cast on it
-		short m_Area;	// -1 if the renderable spans multiple areas.
 		signed char			m_TranslucencyCalculatedView;
+		Vector				m_vecLinkedAbsMins;	// Bounds it was last inserted into the tree with
+		Vector				m_vecLinkedAbsMaxs;
+	};
+
+	// Renderables in a leaf, flattened out of m_RenderablesInLeaf
+	struct LeafRenderableArray_t
+	{
+		CUtlVector< ClientRenderHandle_t >	m_Handles;
+		bool								m_bDirty;
+	};
+
+	// BuildRenderablesList timings for cl_bench_leafsystem_collate
+	struct CollateBenchmark_t
+	{
+		int		m_nFramesPerPass;
+		int		m_nFramesLeft;
+		int		m_nPass;		// 0 = linked lists, 1 = flat arrays, -1 = not running. Alternates every frame.
+		bool	m_bSavedFlatCollate;
+		int		m_nCalls[2];
+		int		m_nRenderables[2];
+		double	m_flTime[2];
 	};
 
 	// The leaf contains an index into a list of renderables
@@ -292,9 +348,29 @@ private:
 		ClientRenderHandle_t handle;
 	};
 
+	struct DirtySortEntry_t
+	{
+		int m_nLeaf;
+		ClientRenderHandle_t m_hRenderable;
+	};
+
+	// How dirty renderables got relinked in PreRender
+	struct ReinsertStats_t
+	{
+		int m_nFull;			// removed from every leaf and reinserted
+		int m_nSkippedBounds;	// bounds didn't change
+		int m_nSkippedLeaves;	// bounds changed, but the leaf set didn't
+		int m_nPartial;			// only the leaves entered or left were touched
+		int m_nLeavesEntered;
+		int m_nLeavesLeft;
+	};
+
 	// Stores data associated with each leaf.
 	CUtlVector< ClientLeaf_t >	m_Leaf;
 
+	// Same indexing as m_Leaf
+	CUtlVector< LeafRenderableArray_t >	m_RenderableArrayInLeaf;
+
 	// Stores all unique non-detail renderables
 	CUtlLinkedList< RenderableInfo_t, ClientRenderHandle_t, false, unsigned int >	m_Renderables;
 
@@ -312,6 +388,9 @@ private:
 
 	// Dirty list of renderables
 	CUtlVector< ClientRenderHandle_t >	m_DirtyRenderables;
+	CUtlVector< DirtySortEntry_t >		m_DirtySort;
+	ReinsertStats_t						m_ReinsertStats;
+	CollateBenchmark_t					m_CollateBenchmark;
 
 	// List of renderables in view model render groups
 	CUtlVector< ClientRenderHandle_t >	m_ViewModels;
@@ -442,6 +521,9 @@ CClientLeafSystem::CClientLeafSystem() : m_DrawStaticProps(true), m_DrawSmallObj
 	m_RenderablesInLeaf.Init( FirstRenderableInLeaf, FirstLeafInRenderable );
 	m_ShadowsInLeaf.Init( FirstShadowInLeaf, FirstLeafInShadow ); 
 	m_ShadowsOnRenderable.Init( FirstShadowOnRenderable, FirstRenderableInShadow );
+	memset( &m_ReinsertStats, 0, sizeof( m_ReinsertStats ) );
+	memset( &m_CollateBenchmark, 0, sizeof( m_CollateBenchmark ) );
+	m_CollateBenchmark.m_nPass = -1;
 }
 
 CClientLeafSystem::~CClientLeafSystem()
@@ -490,6 +572,12 @@ void CClientLeafSystem::LevelInitPreEntity()
 	{
 		m_Leaf.AddToTail( newLeaf );
 	}
+
+	m_RenderableArrayInLeaf.SetCount( m_Leaf.Count() );
+	for ( int i = 0; i < m_RenderableArrayInLeaf.Count(); ++i )
+	{
+		m_RenderableArrayInLeaf[i].m_bDirty = false;
+	}
 }
 
 void CClientLeafSystem::LevelShutdownPreEntity()
@@ -516,6 +604,7 @@ void CClientLeafSystem::LevelShutdownPostEntity()
 		}
 	}
 	m_Leaf.Purge();
+	m_RenderableArrayInLeaf.Purge();
 	m_ShadowsInLeaf.Purge();
 	m_ShadowsOnRenderable.Purge();
 	m_DirtyRenderables.Purge();
@@ -529,6 +618,11 @@ void CClientLeafSystem::PreRender()
 {
 	VPROF_BUDGET( "CClientLeafSystem::PreRender", "PreRender" );
 
+	if ( m_CollateBenchmark.m_nPass >= 0 )
+	{
+		UpdateCollateBenchmark();
+	}
+
 	int i;
 	int nIterations = 0;
 
@@ -541,26 +635,31 @@ void CClientLeafSystem::PreRender()
 		}
 
 		int nDirty = m_DirtyRenderables.Count();
-		for ( i = nDirty; --i >= 0; )
-		{
-			ClientRenderHandle_t handle = m_DirtyRenderables[i];
-			Assert( m_Renderables[ handle ].m_Flags & RENDER_FLAGS_HASCHANGED );
-
-			// Update position in leaf system
-			RemoveFromTree( handle );
-		}
-
 		bool bThreaded = false;//( nDirty > 5 && cl_threaded_client_leaf_system.GetBool() && g_pThreadPool->NumThreads() );
 
 		if ( !bThreaded )
 		{
+			// Renderables that share leaves get relinked back to back
+			SortDirtyRenderables( nDirty );
+
 			for ( i = nDirty; --i >= 0; )
 			{
-				InsertIntoTree( m_DirtyRenderables[i] );
+				Assert( m_Renderables[ m_DirtyRenderables[i] ].m_Flags & RENDER_FLAGS_HASCHANGED );
+				ReinsertIntoTree( m_DirtyRenderables[i] );
 			}
 		}
 		else
 		{
+			for ( i = nDirty; --i >= 0; )
+			{
+				ClientRenderHandle_t handle = m_DirtyRenderables[i];
+				Assert( m_Renderables[ handle ].m_Flags & RENDER_FLAGS_HASCHANGED );
+
+				// Update position in leaf system
+				RemoveFromTree( handle );
+			}
+			m_ReinsertStats.m_nFull += nDirty;
+
 			// InsertIntoTree can result in new renderables being added, so copy:
 			ClientRenderHandle_t *pDirtyRenderables = (ClientRenderHandle_t *)alloca( sizeof(ClientRenderHandle_t) * nDirty );
 			memcpy( pDirtyRenderables, m_DirtyRenderables.Base(), sizeof(ClientRenderHandle_t) * nDirty );
@@ -631,6 +730,7 @@ void CClientLeafSystem::NewRenderable( IClientRenderable* pRenderable, RenderGro
 	info.m_RenderGroup = (unsigned char)type;
 	info.m_EnumCount = 0;
 	info.m_RenderLeaf = m_RenderablesInLeaf.InvalidIndex();
+	info.m_CachedBoundsFrame = -1;
 	if ( IsViewModelRenderGroup( (RenderGroup_t)info.m_RenderGroup ) )
 	{
 		AddToViewModelList( handle );
@@ -1141,7 +1241,16 @@ void CClientLeafSystem::AddRenderableToLeaf( int leaf, ClientRenderHandle_t rend
 #endif // DUMP_RENDERABLE_LEAFS
 
 	m_RenderablesInLeaf.AddElementToBucket(leaf, renderable);
+	MarkRenderableArrayDirty( leaf );
+	AddShadowsInLeafToRenderable( leaf, renderable );
+}
+
 
+//-----------------------------------------------------------------------------
+// Adds all shadows in a leaf to a renderable
+//-----------------------------------------------------------------------------
+void CClientLeafSystem::AddShadowsInLeafToRenderable( int leaf, ClientRenderHandle_t renderable )
+{
 	if ( !ShouldRenderableReceiveShadow( renderable, SHADOW_FLAGS_PROJECTED_TEXTURE_TYPE_MASK ) )
 		return;
 
@@ -1174,6 +1283,9 @@ void CClientLeafSystem::AddRenderableToLeaves( ClientRenderHandle_t handle, int
 		AddRenderableToLeaf( pLeaves[j], handle ); 
 	}
 	m_Renderables[handle].m_Area = GetRenderableArea( handle );
+
+	// The leaves didn't come from the renderable's bounds
+	m_Renderables[handle].m_Flags &= ~RENDER_FLAGS_LINKED_BOUNDS_VALID;
 }
 
 
@@ -1215,6 +1327,11 @@ void CClientLeafSystem::InsertIntoTree( ClientRenderHandle_t &handle )
 	CalcRenderableWorldSpaceAABB_Fast( pRenderable, absMins, absMaxs );
 	Assert( absMins.IsValid() && absMaxs.IsValid() );
 
+	RenderableInfo_t &info = m_Renderables[handle];
+	info.m_vecLinkedAbsMins = absMins;
+	info.m_vecLinkedAbsMaxs = absMaxs;
+	info.m_Flags |= RENDER_FLAGS_LINKED_BOUNDS_VALID;
+
 	ISpatialQuery* pQuery = engine->GetBSPTreeQuery();
 	pQuery->EnumerateLeavesInBox( absMins, absMaxs, this, (int)&list );
 
@@ -1229,6 +1346,10 @@ void CClientLeafSystem::InsertIntoTree( ClientRenderHandle_t &handle )
 //-----------------------------------------------------------------------------
 void CClientLeafSystem::RemoveFromTree( ClientRenderHandle_t handle )
 {
+	for ( unsigned int i = m_RenderablesInLeaf.FirstBucket( handle ); i != m_RenderablesInLeaf.InvalidIndex(); i = m_RenderablesInLeaf.NextBucket( i ) )
+	{
+		MarkRenderableArrayDirty( m_RenderablesInLeaf.Bucket( i ) );
+	}
 	m_RenderablesInLeaf.RemoveElement( handle );
 
 	// Remove all shadows cast onto the object
@@ -1248,6 +1369,207 @@ void CClientLeafSystem::RemoveFromTree( ClientRenderHandle_t handle )
 }
 
 
+//-----------------------------------------------------------------------------
+// Collects the leaves touched by a box, for ReinsertIntoTree
+//-----------------------------------------------------------------------------
+typedef CUtlVectorFixedGrowable< int, 64 > LeafList_t;
+
+class CLeafListEnumerator : public ISpatialLeafEnumerator
+{
+public:
+	CLeafListEnumerator( LeafList_t &leaves ) : m_Leaves( leaves ) {}
+
+	bool EnumerateLeaf( int leaf, int context )
+	{
+		m_Leaves.AddToTail( leaf );
+		return true;
+	}
+
+private:
+	LeafList_t &m_Leaves;
+};
+
+static int __cdecl LeafCompare( const int *pLeaf1, const int *pLeaf2 )
+{
+	return *pLeaf1 - *pLeaf2;
+}
+
+int __cdecl CClientLeafSystem::DirtySortCompare( const void *p1, const void *p2 )
+{
+	// Sorts by leaf, renderables that aren't in a leaf (-1) go last
+	unsigned int nLeaf1 = (unsigned int)( (const DirtySortEntry_t *)p1 )->m_nLeaf;
+	unsigned int nLeaf2 = (unsigned int)( (const DirtySortEntry_t *)p2 )->m_nLeaf;
+	return ( nLeaf1 < nLeaf2 ) ? -1 : ( nLeaf1 > nLeaf2 );
+}
+
+
+//-----------------------------------------------------------------------------
+// Relinks a dirty renderable, only touching the leaves it entered or left
+//-----------------------------------------------------------------------------
+void CClientLeafSystem::ReinsertIntoTree( ClientRenderHandle_t handle )
+{
+	RenderableInfo_t &info = m_Renderables[handle];
+
+	// Brush models always take the slow path so the shadow manager re-projects the
+	// shadows they receive. Anything never inserted from its bounds has nothing to diff against.
+	if ( !cl_leafsystem_incremental_reinsert.GetBool() || 
+		( info.m_Flags & ( RENDER_FLAGS_LINKED_BOUNDS_VALID | RENDER_FLAGS_BRUSH_MODEL ) ) != RENDER_FLAGS_LINKED_BOUNDS_VALID )
+	{
+		++m_ReinsertStats.m_nFull;
+		RemoveFromTree( handle );
+		InsertIntoTree( handle );
+		return;
+	}
+
+	Vector absMins, absMaxs;
+	CalcRenderableWorldSpaceAABB_Fast( info.m_pRenderable, absMins, absMaxs );
+	Assert( absMins.IsValid() && absMaxs.IsValid() );
+
+	if ( absMins == info.m_vecLinkedAbsMins && absMaxs == info.m_vecLinkedAbsMaxs )
+	{
+		++m_ReinsertStats.m_nSkippedBounds;
+		return;
+	}
+
+	info.m_vecLinkedAbsMins = absMins;
+	info.m_vecLinkedAbsMaxs = absMaxs;
+
+	LeafList_t newLeaves;
+	CLeafListEnumerator enumerator( newLeaves );
+	engine->GetBSPTreeQuery()->EnumerateLeavesInBox( absMins, absMaxs, &enumerator, 0 );
+	newLeaves.Sort( LeafCompare );
+
+	LeafList_t oldLeaves;
+	for ( unsigned int i = m_RenderablesInLeaf.FirstBucket( handle ); i != m_RenderablesInLeaf.InvalidIndex(); i = m_RenderablesInLeaf.NextBucket( i ) )
+	{
+		oldLeaves.AddToTail( m_RenderablesInLeaf.Bucket( i ) );
+	}
+	oldLeaves.Sort( LeafCompare );
+
+	// Walk both sorted lists, unlinking the leaves we left and remembering the ones we entered
+	LeafList_t enteredLeaves;
+	int nLeft = 0;
+	int nOld = 0, nNew = 0;
+	while ( nOld < oldLeaves.Count() || nNew < newLeaves.Count() )
+	{
+		if ( nNew == newLeaves.Count() || ( nOld < oldLeaves.Count() && oldLeaves[nOld] < newLeaves[nNew] ) )
+		{
+			MarkRenderableArrayDirty( oldLeaves[nOld] );
+			m_RenderablesInLeaf.RemoveElementFromBucket( oldLeaves[nOld++], handle );
+			++nLeft;
+		}
+		else if ( nOld == oldLeaves.Count() || newLeaves[nNew] < oldLeaves[nOld] )
+		{
+			enteredLeaves.AddToTail( newLeaves[nNew++] );
+		}
+		else
+		{
+			++nOld;
+			++nNew;
+		}
+	}
+
+	if ( !nLeft && !enteredLeaves.Count() )
+	{
+		++m_ReinsertStats.m_nSkippedLeaves;
+		return;
+	}
+
+	++m_ReinsertStats.m_nPartial;
+	m_ReinsertStats.m_nLeavesLeft += nLeft;
+	m_ReinsertStats.m_nLeavesEntered += enteredLeaves.Count();
+
+	// Make sure each shadow is added exactly once to the renderable
+	m_ShadowEnum++;
+
+	if ( nLeft && ( info.m_FirstShadow != m_ShadowsOnRenderable.InvalidIndex() ) )
+	{
+		// Some of the shadows may only have reached us through the leaves we left,
+		// so rebuild the list from the leaves we stayed in.
+		m_ShadowsOnRenderable.RemoveBucket( handle );
+		if ( info.m_Flags & RENDER_FLAGS_STUDIO_MODEL )
+		{
+			g_pClientShadowMgr->RemoveAllShadowsFromReceiver( info.m_pRenderable, SHADOW_RECEIVER_STUDIO_MODEL );
+		}
+
+		for ( unsigned int i = m_RenderablesInLeaf.FirstBucket( handle ); i != m_RenderablesInLeaf.InvalidIndex(); i = m_RenderablesInLeaf.NextBucket( i ) )
+		{
+			AddShadowsInLeafToRenderable( m_RenderablesInLeaf.Bucket( i ), handle );
+		}
+	}
+	else
+	{
+		// Don't add the shadows we already have again
+		for ( unsigned short i = m_ShadowsOnRenderable.FirstElement( handle ); i != m_ShadowsOnRenderable.InvalidIndex(); i = m_ShadowsOnRenderable.NextElement( i ) )
+		{
+			m_Shadows[ m_ShadowsOnRenderable.Element( i ) ].m_EnumCount = m_ShadowEnum;
+		}
+	}
+
+	for ( int i = 0; i < enteredLeaves.Count(); ++i )
+	{
+		AddRenderableToLeaf( enteredLeaves[i], handle );
+	}
+}
+
+
+//-----------------------------------------------------------------------------
+// Sorts the first nDirty dirty renderables by the leaf they were last in, so
+// renderables that share leaves are relinked back to back
+//-----------------------------------------------------------------------------
+void CClientLeafSystem::SortDirtyRenderables( int nDirty )
+{
+	if ( nDirty < 2 )
+		return;
+
+	m_DirtySort.SetCount( nDirty );
+	for ( int i = 0; i < nDirty; ++i )
+	{
+		ClientRenderHandle_t handle = m_DirtyRenderables[i];
+		unsigned int nFirstLeaf = m_RenderablesInLeaf.FirstBucket( handle );
+
+		m_DirtySort[i].m_nLeaf = ( nFirstLeaf != m_RenderablesInLeaf.InvalidIndex() ) ? m_RenderablesInLeaf.Bucket( nFirstLeaf ) : -1;
+		m_DirtySort[i].m_hRenderable = handle;
+	}
+
+	qsort( m_DirtySort.Base(), nDirty, sizeof( DirtySortEntry_t ), DirtySortCompare );
+
+	for ( int i = 0; i < nDirty; ++i )
+	{
+		m_DirtyRenderables[i] = m_DirtySort[i].m_hRenderable;
+	}
+}
+
+
+//-----------------------------------------------------------------------------
+// Prints how dirty renderables were relinked since the last reset
+//-----------------------------------------------------------------------------
+void CClientLeafSystem::PrintReinsertStats( bool bReset )
+{
+	const ReinsertStats_t &stats = m_ReinsertStats;
+	int nTotal = stats.m_nFull + stats.m_nSkippedBounds + stats.m_nSkippedLeaves + stats.m_nPartial;
+	float flScale = nTotal ? 100.0f / nTotal : 0.0f;
+
+	Msg( "Client leaf system reinserts: %d\n", nTotal );
+	Msg( "  full:                  %8d (%5.1f%%)\n", stats.m_nFull, stats.m_nFull * flScale );
+	Msg( "  skipped (same bounds): %8d (%5.1f%%)\n", stats.m_nSkippedBounds, stats.m_nSkippedBounds * flScale );
+	Msg( "  skipped (same leaves): %8d (%5.1f%%)\n", stats.m_nSkippedLeaves, stats.m_nSkippedLeaves * flScale );
+	Msg( "  partial:               %8d (%5.1f%%), %d leaves entered, %d leaves left\n", 
+		stats.m_nPartial, stats.m_nPartial * flScale, stats.m_nLeavesEntered, stats.m_nLeavesLeft );
+
+	if ( bReset )
+	{
+		memset( &m_ReinsertStats, 0, sizeof( m_ReinsertStats ) );
+	}
+}
+
+CON_COMMAND_F( cl_leafsystem_reinsert_stats, "Prints how many moving renderables were fully reinserted into the leaf system vs. skipped or partially relinked. Pass 'reset' to clear the counters.", FCVAR_CHEAT )
+{
+	bool bReset = ( args.ArgC() > 1 ) && !Q_stricmp( args[1], "reset" );
+	CClientLeafSystem::s_ClientLeafSystem.PrintReinsertStats( bReset );
+}
+
+
 //-----------------------------------------------------------------------------
 // Call this when the renderable moves
 //-----------------------------------------------------------------------------
@@ -1258,6 +1580,9 @@ void CClientLeafSystem::RenderableChanged( ClientRenderHandle_t handle )
 	if ( !m_Renderables.IsValidIndex( handle ) )
 		return;
 
+	// It may move between views, so its bounds can't be reused
+	m_Renderables[handle].m_CachedBoundsFrame = -1;
+
 	if ( (m_Renderables[handle].m_Flags & RENDER_FLAGS_HASCHANGED ) == 0 )
 	{
 		m_Renderables[handle].m_Flags |= RENDER_FLAGS_HASCHANGED;
@@ -1551,147 +1876,76 @@ static RenderGroup_t DetectBucketedRenderGroup( RenderGroup_t group, float fDime
 	return bucketedGroup;
 }
 
-void CClientLeafSystem::CollateRenderablesInLeaf( int leaf, int worldListLeafIndex,	const SetupRenderInfo_t &info )
+//-----------------------------------------------------------------------------
+// Flat per-leaf renderable arrays
+//-----------------------------------------------------------------------------
+inline void CClientLeafSystem::MarkRenderableArrayDirty( int leaf )
 {
-	bool portalTestEnts = r_PortalTestEnts.GetBool() && !r_portalsopenall.GetBool();
-	
-	// Place a fake entity for static/opaque ents in this leaf
-	AddRenderableToRenderList( *info.m_pRenderList, NULL, worldListLeafIndex, RENDER_GROUP_OPAQUE_STATIC, NULL );
-	AddRenderableToRenderList( *info.m_pRenderList, NULL, worldListLeafIndex, RENDER_GROUP_OPAQUE_ENTITY, NULL );
-
-	// Collate everything.
-	unsigned int idx = m_RenderablesInLeaf.FirstElement(leaf);
-	for ( ;idx != m_RenderablesInLeaf.InvalidIndex(); idx = m_RenderablesInLeaf.NextElement(idx) )
+	if ( leaf < m_RenderableArrayInLeaf.Count() )
 	{
-		ClientRenderHandle_t handle = m_RenderablesInLeaf.Element(idx);
-		RenderableInfo_t& renderable = m_Renderables[handle];
-
-		// Early out on static props if we don't want to render them
-		if ((!m_DrawStaticProps) && (renderable.m_Flags & RENDER_FLAGS_STATIC_PROP))
-			continue;
-
-		// Early out if we're told to not draw small objects (top view only,
-		/* that's why we don't check the z component).
-		if (!m_DrawSmallObjects)
-		{
-			CCachedRenderInfo& cachedInfo =  m_CachedRenderInfos[renderable.m_CachedRenderInfo];
-			float sizeX = cachedInfo.m_Maxs.x - cachedInfo.m_Mins.x;
-			float sizeY = cachedInfo.m_Maxs.y - cachedInfo.m_Mins.y;
-			if ((sizeX < 50.f) && (sizeY < 50.f))
-				continue;
-		}*/
-
-		Assert( m_DrawSmallObjects ); // MOTODO
-
-		// Don't hit the same ent in multiple leaves twice.
-		if ( renderable.m_RenderGroup != RENDER_GROUP_TRANSLUCENT_ENTITY )
-		{
-			if ( renderable.m_RenderFrame2 == info.m_nRenderFrame )
-				continue;
-
-			renderable.m_RenderFrame2 = info.m_nRenderFrame;
-		}
-		else // translucent
-		{
-			// Shadow depth skips ComputeTranslucentRenderLeaf!
-
-			// Translucent entities already have had ComputeTranslucentRenderLeaf called on them
-			// so m_RenderLeaf should be set to the nearest leaf, so that's what we want here.
-			if ( renderable.m_RenderLeaf != leaf )
-				continue;
-		}
-
-		unsigned char nAlpha = 255;
-		if ( info.m_bDrawTranslucentObjects ) 
-		{
-			// Prevent culling if the renderable is invisible
-			// NOTE: OPAQUE objects can have alpha == 0. 
-			// They are made to be opaque because they don't have to be sorted.
-			nAlpha = renderable.m_pRenderable->GetFxBlend();
-			if ( nAlpha == 0 )
-				continue;
-		}
+		m_RenderableArrayInLeaf[leaf].m_bDirty = true;
+	}
+}
 
-		Vector absMins, absMaxs;
-		CalcRenderableWorldSpaceAABB( renderable.m_pRenderable, absMins, absMaxs );
-		// If the renderable is inside an area, cull it using the frustum for that area.
-		if ( portalTestEnts && renderable.m_Area != -1 )
-		{
-			VPROF( "r_PortalTestEnts" );
-			if ( !engine->DoesBoxTouchAreaFrustum( absMins, absMaxs, renderable.m_Area ) )
-				continue;
-		}
-		else
+const CUtlVector< ClientRenderHandle_t > &CClientLeafSystem::GetRenderableArrayInLeaf( int leaf )
+{
+	LeafRenderableArray_t &leafArray = m_RenderableArrayInLeaf[leaf];
+	if ( leafArray.m_bDirty )
+	{
+		// Keep the linked list order so the render lists come out the same
+		leafArray.m_Handles.RemoveAll();
+		for ( unsigned int idx = m_RenderablesInLeaf.FirstElement( leaf ); idx != m_RenderablesInLeaf.InvalidIndex(); idx = m_RenderablesInLeaf.NextElement( idx ) )
 		{
-			// cull with main frustum
-			if ( engine->CullBox( absMins, absMaxs ) )
-				continue;
+			leafArray.m_Handles.AddToTail( m_RenderablesInLeaf.Element( idx ) );
 		}
+		leafArray.m_bDirty = false;
+	}
+	return leafArray.m_Handles;
+}
 
-		// UNDONE: Investigate speed tradeoffs of occlusion culling brush models too?
-		if ( renderable.m_Flags & RENDER_FLAGS_STUDIO_MODEL )
-		{
-			// test to see if this renderable is occluded by the engine's occlusion system
-			if ( engine->IsOccluded( absMins, absMaxs ) )
-				continue;
-		}
 
-#ifdef INVASION_CLIENT_DLL
-		if (info.m_flRenderDistSq != 0.0f)
-		{
-			Vector mins, maxs;
-			renderable.m_pRenderable->GetRenderBounds( mins, maxs );
+//-----------------------------------------------------------------------------
+// World space bounds, computed at most once a frame unless the renderable moves.
+// Every view of a frame collates the same renderables, so all but the first reuse them.
+//-----------------------------------------------------------------------------
+inline void CClientLeafSystem::GetCachedRenderableWorldSpaceAABB( ClientRenderHandle_t handle, Vector &absMins, Vector &absMaxs )
+{
+	RenderableInfo_t &renderable = m_Renderables[handle];
+	if ( renderable.m_CachedBoundsFrame != gpGlobals->framecount )
+	{
+		CalcRenderableWorldSpaceAABB( renderable.m_pRenderable, renderable.m_vecCachedAbsMins, renderable.m_vecCachedAbsMaxs );
+		renderable.m_CachedBoundsFrame = gpGlobals->framecount;
+	}
+	absMins = renderable.m_vecCachedAbsMins;
+	absMaxs = renderable.m_vecCachedAbsMaxs;
+}
 
-			if ((maxs.z - mins.z) < 100)
-			{
-				Vector vCenter;
-				VectorLerp( mins, maxs, 0.5f, vCenter );
-				vCenter += renderable.m_pRenderable->GetRenderOrigin();
 
-				float flDistSq = info.m_vecRenderOrigin.DistToSqr( vCenter );
-				if (info.m_flRenderDistSq <= flDistSq)
-					continue;
-			}
-		}
-#endif
+void CClientLeafSystem::CollateRenderablesInLeaf( int leaf, int worldListLeafIndex,	const SetupRenderInfo_t &info )
+{
+	bool portalTestEnts = r_PortalTestEnts.GetBool() && !r_portalsopenall.GetBool();
+	
+	// Place a fake entity for static/opaque ents in this leaf
+	AddRenderableToRenderList( *info.m_pRenderList, NULL, worldListLeafIndex, RENDER_GROUP_OPAQUE_STATIC, NULL );
+	AddRenderableToRenderList( *info.m_pRenderList, NULL, worldListLeafIndex, RENDER_GROUP_OPAQUE_ENTITY, NULL );
 
-		if( renderable.m_RenderGroup != RENDER_GROUP_TRANSLUCENT_ENTITY )
+	// Collate everything.
+	if ( cl_leafsystem_flat_collate.GetBool() && leaf < m_RenderableArrayInLeaf.Count() )
+	{
+		const CUtlVector< ClientRenderHandle_t > &handles = GetRenderableArrayInLeaf( leaf );
+		int nCount = handles.Count();
+		const ClientRenderHandle_t *pHandles = handles.Base();
+		for ( int i = 0; i < nCount; ++i )
 		{
-			RenderGroup_t group = (RenderGroup_t)renderable.m_RenderGroup;
-
-			// Determine object group offset
-			if ( RENDER_GROUP_CFG_NUM_OPAQUE_ENT_BUCKETS > 1 &&
-				 group >= RENDER_GROUP_OPAQUE_STATIC &&
-				 group <= RENDER_GROUP_OPAQUE_ENTITY )
-			{
-				Vector dims;
-				VectorSubtract( absMaxs, absMins, dims );
-
-				float const fDimension = MAX( MAX( fabs(dims.x), fabs(dims.y) ), fabs(dims.z) );
-				group = DetectBucketedRenderGroup( group, fDimension );
-				
-				Assert( group >= RENDER_GROUP_OPAQUE_STATIC_HUGE && group <= RENDER_GROUP_OPAQUE_ENTITY );
-			}
-
-			AddRenderableToRenderList( *info.m_pRenderList, renderable.m_pRenderable, 
-				worldListLeafIndex, group, handle);
+			CollateRenderable( pHandles[i], leaf, worldListLeafIndex, info, portalTestEnts, true );
 		}
-		else
+	}
+	else
+	{
+		unsigned int idx = m_RenderablesInLeaf.FirstElement(leaf);
+		for ( ;idx != m_RenderablesInLeaf.InvalidIndex(); idx = m_RenderablesInLeaf.NextElement(idx) )
 		{
-			bool bTwoPass = ((renderable.m_Flags & RENDER_FLAGS_TWOPASS) != 0) && ( nAlpha == 255 );	// Two pass?
-
-			// Add to appropriate list if drawing translucent objects (shadow depth mapping will skip this)
-			if ( info.m_bDrawTranslucentObjects ) 
-			{
-				AddRenderableToRenderList( *info.m_pRenderList, renderable.m_pRenderable, 
-					worldListLeafIndex, (RenderGroup_t)renderable.m_RenderGroup, handle, bTwoPass );
-			}
-			
-			if ( bTwoPass )	// Also add to opaque list if it's a two-pass model... 
-			{
-				AddRenderableToRenderList( *info.m_pRenderList, renderable.m_pRenderable, 
-					worldListLeafIndex, RENDER_GROUP_OPAQUE_ENTITY, handle, bTwoPass );
-			}
+			CollateRenderable( m_RenderablesInLeaf.Element(idx), leaf, worldListLeafIndex, info, portalTestEnts, false );
 		}
 	}
 
@@ -1699,7 +1953,7 @@ void CClientLeafSystem::CollateRenderablesInLeaf( int leaf, int worldListLeafInd
 	// These don't have render handles!
 	if ( info.m_bDrawDetailObjects && ShouldDrawDetailObjectsInLeaf( leaf, info.m_nDetailBuildFrame ) )
 	{
-		idx = m_Leaf[leaf].m_FirstDetailProp;
+		int idx = m_Leaf[leaf].m_FirstDetailProp;
 		int count = m_Leaf[leaf].m_DetailPropCount;
 		while( --count >= 0 )
 		{
@@ -1731,6 +1985,147 @@ void CClientLeafSystem::CollateRenderablesInLeaf( int leaf, int worldListLeafInd
 	}
 }
 
+inline void CClientLeafSystem::CollateRenderable( ClientRenderHandle_t handle, int leaf, int worldListLeafIndex, const SetupRenderInfo_t &info, bool portalTestEnts, bool bCachedBounds )
+{
+	RenderableInfo_t& renderable = m_Renderables[handle];
+
+	// Early out on static props if we don't want to render them
+	if ((!m_DrawStaticProps) && (renderable.m_Flags & RENDER_FLAGS_STATIC_PROP))
+		return;
+
+	// Early out if we're told to not draw small objects (top view only,
+	/* that's why we don't check the z component).
+	if (!m_DrawSmallObjects)
+	{
+		CCachedRenderInfo& cachedInfo =  m_CachedRenderInfos[renderable.m_CachedRenderInfo];
+		float sizeX = cachedInfo.m_Maxs.x - cachedInfo.m_Mins.x;
+		float sizeY = cachedInfo.m_Maxs.y - cachedInfo.m_Mins.y;
+		if ((sizeX < 50.f) && (sizeY < 50.f))
+			return;
+	}*/
+
+	Assert( m_DrawSmallObjects ); // MOTODO
+
+	// Don't hit the same ent in multiple leaves twice.
+	if ( renderable.m_RenderGroup != RENDER_GROUP_TRANSLUCENT_ENTITY )
+	{
+		if ( renderable.m_RenderFrame2 == info.m_nRenderFrame )
+			return;
+
+		renderable.m_RenderFrame2 = info.m_nRenderFrame;
+	}
+	else // translucent
+	{
+		// Shadow depth skips ComputeTranslucentRenderLeaf!
+
+		// Translucent entities already have had ComputeTranslucentRenderLeaf called on them
+		// so m_RenderLeaf should be set to the nearest leaf, so that's what we want here.
+		if ( renderable.m_RenderLeaf != leaf )
+			return;
+	}
+
+	unsigned char nAlpha = 255;
+	if ( info.m_bDrawTranslucentObjects ) 
+	{
+		// Prevent culling if the renderable is invisible
+		// NOTE: OPAQUE objects can have alpha == 0. 
+		// They are made to be opaque because they don't have to be sorted.
+		nAlpha = renderable.m_pRenderable->GetFxBlend();
+		if ( nAlpha == 0 )
+			return;
+	}
+
+	Vector absMins, absMaxs;
+	if ( bCachedBounds )
+	{
+		GetCachedRenderableWorldSpaceAABB( handle, absMins, absMaxs );
+	}
+	else
+	{
+		CalcRenderableWorldSpaceAABB( renderable.m_pRenderable, absMins, absMaxs );
+	}
+
+	// If the renderable is inside an area, cull it using the frustum for that area.
+	if ( portalTestEnts && renderable.m_Area != -1 )
+	{
+		VPROF( "r_PortalTestEnts" );
+		if ( !engine->DoesBoxTouchAreaFrustum( absMins, absMaxs, renderable.m_Area ) )
+			return;
+	}
+	else
+	{
+		// cull with main frustum
+		if ( engine->CullBox( absMins, absMaxs ) )
+			return;
+	}
+
+	// UNDONE: Investigate speed tradeoffs of occlusion culling brush models too?
+	if ( renderable.m_Flags & RENDER_FLAGS_STUDIO_MODEL )
+	{
+		// test to see if this renderable is occluded by the engine's occlusion system
+		if ( engine->IsOccluded( absMins, absMaxs ) )
+			return;
+	}
+
+#ifdef INVASION_CLIENT_DLL
+	if (info.m_flRenderDistSq != 0.0f)
+	{
+		Vector mins, maxs;
+		renderable.m_pRenderable->GetRenderBounds( mins, maxs );
+
+		if ((maxs.z - mins.z) < 100)
+		{
+			Vector vCenter;
+			VectorLerp( mins, maxs, 0.5f, vCenter );
+			vCenter += renderable.m_pRenderable->GetRenderOrigin();
+
+			float flDistSq = info.m_vecRenderOrigin.DistToSqr( vCenter );
+			if (info.m_flRenderDistSq <= flDistSq)
+				return;
+		}
+	}
+#endif
+
+	if( renderable.m_RenderGroup != RENDER_GROUP_TRANSLUCENT_ENTITY )
+	{
+		RenderGroup_t group = (RenderGroup_t)renderable.m_RenderGroup;
+
+		// Determine object group offset
+		if ( RENDER_GROUP_CFG_NUM_OPAQUE_ENT_BUCKETS > 1 &&
+			 group >= RENDER_GROUP_OPAQUE_STATIC &&
+			 group <= RENDER_GROUP_OPAQUE_ENTITY )
+		{
+			Vector dims;
+			VectorSubtract( absMaxs, absMins, dims );
+
+			float const fDimension = MAX( MAX( fabs(dims.x), fabs(dims.y) ), fabs(dims.z) );
+			group = DetectBucketedRenderGroup( group, fDimension );
+			
+			Assert( group >= RENDER_GROUP_OPAQUE_STATIC_HUGE && group <= RENDER_GROUP_OPAQUE_ENTITY );
+		}
+
+		AddRenderableToRenderList( *info.m_pRenderList, renderable.m_pRenderable, 
+			worldListLeafIndex, group, handle);
+	}
+	else
+	{
+		bool bTwoPass = ((renderable.m_Flags & RENDER_FLAGS_TWOPASS) != 0) && ( nAlpha == 255 );	// Two pass?
+
+		// Add to appropriate list if drawing translucent objects (shadow depth mapping will skip this)
+		if ( info.m_bDrawTranslucentObjects ) 
+		{
+			AddRenderableToRenderList( *info.m_pRenderList, renderable.m_pRenderable, 
+				worldListLeafIndex, (RenderGroup_t)renderable.m_RenderGroup, handle, bTwoPass );
+		}
+		
+		if ( bTwoPass )	// Also add to opaque list if it's a two-pass model... 
+		{
+			AddRenderableToRenderList( *info.m_pRenderList, renderable.m_pRenderable, 
+				worldListLeafIndex, RENDER_GROUP_OPAQUE_ENTITY, handle, bTwoPass );
+		}
+	}
+}
+
 
 //-----------------------------------------------------------------------------
 // Sort entities in a back-to-front ordering
@@ -1799,6 +2194,12 @@ void CClientLeafSystem::BuildRenderablesList( const SetupRenderInfo_t &info )
 	CClientRenderablesList::CEntry *pTranslucentEntries = info.m_pRenderList->m_RenderGroups[RENDER_GROUP_TRANSLUCENT_ENTITY];
 	int &nTranslucentEntries = info.m_pRenderList->m_RenderGroupCounts[RENDER_GROUP_TRANSLUCENT_ENTITY];
 
+	CFastTimer timer;
+	if ( m_CollateBenchmark.m_nPass >= 0 )
+	{
+		timer.Start();
+	}
+
 	for( int i = 0; i < leafCount; i++ )
 	{
 		int nTranslucent = nTranslucentEntries;
@@ -1813,4 +2214,74 @@ void CClientLeafSystem::BuildRenderablesList( const SetupRenderInfo_t &info )
 			SortEntities( vecRenderOrigin, vecRenderForward, &pTranslucentEntries[nTranslucent], nNewTranslucent );
 		}
 	}
+
+	if ( m_CollateBenchmark.m_nPass >= 0 )
+	{
+		timer.End();
+
+		int nPass = m_CollateBenchmark.m_nPass;
+		m_CollateBenchmark.m_flTime[nPass] += timer.GetDuration().GetSeconds();
+		m_CollateBenchmark.m_nCalls[nPass]++;
+		for ( int i = 0; i < RENDER_GROUP_COUNT; ++i )
+		{
+			m_CollateBenchmark.m_nRenderables[nPass] += info.m_pRenderList->m_RenderGroupCounts[i];
+		}
+	}
+}
+
+
+//-----------------------------------------------------------------------------
+// Times BuildRenderablesList with the linked list collation and the flat per-leaf
+// arrays on alternate frames, so both see the same camera path. Run it during demo
+// playback to replay a recorded one.
+//-----------------------------------------------------------------------------
+void CClientLeafSystem::StartCollateBenchmark( int nFrames )
+{
+	if ( m_CollateBenchmark.m_nPass >= 0 )
+	{
+		cl_leafsystem_flat_collate.SetValue( m_CollateBenchmark.m_bSavedFlatCollate );
+	}
+
+	memset( &m_CollateBenchmark, 0, sizeof( m_CollateBenchmark ) );
+	m_CollateBenchmark.m_nFramesPerPass = MAX( nFrames, 1 );
+	m_CollateBenchmark.m_nFramesLeft = 2 * m_CollateBenchmark.m_nFramesPerPass;
+	m_CollateBenchmark.m_nPass = 0;
+	m_CollateBenchmark.m_bSavedFlatCollate = cl_leafsystem_flat_collate.GetBool();
+	cl_leafsystem_flat_collate.SetValue( 0 );
+
+	Msg( "Timing BuildRenderablesList over %d frames, alternating linked lists and flat arrays...\n", 
+		2 * m_CollateBenchmark.m_nFramesPerPass );
+}
+
+void CClientLeafSystem::UpdateCollateBenchmark()
+{
+	if ( --m_CollateBenchmark.m_nFramesLeft > 0 )
+	{
+		m_CollateBenchmark.m_nPass ^= 1;
+		cl_leafsystem_flat_collate.SetValue( m_CollateBenchmark.m_nPass );
+		return;
+	}
+
+	static const char *s_pPassNames[2] = { "linked lists", "flat arrays" };
+	for ( int i = 0; i < 2; ++i )
+	{
+		int nCalls = MAX( m_CollateBenchmark.m_nCalls[i], 1 );
+		Msg( "%12s: %5d calls, %8.3f ms total, %6.3f ms/call, %6d renderables/call\n", 
+			s_pPassNames[i], m_CollateBenchmark.m_nCalls[i], m_CollateBenchmark.m_flTime[i] * 1000.0,
+			m_CollateBenchmark.m_flTime[i] * 1000.0 / nCalls, m_CollateBenchmark.m_nRenderables[i] / nCalls );
+	}
+
+	if ( m_CollateBenchmark.m_flTime[1] > 0.0 )
+	{
+		Msg( "Speedup: %.2fx\n", m_CollateBenchmark.m_flTime[0] / m_CollateBenchmark.m_flTime[1] );
+	}
+
+	cl_leafsystem_flat_collate.SetValue( m_CollateBenchmark.m_bSavedFlatCollate );
+	m_CollateBenchmark.m_nPass = -1;
+}
+
+CON_COMMAND_F( cl_bench_leafsystem_collate, "Times renderable collation with linked lists vs. flat per-leaf arrays, N frames each (default 300) on alternate frames. Start it during demo playback on a busy map to replay a recorded camera path.", FCVAR_CHEAT )
+{
+	int nFrames = ( args.ArgC() > 1 ) ? atoi( args[1] ) : 300;
+	CClientLeafSystem::s_ClientLeafSystem.StartCollateBenchmark( nFrames );
 }
@@ -50,6 +50,7 @@ struct model_t;
 
 ConVar cl_detaildist( "cl_detaildist", "1200", 0, "Distance at which detail props are no longer visible" );
 ConVar cl_detailfade( "cl_detailfade", "400", 0, "Distance across which detail props fade in" );
+ConVar cl_detail_resort_dist( "cl_detail_resort_dist", "16", 0, "Fast detail sprites keep their previous back-to-front order until the view moves this far from where they were last sorted. 0 re-sorts every view." );
 #if defined( USE_DETAIL_SHAPES ) 
 ConVar cl_detail_max_sway( "cl_detail_max_sway", "0", FCVAR_ARCHIVE, "Amplitude of the detail prop sway" );
 ConVar cl_detail_avoid_radius( "cl_detail_avoid_radius", "0", FCVAR_ARCHIVE, "radius around detail sprite to avoid players" );
@@ -338,10 +339,15 @@ class CFastDetailLeafSpriteList : public CClientLeafSubSystemData
 	int m_nNumPendingSprites;
 	int m_nStartSpriteIndex;
 
+	// sprite indices in back-to-front order as seen from m_vecSortOrigin, reused while the view stays close
+	CUtlVector< int > m_SortOrder;
+	Vector m_vecSortOrigin;
+
 	CFastDetailLeafSpriteList( void )
 	{
 		m_nNumPendingSprites = 0;
 		m_nStartSpriteIndex = 0;
+		m_vecSortOrigin.Init();
 	}
 
 };
@@ -410,6 +416,9 @@ public:
 	DetailPropLightstylesLump_t& DetailLighting( int i ) { return m_DetailLighting[i]; }
 	DetailPropSpriteDict_t& DetailSpriteDict( int i ) { return m_DetailSpriteDict[i]; }
 
+	// Times the per view list building (fade, cull and sort) without drawing anything
+	void RunBuildListBenchmark( int nIterations );
+
 private:
 	struct DetailModelDict_t
 	{
@@ -434,8 +443,17 @@ private:
 							   Vector const &viewRight,
 							   Vector const &viewUp );
 
+	// Fills m_pFastSortInfo from pData->m_SortOrder, re-sorting it first if the view moved too far
+	int EmitSortedFastSprites( CFastDetailLeafSpriteList *pData, Vector const &viewOrigin );
+
 	void RenderFastSprites( const Vector &viewOrigin, const Vector &viewForward, const Vector &viewRight, const Vector &viewUp, int nLeafCount, LeafIndex_t const * pLeafList );
 
+	// Computes the fade distances for the current view
+	void ComputeFadeDistances();
+
+	// Computes alpha for a range of detail models, 4 at a time
+	void ComputeDetailModelFade( int nFirstDetailObject, int nDetailObjectCount, const Vector &vViewOrigin );
+
 	void UnserializeFastSprite( FastSpriteX4_t *pSpritex4, int nSubField, DetailObjectLump_t const &lump, bool bFlipped, Vector const &posOffset );
 
 	// Unserialization
@@ -485,6 +503,11 @@ private:
 	SortInfo_t *m_pSortInfo;
 	SortInfo_t *m_pFastSortInfo;
 	FastSpriteQuadBuildoutBufferX4_t *m_pBuildoutBuffer;
+	float *m_pFastSortDistances;		// squared distance of each sprite in the leaf being built out
+	int *m_pFastBlockRemap;				// buildout buffer index of each group of 4 sprites, -1 if culled
+
+	// origins of m_DetailObjects, 4 to a FourVectors
+	FourVectors *m_pDetailObjectOriginsX4;
 
 	float m_flDefaultFadeStart;
 	float m_flDefaultFadeEnd;
@@ -1402,6 +1425,9 @@ CDetailObjectSystem::CDetailObjectSystem() : m_DetailSpriteDict( 0, 32 ), m_Deta
 	m_pSortInfo = NULL;
 	m_pFastSortInfo = NULL;
 	m_pBuildoutBuffer = NULL;
+	m_pFastSortDistances = NULL;
+	m_pFastBlockRemap = NULL;
+	m_pDetailObjectOriginsX4 = NULL;
 }
 
 void CDetailObjectSystem::FreeSortBuffers( void )
@@ -1421,6 +1447,21 @@ void CDetailObjectSystem::FreeSortBuffers( void )
 		MemAlloc_FreeAligned(  m_pBuildoutBuffer );
 		m_pBuildoutBuffer = NULL;
 	}
+	if ( m_pFastSortDistances )
+	{
+		MemAlloc_FreeAligned(  m_pFastSortDistances );
+		m_pFastSortDistances = NULL;
+	}
+	if ( m_pFastBlockRemap )
+	{
+		MemAlloc_FreeAligned(  m_pFastBlockRemap );
+		m_pFastBlockRemap = NULL;
+	}
+	if ( m_pDetailObjectOriginsX4 )
+	{
+		MemAlloc_FreeAligned(  m_pDetailObjectOriginsX4 );
+		m_pDetailObjectOriginsX4 = NULL;
+	}
 }
 
 CDetailObjectSystem::~CDetailObjectSystem()
@@ -1747,6 +1788,11 @@ void CDetailObjectSystem::UnserializeModels( CUtlBuffer& buf )
 			MemAlloc_AllocAligned( 
 				( 1 + nMaxFastInLeaf / 4 ) * sizeof( FastSpriteQuadBuildoutBufferX4_t ),
 				sizeof( fltx4 ) ) );
+
+		m_pFastSortDistances = reinterpret_cast<float *> (
+			MemAlloc_AllocAligned( ( 4 + nMaxFastInLeaf ) * sizeof( float ), sizeof( fltx4 ) ) );
+		m_pFastBlockRemap = reinterpret_cast<int *> (
+			MemAlloc_AllocAligned( ( 1 + nMaxFastInLeaf / 4 ) * sizeof( int ), sizeof( fltx4 ) ) );
 	}
 
 	if ( nNumFastSpritesToAllocate )
@@ -1878,6 +1924,25 @@ void CDetailObjectSystem::UnserializeModels( CUtlBuffer& buf )
 		ClientLeafSystem()->SetDetailObjectsInLeaf( detailObjectLeaf, 
 													firstDetailObject, detailObjectCount );
 	}
+
+	// Detail models never move, so lay their origins out for ComputeDetailModelFade
+	int nOldStyleObjects = m_DetailObjects.Count();
+	if ( nOldStyleObjects )
+	{
+		int nBlocks = ( nOldStyleObjects + 3 ) >> 2;
+		m_pDetailObjectOriginsX4 = reinterpret_cast<FourVectors *> (
+			MemAlloc_AllocAligned( nBlocks * sizeof( FourVectors ), sizeof( fltx4 ) ) );
+		for ( int i = 0; i < nBlocks; ++i )
+		{
+			// Pad the last block with the last model to keep bad numbers out
+			int nLast = nOldStyleObjects - 1;
+			m_pDetailObjectOriginsX4[i].LoadAndSwizzle( 
+				m_DetailObjects[ MIN( 4 * i, nLast ) ].GetRenderOrigin(),
+				m_DetailObjects[ MIN( 4 * i + 1, nLast ) ].GetRenderOrigin(),
+				m_DetailObjects[ MIN( 4 * i + 2, nLast ) ].GetRenderOrigin(),
+				m_DetailObjects[ MIN( 4 * i + 3, nLast ) ].GetRenderOrigin() );
+		}
+	}
 }
 
 
@@ -2141,6 +2206,8 @@ int CDetailObjectSystem::BuildOutSortedSprites( CFastDetailLeafSpriteList *pData
 	FastSpriteQuadBuildoutBufferX4_t *pQuadBufferOut = m_pBuildoutBuffer;
 	int curidx = 0;
 	int nLastBfMask = 0;
+	int nBlock = 0;
+	bool bReuseOrder = ( cl_detail_resort_dist.GetFloat() > 0.0f );
 
 	FourVectors vecViewPos;
 	vecViewPos.DuplicateVector( viewOrigin );
@@ -2162,6 +2229,11 @@ int CDetailObjectSystem::BuildOutSortedSprites( CFastDetailLeafSpriteList *pData
 		fltx4 ofsDotFwd = ofs * vecFwd;
 		fltx4 distanceSquared = ofs * ofs;
 		nLastBfMask = TestSignSIMD( OrSIMD( ofsDotFwd, CmpGtSIMD( distanceSquared, maxsqdist ) ) );		//  cull
+		if ( bReuseOrder )
+		{
+			StoreAlignedSIMD( m_pFastSortDistances + 4 * nBlock, distanceSquared );
+			m_pFastBlockRemap[nBlock] = ( nLastBfMask != 0xf ) ? ( curidx >> 2 ) : -1;
+		}
 		if ( nLastBfMask != 0xf )
 		{
 			FourVectors dx1;
@@ -2214,8 +2286,15 @@ int CDetailObjectSystem::BuildOutSortedSprites( CFastDetailLeafSpriteList *pData
 			pQuadBufferOut++;
 		}
 		pSprites++;
+		nBlock++;
 	} while( --nSIMDSprites );
 
+	if ( bReuseOrder )
+	{
+		// part 2 - walk the cached order instead of sorting from scratch
+		return EmitSortedFastSprites( pData, viewOrigin );
+	}
+
 	// adjust count for tail
 	int nCount = pOut - m_pFastSortInfo;
 	if ( nLastBfMask != 0xf )						// if last not skipped
@@ -2232,6 +2311,94 @@ int CDetailObjectSystem::BuildOutSortedSprites( CFastDetailLeafSpriteList *pData
 }
 
 
+//-----------------------------------------------------------------------------
+// Fills m_pFastSortInfo back-to-front with the sprites BuildOutSortedSprites kept.
+// A leaf's order is only re-sorted once the view moves cl_detail_resort_dist away
+// from where it was last sorted, and then starting from the old order, which is
+// nearly sorted already.
+//-----------------------------------------------------------------------------
+struct FastSpriteFartherFunc_t
+{
+	FastSpriteFartherFunc_t( const float *pDistances ) : m_pDistances( pDistances ) {}
+
+	bool operator()( int nLeft, int nRight ) const
+	{
+		return TREATASINT( m_pDistances[nLeft] ) > TREATASINT( m_pDistances[nRight] );
+	}
+
+	const float *m_pDistances;
+};
+
+int CDetailObjectSystem::EmitSortedFastSprites( CFastDetailLeafSpriteList *pData, Vector const &viewOrigin )
+{
+	int nSprites = pData->m_nNumSprites;
+	const float *pDistances = m_pFastSortDistances;
+	CUtlVector< int > &order = pData->m_SortOrder;
+
+	float flResortDist = cl_detail_resort_dist.GetFloat();
+	if ( ( order.Count() != nSprites ) || ( viewOrigin.DistToSqr( pData->m_vecSortOrigin ) >= flResortDist * flResortDist ) )
+	{
+		VPROF( "CDetailObjectSystem::SortSpritesBackToFront -- Sort" );
+		FastSpriteFartherFunc_t fartherFunc( pDistances );
+
+		bool bFullSort = ( order.Count() != nSprites );
+		if ( bFullSort )
+		{
+			order.SetCount( nSprites );
+			for ( int i = 0; i < nSprites; ++i )
+			{
+				order[i] = i;
+			}
+		}
+		else
+		{
+			// Insertion sort, giving up on it if things moved around too much
+			int *pOrder = order.Base();
+			int nMaxShifts = 8 * nSprites;
+			int nShifts = 0;
+			for ( int i = 1; i < nSprites; ++i )
+			{
+				int nSprite = pOrder[i];
+				int j = i;
+				for ( ; ( j > 0 ) && fartherFunc( nSprite, pOrder[j - 1] ); --j )
+				{
+					pOrder[j] = pOrder[j - 1];
+				}
+				pOrder[j] = nSprite;
+
+				nShifts += i - j;
+				if ( nShifts > nMaxShifts )
+				{
+					bFullSort = true;
+					break;
+				}
+			}
+		}
+
+		if ( bFullSort )
+		{
+			std::sort( order.Base(), order.Base() + nSprites, fartherFunc );
+		}
+		pData->m_vecSortOrigin = viewOrigin;
+	}
+
+	SortInfo_t *pOut = m_pFastSortInfo;
+	const int *pOrder = order.Base();
+	for ( int i = 0; i < nSprites; ++i )
+	{
+		int nSprite = pOrder[i];
+		int nBuildoutIndex = m_pFastBlockRemap[nSprite >> 2];
+		if ( nBuildoutIndex < 0 )
+			continue;
+
+		pOut->m_nIndex = ( nBuildoutIndex << 2 ) | ( nSprite & 3 );
+		pOut->m_flDistance = pDistances[nSprite];
+		++pOut;
+	}
+	return pOut - m_pFastSortInfo;
+}
+
+
 void CDetailObjectSystem::RenderFastSprites( const Vector &viewOrigin, const Vector &viewForward, const Vector &viewRight, const Vector &viewUp, int nLeafCount, LeafIndex_t const * pLeafList )
 {
 	// Here, we must draw all detail objects back-to-front
@@ -2719,35 +2886,57 @@ bool CDetailObjectSystem::EnumerateLeaf( int leaf, int context )
 
 	// Compute the translucency. Need to do it now cause we need to
 	// know that when we're rendering (opaque stuff is rendered first)
-	for ( int i = 0; i < detailObjectCount; ++i)
-	{
-		// Calculate distance (badly)
-		CDetailModel& model = m_DetailObjects[firstDetailObject+i];
-		VectorSubtract( model.GetRenderOrigin(), pCtx->m_vViewOrigin, v );
+	ComputeDetailModelFade( firstDetailObject, detailObjectCount, pCtx->m_vViewOrigin );
+	return true;
+}
+
+
+//-----------------------------------------------------------------------------
+// Computes alpha for a range of detail models, 4 at a time. Models past the
+// fade start fall off linearly with squared distance, and models past the max
+// distance get 0 and skip their screen alignment.
+//-----------------------------------------------------------------------------
+void CDetailObjectSystem::ComputeDetailModelFade( int nFirstDetailObject, int nDetailObjectCount, const Vector &vViewOrigin )
+{
+	if ( nDetailObjectCount <= 0 )
+		return;
 
-		float sqDist = v.LengthSqr();
+	FourVectors vecViewPos;
+	vecViewPos.DuplicateVector( vViewOrigin );
+	fltx4 maxSqDist = ReplicateX4( m_flCurMaxSqDist );
+	fltx4 fadeSqDist = ReplicateX4( m_flCurFadeSqDist );
+	fltx4 falloffFactor = ReplicateX4( m_flCurFalloffFactor );
 
-		model.SetAlpha( 255 );
-		if ( sqDist < m_flCurMaxSqDist )
+	ALIGN16 float flAlpha[4] ALIGN16_POST;
+	int nEnd = nFirstDetailObject + nDetailObjectCount;
+	for ( int nBlock = nFirstDetailObject >> 2; ( nBlock << 2 ) < nEnd; ++nBlock )
+	{
+		FourVectors ofs = m_pDetailObjectOriginsX4[nBlock];
+		ofs -= vecViewPos;
+		fltx4 sqDist = ofs * ofs;
+
+		fltx4 inRange = CmpLtSIMD( sqDist, maxSqDist );
+		fltx4 alpha = MulSIMD( falloffFactor, SubSIMD( maxSqDist, sqDist ) );
+		alpha = MaskedAssign( CmpGtSIMD( sqDist, fadeSqDist ), alpha, Four_255s );
+		alpha = MaskedAssign( inRange, alpha, Four_Zeros );
+		StoreAlignedSIMD( flAlpha, alpha );
+		int nInRangeMask = TestSignSIMD( inRange );
+
+		int nBase = nBlock << 2;
+		int nLane = MAX( nFirstDetailObject - nBase, 0 );
+		int nLaneEnd = MIN( nEnd - nBase, 4 );
+		for ( ; nLane < nLaneEnd; ++nLane )
 		{
-			if ( sqDist > m_flCurFadeSqDist ) 
-			{
-				model.SetAlpha( m_flCurFalloffFactor * ( m_flCurMaxSqDist - sqDist ) );
-			}
-			else
+			CDetailModel& model = m_DetailObjects[nBase + nLane];
+			model.SetAlpha( flAlpha[nLane] );
+
+			// Perform screen alignment if necessary.
+			if ( nInRangeMask & ( 1 << nLane ) )
 			{
-				model.SetAlpha( 255 );
+				model.ComputeAngles();
 			}
-			
-			// Perform screen alignment if necessary.
-			model.ComputeAngles();
-		}
-		else
-		{
-			model.SetAlpha( 0 );
 		}
 	}
-	return true;
 }
 
 
@@ -2778,6 +2967,19 @@ void CDetailObjectSystem::BuildDetailObjectRenderLists( const Vector &vViewOrigi
 		}
 	}
 
+	ComputeFadeDistances();
+
+	ISpatialQuery* pQuery = engine->GetBSPTreeQuery();
+	pQuery->EnumerateLeavesInSphere( CurrentViewOrigin(), 
+									 cl_detaildist.GetFloat(), this, (int)&ctx );
+}
+
+
+//-----------------------------------------------------------------------------
+// Computes the fade distances for the current view
+//-----------------------------------------------------------------------------
+void CDetailObjectSystem::ComputeFadeDistances()
+{
 	float factor = 1.0f;
 	C_BasePlayer *local = C_BasePlayer::GetLocalPlayer();
 	if ( local )
@@ -2802,10 +3004,107 @@ void CDetailObjectSystem::BuildDetailObjectRenderLists( const Vector &vViewOrigi
 	}
 	m_flCurFadeSqDist = MIN( m_flCurFadeSqDist, m_flCurMaxSqDist -1  );
 	m_flCurFalloffFactor = 255.0f / ( m_flCurMaxSqDist - m_flCurFadeSqDist );
+}
 
 
-	ISpatialQuery* pQuery = engine->GetBSPTreeQuery();
-	pQuery->EnumerateLeavesInSphere( CurrentViewOrigin(), 
-									 cl_detaildist.GetFloat(), this, (int)&ctx );
+//-----------------------------------------------------------------------------
+// Headless benchmark of the per view list building: fades the detail models and
+// builds out and sorts the fast sprites in every leaf around the view, walking
+// forward a few units per iteration, once re-sorting from scratch every time and
+// once reusing the previous order.
+//-----------------------------------------------------------------------------
+class CDetailLeafListEnumerator : public ISpatialLeafEnumerator
+{
+public:
+	bool EnumerateLeaf( int leaf, int context )
+	{
+		m_Leaves.AddToTail( leaf );
+		return true;
+	}
+
+	CUtlVector< int > m_Leaves;
+};
+
+void CDetailObjectSystem::RunBuildListBenchmark( int nIterations )
+{
+	if ( ( ! m_pFastSpriteData ) && ( m_DetailObjects.Count() == 0 ) )
+	{
+		Msg( "This map has no detail props.\n" );
+		return;
+	}
+
+	const Vector &vecOrigin = MainViewOrigin();
+	const Vector &vecForward = MainViewForward();
+	const Vector &vecRight = MainViewRight();
+	const Vector &vecUp = MainViewUp();
+	const float flStepPerIteration = 4.0f;
+
+	ComputeFadeDistances();
+
+	// Every leaf the walk can see detail props in
+	CDetailLeafListEnumerator leafList;
+	float flRadius = cl_detaildist.GetFloat() + flStepPerIteration * nIterations;
+	engine->GetBSPTreeQuery()->EnumerateLeavesInSphere( vecOrigin, flRadius, &leafList, 0 );
+
+	float flSavedResortDist = cl_detail_resort_dist.GetFloat();
+	static const char *s_pPassNames[2] = { "full sort", "reused order" };
+	for ( int nPass = 0; nPass < 2; ++nPass )
+	{
+		cl_detail_resort_dist.SetValue( nPass ? ( ( flSavedResortDist > 0.0f ) ? flSavedResortDist : 16.0f ) : 0.0f );
+
+		for ( int i = 0; i < leafList.m_Leaves.Count(); ++i )
+		{
+			CFastDetailLeafSpriteList *pData = reinterpret_cast< CFastDetailLeafSpriteList *> (
+				ClientLeafSystem()->GetSubSystemDataInLeaf( leafList.m_Leaves[i], CLSUBSYSTEM_DETAILOBJECTS ) );
+			if ( pData )
+			{
+				pData->m_SortOrder.Purge();
+			}
+		}
+
+		int nModels = 0;
+		int nSprites = 0;
+		CFastTimer timer;
+		timer.Start();
+		for ( int nIteration = 0; nIteration < nIterations; ++nIteration )
+		{
+			Vector vecViewOrigin;
+			VectorMA( vecOrigin, flStepPerIteration * nIteration, vecForward, vecViewOrigin );
+
+			for ( int i = 0; i < leafList.m_Leaves.Count(); ++i )
+			{
+				int nLeaf = leafList.m_Leaves[i];
+
+				int nFirstDetailObject, nDetailObjectCount;
+				ClientLeafSystem()->GetDetailObjectsInLeaf( nLeaf, nFirstDetailObject, nDetailObjectCount );
+				ComputeDetailModelFade( nFirstDetailObject, nDetailObjectCount, vecViewOrigin );
+				nModels += nDetailObjectCount;
+
+				CFastDetailLeafSpriteList *pData = reinterpret_cast< CFastDetailLeafSpriteList *> (
+					ClientLeafSystem()->GetSubSystemDataInLeaf( nLeaf, CLSUBSYSTEM_DETAILOBJECTS ) );
+				if ( pData )
+				{
+					nSprites += BuildOutSortedSprites( pData, vecViewOrigin, vecForward, vecRight, vecUp );
+				}
+			}
+		}
+		timer.End();
+
+		float flMilliseconds = timer.GetDuration().GetMillisecondsF();
+		Msg( "%12s: %d leaves, %.3f ms/view, %d models faded/view, %d sprites built out/view\n",
+			s_pPassNames[nPass], leafList.m_Leaves.Count(), flMilliseconds / MAX( nIterations, 1 ),
+			nModels / MAX( nIterations, 1 ), nSprites / MAX( nIterations, 1 ) );
+	}
+
+	cl_detail_resort_dist.SetValue( flSavedResortDist );
+
+	// The sort buffer no longer matches whatever leaf was being drawn
+	m_nSortedFastLeaf = -1;
+}
+
+CON_COMMAND_F( cl_bench_detail_buildlist, "Times detail prop fading, sprite buildout and sorting for N views (default 100) walking forward from the current view, with and without reusing the previous sort order. Nothing is drawn.", FCVAR_CHEAT )
+{
+	int nIterations = ( args.ArgC() > 1 ) ? atoi( args[1] ) : 100;
+	s_DetailObjectSystem.RunBuildListBenchmark( MAX( nIterations, 1 ) );
 }
 
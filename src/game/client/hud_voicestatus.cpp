@@ -344,7 +344,7 @@ void CHudVoiceStatus::Paint()
 	}
 
 	if ( !sv_alltalk )
-		sv_alltalk = cvar->FindVar( "sv_alltalk" );
+		sv_alltalk = ConVar_FindVar( "sv_alltalk" );
 
 	//draw everyone in the list!
 	FOR_EACH_LL(m_SpeakingList, i)
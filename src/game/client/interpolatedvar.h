@@ -15,6 +15,7 @@
 #include "lerp_functions.h"
 #include "animationlayer.h"
 #include "convar.h"
+#include "mathlib/ssemath.h"
 
 
 #include "tier0/memdbgon.h"
@@ -123,6 +124,88 @@ private:
 extern ConVar cl_extrapolate_amount;
 
 
+//-----------------------------------------------------------------------------
+// Remembers the history searches done by an entity's interpolated vars during one
+// Interpolate() so its other vars can skip theirs. An entity's vars are latched
+// together, so they mostly share sample times. A search is only reused when every
+// sample time it looked at matches, so the result is the same as searching.
+//-----------------------------------------------------------------------------
+class CInterpolationHistoryCache
+{
+public:
+	enum
+	{
+		MAX_SEARCHES = 2,		// Usually one for simulation vars and one for animation vars.
+		MAX_SAMPLES = 16,
+	};
+
+	enum
+	{
+		NO_MORE_CHANGES_NEVER = 0,
+		NO_MORE_CHANGES_ALWAYS,
+		NO_MORE_CHANGES_IF_SAMPLES_MATCH,	// If the samples used are identical.
+	};
+
+	struct Search_t
+	{
+		float	m_flTargetTime;
+		bool	m_bLinearOnly;
+		bool	m_bExactCount;		// The history had exactly m_nSamples entries.
+		int		m_nSamples;			// Number of leading sample times the search looked at.
+		float	m_flChangeTimes[MAX_SAMPLES];
+
+		bool	m_bResult;
+		bool	m_bHermite;
+		int		m_nOldest;
+		int		m_nOlder;
+		int		m_nNewer;
+		float	m_flFrac;
+		int		m_nNoMoreChanges;
+	};
+
+	CInterpolationHistoryCache()
+	{
+		m_nSearches = 0;
+		m_nNextSearch = 0;
+		m_nHits = 0;
+		m_nMisses = 0;
+	}
+
+	int			m_nSearches;
+	int			m_nNextSearch;
+	Search_t	m_Searches[MAX_SEARCHES];
+
+	int			m_nHits;
+	int			m_nMisses;
+};
+
+
+// Number of floats in an interpolated type that lerps component-wise and needs no
+// Lerp_Clamp, or 0 if it has to go through the type's own Lerp.
+template< class T > struct InterpolatedVarFloatCount { enum { COUNT = 0 }; };
+template<> struct InterpolatedVarFloatCount< float > { enum { COUNT = 1 }; };
+template<> struct InterpolatedVarFloatCount< Vector > { enum { COUNT = 3 }; };
+
+// Same operations in the same order as Lerp(), so the results are bit-identical.
+inline void LerpFloats_SIMD( float *pOut, const float *pFrom, const float *pTo, float flPercent, int nCount )
+{
+	fltx4 fl4Percent = ReplicateX4( flPercent );
+
+	int i = 0;
+	for ( ; i + 4 <= nCount; i += 4 )
+	{
+		fltx4 fl4From = LoadUnalignedSIMD( pFrom + i );
+		fltx4 fl4To = LoadUnalignedSIMD( pTo + i );
+		StoreUnalignedSIMD( pOut + i, AddSIMD( fl4From, MulSIMD( SubSIMD( fl4To, fl4From ), fl4Percent ) ) );
+	}
+
+	for ( ; i < nCount; i++ )
+	{
+		pOut[i] = Lerp( flPercent, pFrom[i], pTo[i] );
+	}
+}
+
+
 template< class T >
 inline T ExtrapolateInterpolatedVarType( const T &oldVal, const T &newVal, float divisor, float flExtrapolationAmount )
 {
@@ -164,6 +247,14 @@ public:
 	
 	// Returns 1 if the value will always be the same if currentTime is always increasing.
 	virtual int Interpolate( float currentTime ) = 0;
+
+	// Same as Interpolate, but shares history searches with the entity's other vars
+	// through pCache and lerps float arrays with SIMD. The results are bit-identical.
+	virtual int InterpolateWithCache( float currentTime, CInterpolationHistoryCache *pCache ) = 0;
+
+	// Runs Interpolate and InterpolateWithCache at currentTime and returns true if
+	// they agree bit for bit. The value is left as it was.
+	virtual bool CheckInterpolateWithCache( float currentTime, CInterpolationHistoryCache *pCache ) = 0;
 	
 	virtual int	 GetType() const = 0;
 	virtual void RestoreToLastNetworked() = 0;
@@ -451,6 +542,8 @@ public:
 	virtual bool NoteChanged( float changetime, bool bUpdateLastNetworkedValue );
 	virtual void Reset();
 	virtual int Interpolate( float currentTime );
+	virtual int InterpolateWithCache( float currentTime, CInterpolationHistoryCache *pCache );
+	virtual bool CheckInterpolateWithCache( float currentTime, CInterpolationHistoryCache *pCache );
 	virtual int GetType() const;
 	virtual void RestoreToLastNetworked();
 	virtual void Copy( IInterpolatedVar *pInSrc );
@@ -462,6 +555,7 @@ public:
 	// Just like the IInterpolatedVar functions, but you can specify an interpolation amount.
 	bool NoteChanged( float changetime, float interpolation_amount, bool bUpdateLastNetworkedValue );
 	int Interpolate( float currentTime, float interpolation_amount );
+	int InterpolateWithCache( float currentTime, float interpolation_amount, CInterpolationHistoryCache *pCache );
 
 	void DebugInterpolate( Type *pOut, float currentTime );
 
@@ -526,7 +620,24 @@ protected:
 		CInterpolationInfo *pInfo,
 		float currentTime, 
 		float interpolation_amount,
-		int *pNoMoreChanges );
+		int *pNoMoreChanges,
+		CInterpolationHistoryCache *pCache = NULL );
+
+	bool FindCachedInterpolationInfo( 
+		CInterpolationInfo *pInfo,
+		float targettime,
+		int *pNoMoreChanges,
+		CInterpolationHistoryCache *pCache,
+		bool *pResult );
+
+	void StoreCachedInterpolationInfo( 
+		const CInterpolationInfo *pInfo,
+		float targettime,
+		bool bResult,
+		int nSamples,
+		bool bExactCount,
+		int nNoMoreChanges,
+		CInterpolationHistoryCache *pCache );
 
 	void TimeFixup_Hermite( 
 		CInterpolatedVarEntry &fixup,
@@ -550,7 +661,8 @@ protected:
 		float flMaxExtrapolationAmount
 		);
 
-	void _Interpolate( Type *out, float frac, CInterpolatedVarEntry *start, CInterpolatedVarEntry *end );
+	void _Interpolate( Type *out, float frac, CInterpolatedVarEntry *start, CInterpolatedVarEntry *end, bool bSIMD = false );
+	void _Interpolate_SIMD( Type *out, float frac, CInterpolatedVarEntry *start, CInterpolatedVarEntry *end );
 	void _Interpolate_Hermite( Type *out, float frac, CInterpolatedVarEntry *pOriginalPrev, CInterpolatedVarEntry *start, CInterpolatedVarEntry *end, bool looping = false );
 	
 	void _Derivative_Hermite( Type *out, float frac, CInterpolatedVarEntry *pOriginalPrev, CInterpolatedVarEntry *start, CInterpolatedVarEntry *end );
@@ -800,7 +912,8 @@ inline bool CInterpolatedVarArrayBase<Type, IS_ARRAY>::GetInterpolationInfo(
 	typename CInterpolatedVarArrayBase<Type, IS_ARRAY>::CInterpolationInfo *pInfo,
 	float currentTime, 
 	float interpolation_amount,
-	int *pNoMoreChanges
+	int *pNoMoreChanges,
+	CInterpolationHistoryCache *pCache
 	)
 {
 	Assert( m_pValue );
@@ -809,9 +922,17 @@ inline bool CInterpolatedVarArrayBase<Type, IS_ARRAY>::GetInterpolationInfo(
 
 	float targettime = currentTime - interpolation_amount;
 
+	bool bCachedResult;
+	if ( pCache && FindCachedInterpolationInfo( pInfo, targettime, pNoMoreChanges, pCache, &bCachedResult ) )
+		return bCachedResult;
+
 	pInfo->m_bHermite = false;
 	pInfo->frac = 0;
 	pInfo->oldest = pInfo->older = pInfo->newer = varHistory.InvalidIndex();
+
+	// Which sample times the search depends on, for pCache.
+	int nSamples = varHistory.Count();
+	bool bExactCount = true;
 	
 	for ( int i = 0; i < varHistory.Count(); i++ )
 	{
@@ -819,7 +940,11 @@ inline bool CInterpolatedVarArrayBase<Type, IS_ARRAY>::GetInterpolationInfo(
 		
 		float older_change_time = m_VarHistory[ i ].changetime;
 		if ( older_change_time == 0.0f )
+		{
+			nSamples = i + 1;
+			bExactCount = false;
 			break;
+		}
 
 		if ( targettime < older_change_time )
 		{
@@ -836,9 +961,16 @@ inline bool CInterpolatedVarArrayBase<Type, IS_ARRAY>::GetInterpolationInfo(
 			// as time continues to increase, we'll be returning the same value.
 			if ( pNoMoreChanges )
 				*pNoMoreChanges = 1;
+
+			if ( pCache )
+				StoreCachedInterpolationInfo( pInfo, targettime, true, i + 1, false, CInterpolationHistoryCache::NO_MORE_CHANGES_ALWAYS, pCache );
 			return true;
 		}
 
+		nSamples = i + 1;
+		bExactCount = false;
+		int nNoMoreChanges = CInterpolationHistoryCache::NO_MORE_CHANGES_NEVER;
+
 		float newer_change_time = varHistory[ pInfo->newer ].changetime;
 		float dt = newer_change_time - older_change_time;
 		if ( dt > 0.0001f )
@@ -857,6 +989,17 @@ inline bool CInterpolatedVarArrayBase<Type, IS_ARRAY>::GetInterpolationInfo(
 				{
 					pInfo->m_bHermite = true;
 				}
+				nSamples = i + 2;
+			}
+			else if ( !(m_fType & INTERPOLATE_LINEAR_ONLY) )
+			{
+				// Found there was no older sample.
+				bExactCount = true;
+			}
+
+			if ( pInfo->newer == m_VarHistory.Head() )
+			{
+				nNoMoreChanges = CInterpolationHistoryCache::NO_MORE_CHANGES_IF_SAMPLES_MATCH;
 			}
 
 			// If pInfo->newer is the most recent entry we have, and all 2 or 3 other
@@ -871,6 +1014,9 @@ inline bool CInterpolatedVarArrayBase<Type, IS_ARRAY>::GetInterpolationInfo(
 				 }
 			}
 		}
+
+		if ( pCache )
+			StoreCachedInterpolationInfo( pInfo, targettime, true, nSamples, bExactCount, nNoMoreChanges, pCache );
 		return true;
 	}
 
@@ -878,13 +1024,117 @@ inline bool CInterpolatedVarArrayBase<Type, IS_ARRAY>::GetInterpolationInfo(
 	if ( pInfo->newer != varHistory.InvalidIndex() )
 	{
 		pInfo->older = pInfo->newer;
+		if ( pCache )
+			StoreCachedInterpolationInfo( pInfo, targettime, true, nSamples, bExactCount, CInterpolationHistoryCache::NO_MORE_CHANGES_NEVER, pCache );
 		return true;
 	}
 
 
 	// This is the single-element case
 	pInfo->newer = pInfo->older;
-	return (pInfo->older != varHistory.InvalidIndex());
+	bool bResult = (pInfo->older != varHistory.InvalidIndex());
+	if ( pCache )
+		StoreCachedInterpolationInfo( pInfo, targettime, bResult, nSamples, bExactCount, CInterpolationHistoryCache::NO_MORE_CHANGES_NEVER, pCache );
+	return bResult;
+}
+
+
+template< typename Type, bool IS_ARRAY >
+inline bool CInterpolatedVarArrayBase<Type, IS_ARRAY>::FindCachedInterpolationInfo( 
+	typename CInterpolatedVarArrayBase<Type, IS_ARRAY>::CInterpolationInfo *pInfo,
+	float targettime, 
+	int *pNoMoreChanges,
+	CInterpolationHistoryCache *pCache,
+	bool *pResult
+	)
+{
+	bool bLinearOnly = ( m_fType & INTERPOLATE_LINEAR_ONLY ) != 0;
+	int nCount = m_VarHistory.Count();
+
+	for ( int iSearch = 0; iSearch < pCache->m_nSearches; iSearch++ )
+	{
+		const CInterpolationHistoryCache::Search_t &search = pCache->m_Searches[ iSearch ];
+		if ( search.m_flTargetTime != targettime || search.m_bLinearOnly != bLinearOnly )
+			continue;
+
+		if ( search.m_bExactCount ? ( nCount != search.m_nSamples ) : ( nCount < search.m_nSamples ) )
+			continue;
+
+		int i;
+		for ( i = 0; i < search.m_nSamples; i++ )
+		{
+			if ( m_VarHistory[ i ].changetime != search.m_flChangeTimes[ i ] )
+				break;
+		}
+		if ( i != search.m_nSamples )
+			continue;
+
+		pInfo->m_bHermite = search.m_bHermite;
+		pInfo->oldest = search.m_nOldest;
+		pInfo->older = search.m_nOlder;
+		pInfo->newer = search.m_nNewer;
+		pInfo->frac = search.m_flFrac;
+
+		if ( pNoMoreChanges )
+		{
+			if ( search.m_nNoMoreChanges == CInterpolationHistoryCache::NO_MORE_CHANGES_ALWAYS )
+			{
+				*pNoMoreChanges = 1;
+			}
+			else if ( search.m_nNoMoreChanges == CInterpolationHistoryCache::NO_MORE_CHANGES_IF_SAMPLES_MATCH )
+			{
+				if ( COMPARE_HISTORY( pInfo->newer, pInfo->older ) )
+				{
+					if ( !pInfo->m_bHermite || COMPARE_HISTORY( pInfo->newer, pInfo->oldest ) )
+						*pNoMoreChanges = 1;
+				}
+			}
+		}
+
+		++pCache->m_nHits;
+		*pResult = search.m_bResult;
+		return true;
+	}
+
+	++pCache->m_nMisses;
+	return false;
+}
+
+
+template< typename Type, bool IS_ARRAY >
+inline void CInterpolatedVarArrayBase<Type, IS_ARRAY>::StoreCachedInterpolationInfo( 
+	const typename CInterpolatedVarArrayBase<Type, IS_ARRAY>::CInterpolationInfo *pInfo,
+	float targettime, 
+	bool bResult,
+	int nSamples,
+	bool bExactCount,
+	int nNoMoreChanges,
+	CInterpolationHistoryCache *pCache
+	)
+{
+	if ( nSamples > CInterpolationHistoryCache::MAX_SAMPLES )
+		return;
+
+	CInterpolationHistoryCache::Search_t &search = pCache->m_Searches[ pCache->m_nNextSearch ];
+	pCache->m_nNextSearch = ( pCache->m_nNextSearch + 1 ) % CInterpolationHistoryCache::MAX_SEARCHES;
+	pCache->m_nSearches = MIN( pCache->m_nSearches + 1, (int)CInterpolationHistoryCache::MAX_SEARCHES );
+
+	search.m_flTargetTime = targettime;
+	search.m_bLinearOnly = ( m_fType & INTERPOLATE_LINEAR_ONLY ) != 0;
+	search.m_bExactCount = bExactCount;
+	search.m_nSamples = nSamples;
+	for ( int i = 0; i < nSamples; i++ )
+	{
+		search.m_flChangeTimes[ i ] = m_VarHistory[ i ].changetime;
+	}
+
+	search.m_bResult = bResult;
+	search.m_bHermite = pInfo->m_bHermite;
+	search.m_nOldest = pInfo->oldest;
+	search.m_nOlder = pInfo->older;
+	search.m_nNewer = pInfo->newer;
+	search.m_flFrac = pInfo->frac;
+	search.m_nNoMoreChanges = nNoMoreChanges;
 }
 
 
@@ -966,11 +1216,17 @@ inline void CInterpolatedVarArrayBase<Type, IS_ARRAY>::DebugInterpolate( Type *p
 
 template< typename Type, bool IS_ARRAY >
 inline int CInterpolatedVarArrayBase<Type, IS_ARRAY>::Interpolate( float currentTime, float interpolation_amount )
+{
+	return InterpolateWithCache( currentTime, interpolation_amount, NULL );
+}
+
+template< typename Type, bool IS_ARRAY >
+inline int CInterpolatedVarArrayBase<Type, IS_ARRAY>::InterpolateWithCache( float currentTime, float interpolation_amount, CInterpolationHistoryCache *pCache )
 {
 	int noMoreChanges = 0;
 	
 	CInterpolationInfo info;
-	if (!GetInterpolationInfo( &info, currentTime, interpolation_amount, &noMoreChanges ))
+	if (!GetInterpolationInfo( &info, currentTime, interpolation_amount, &noMoreChanges, pCache ))
 		return noMoreChanges;
 
 	
@@ -1025,12 +1281,12 @@ inline int CInterpolatedVarArrayBase<Type, IS_ARRAY>::Interpolate( float current
 		}
 		else
 		{
-			_Interpolate( m_pValue, info.frac, &history[info.older], &history[info.newer] );
+			_Interpolate( m_pValue, info.frac, &history[info.older], &history[info.newer], pCache != NULL );
 		}
 	}
 	else
 	{
-		_Interpolate( m_pValue, info.frac, &history[info.older], &history[info.newer] );
+		_Interpolate( m_pValue, info.frac, &history[info.older], &history[info.newer], pCache != NULL );
 	}
 
 #ifdef INTERPOLATEDVAR_PARANOID_MEASUREMENT
@@ -1153,6 +1409,33 @@ inline int CInterpolatedVarArrayBase<Type, IS_ARRAY>::Interpolate( float current
 	return Interpolate( currentTime, m_InterpolationAmount );
 }
 
+template< typename Type, bool IS_ARRAY >
+inline int CInterpolatedVarArrayBase<Type, IS_ARRAY>::InterpolateWithCache( float currentTime, CInterpolationHistoryCache *pCache )
+{
+	return InterpolateWithCache( currentTime, m_InterpolationAmount, pCache );
+}
+
+template< typename Type, bool IS_ARRAY >
+inline bool CInterpolatedVarArrayBase<Type, IS_ARRAY>::CheckInterpolateWithCache( float currentTime, CInterpolationHistoryCache *pCache )
+{
+	Assert( m_pValue );
+
+	int nBytes = m_nMaxCount * sizeof( Type );
+	Type *pBackup = (Type*)stackalloc( nBytes );
+	Type *pScalar = (Type*)stackalloc( nBytes );
+	memcpy( pBackup, m_pValue, nBytes );
+
+	int nScalarNoMoreChanges = Interpolate( currentTime );
+	memcpy( pScalar, m_pValue, nBytes );
+	memcpy( m_pValue, pBackup, nBytes );
+
+	int nCachedNoMoreChanges = InterpolateWithCache( currentTime, pCache );
+	bool bMatch = ( nScalarNoMoreChanges == nCachedNoMoreChanges ) && ( memcmp( pScalar, m_pValue, nBytes ) == 0 );
+	memcpy( m_pValue, pBackup, nBytes );
+
+	return bMatch;
+}
+
 template< typename Type, bool IS_ARRAY >
 inline void CInterpolatedVarArrayBase<Type, IS_ARRAY>::Copy( IInterpolatedVar *pInSrc )
 {
@@ -1307,7 +1590,7 @@ inline int CInterpolatedVarArrayBase<Type, IS_ARRAY>::GetMaxCount() const
 
 
 template< typename Type, bool IS_ARRAY >
-inline void CInterpolatedVarArrayBase<Type, IS_ARRAY>::_Interpolate( Type *out, float frac, CInterpolatedVarEntry *start, CInterpolatedVarEntry *end )
+inline void CInterpolatedVarArrayBase<Type, IS_ARRAY>::_Interpolate( Type *out, float frac, CInterpolatedVarEntry *start, CInterpolatedVarEntry *end, bool bSIMD )
 {
 	Assert( start );
 	Assert( end );
@@ -1325,6 +1608,13 @@ inline void CInterpolatedVarArrayBase<Type, IS_ARRAY>::_Interpolate( Type *out,
 
 	Assert( frac >= 0.0f && frac <= 1.0f );
 
+	// Single vectors aren't worth the loads.
+	if ( bSIMD && InterpolatedVarFloatCount<Type>::COUNT * m_nMaxCount >= 4 )
+	{
+		_Interpolate_SIMD( out, frac, start, end );
+		return;
+	}
+
 	// Note that QAngle has a specialization that will do quaternion interpolation here...
 	for ( int i = 0; i < m_nMaxCount; i++ )
 	{
@@ -1341,6 +1631,38 @@ inline void CInterpolatedVarArrayBase<Type, IS_ARRAY>::_Interpolate( Type *out,
 }
 
 
+//-----------------------------------------------------------------------------
+// Lerps runs of non-looping elements as flat float arrays. Only used for types
+// with an InterpolatedVarFloatCount, whose Lerp_Clamp does nothing.
+//-----------------------------------------------------------------------------
+template< typename Type, bool IS_ARRAY >
+inline void CInterpolatedVarArrayBase<Type, IS_ARRAY>::_Interpolate_SIMD( Type *out, float frac, CInterpolatedVarEntry *start, CInterpolatedVarEntry *end )
+{
+	const int nFloatsPerElement = InterpolatedVarFloatCount<Type>::COUNT;
+	Assert( nFloatsPerElement > 0 );
+
+	int i = 0;
+	while ( i < m_nMaxCount )
+	{
+		if ( m_bLooping[ i ] )
+		{
+			out[i] = LoopingLerp( frac, start->GetValue()[i], end->GetValue()[i] );
+			++i;
+			continue;
+		}
+
+		int nRunStart = i;
+		while ( i < m_nMaxCount && !m_bLooping[ i ] )
+		{
+			++i;
+		}
+
+		LerpFloats_SIMD( (float*)&out[nRunStart], (const float*)&start->GetValue()[nRunStart], 
+			(const float*)&end->GetValue()[nRunStart], frac, ( i - nRunStart ) * nFloatsPerElement );
+	}
+}
+
+
 template< typename Type, bool IS_ARRAY >
 inline void CInterpolatedVarArrayBase<Type, IS_ARRAY>::_Extrapolate( 
 	Type *pOut,
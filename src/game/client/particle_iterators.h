@@ -52,6 +52,10 @@ public:
 	// it should GO AWAY SOON!
 	ParticleDraw* GetParticleDraw() const;
 
+	// Effects that render their own particle storage instead of walking GetFirst/GetNext
+	// must call this after each particle so the mesh gets flushed in batches.
+	void AddExternalParticle();
+
 
 private:
 
@@ -143,6 +147,11 @@ inline const Particle* CParticleRenderIterator::GetFirst()
 	return m_pCur;
 }
 
+inline void CParticleRenderIterator::AddExternalParticle()
+{
+	TestFlushBatch();
+}
+
 inline void CParticleRenderIterator::TestFlushBatch()
 {
 	++m_nParticlesInCurrentBatch;
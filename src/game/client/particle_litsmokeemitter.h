@@ -28,6 +28,7 @@ public:
 	virtual void	StartRender( VMatrix &effectMatrix );
 	virtual void RenderParticles( CParticleRenderIterator *pIterator );
 	virtual void SimulateParticles( CParticleSimulateIterator *pIterator );
+	virtual bool IsSimulateThreadSafe() const { return typeid( *this ) == typeid( CLitSmokeEmitter ); }
 
 	virtual	void	Init( const char *materialName, Vector sortOrigin );
 	
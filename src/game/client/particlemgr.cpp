@@ -531,6 +531,19 @@ Particle* CParticleEffectBinding::AddParticle( int sizeInBytes, PMaterialHandle
 	return pParticle;
 }
 
+void CParticleEffectBinding::SetExternalParticles( int nActiveParticles, PMaterialHandle hMaterial )
+{
+	Assert( nActiveParticles <= MAX_TOTAL_PARTICLES );
+
+	if ( hMaterial )
+	{
+		m_pParticleMgr->RepairPMaterial( hMaterial ); //HACKHACK: Remove this when we can stop leaking handles from level to level.
+		GetEffectMaterial( hMaterial );
+	}
+
+	m_nActiveParticles = nActiveParticles;
+}
+
 void CParticleEffectBinding::SetBBox( const Vector &bbMin, const Vector &bbMax, bool bDisableAutoUpdate )
 {
 	m_Min = bbMin;
@@ -655,6 +668,38 @@ void CParticleEffectBinding::SimulateParticles( float flTimeDelta )
 	if ( !m_pSim->ShouldSimulate() )
 		return;
 
+	SimulateParticles( flTimeDelta, StartSimulateParticles() );
+}
+
+
+//-----------------------------------------------------------------------------
+// Advance the bbox update watchdog. Uses the shared random stream, so this
+// must run on the main thread even when the simulation itself doesn't.
+//-----------------------------------------------------------------------------
+bool CParticleEffectBinding::StartSimulateParticles()
+{
+	if ( GetFlag( FLAGS_NEW_PARTICLE_SYSTEM ) )
+		return false;
+
+	// slow the expensive update operation for particle systems that use auto-update-bbox
+	// auto update the bbox after N frames then randomly 1/N or after 2*N frames 
+	bool bFullBBoxUpdate = false;
+	++m_UpdateBBoxCounter;
+	if ( ( m_UpdateBBoxCounter >= BBOX_UPDATE_EVERY_N && random->RandomInt( 0, BBOX_UPDATE_EVERY_N ) == 0 ) ||
+		 ( m_UpdateBBoxCounter >= 2*BBOX_UPDATE_EVERY_N ) )
+	{
+		bFullBBoxUpdate = true;
+
+		// reset watchdog
+		m_UpdateBBoxCounter = 0;
+	}
+
+	return bFullBBoxUpdate;
+}
+
+
+void CParticleEffectBinding::SimulateParticles( float flTimeDelta, bool bFullBBoxUpdate )
+{
 	if ( GetFlag( FLAGS_NEW_PARTICLE_SYSTEM ) )
 	{
 		CParticleSimulateIterator simulateIterator;
@@ -668,19 +713,6 @@ void CParticleEffectBinding::SimulateParticles( float flTimeDelta )
 		Vector bbMin(0,0,0), bbMax(0,0,0);
 		bool bboxSet = false;
 
-		// slow the expensive update operation for particle systems that use auto-update-bbox
-		// auto update the bbox after N frames then randomly 1/N or after 2*N frames 
-		bool bFullBBoxUpdate = false;
-		++m_UpdateBBoxCounter;
-		if ( ( m_UpdateBBoxCounter >= BBOX_UPDATE_EVERY_N && random->RandomInt( 0, BBOX_UPDATE_EVERY_N ) == 0 ) ||
-			 ( m_UpdateBBoxCounter >= 2*BBOX_UPDATE_EVERY_N ) )
-		{
-			bFullBBoxUpdate = true;
-
-			// reset watchdog
-			m_UpdateBBoxCounter = 0;
-		}
-
 		if ( bFullBBoxUpdate )
 		{
 			BBoxCalcStart( bbMin, bbMax );
@@ -1188,6 +1220,21 @@ void CParticleMgr::FreeParticle( Particle *pParticle )
 	free( pParticle );
 }
 
+bool CParticleMgr::ReserveParticles( int nCount )
+{
+	if ( m_nCurrentParticlesAllocated + nCount > MAX_TOTAL_PARTICLES )
+		return false;
+
+	m_nCurrentParticlesAllocated += nCount;
+	return true;
+}
+
+void CParticleMgr::ReleaseParticles( int nCount )
+{
+	Assert( m_nCurrentParticlesAllocated >= nCount );
+	m_nCurrentParticlesAllocated -= nCount;
+}
+
 
 //-----------------------------------------------------------------------------
 // Should particle effects be rendered?
@@ -1537,6 +1584,7 @@ void EndSimulateParticles( void )
 
 
 static ConVar r_threaded_particles( "r_threaded_particles", "1" );
+static ConVar r_threaded_legacy_particles( "r_threaded_legacy_particles", "1", 0, "Simulate thread-safe legacy particle effects on the job pool. 0 simulates every effect serially in list order." );
 
 static float s_flThreadedPSystemTimeStep;
 
@@ -1931,6 +1979,44 @@ void CParticleMgr::UpdateNewEffects( float flTimeDelta )
 	}
 }
 
+static float s_flThreadedLegacyTimeStep;
+
+static void ProcessLegacyEffect( LegacyParticleSimListEntry_t& simListEntry )
+{
+	FPExceptionEnabler enableExceptions;
+
+	simListEntry.m_pEffect->SimulateParticles( s_flThreadedLegacyTimeStep, simListEntry.m_bFullBBoxUpdate );
+}
+
+
+//-----------------------------------------------------------------------------
+// Simulate the effects gathered in m_ThreadedEffects. Each job only touches its
+// own binding and particles; freeing particles is safe from any thread.
+//-----------------------------------------------------------------------------
+void CParticleMgr::SimulateLegacyEffects( float flTimeDelta )
+{
+	VPROF_BUDGET( "CParticleMgr::SimulateLegacyEffects", "Particle Simulation" );
+
+	s_flThreadedLegacyTimeStep = flTimeDelta;
+
+	int nCount = m_ThreadedEffects.Count();
+	if ( nCount == 1 )
+	{
+		ProcessLegacyEffect( m_ThreadedEffects[0] );
+	}
+	else if ( !m_pThreadPool[1] )
+	{
+		ParallelProcess( "CParticleMgr::SimulateLegacyEffects", m_ThreadedEffects.Base(), nCount, ProcessLegacyEffect );
+	}
+	else
+	{
+		CParallelProcessor<LegacyParticleSimListEntry_t, CFuncJobItemProcessor<LegacyParticleSimListEntry_t> > processor( "CParticleMgr::SimulateLegacyEffects" );
+		processor.m_ItemProcessor.Init( ProcessLegacyEffect, NULL, NULL );
+		processor.Run( m_ThreadedEffects.Base(), nCount, INT_MAX, m_pThreadPool[1] );
+	}
+}
+
+
 void CParticleMgr::UpdateAllEffects( float flTimeDelta )
 {
 	// These reflect the convars so we don't parse the strings every particle.
@@ -1943,6 +2029,10 @@ void CParticleMgr::UpdateAllEffects( float flTimeDelta )
 	if( flTimeDelta > 0.1f )
 		flTimeDelta = 0.1f;
 
+	double flStartSimTime = Plat_FloatTime();
+	bool bThreaded = r_threaded_legacy_particles.GetBool();
+	m_ThreadedEffects.RemoveAll();
+
 	FOR_EACH_LL( m_Effects, iEffect )
 	{
 		CParticleEffectBinding *pEffect = m_Effects[iEffect];
@@ -1971,14 +2061,48 @@ void CParticleMgr::UpdateAllEffects( float flTimeDelta )
 		pEffect->m_pSim->Update( flTimeDelta );
 
 		if ( pEffect->GetFirstFrameFlag() )
+		{
 			pEffect->SetFirstFrameFlag( false );
+		}
 		else
+		{
+			if ( g_bMeasureParticlePerformance && pEffect->m_pSim->ShouldSimulate() )
+			{
+				g_nNumParticlesSimulated += pEffect->GetNumActiveParticles();
+			}
+
+			if ( bThreaded && pEffect->m_pSim->ShouldSimulate() && pEffect->m_pSim->IsSimulateThreadSafe() )
+			{
+				// simulated on the job pool once every effect has been updated
+				LegacyParticleSimListEntry_t entry = { pEffect, pEffect->StartSimulateParticles() };
+				m_ThreadedEffects.AddToTail( entry );
+				continue;
+			}
+
 			pEffect->SimulateParticles( flTimeDelta );
+		}
 
 		// Update its position in the leaf system if its bbox changed.
 		pEffect->DetectChanges();
 	}
 
+	if ( m_ThreadedEffects.Count() )
+	{
+		SimulateLegacyEffects( flTimeDelta );
+
+		// the leaf system isn't thread-safe, so update positions back on this thread
+		FOR_EACH_VEC( m_ThreadedEffects, i )
+		{
+			m_ThreadedEffects[i].m_pEffect->DetectChanges();
+		}
+		m_ThreadedEffects.RemoveAll();
+	}
+
+	if ( g_bMeasureParticlePerformance )
+	{
+		g_nNumUSSpentSimulatingParticles += 1.0e6 * ( Plat_FloatTime() - flStartSimTime );
+	}
+
 	if ( g_bMeasureParticlePerformance )					// use fixed time step
 	{
 		for( float dt=0.0f; dt <= flTimeDelta ; dt+= 0.01f )
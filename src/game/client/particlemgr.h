@@ -145,6 +145,7 @@ class IThreadPool;
 class CParticleSystemDefinition;
 class CParticleMgr;
 class CNewParticleEffect;
+class CParticleEffectBinding;
 class CParticleCollection;
 
 #define INVALID_MATERIAL_HANDLE	NULL
@@ -243,6 +244,13 @@ struct ParticleSimListEntry_t
 	bool m_bBoundingBoxOnly;
 };
 
+// Legacy effect simulation list, used by the threaded update of CParticleEffectBindings.
+struct LegacyParticleSimListEntry_t
+{
+	CParticleEffectBinding* m_pEffect;
+	bool m_bFullBBoxUpdate;
+};
+
 
 //-----------------------------------------------------------------------------
 // interface IParticleEffect:
@@ -276,6 +284,11 @@ public:
 	virtual void	SetShouldSimulate( bool bSim ) = 0;
 	virtual void	SimulateParticles( CParticleSimulateIterator *pIterator ) = 0;
 
+	// Return true if SimulateParticles only touches this effect's own particles, so it can
+	// run on a worker thread alongside other effects. It must not call into entities,
+	// trace, use the shared random stream, or add particles.
+	virtual bool	IsSimulateThreadSafe() const { return false; }
+
 	// Render the particles.
 	virtual void	RenderParticles( CParticleRenderIterator *pIterator ) = 0;
 
@@ -354,6 +367,11 @@ public:
 	// Simulate all the particles.
 	void			SimulateParticles( float flTimeDelta );
 
+	// Split version of SimulateParticles for the threaded update. StartSimulateParticles must be
+	// called on the main thread and returns whether this frame does a full bbox update.
+	bool			StartSimulateParticles();
+	void			SimulateParticles( float flTimeDelta, bool bFullBBoxUpdate );
+
 	// Use this to specify materials when adding particles. 
 	// Returns the index of the material it found or added.
 	// Returns INVALID_MATERIAL_HANDLE if it couldn't find or add a material.
@@ -365,6 +383,12 @@ public:
 	// structure in bytes
 	Particle*		AddParticle( int sizeInBytes, PMaterialHandle pMaterial );
 
+	// For effects that keep their own particle storage instead of calling AddParticle
+	// (see CSoaSimpleEmitter). Makes sure DrawModel renders the material, and sets the
+	// active particle count used for drawing and stats.
+	// Only pass hMaterial from the main thread.
+	void			SetExternalParticles( int nActiveParticles, PMaterialHandle hMaterial = NULL );
+
 	// This is an optional call you can make if you want to manually manage the effect's
 	// bounding box. Normally, the bounding box is managed automatically, but in certain
 	// cases it is more efficient to set it manually.
@@ -668,6 +692,11 @@ public:
 	Particle		*AllocParticle( int size );
 	void			FreeParticle( Particle * );
 
+	// Counts particles an effect stores itself (see CSoaSimpleEmitter) against the same
+	// MAX_TOTAL_PARTICLES budget as AllocParticle. Returns false if the budget is used up.
+	bool			ReserveParticles( int nCount );
+	void			ReleaseParticles( int nCount );
+
 	PMaterialHandle	GetPMaterial( const char *pMaterialName );
 	IMaterial*		PMaterialToIMaterial( PMaterialHandle hMaterial );
 
@@ -716,6 +745,8 @@ private:
 
 	void UpdateNewEffects( float flTimeDelta );				// update new particle effects
 
+	void SimulateLegacyEffects( float flTimeDelta );		// simulate m_ThreadedEffects on the job pool
+
 	CParticleSubTextureGroup* FindOrAddSubTextureGroup( IMaterial *pPageMaterial );
 
 	int ComputeParticleDefScreenArea( int nInfoCount, RetireInfo_t *pInfo, float *pTotalArea, CParticleSystemDefinition* pDef, 
@@ -729,7 +760,7 @@ private:
 
 private:
 
-	int m_nCurrentParticlesAllocated;
+	CInterlockedInt m_nCurrentParticlesAllocated;			// particles are freed from worker threads during SimulateLegacyEffects
 
 	// Directional lighting info.
 	CParticleLightInfo m_DirectionalLight;
@@ -745,6 +776,9 @@ private:
 	// All the active effects.
 	CUtlLinkedList<CParticleEffectBinding*, unsigned short>		m_Effects;
 
+	// Effects gathered by UpdateAllEffects to be simulated in parallel this frame.
+	CUtlVector< LegacyParticleSimListEntry_t >	m_ThreadedEffects;
+
 	// all the active effects using the new particle interface
 	CUtlIntrusiveDList< CNewParticleEffect > m_NewEffects;
 
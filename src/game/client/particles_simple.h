@@ -172,6 +172,10 @@ public:
 	virtual void	SimulateParticles( CParticleSimulateIterator *pIterator );
 	virtual void	RenderParticles( CParticleRenderIterator *pIterator );
 
+	// Only the stock simulation is known to be thread-safe; variants that override the
+	// Update* hooks must opt in themselves.
+	virtual bool	IsSimulateThreadSafe() const { return typeid( *this ) == typeid( CSimpleEmitter ); }
+
 	void			SetNearClip( float nearClipMin, float nearClipMax );
 
 	void			SetDrawBeforeViewModel( bool state = true );
@@ -0,0 +1,413 @@
+//========= Copyright Valve Corporation, All rights reserved. ============//
+//
+// Purpose: Structure-of-arrays variant of CSimpleEmitter, simulated 4 particles
+//			at a time with SIMD.
+//
+// $NoKeywords: $
+//===========================================================================//
+#include "cbase.h"
+#include "particles_soa.h"
+#include "particle_util.h"
+#include "tier0/fasttimer.h"
+
+// memdbgon must be the last include file in a .cpp file!!!
+#include "tier0/memdbgon.h"
+
+
+//-----------------------------------------------------------------------------
+// CSoaSimpleParticles
+//-----------------------------------------------------------------------------
+CSoaSimpleParticles::CSoaSimpleParticles()
+{
+	m_nCount = 0;
+}
+
+
+void CSoaSimpleParticles::Init( int nMaxParticles )
+{
+	m_Data.Purge();
+	for ( int i = 0; i < SOA_PARTICLE_ATTRIBUTE_COUNT; ++i )
+	{
+		m_Data.SetAttributeType( i, ATTRDATATYPE_FLOAT );
+	}
+	m_Data.AllocateData( nMaxParticles, 1 );
+	m_nCount = 0;
+}
+
+
+bool CSoaSimpleParticles::AddParticle( const SimpleParticle &particle )
+{
+	if ( m_nCount >= MaxCount() )
+		return false;
+
+	int i = m_nCount++;
+	Element( SOA_PARTICLE_POS_X, i ) = particle.m_Pos.x;
+	Element( SOA_PARTICLE_POS_Y, i ) = particle.m_Pos.y;
+	Element( SOA_PARTICLE_POS_Z, i ) = particle.m_Pos.z;
+	Element( SOA_PARTICLE_VEL_X, i ) = particle.m_vecVelocity.x;
+	Element( SOA_PARTICLE_VEL_Y, i ) = particle.m_vecVelocity.y;
+	Element( SOA_PARTICLE_VEL_Z, i ) = particle.m_vecVelocity.z;
+	Element( SOA_PARTICLE_LIFETIME, i ) = particle.m_flLifetime;
+	Element( SOA_PARTICLE_DIETIME, i ) = particle.m_flDieTime;
+	Element( SOA_PARTICLE_ROLL, i ) = particle.m_flRoll;
+	Element( SOA_PARTICLE_ROLLDELTA, i ) = particle.m_flRollDelta;
+	Element( SOA_PARTICLE_START_SIZE, i ) = particle.m_uchStartSize;
+	Element( SOA_PARTICLE_END_SIZE, i ) = particle.m_uchEndSize;
+	Element( SOA_PARTICLE_START_ALPHA, i ) = particle.m_uchStartAlpha / 255.0f;
+	Element( SOA_PARTICLE_END_ALPHA, i ) = particle.m_uchEndAlpha / 255.0f;
+	Element( SOA_PARTICLE_COLOR_R, i ) = particle.m_uchColor[0] / 255.0f;
+	Element( SOA_PARTICLE_COLOR_G, i ) = particle.m_uchColor[1] / 255.0f;
+	Element( SOA_PARTICLE_COLOR_B, i ) = particle.m_uchColor[2] / 255.0f;
+
+	// so it can be rendered before its first simulation
+	float t = ( particle.m_flDieTime > 0.0f ) ? particle.m_flLifetime / particle.m_flDieTime : 1.0f;
+	Element( SOA_PARTICLE_SIZE, i ) = Lerp( t, Element( SOA_PARTICLE_START_SIZE, i ), Element( SOA_PARTICLE_END_SIZE, i ) );
+	Element( SOA_PARTICLE_ALPHA, i ) = Lerp( t, Element( SOA_PARTICLE_START_ALPHA, i ), Element( SOA_PARTICLE_END_ALPHA, i ) );
+	return true;
+}
+
+
+void CSoaSimpleParticles::CopyParticle( int nFrom, int nTo )
+{
+	for ( int i = 0; i < SOA_PARTICLE_ATTRIBUTE_COUNT; ++i )
+	{
+		Element( i, nTo ) = Element( i, nFrom );
+	}
+}
+
+
+void CSoaSimpleParticles::Simulate( float flTimeDelta, Vector &bbMin, Vector &bbMax )
+{
+	if ( !m_nCount )
+		return;
+
+	// Copy the last particle into the padding lanes so every quad can be processed whole,
+	// and the padding can't push out the bounds.
+	int nPadded = ( m_nCount + 3 ) & ~3;
+	for ( int i = m_nCount; i < nPadded; ++i )
+	{
+		CopyParticle( m_nCount - 1, i );
+	}
+
+	fltx4 *pPosX = (fltx4 *)m_Data.RowPtr( SOA_PARTICLE_POS_X, 0 );
+	fltx4 *pPosY = (fltx4 *)m_Data.RowPtr( SOA_PARTICLE_POS_Y, 0 );
+	fltx4 *pPosZ = (fltx4 *)m_Data.RowPtr( SOA_PARTICLE_POS_Z, 0 );
+	const fltx4 *pVelX = (const fltx4 *)m_Data.ConstRowPtr( SOA_PARTICLE_VEL_X, 0 );
+	const fltx4 *pVelY = (const fltx4 *)m_Data.ConstRowPtr( SOA_PARTICLE_VEL_Y, 0 );
+	const fltx4 *pVelZ = (const fltx4 *)m_Data.ConstRowPtr( SOA_PARTICLE_VEL_Z, 0 );
+	fltx4 *pLifetime = (fltx4 *)m_Data.RowPtr( SOA_PARTICLE_LIFETIME, 0 );
+	const fltx4 *pDieTime = (const fltx4 *)m_Data.ConstRowPtr( SOA_PARTICLE_DIETIME, 0 );
+	fltx4 *pRoll = (fltx4 *)m_Data.RowPtr( SOA_PARTICLE_ROLL, 0 );
+	const fltx4 *pRollDelta = (const fltx4 *)m_Data.ConstRowPtr( SOA_PARTICLE_ROLLDELTA, 0 );
+	const fltx4 *pStartSize = (const fltx4 *)m_Data.ConstRowPtr( SOA_PARTICLE_START_SIZE, 0 );
+	const fltx4 *pEndSize = (const fltx4 *)m_Data.ConstRowPtr( SOA_PARTICLE_END_SIZE, 0 );
+	const fltx4 *pStartAlpha = (const fltx4 *)m_Data.ConstRowPtr( SOA_PARTICLE_START_ALPHA, 0 );
+	const fltx4 *pEndAlpha = (const fltx4 *)m_Data.ConstRowPtr( SOA_PARTICLE_END_ALPHA, 0 );
+	fltx4 *pSize = (fltx4 *)m_Data.RowPtr( SOA_PARTICLE_SIZE, 0 );
+	fltx4 *pAlpha = (fltx4 *)m_Data.RowPtr( SOA_PARTICLE_ALPHA, 0 );
+
+	fltx4 fl4TimeDelta = ReplicateX4( flTimeDelta );
+	fltx4 fl4MinX = Four_FLT_MAX, fl4MinY = Four_FLT_MAX, fl4MinZ = Four_FLT_MAX;
+	fltx4 fl4MaxX = Four_Negative_FLT_MAX, fl4MaxY = Four_Negative_FLT_MAX, fl4MaxZ = Four_Negative_FLT_MAX;
+	int nDeadMask = 0;
+
+	int nQuads = nPadded / 4;
+	for ( int i = 0; i < nQuads; ++i )
+	{
+		fltx4 x = MaddSIMD( pVelX[i], fl4TimeDelta, pPosX[i] );
+		fltx4 y = MaddSIMD( pVelY[i], fl4TimeDelta, pPosY[i] );
+		fltx4 z = MaddSIMD( pVelZ[i], fl4TimeDelta, pPosZ[i] );
+		pPosX[i] = x;
+		pPosY[i] = y;
+		pPosZ[i] = z;
+
+		fl4MinX = MinSIMD( fl4MinX, x );
+		fl4MinY = MinSIMD( fl4MinY, y );
+		fl4MinZ = MinSIMD( fl4MinZ, z );
+		fl4MaxX = MaxSIMD( fl4MaxX, x );
+		fl4MaxY = MaxSIMD( fl4MaxY, y );
+		fl4MaxZ = MaxSIMD( fl4MaxZ, z );
+
+		fltx4 lifetime = AddSIMD( pLifetime[i], fl4TimeDelta );
+		pLifetime[i] = lifetime;
+		pRoll[i] = MaddSIMD( pRollDelta[i], fl4TimeDelta, pRoll[i] );
+
+		fltx4 dieTime = pDieTime[i];
+		nDeadMask |= TestSignSIMD( CmpGeSIMD( lifetime, dieTime ) );
+
+		// fraction of the particle's life used, for the size and alpha ramps
+		fltx4 t = DivSIMD( lifetime, MaxSIMD( dieTime, Four_Epsilons ) );
+		pSize[i] = MaddSIMD( SubSIMD( pEndSize[i], pStartSize[i] ), t, pStartSize[i] );
+		pAlpha[i] = MaddSIMD( SubSIMD( pEndAlpha[i], pStartAlpha[i] ), t, pStartAlpha[i] );
+	}
+
+	if ( nDeadMask )
+	{
+		const float *pLife = Attribute( SOA_PARTICLE_LIFETIME );
+		const float *pDie = Attribute( SOA_PARTICLE_DIETIME );
+		for ( int i = 0; i < m_nCount; )
+		{
+			if ( pLife[i] >= pDie[i] )
+			{
+				// fill the hole with the last particle
+				--m_nCount;
+				if ( i != m_nCount )
+				{
+					CopyParticle( m_nCount, i );
+				}
+			}
+			else
+			{
+				++i;
+			}
+		}
+	}
+
+	// Fold the 4 lanes of the bounds. These include particles that died this frame,
+	// which only makes the box a little conservative.
+	ALIGN16 float flMin[3][4] ALIGN16_POST;
+	ALIGN16 float flMax[3][4] ALIGN16_POST;
+	StoreAlignedSIMD( flMin[0], fl4MinX );
+	StoreAlignedSIMD( flMin[1], fl4MinY );
+	StoreAlignedSIMD( flMin[2], fl4MinZ );
+	StoreAlignedSIMD( flMax[0], fl4MaxX );
+	StoreAlignedSIMD( flMax[1], fl4MaxY );
+	StoreAlignedSIMD( flMax[2], fl4MaxZ );
+	for ( int i = 0; i < 3; ++i )
+	{
+		bbMin[i] = MIN( MIN( flMin[i][0], flMin[i][1] ), MIN( flMin[i][2], flMin[i][3] ) );
+		bbMax[i] = MAX( MAX( flMax[i][0], flMax[i][1] ), MAX( flMax[i][2], flMax[i][3] ) );
+	}
+}
+
+
+//-----------------------------------------------------------------------------
+// CSoaSimpleEmitter
+//-----------------------------------------------------------------------------
+CSoaSimpleEmitter::CSoaSimpleEmitter( const char *pDebugName, PMaterialHandle hMaterial, int nMaxParticles ) : CParticleEffect( pDebugName )
+{
+	Assert( hMaterial );
+	m_hMaterial = hMaterial;
+	m_flNearClipMin	= 16.0f;
+	m_flNearClipMax	= 64.0f;
+	m_Particles.Init( clamp( nMaxParticles, 1, MAX_TOTAL_PARTICLES ) );
+}
+
+
+CSoaSimpleEmitter::~CSoaSimpleEmitter()
+{
+	ParticleMgr()->ReleaseParticles( m_Particles.Count() );
+}
+
+
+CSmartPtr<CSoaSimpleEmitter> CSoaSimpleEmitter::Create( const char *pDebugName, PMaterialHandle hMaterial, int nMaxParticles )
+{
+	CSoaSimpleEmitter *pRet = new CSoaSimpleEmitter( pDebugName, hMaterial, nMaxParticles );
+	pRet->SetDynamicallyAllocated( true );
+	return pRet;
+}
+
+
+//-----------------------------------------------------------------------------
+// Purpose: Set the internal near clip range for this particle system
+// Input  : nearClipMin - beginning of clip range
+//			nearClipMax - end of clip range
+//-----------------------------------------------------------------------------
+void CSoaSimpleEmitter::SetNearClip( float nearClipMin, float nearClipMax )
+{
+	m_flNearClipMin = nearClipMin;
+	m_flNearClipMax = nearClipMax;
+}
+
+
+bool CSoaSimpleEmitter::AddSimpleParticle( const SimpleParticle &particle )
+{
+	Assert( !( particle.m_iFlags & SIMPLE_PARTICLE_FLAG_WINDBLOWN ) );
+
+	Vector bbMin = particle.m_Pos, bbMax = particle.m_Pos;
+	if ( m_Particles.Count() )
+	{
+		Vector vecMins, vecMaxs;
+		m_ParticleEffect.GetWorldspaceBounds( &vecMins, &vecMaxs );
+		VectorMin( bbMin, vecMins, bbMin );
+		VectorMax( bbMax, vecMaxs, bbMax );
+	}
+
+	if ( m_Particles.Count() >= m_Particles.MaxCount() || !ParticleMgr()->ReserveParticles( 1 ) )
+		return false;
+
+	m_Particles.AddParticle( particle );
+
+	// we own the bounds from here on, the binding can't see our particles
+	m_ParticleEffect.SetBBox( bbMin, bbMax );
+	m_ParticleEffect.SetExternalParticles( m_Particles.Count(), m_hMaterial );
+	return true;
+}
+
+
+void CSoaSimpleEmitter::SimulateParticles( CParticleSimulateIterator *pIterator )
+{
+	if ( m_Particles.Count() )
+	{
+		int nCount = m_Particles.Count();
+		Vector bbMin, bbMax;
+		m_Particles.Simulate( pIterator->GetTimeDelta(), bbMin, bbMax );
+		m_ParticleEffect.SetBBox( bbMin, bbMax );
+		ParticleMgr()->ReleaseParticles( nCount - m_Particles.Count() );
+	}
+
+	m_ParticleEffect.SetExternalParticles( m_Particles.Count() );
+
+	// Go away if we're released and there are no more particles.
+	if ( m_Particles.Count() == 0 && IsReleased() && ( m_Flags & FLAG_ALLOCATED ) && !( m_Flags & FLAG_DONT_REMOVE ) )
+	{
+		m_ParticleEffect.SetRemoveFlag();
+	}
+}
+
+
+//-----------------------------------------------------------------------------
+// Purpose: Orders particles by increasing view space z, the same order the
+//			binding's sort puts CSimpleEmitter particles in (farthest first)
+//-----------------------------------------------------------------------------
+int CSoaSimpleEmitter::SortedParticleCompare( const SortedParticle_t *pLeft, const SortedParticle_t *pRight )
+{
+	if ( pLeft->m_vecPos.z < pRight->m_vecPos.z )
+		return -1;
+	if ( pLeft->m_vecPos.z > pRight->m_vecPos.z )
+		return 1;
+	return pLeft->m_nIndex - pRight->m_nIndex;
+}
+
+
+void CSoaSimpleEmitter::RenderParticles( CParticleRenderIterator *pIterator )
+{
+	ParticleDraw *pDraw = pIterator->GetParticleDraw();
+	pDraw->m_pSubTexture = m_hMaterial;
+
+	const VMatrix &mModelView = ParticleMgr()->GetModelView();
+	const float *pPosX = m_Particles.Attribute( SOA_PARTICLE_POS_X );
+	const float *pPosY = m_Particles.Attribute( SOA_PARTICLE_POS_Y );
+	const float *pPosZ = m_Particles.Attribute( SOA_PARTICLE_POS_Z );
+
+	// Transform everything first so the particles can be drawn back to front
+	int nCount = m_Particles.Count();
+	m_SortedParticles.SetCount( nCount );
+	for ( int i = 0; i < nCount; ++i )
+	{
+		TransformParticle( mModelView, Vector( pPosX[i], pPosY[i], pPosZ[i] ), m_SortedParticles[i].m_vecPos );
+		m_SortedParticles[i].m_nIndex = i;
+	}
+	m_SortedParticles.Sort( SortedParticleCompare );
+
+	const float *pColorR = m_Particles.Attribute( SOA_PARTICLE_COLOR_R );
+	const float *pColorG = m_Particles.Attribute( SOA_PARTICLE_COLOR_G );
+	const float *pColorB = m_Particles.Attribute( SOA_PARTICLE_COLOR_B );
+	const float *pAlpha = m_Particles.Attribute( SOA_PARTICLE_ALPHA );
+	const float *pSize = m_Particles.Attribute( SOA_PARTICLE_SIZE );
+	const float *pRoll = m_Particles.Attribute( SOA_PARTICLE_ROLL );
+
+	for ( int iSorted = 0; iSorted < nCount; ++iSorted )
+	{
+		const Vector &tPos = m_SortedParticles[iSorted].m_vecPos;
+		int i = m_SortedParticles[iSorted].m_nIndex;
+
+		RenderParticle_ColorSizeAngle(
+			pDraw,
+			tPos,
+			Vector( pColorR[i], pColorG[i], pColorB[i] ),
+			pAlpha[i] * GetAlphaDistanceFade( tPos, m_flNearClipMin, m_flNearClipMax ),
+			pSize[i],
+			pRoll[i]
+			);
+
+		pIterator->AddExternalParticle();
+	}
+}
+
+
+//-----------------------------------------------------------------------------
+// Headless benchmark of CSoaSimpleParticles against the CSimpleEmitter
+// linked-list simulation, on the same particles.
+//-----------------------------------------------------------------------------
+static void SimulateSimpleParticlesAoS( SimpleParticle *pParticles, int nCount, float flTimeDelta, float *pSize, float *pAlpha )
+{
+	for ( int i = 0; i < nCount; ++i )
+	{
+		SimpleParticle *pParticle = &pParticles[i];
+		pParticle->m_Pos += pParticle->m_vecVelocity * flTimeDelta;
+		pParticle->m_flLifetime += flTimeDelta;
+		pParticle->m_flRoll += pParticle->m_flRollDelta * flTimeDelta;
+
+		float t = pParticle->m_flLifetime / pParticle->m_flDieTime;
+		pSize[i] = (float)pParticle->m_uchStartSize + ( (float)pParticle->m_uchEndSize - (float)pParticle->m_uchStartSize ) * t;
+		pAlpha[i] = ( pParticle->m_uchStartAlpha / 255.0f ) + ( pParticle->m_uchEndAlpha / 255.0f - pParticle->m_uchStartAlpha / 255.0f ) * t;
+	}
+}
+
+CON_COMMAND_F( cl_bench_particle_soa, "Time the SIMD structure-of-arrays particle simulation against the scalar one. Arguments: [particles] [frames]", FCVAR_CHEAT )
+{
+	int nParticles = ( args.ArgC() > 1 ) ? clamp( atoi( args[1] ), 4, 1024 * 1024 ) : 2048;
+	int nFrames = ( args.ArgC() > 2 ) ? clamp( atoi( args[2] ), 1, 100000 ) : 1000;
+	const float flTimeDelta = 1.0f / 60.0f;
+
+	CUtlVector< SimpleParticle > aos;
+	aos.SetCount( nParticles );
+	CUtlVector< float > aosSize, aosAlpha;
+	aosSize.SetCount( nParticles );
+	aosAlpha.SetCount( nParticles );
+
+	CSoaSimpleParticles soa;
+	soa.Init( nParticles );
+
+	for ( int i = 0; i < nParticles; ++i )
+	{
+		SimpleParticle &particle = aos[i];
+		particle.m_Pos = RandomVector( -512, 512 );
+		particle.m_vecVelocity = RandomVector( -64, 64 );
+		particle.m_flLifetime = 0.0f;
+		particle.m_flDieTime = nFrames * flTimeDelta * 2.0f;	// nothing dies, so both sides do the same work every frame
+		particle.m_flRoll = RandomFloat( 0, 360 );
+		particle.m_flRollDelta = RandomFloat( -2, 2 );
+		particle.m_uchColor[0] = particle.m_uchColor[1] = particle.m_uchColor[2] = 128;
+		particle.m_uchStartAlpha = 255;
+		particle.m_uchEndAlpha = 0;
+		particle.m_uchStartSize = 4;
+		particle.m_uchEndSize = 32;
+		soa.AddParticle( particle );
+	}
+
+	CFastTimer timer;
+	timer.Start();
+	for ( int i = 0; i < nFrames; ++i )
+	{
+		SimulateSimpleParticlesAoS( aos.Base(), nParticles, flTimeDelta, aosSize.Base(), aosAlpha.Base() );
+	}
+	timer.End();
+	double flAoSMicroseconds = MAX( timer.GetDuration().GetMicrosecondsF(), 1.0 );
+
+	Vector bbMin, bbMax;
+	timer.Start();
+	for ( int i = 0; i < nFrames; ++i )
+	{
+		soa.Simulate( flTimeDelta, bbMin, bbMax );
+	}
+	timer.End();
+	double flSoAMicroseconds = MAX( timer.GetDuration().GetMicrosecondsF(), 1.0 );
+
+	// compare the results so the benchmark doubles as a correctness check
+	float flMaxError = 0.0f;
+	const float *pPosX = soa.Attribute( SOA_PARTICLE_POS_X );
+	const float *pSize = soa.Attribute( SOA_PARTICLE_SIZE );
+	for ( int i = 0; i < nParticles; ++i )
+	{
+		flMaxError = MAX( flMaxError, fabs( pPosX[i] - aos[i].m_Pos.x ) );
+		flMaxError = MAX( flMaxError, fabs( pSize[i] - aosSize[i] ) );
+	}
+
+	double flParticleFrames = (double)nParticles * nFrames;
+	Msg( "%d particles, %d frames\n", nParticles, nFrames );
+	Msg( "  scalar AoS: %8.2f ms  %8.2f particles/us\n", flAoSMicroseconds / 1000.0, flParticleFrames / flAoSMicroseconds );
+	Msg( "  SIMD SoA:   %8.2f ms  %8.2f particles/us  (%.2fx)\n", flSoAMicroseconds / 1000.0, flParticleFrames / flSoAMicroseconds, flAoSMicroseconds / flSoAMicroseconds );
+	Msg( "  max difference %g\n", flMaxError );
+}
@@ -0,0 +1,138 @@
+//========= Copyright Valve Corporation, All rights reserved. ============//
+//
+// Purpose: Structure-of-arrays variant of CSimpleEmitter, simulated 4 particles
+//			at a time with SIMD.
+//
+// $NoKeywords: $
+//===========================================================================//
+
+#ifndef PARTICLES_SOA_H
+#define PARTICLES_SOA_H
+#ifdef _WIN32
+#pragma once
+#endif
+
+#include "particles_simple.h"
+#include "tier1/utlsoacontainer.h"
+
+
+// Per-particle attributes of CSoaSimpleParticles. Each one is a float column.
+enum SoaSimpleParticleAttribute_t
+{
+	SOA_PARTICLE_POS_X = 0,
+	SOA_PARTICLE_POS_Y,
+	SOA_PARTICLE_POS_Z,
+	SOA_PARTICLE_VEL_X,
+	SOA_PARTICLE_VEL_Y,
+	SOA_PARTICLE_VEL_Z,
+	SOA_PARTICLE_LIFETIME,
+	SOA_PARTICLE_DIETIME,
+	SOA_PARTICLE_ROLL,
+	SOA_PARTICLE_ROLLDELTA,
+	SOA_PARTICLE_START_SIZE,
+	SOA_PARTICLE_END_SIZE,
+	SOA_PARTICLE_START_ALPHA,
+	SOA_PARTICLE_END_ALPHA,
+	SOA_PARTICLE_COLOR_R,
+	SOA_PARTICLE_COLOR_G,
+	SOA_PARTICLE_COLOR_B,
+	SOA_PARTICLE_SIZE,						// output of Simulate()
+	SOA_PARTICLE_ALPHA,						// output of Simulate()
+
+	SOA_PARTICLE_ATTRIBUTE_COUNT
+};
+
+
+//-----------------------------------------------------------------------------
+// Fixed capacity particle storage and simulation, without any rendering, so
+// it can be driven headless (see cl_bench_particle_soa).
+//-----------------------------------------------------------------------------
+class CSoaSimpleParticles
+{
+public:
+	CSoaSimpleParticles();
+
+	void			Init( int nMaxParticles );
+	int				Count() const					{ return m_nCount; }
+	int				MaxCount() const				{ return m_Data.Count(); }
+
+	// Copies the simulation state of a CSimpleEmitter particle. Returns false when full.
+	bool			AddParticle( const SimpleParticle &particle );
+	void			RemoveAll()						{ m_nCount = 0; }
+
+	// Integrates position, lifetime and roll, computes size and alpha, then removes
+	// dead particles. Returns the bounds of the surviving particles in bbMin/bbMax.
+	void			Simulate( float flTimeDelta, Vector &bbMin, Vector &bbMax );
+
+	FORCEINLINE const float *Attribute( int nAttribute ) const
+	{
+		return m_Data.ElementPointer<float>( nAttribute );
+	}
+
+private:
+	FORCEINLINE float &Element( int nAttribute, int nParticle )
+	{
+		return m_Data.ElementPointer<float>( nAttribute )[nParticle];
+	}
+
+	void			CopyParticle( int nFrom, int nTo );
+
+	CSOAContainer	m_Data;
+	int				m_nCount;
+};
+
+
+//-----------------------------------------------------------------------------
+// CSoaSimpleEmitter simulates and renders like CSimpleEmitter, but keeps its
+// particles in a CSoaSimpleParticles instead of the binding's linked lists.
+// All particles share one material and can't be SIMPLE_PARTICLE_FLAG_WINDBLOWN.
+// They are drawn back to front, like the sorted CSimpleEmitter lists.
+//-----------------------------------------------------------------------------
+class CSoaSimpleEmitter : public CParticleEffect
+{
+public:
+	DECLARE_CLASS( CSoaSimpleEmitter, CParticleEffect );
+
+	static CSmartPtr<CSoaSimpleEmitter>	Create( const char *pDebugName, PMaterialHandle hMaterial, int nMaxParticles = MAX_TOTAL_PARTICLES );
+
+	// Fill in m_Pos and the SimpleParticle fields, the same way you would after
+	// CSimpleEmitter::AddSimpleParticle. Returns false if the emitter is full or
+	// the particle manager's MAX_TOTAL_PARTICLES budget is used up.
+	bool			AddSimpleParticle( const SimpleParticle &particle );
+
+	void			SetNearClip( float nearClipMin, float nearClipMax );
+
+	int				GetParticleCount() const		{ return m_Particles.Count(); }
+
+// IParticleEffect overrides.
+public:
+	virtual void	SimulateParticles( CParticleSimulateIterator *pIterator );
+	virtual void	RenderParticles( CParticleRenderIterator *pIterator );
+	virtual bool	IsSimulateThreadSafe() const	{ return true; }
+
+protected:
+					CSoaSimpleEmitter( const char *pDebugName, PMaterialHandle hMaterial, int nMaxParticles );
+	virtual			~CSoaSimpleEmitter();
+
+	// A particle's view space position, for sorting by depth before drawing
+	struct SortedParticle_t
+	{
+		Vector	m_vecPos;
+		int		m_nIndex;
+	};
+
+	static int		SortedParticleCompare( const SortedParticle_t *pLeft, const SortedParticle_t *pRight );
+
+	CSoaSimpleParticles	m_Particles;
+	PMaterialHandle		m_hMaterial;
+	CUtlVector<SortedParticle_t> m_SortedParticles;
+
+	float			m_flNearClipMin;
+	float			m_flNearClipMax;
+
+private:
+	CSoaSimpleEmitter( const CSoaSimpleEmitter & ); // not defined, not accessible
+};
+
+
+#endif // PARTICLES_SOA_H
@@ -85,6 +85,79 @@ static C_BaseEntity *FindPredictableByGameClass( const char *classname )
 
 	return NULL;
 }
+
+//-----------------------------------------------------------------------------
+// Purpose: Times a store and restore of every predictable through its packed
+//			data, with cl_pred_copy_plans off and on, and checks both stores agree
+//-----------------------------------------------------------------------------
+CON_COMMAND_F( cl_bench_pred_copy, "Times predicted entity store+restore with and without cl_pred_copy_plans. Usage: cl_bench_pred_copy [iterations]", FCVAR_CHEAT )
+{
+	int nIterations = ( args.ArgC() > 1 ) ? MAX( atoi( args[1] ), 1 ) : 100;
+
+	ConVarRef cl_pred_copy_plans( "cl_pred_copy_plans" );
+	bool bOldUsePlans = cl_pred_copy_plans.GetBool();
+
+	CUtlVector< byte > walkData;
+	CUtlVector< byte > planData;
+	double flMilliseconds[ 2 ] = { 0.0, 0.0 };
+	int nEntities = 0;
+	int nMismatches = 0;
+
+	int c = predictables->GetPredictableCount();
+	for ( int i = 0; i < c; i++ )
+	{
+		C_BaseEntity *ent = predictables->GetPredictable( i );
+		if ( !ent )
+			continue;
+
+		datamap_t *map = ent->GetPredDescMap();
+		if ( !map || !map->packed_offsets_computed )
+			continue;
+
+		++nEntities;
+		walkData.SetCount( map->packed_size );
+		planData.SetCount( map->packed_size );
+		V_memset( walkData.Base(), 0, map->packed_size );
+		V_memset( planData.Base(), 0, map->packed_size );
+
+		for ( int nUsePlans = 0; nUsePlans < 2; nUsePlans++ )
+		{
+			cl_pred_copy_plans.SetValue( nUsePlans );
+			byte *pData = nUsePlans ? planData.Base() : walkData.Base();
+
+			CFastTimer timer;
+			timer.Start();
+			for ( int j = 0; j < nIterations; j++ )
+			{
+				// Restoring what was just stored leaves the entity as it was
+				CPredictionCopy store( PC_EVERYTHING, pData, PC_DATA_PACKED, ent, PC_DATA_NORMAL );
+				store.TransferData( "", -1, map );
+				CPredictionCopy restore( PC_EVERYTHING, ent, PC_DATA_NORMAL, pData, PC_DATA_PACKED );
+				restore.TransferData( "", -1, map );
+			}
+			timer.End();
+			flMilliseconds[ nUsePlans ] += timer.GetDuration().GetMillisecondsF();
+		}
+
+		if ( V_memcmp( walkData.Base(), planData.Base(), map->packed_size ) )
+		{
+			++nMismatches;
+			Warning( "cl_bench_pred_copy: %s (%d) stored different data with cl_pred_copy_plans\n", ent->GetClassname(), ent->entindex() );
+		}
+	}
+
+	cl_pred_copy_plans.SetValue( bOldUsePlans );
+
+	if ( !nEntities )
+	{
+		Msg( "cl_bench_pred_copy: no predicted entities\n" );
+		return;
+	}
+
+	double flScale = 1000.0 / ( (double)nEntities * nIterations );
+	Msg( "cl_bench_pred_copy: %d predictables, store+restore %.3f us walking, %.3f us with plans, %d mismatches\n",
+		nEntities, flMilliseconds[ 0 ] * flScale, flMilliseconds[ 1 ] * flScale, nMismatches );
+}
 #endif
 
 
@@ -16,6 +16,7 @@
 #include "view.h"
 #include "physics_saverestore.h"
 #include "vphysics/constraints.h"
+#include "tier0/fasttimer.h"
 // memdbgon must be the last include file in a .cpp file!!!
 #include "tier0/memdbgon.h"
 
@@ -23,13 +24,63 @@
 extern ConVar r_FadeProps;
 #endif
 
+//-----------------------------------------------------------------------------
+// What each ragdoll LOD changes. VPhysics solves a ragdoll's constraint group
+// as a unit at the global physics rate, so the cheaper tiers trade accuracy
+// by reading bones less often, tolerating more constraint error, damping
+// motion and letting the ragdoll fall asleep sooner.
+//-----------------------------------------------------------------------------
+struct RagdollLODParams_t
+{
+	int		nBoneInterval;			// Frames between bone reads from physics
+	float	flDampingScale;
+	float	flErrorToleranceScale;
+	float	flSleepTimeScale;		// Scales ragdoll_sleepaftertime
+};
+
+static const RagdollLODParams_t s_RagdollLODParams[RAGDOLL_LOD_COUNT] =
+{
+	{ 1, 1.0f, 1.0f, 1.0f },		// RAGDOLL_LOD_FULL
+	{ 2, 1.0f, 2.0f, 0.5f },		// RAGDOLL_LOD_REDUCED
+	{ 4, 2.0f, 4.0f, 0.2f },		// RAGDOLL_LOD_DISTANT
+	{ 4, 2.0f, 4.0f, 0.2f },		// RAGDOLL_LOD_FROZEN
+};
+
+static CUtlVector<CRagdoll *> s_ClientRagdolls;
+static float s_flRagdollUpdateTime = 0.0f;
+
+int GetClientRagdollCount()
+{
+	return s_ClientRagdolls.Count();
+}
+
+CRagdoll *GetClientRagdoll( int i )
+{
+	return s_ClientRagdolls[i];
+}
+
+float ConsumeRagdollUpdateTime()
+{
+	float flTime = s_flRagdollUpdateTime;
+	s_flRagdollUpdateTime = 0.0f;
+	return flTime;
+}
+
 CRagdoll::CRagdoll()
 {
 	m_ragdoll.listCount = 0;
 	m_vecLastOrigin.Init();
 	m_flLastOriginChangeTime = - 1.0f;
+	m_allAsleep = false;
 	
 	m_lastUpdate = -FLT_MAX;
+
+	m_nLOD = RAGDOLL_LOD_FULL;
+	m_bHasBaseParams = false;
+	m_nCachedBoneMask = 0;
+	m_nCachedBoneFrame = -1;
+
+	s_ClientRagdolls.AddToTail( this );
 }
 
 #define DEFINE_RAGDOLL_ELEMENT( i ) \
@@ -159,18 +210,119 @@ CRagdoll::~CRagdoll( void )
 	}
 
 	RagdollDestroy( m_ragdoll );
+
+	s_ClientRagdolls.FindAndFastRemove( this );
 }
 
+//-----------------------------------------------------------------------------
+// Purpose: Moves the ragdoll to a new LOD, rescaling its damping and
+//			constraint error tolerance from the values it was created with.
+//-----------------------------------------------------------------------------
+void CRagdoll::SetLOD( int nLOD )
+{
+	nLOD = clamp( nLOD, (int)RAGDOLL_LOD_FULL, (int)RAGDOLL_LOD_FROZEN );
+	if ( nLOD == m_nLOD || !m_ragdoll.listCount )
+		return;
 
-void CRagdoll::RagdollBone( C_BaseEntity *ent, mstudiobone_t *pbones, int boneCount, bool *boneSimulated, CBoneAccessor &pBoneToWorld )
+	if ( !m_bHasBaseParams )
+	{
+		for ( int i = 0; i < m_ragdoll.listCount; i++ )
+		{
+			m_flBaseDamping[i][0] = m_flBaseDamping[i][1] = 0.0f;
+			if ( m_ragdoll.list[i].pObject )
+			{
+				m_ragdoll.list[i].pObject->GetDamping( &m_flBaseDamping[i][0], &m_flBaseDamping[i][1] );
+			}
+		}
+
+		m_BaseErrorParams.Defaults();
+		if ( m_ragdoll.pGroup )
+		{
+			m_ragdoll.pGroup->GetErrorParams( &m_BaseErrorParams );
+		}
+		m_bHasBaseParams = true;
+	}
+
+	const RagdollLODParams_t &oldParams = s_RagdollLODParams[m_nLOD];
+	const RagdollLODParams_t &params = s_RagdollLODParams[nLOD];
+	m_nLOD = nLOD;
+
+	if ( params.flDampingScale != oldParams.flDampingScale )
+	{
+		for ( int i = 0; i < m_ragdoll.listCount; i++ )
+		{
+			if ( !m_ragdoll.list[i].pObject )
+				continue;
+
+			float speed = m_flBaseDamping[i][0] * params.flDampingScale;
+			float rot = m_flBaseDamping[i][1] * params.flDampingScale;
+			m_ragdoll.list[i].pObject->SetDamping( &speed, &rot );
+		}
+	}
+
+	if ( m_ragdoll.pGroup && params.flErrorToleranceScale != oldParams.flErrorToleranceScale )
+	{
+		constraint_groupparams_t group = m_BaseErrorParams;
+		group.errorTolerance *= params.flErrorToleranceScale;
+		m_ragdoll.pGroup->SetErrorParams( group );
+	}
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: Writes the bones last read from physics if the LOD says this frame
+//			can skip reading them. Returns false if they need a fresh read.
+//-----------------------------------------------------------------------------
+bool CRagdoll::ReuseCachedBones( bool *boneSimulated, CBoneAccessor &pBoneToWorld )
 {
+	if ( m_nCachedBoneFrame < 0 || m_nLOD == RAGDOLL_LOD_FULL )
+		return false;
+
+	// Frozen ragdolls keep their pose only while physics agrees they're asleep
+	if ( m_nLOD == RAGDOLL_LOD_FROZEN )
+	{
+		if ( !m_allAsleep )
+			return false;
+	}
+	else if ( gpGlobals->framecount - m_nCachedBoneFrame >= s_RagdollLODParams[m_nLOD].nBoneInterval )
+	{
+		return false;
+	}
+
 	for ( int i = 0; i < m_ragdoll.listCount; i++ )
 	{
-		if ( RagdollGetBoneMatrix( m_ragdoll, pBoneToWorld, i ) )
+		if ( m_nCachedBoneMask & ( 1 << i ) )
+		{
+			int boneIndex = m_ragdoll.boneIndex[i];
+			MatrixCopy( m_CachedBones[i], pBoneToWorld.GetBoneForWrite( boneIndex ) );
+			boneSimulated[boneIndex] = true;
+		}
+	}
+	return true;
+}
+
+void CRagdoll::RagdollBone( C_BaseEntity *ent, mstudiobone_t *pbones, int boneCount, bool *boneSimulated, CBoneAccessor &pBoneToWorld )
+{
+	CFastTimer timer;
+	timer.Start();
+
+	if ( !ReuseCachedBones( boneSimulated, pBoneToWorld ) )
+	{
+		m_nCachedBoneMask = 0;
+		for ( int i = 0; i < m_ragdoll.listCount; i++ )
 		{
-			boneSimulated[m_ragdoll.boneIndex[i]] = true;
+			if ( RagdollGetBoneMatrix( m_ragdoll, pBoneToWorld, i ) )
+			{
+				int boneIndex = m_ragdoll.boneIndex[i];
+				boneSimulated[boneIndex] = true;
+				MatrixCopy( pBoneToWorld.GetBone( boneIndex ), m_CachedBones[i] );
+				m_nCachedBoneMask |= ( 1 << i );
+			}
 		}
+		m_nCachedBoneFrame = gpGlobals->framecount;
 	}
+
+	timer.End();
+	s_flRagdollUpdateTime += timer.GetDuration().GetMillisecondsF();
 }
 
 const Vector& CRagdoll::GetRagdollOrigin( )
@@ -190,6 +342,10 @@ void CRagdoll::VPhysicsUpdate( IPhysicsObject *pPhysics )
 	if ( m_lastUpdate == gpGlobals->curtime )
 		return;
 	m_lastUpdate = gpGlobals->curtime;
+
+	CFastTimer timer;
+	timer.Start();
+
 	m_allAsleep = RagdollIsAsleep( m_ragdoll );
 	if ( m_allAsleep )
 	{
@@ -215,6 +371,9 @@ void CRagdoll::VPhysicsUpdate( IPhysicsObject *pPhysics )
 
 	// See if we should go to sleep...
 	CheckSettleStationaryRagdoll();
+
+	timer.End();
+	s_flRagdollUpdateTime += timer.GetDuration().GetMillisecondsF();
 }
 
 //=============================================================================
@@ -287,7 +446,7 @@ void CRagdoll::CheckSettleStationaryRagdoll()
 
 	// It has stopped moving, see if it
 	float dt = gpGlobals->curtime - m_flLastOriginChangeTime;
-	if ( dt < ragdoll_sleepaftertime.GetFloat() )
+	if ( dt < ragdoll_sleepaftertime.GetFloat() * s_RagdollLODParams[m_nLOD].flSleepTimeScale )
 		return;
 
 	// Msg( "%d [%p] FORCE SLEEP\n",gpGlobals->tickcount, this );
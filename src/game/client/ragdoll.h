@@ -15,6 +15,7 @@
 #endif
 
 #include "ragdoll_shared.h"
+#include "vphysics/constraints.h"
 
 #define RAGDOLL_VISUALIZE	0
 
@@ -25,6 +26,17 @@ class Vector;
 class IPhysicsObject;
 class CBoneAccessor;
 
+// Level of detail the ragdoll LOD system (c_ragdoll_manager.cpp) picks each frame
+enum RagdollLOD_t
+{
+	RAGDOLL_LOD_FULL = 0,		// Bones read from physics every frame
+	RAGDOLL_LOD_REDUCED,		// Bones every other frame, looser constraint errors, sleeps sooner
+	RAGDOLL_LOD_DISTANT,		// Bones every 4th frame, extra damping, sleeps soon after resting
+	RAGDOLL_LOD_FROZEN,			// Asleep, the last pose is reused until something wakes it
+
+	RAGDOLL_LOD_COUNT
+};
+
 abstract_class IRagdoll
 {
 public:
@@ -88,10 +100,15 @@ public:
 	void ResetRagdollSleepAfterTime( void );
 	float GetLastVPhysicsUpdateTime() const { return m_lastUpdate; }
 
+	void	SetLOD( int nLOD );
+	int		GetLOD() const { return m_nLOD; }
+	bool	IsAsleep() const { return m_allAsleep; }
+
 private:
 
 	void			CheckSettleStationaryRagdoll();
 	void			PhysForceRagdollToSleep();
+	bool			ReuseCachedBones( bool *boneSimulated, CBoneAccessor &pBoneToWorld );
 
 	ragdoll_t	m_ragdoll;
 	Vector		m_mins, m_maxs;
@@ -102,6 +119,16 @@ private:
 	Vector		m_vecLastOrigin;
 	float		m_flLastOriginChangeTime;
 
+	int			m_nLOD;
+	float		m_flBaseDamping[RAGDOLL_MAX_ELEMENTS][2];
+	constraint_groupparams_t m_BaseErrorParams;
+	bool		m_bHasBaseParams;
+
+	// Last bones read from physics, for frames the LOD skips
+	matrix3x4_t	m_CachedBones[RAGDOLL_MAX_ELEMENTS];
+	unsigned int m_nCachedBoneMask;
+	int			m_nCachedBoneFrame;
+
 #if RAGDOLL_VISUALIZE
 	matrix3x4_t			m_savedBone1[MAXSTUDIOBONES];
 	matrix3x4_t			m_savedBone2[MAXSTUDIOBONES];
@@ -126,6 +153,13 @@ CRagdoll *CreateRagdoll(
 	bool bFixedConstraints=false );
 
 
+// Every live CRagdoll, for the ragdoll LOD system
+int GetClientRagdollCount();
+CRagdoll *GetClientRagdoll( int i );
+
+// Milliseconds spent updating ragdoll bones and physics state since the last call
+float ConsumeRagdollUpdateTime();
+
 // save this ragdoll's creation as the current tick
 void NoteRagdollCreationTick( C_BaseEntity *pRagdoll );
 // returns true if the ragdoll was created on this tick
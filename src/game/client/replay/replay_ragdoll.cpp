@@ -325,7 +325,7 @@ void CReplayRagdollRecorder::Record()
 	static bool bLookedForConvar = false;
 	if ( bLookedForConvar )
 	{
-		pReplayEnable =  (ConVar*)cvar->FindVar( "replay_enable" );
+		pReplayEnable =  ConVar_FindVar( "replay_enable" );
 		bLookedForConvar = true;
 	}
 	if ( !pReplayEnable || !pReplayEnable->GetInt() )
@@ -132,6 +132,13 @@ public:
 	int								m_iLastCollisionFrame;
 	Vector							m_vLastCollisionOrigin;
 
+	// Leaf system state as of the last relink, so tempents at rest aren't relinked every frame
+	bool							m_bLeafStateValid;
+	RenderGroup_t					m_LeafRenderGroup;
+	Vector							m_vecLeafOrigin;
+	QAngle							m_angLeafAngles;
+	float							m_flLeafSpriteScale;
+
 private:
 	C_LocalTempEntity( const C_LocalTempEntity & );
 
@@ -0,0 +1,1657 @@
+//========= Copyright Valve Corporation, All rights reserved. ============//
+//
+// Purpose: Microbenchmarks for tier1 containers and utilities, run from the
+//			console in a client with sv_cheats 1.
+//
+// $NoKeywords: $
+//=============================================================================//
+
+#include "cbase.h"
+#include "tier1/utlsymbol.h"
+#include "tier1/bitbuf.h"
+#include "tier1/mempool.h"
+#include "tier1/checksum_crc.h"
+#include "tier1/generichash.h"
+#include "tier1/snappy.h"
+#include "tier1/snappystream.h"
+#include "tier1/compressedstreamreader.h"
+#include "tier1/utlhashtable.h"
+#include "tier1/utlswisshashtable.h"
+#include "tier1/KeyValues.h"
+#include "filesystem.h"
+#include "coordsize.h"
+#include "vstdlib/random.h"
+#include "tier0/fasttimer.h"
+#include "vstdlib/jobthread.h"
+
+// memdbgon must be the last include file in a .cpp file!!!
+#include "tier0/memdbgon.h"
+
+
+//-----------------------------------------------------------------------------
+// Symbol tables
+//-----------------------------------------------------------------------------
+
+// Names shaped like the sound, model and activity names the tables hold in game
+static void BuildBenchSymbolNames( int nCount, CUtlVector<CUtlString> &names )
+{
+	static const char *s_pPrefixes[] = { "Weapon_", "models/props_", "ACT_", "Player.", "npc_", "materials/" };
+	static const char *s_pSuffixes[] = { ".Single", ".mdl", "_RELOAD", ".FootstepLeft", "_idle", ".vmt" };
+
+	names.EnsureCapacity( nCount );
+	for ( int i = 0; i < nCount; ++i )
+	{
+		int nKind = i % ARRAYSIZE( s_pPrefixes );
+		char szName[128];
+		V_snprintf( szName, sizeof( szName ), "%s%d_%x%s", s_pPrefixes[nKind], i, i * 2654435761u, s_pSuffixes[nKind] );
+		names.AddToTail( szName );
+	}
+}
+
+template < class TABLE >
+static void BenchSymbolTable( const char *pName, TABLE &table, const CUtlVector<CUtlString> &names, int nLookups )
+{
+	CFastTimer insertTimer;
+	insertTimer.Start();
+	FOR_EACH_VEC( names, i )
+	{
+		table.AddString( names[i].Get() );
+	}
+	insertTimer.End();
+
+	// Half hits, half misses that share a prefix with a stored name
+	char szMiss[256];
+	int nFound = 0;
+	CFastTimer findTimer;
+	findTimer.Start();
+	for ( int i = 0; i < nLookups; ++i )
+	{
+		const char *pString = names[i % names.Count()].Get();
+		if ( i & 1 )
+		{
+			V_snprintf( szMiss, sizeof( szMiss ), "%s_", pString );
+			pString = szMiss;
+		}
+		if ( table.Find( pString ).IsValid() )
+		{
+			++nFound;
+		}
+	}
+	findTimer.End();
+
+	// Every name has to come back as itself
+	int nErrors = 0;
+	FOR_EACH_VEC( names, i )
+	{
+		if ( V_strcmp( table.String( table.Find( names[i].Get() ) ), names[i].Get() ) )
+		{
+			++nErrors;
+		}
+	}
+
+	Msg( "  %-24s insert %8.3f ms  find %8.3f ms  (%d found, %d errors)\n", pName,
+		insertTimer.GetDuration().GetMillisecondsF(), findTimer.GetDuration().GetMillisecondsF(), nFound, nErrors );
+}
+
+struct SymbolLookupJob_t
+{
+	const void *m_pTable;
+	const CUtlVector<CUtlString> *m_pNames;
+	int m_nLookups;
+	int m_nFound;
+};
+
+template < class TABLE >
+static void ProcessSymbolLookupJob( SymbolLookupJob_t &job )
+{
+	const TABLE *pTable = (const TABLE *)job.m_pTable;
+	const CUtlVector<CUtlString> &names = *job.m_pNames;
+	for ( int i = 0; i < job.m_nLookups; ++i )
+	{
+		if ( pTable->Find( names[i % names.Count()].Get() ).IsValid() )
+		{
+			++job.m_nFound;
+		}
+	}
+}
+
+template < class TABLE >
+static void BenchSymbolTableThreaded( const char *pName, TABLE &table, const CUtlVector<CUtlString> &names, int nLookups )
+{
+	SymbolLookupJob_t jobs[16];
+	for ( int i = 0; i < ARRAYSIZE( jobs ); ++i )
+	{
+		jobs[i].m_pTable = &table;
+		jobs[i].m_pNames = &names;
+		jobs[i].m_nLookups = nLookups / ARRAYSIZE( jobs );
+		jobs[i].m_nFound = 0;
+	}
+
+	CFastTimer timer;
+	timer.Start();
+	ParallelProcess( "BenchSymbolTableThreaded", jobs, ARRAYSIZE( jobs ), &ProcessSymbolLookupJob<TABLE> );
+	timer.End();
+
+	int nFound = 0;
+	for ( int i = 0; i < ARRAYSIZE( jobs ); ++i )
+	{
+		nFound += jobs[i].m_nFound;
+	}
+
+	Msg( "  %-24s threaded find %8.3f ms  (%d found)\n", pName, timer.GetDuration().GetMillisecondsF(), nFound );
+}
+
+CON_COMMAND_F( cl_bench_symboltable, "Compares insert and lookup times of the tree and hash symbol tables. Usage: cl_bench_symboltable [strings] [lookups]", FCVAR_CHEAT )
+{
+	int nStrings = ( args.ArgC() > 1 ) ? clamp( atoi( args[1] ), 1, 60000 ) : 20000;
+	int nLookups = ( args.ArgC() > 2 ) ? MAX( atoi( args[2] ), 1 ) : 1000000;
+
+	CUtlVector<CUtlString> names;
+	BuildBenchSymbolNames( nStrings, names );
+
+	Msg( "cl_bench_symboltable: %d strings, %d lookups\n", nStrings, nLookups );
+	{
+		CUtlSymbolTable table;
+		BenchSymbolTable( "CUtlSymbolTable", table, names, nLookups );
+	}
+	{
+		CUtlSymbolTable table( 0, 32, true );
+		BenchSymbolTable( "CUtlSymbolTable (nocase)", table, names, nLookups );
+	}
+	{
+		CUtlSymbolTableHash table;
+		BenchSymbolTable( "CUtlSymbolTableHash", table, names, nLookups );
+	}
+	{
+		CUtlSymbolTableHash table( 32, true );
+		BenchSymbolTable( "CUtlSymbolTableHash (nocase)", table, names, nLookups );
+	}
+	{
+		CUtlSymbolTableMT table;
+		BenchSymbolTable( "CUtlSymbolTableMT", table, names, nLookups );
+		BenchSymbolTableThreaded( "CUtlSymbolTableMT", table, names, nLookups );
+	}
+	{
+		CUtlSymbolTableHashMT table;
+		BenchSymbolTable( "CUtlSymbolTableHashMT", table, names, nLookups );
+		BenchSymbolTableThreaded( "CUtlSymbolTableHashMT", table, names, nLookups );
+	}
+}
+
+
+//-----------------------------------------------------------------------------
+// Bit buffers
+//-----------------------------------------------------------------------------
+
+// The coord and normal encoders as they were before the packed fast paths, built only
+// on the single field writers. The fast paths have to match these bit for bit.
+static void RefWriteBitCoord( bf_write &buf, const float f )
+{
+	int		signbit = (f <= -COORD_RESOLUTION);
+	int		intval = (int)abs(f);
+	int		fractval = abs((int)(f*COORD_DENOMINATOR)) & (COORD_DENOMINATOR-1);
+
+	buf.WriteOneBit( intval );
+	buf.WriteOneBit( fractval );
+
+	if ( intval || fractval )
+	{
+		buf.WriteOneBit( signbit );
+		if ( intval )
+		{
+			intval--;
+			buf.WriteUBitLong( (unsigned int)intval, COORD_INTEGER_BITS );
+		}
+		if ( fractval )
+		{
+			buf.WriteUBitLong( (unsigned int)fractval, COORD_FRACTIONAL_BITS );
+		}
+	}
+}
+
+static void RefWriteBitVec3Coord( bf_write &buf, const Vector &fa )
+{
+	int xflag = (fa[0] >= COORD_RESOLUTION) || (fa[0] <= -COORD_RESOLUTION);
+	int yflag = (fa[1] >= COORD_RESOLUTION) || (fa[1] <= -COORD_RESOLUTION);
+	int zflag = (fa[2] >= COORD_RESOLUTION) || (fa[2] <= -COORD_RESOLUTION);
+
+	buf.WriteOneBit( xflag );
+	buf.WriteOneBit( yflag );
+	buf.WriteOneBit( zflag );
+
+	if ( xflag )
+		RefWriteBitCoord( buf, fa[0] );
+	if ( yflag )
+		RefWriteBitCoord( buf, fa[1] );
+	if ( zflag )
+		RefWriteBitCoord( buf, fa[2] );
+}
+
+static void RefWriteBitNormal( bf_write &buf, float f )
+{
+	int	signbit = (f <= -NORMAL_RESOLUTION);
+	unsigned int fractval = abs( (int)(f*NORMAL_DENOMINATOR) );
+	if (fractval > NORMAL_DENOMINATOR)
+		fractval = NORMAL_DENOMINATOR;
+
+	buf.WriteOneBit( signbit );
+	buf.WriteUBitLong( fractval, NORMAL_FRACTIONAL_BITS );
+}
+
+static void RefWriteBitVec3Normal( bf_write &buf, const Vector &fa )
+{
+	int xflag = (fa[0] >= NORMAL_RESOLUTION) || (fa[0] <= -NORMAL_RESOLUTION);
+	int yflag = (fa[1] >= NORMAL_RESOLUTION) || (fa[1] <= -NORMAL_RESOLUTION);
+
+	buf.WriteOneBit( xflag );
+	buf.WriteOneBit( yflag );
+
+	if ( xflag )
+		RefWriteBitNormal( buf, fa[0] );
+	if ( yflag )
+		RefWriteBitNormal( buf, fa[1] );
+
+	buf.WriteOneBit( fa[2] <= -NORMAL_RESOLUTION );
+}
+
+static void RefWriteVarInt64( bf_write &buf, uint64 data )
+{
+	while ( data > 0x7F )
+	{
+		buf.WriteUBitLong( (data & 0x7F) | 0x80, 8 );
+		data >>= 7;
+	}
+	buf.WriteUBitLong( data & 0x7F, 8 );
+}
+
+static float RefReadBitCoord( bf_read &buf )
+{
+	int intval = buf.ReadOneBit();
+	int fractval = buf.ReadOneBit();
+	float value = 0.0;
+
+	if ( intval || fractval )
+	{
+		int signbit = buf.ReadOneBit();
+		if ( intval )
+		{
+			intval = buf.ReadUBitLong( COORD_INTEGER_BITS ) + 1;
+		}
+		if ( fractval )
+		{
+			fractval = buf.ReadUBitLong( COORD_FRACTIONAL_BITS );
+		}
+
+		value = intval + ((float)fractval * COORD_RESOLUTION);
+		if ( signbit )
+			value = -value;
+	}
+
+	return value;
+}
+
+static void RefReadBitVec3Coord( bf_read &buf, Vector &fa )
+{
+	fa.Init( 0, 0, 0 );
+
+	int xflag = buf.ReadOneBit();
+	int yflag = buf.ReadOneBit();
+	int zflag = buf.ReadOneBit();
+
+	if ( xflag )
+		fa[0] = RefReadBitCoord( buf );
+	if ( yflag )
+		fa[1] = RefReadBitCoord( buf );
+	if ( zflag )
+		fa[2] = RefReadBitCoord( buf );
+}
+
+static float RefReadBitNormal( bf_read &buf )
+{
+	int	signbit = buf.ReadOneBit();
+	unsigned int fractval = buf.ReadUBitLong( NORMAL_FRACTIONAL_BITS );
+
+	float value = (float)fractval * NORMAL_RESOLUTION;
+	if ( signbit )
+		value = -value;
+
+	return value;
+}
+
+enum BitBufBenchOp_t
+{
+	BITBUF_OP_COORD = 0,
+	BITBUF_OP_VEC3COORD,
+	BITBUF_OP_NORMAL,
+	BITBUF_OP_VEC3NORMAL,
+	BITBUF_OP_VARINT32,
+	BITBUF_OP_VARINT64,
+	BITBUF_OP_VEC3COORD_ARRAY,
+	BITBUF_OP_ANGLES_ARRAY,
+
+	BITBUF_OP_COUNT
+};
+
+#define BITBUF_BENCH_ARRAY_SIZE	8
+
+struct BitBufBenchValue_t
+{
+	BitBufBenchOp_t m_nOp;
+	Vector m_vecValues[BITBUF_BENCH_ARRAY_SIZE];
+	uint64 m_nVarInt;
+};
+
+// Zeros, values just either side of the coord resolution, fractions, whole numbers
+// and values past the coord range all take different paths through the encoders
+static float RandomBenchCoord( IUniformRandomStream &random )
+{
+	switch ( random.RandomInt( 0, 6 ) )
+	{
+	case 0:		return 0.0f;
+	case 1:		return random.RandomInt( -2, 2 ) * COORD_RESOLUTION * 0.75f;
+	case 2:		return random.RandomFloat( -1.0f, 1.0f );
+	case 3:		return (float)random.RandomInt( -MAX_COORD_INTEGER, MAX_COORD_INTEGER );
+	case 4:		return random.RandomFloat( -2.0f * MAX_COORD_INTEGER, 2.0f * MAX_COORD_INTEGER );
+	default:	return random.RandomFloat( -MAX_COORD_INTEGER, MAX_COORD_INTEGER );
+	}
+}
+
+static void RandomBenchValue( IUniformRandomStream &random, BitBufBenchValue_t &value )
+{
+	value.m_nOp = (BitBufBenchOp_t)random.RandomInt( 0, BITBUF_OP_COUNT - 1 );
+	for ( int i = 0; i < BITBUF_BENCH_ARRAY_SIZE; ++i )
+	{
+		if ( value.m_nOp == BITBUF_OP_NORMAL || value.m_nOp == BITBUF_OP_VEC3NORMAL )
+		{
+			value.m_vecValues[i].Init( random.RandomFloat( -1.1f, 1.1f ), random.RandomFloat( -1.1f, 1.1f ), random.RandomFloat( -1.0f, 1.0f ) );
+		}
+		else
+		{
+			value.m_vecValues[i].Init( RandomBenchCoord( random ), RandomBenchCoord( random ), RandomBenchCoord( random ) );
+		}
+	}
+
+	// Spread the varints over every encoded length
+	int nBits = random.RandomInt( 0, 63 );
+	value.m_nVarInt = ( ( (uint64)(uint32)random.RandomInt( 0, INT_MAX ) << 32 ) | (uint32)random.RandomInt( 0, INT_MAX ) ) >> nBits;
+}
+
+static void WriteBenchValue( bf_write &buf, const BitBufBenchValue_t &value, bool bReference )
+{
+	switch ( value.m_nOp )
+	{
+	case BITBUF_OP_COORD:
+		bReference ? RefWriteBitCoord( buf, value.m_vecValues[0].x ) : buf.WriteBitCoord( value.m_vecValues[0].x );
+		break;
+	case BITBUF_OP_VEC3COORD:
+		bReference ? RefWriteBitVec3Coord( buf, value.m_vecValues[0] ) : buf.WriteBitVec3Coord( value.m_vecValues[0] );
+		break;
+	case BITBUF_OP_NORMAL:
+		bReference ? RefWriteBitNormal( buf, value.m_vecValues[0].x ) : buf.WriteBitNormal( value.m_vecValues[0].x );
+		break;
+	case BITBUF_OP_VEC3NORMAL:
+		bReference ? RefWriteBitVec3Normal( buf, value.m_vecValues[0] ) : buf.WriteBitVec3Normal( value.m_vecValues[0] );
+		break;
+	case BITBUF_OP_VARINT32:
+		bReference ? RefWriteVarInt64( buf, (uint32)value.m_nVarInt ) : buf.WriteVarInt32( (uint32)value.m_nVarInt );
+		break;
+	case BITBUF_OP_VARINT64:
+		bReference ? RefWriteVarInt64( buf, value.m_nVarInt ) : buf.WriteVarInt64( value.m_nVarInt );
+		break;
+	case BITBUF_OP_VEC3COORD_ARRAY:
+		if ( bReference )
+		{
+			for ( int i = 0; i < BITBUF_BENCH_ARRAY_SIZE; ++i )
+			{
+				RefWriteBitVec3Coord( buf, value.m_vecValues[i] );
+			}
+		}
+		else
+		{
+			buf.WriteBitVec3CoordArray( value.m_vecValues, BITBUF_BENCH_ARRAY_SIZE );
+		}
+		break;
+	case BITBUF_OP_ANGLES_ARRAY:
+		if ( bReference )
+		{
+			// WriteBitAngles has always been WriteBitVec3Coord of the angles
+			for ( int i = 0; i < BITBUF_BENCH_ARRAY_SIZE; ++i )
+			{
+				RefWriteBitVec3Coord( buf, value.m_vecValues[i] );
+			}
+		}
+		else
+		{
+			QAngle angles[BITBUF_BENCH_ARRAY_SIZE];
+			for ( int i = 0; i < BITBUF_BENCH_ARRAY_SIZE; ++i )
+			{
+				angles[i].Init( value.m_vecValues[i].x, value.m_vecValues[i].y, value.m_vecValues[i].z );
+			}
+			buf.WriteBitAnglesArray( angles, BITBUF_BENCH_ARRAY_SIZE );
+		}
+		break;
+	default:
+		Assert( 0 );
+	}
+}
+
+// Reads one value back into out, returning the component count it filled in
+static int ReadBenchValue( bf_read &buf, BitBufBenchOp_t nOp, float *pOut, bool bReference )
+{
+	switch ( nOp )
+	{
+	case BITBUF_OP_COORD:
+		pOut[0] = bReference ? RefReadBitCoord( buf ) : buf.ReadBitCoord();
+		return 1;
+	case BITBUF_OP_VEC3COORD:
+		bReference ? RefReadBitVec3Coord( buf, *(Vector *)pOut ) : buf.ReadBitVec3Coord( *(Vector *)pOut );
+		return 3;
+	case BITBUF_OP_NORMAL:
+		pOut[0] = bReference ? RefReadBitNormal( buf ) : buf.ReadBitNormal();
+		return 1;
+	case BITBUF_OP_VEC3NORMAL:
+		{
+			// Only the x and y fields go through ReadBitNormal
+			int xflag = buf.ReadOneBit();
+			int yflag = buf.ReadOneBit();
+			pOut[0] = xflag ? ( bReference ? RefReadBitNormal( buf ) : buf.ReadBitNormal() ) : 0.0f;
+			pOut[1] = yflag ? ( bReference ? RefReadBitNormal( buf ) : buf.ReadBitNormal() ) : 0.0f;
+			pOut[2] = (float)buf.ReadOneBit();
+		}
+		return 3;
+	case BITBUF_OP_VARINT32:
+		pOut[0] = (float)buf.ReadVarInt32();
+		return 1;
+	case BITBUF_OP_VARINT64:
+		pOut[0] = (float)buf.ReadVarInt64();
+		return 1;
+	case BITBUF_OP_VEC3COORD_ARRAY:
+		if ( bReference )
+		{
+			for ( int i = 0; i < BITBUF_BENCH_ARRAY_SIZE; ++i )
+			{
+				RefReadBitVec3Coord( buf, ((Vector *)pOut)[i] );
+			}
+		}
+		else
+		{
+			buf.ReadBitVec3CoordArray( (Vector *)pOut, BITBUF_BENCH_ARRAY_SIZE );
+		}
+		return 3 * BITBUF_BENCH_ARRAY_SIZE;
+	case BITBUF_OP_ANGLES_ARRAY:
+		if ( bReference )
+		{
+			for ( int i = 0; i < BITBUF_BENCH_ARRAY_SIZE; ++i )
+			{
+				RefReadBitVec3Coord( buf, ((Vector *)pOut)[i] );
+			}
+		}
+		else
+		{
+			QAngle angles[BITBUF_BENCH_ARRAY_SIZE];
+			buf.ReadBitAnglesArray( angles, BITBUF_BENCH_ARRAY_SIZE );
+			for ( int i = 0; i < BITBUF_BENCH_ARRAY_SIZE; ++i )
+			{
+				pOut[3 * i + 0] = angles[i].x;
+				pOut[3 * i + 1] = angles[i].y;
+				pOut[3 * i + 2] = angles[i].z;
+			}
+		}
+		return 3 * BITBUF_BENCH_ARRAY_SIZE;
+	default:
+		Assert( 0 );
+		return 0;
+	}
+}
+
+// Writes a run of random values with both encoders into buffers of random size and
+// start bit, then reads them back with both decoders from a random length. Returns
+// the number of mismatches in buffer contents, positions, overflow flags or values.
+static int CheckBitBufRoundTrip( IUniformRandomStream &random )
+{
+	const int nMaxBytes = 256;
+	uint32 refData[nMaxBytes / 4], newData[nMaxBytes / 4];
+	for ( int i = 0; i < ARRAYSIZE( refData ); ++i )
+	{
+		refData[i] = newData[i] = (uint32)random.RandomInt( 0, INT_MAX ) * 2654435761u;
+	}
+
+	// Small buffers and bit limits that aren't on a word boundary make the writes run out of room
+	int nBytes = 4 * random.RandomInt( 1, nMaxBytes / 4 );
+	int nStartBit = random.RandomInt( 0, 31 );
+	int nMaxBits = random.RandomInt( nStartBit, nBytes * 8 );
+
+	bf_write refBuf( refData, nBytes, nMaxBits ), newBuf( newData, nBytes, nMaxBits );
+	refBuf.SetAssertOnOverflow( false );
+	newBuf.SetAssertOnOverflow( false );
+	refBuf.SeekToBit( nStartBit );
+	newBuf.SeekToBit( nStartBit );
+
+	BitBufBenchValue_t values[16];
+	int nValues = random.RandomInt( 1, ARRAYSIZE( values ) );
+	int nErrors = 0;
+	for ( int i = 0; i < nValues; ++i )
+	{
+		RandomBenchValue( random, values[i] );
+		WriteBenchValue( refBuf, values[i], true );
+		WriteBenchValue( newBuf, values[i], false );
+		if ( refBuf.GetNumBitsWritten() != newBuf.GetNumBitsWritten() || refBuf.IsOverflowed() != newBuf.IsOverflowed() )
+		{
+			++nErrors;
+		}
+	}
+
+	if ( V_memcmp( refData, newData, sizeof( refData ) ) )
+	{
+		++nErrors;
+	}
+
+	// Both decoders read the same bits, sometimes cut short so the reads overflow too
+	int nReadBits = random.RandomInt( 0, 3 ) ? refBuf.GetNumBitsWritten() : random.RandomInt( nStartBit, refBuf.GetNumBitsWritten() );
+	bf_read refRead( refData, nBytes, nReadBits ), newRead( refData, nBytes, nReadBits );
+	refRead.SetAssertOnOverflow( false );
+	newRead.SetAssertOnOverflow( false );
+	refRead.Seek( nStartBit );
+	newRead.Seek( nStartBit );
+
+	float refValues[3 * BITBUF_BENCH_ARRAY_SIZE], newValues[3 * BITBUF_BENCH_ARRAY_SIZE];
+	for ( int i = 0; i < nValues; ++i )
+	{
+		int nCount = ReadBenchValue( refRead, values[i].m_nOp, refValues, true );
+		ReadBenchValue( newRead, values[i].m_nOp, newValues, false );
+
+		// Compare the bits so the sign of zero counts too
+		if ( V_memcmp( refValues, newValues, nCount * sizeof( float ) ) ||
+			refRead.GetNumBitsRead() != newRead.GetNumBitsRead() || refRead.IsOverflowed() != newRead.IsOverflowed() )
+		{
+			++nErrors;
+		}
+	}
+
+	return nErrors;
+}
+
+CON_COMMAND_F( cl_bench_bitbuf, "Checks the packed bitbuf coord, angle, normal and varint encoders against the field by field ones, then times them. Usage: cl_bench_bitbuf [iterations]", FCVAR_CHEAT )
+{
+	int nIterations = ( args.ArgC() > 1 ) ? MAX( atoi( args[1] ), 1 ) : 100000;
+
+	CUniformRandomStream random;
+	random.SetSeed( 0x5eed );
+
+	int nErrors = 0;
+	for ( int i = 0; i < nIterations; ++i )
+	{
+		nErrors += CheckBitBufRoundTrip( random );
+	}
+	Msg( "cl_bench_bitbuf: %d round trips, %d mismatches\n", nIterations, nErrors );
+
+	// Timing: a snapshot's worth of origins and angles per pass
+	const int nVecs = 256;
+	Vector vecs[nVecs];
+	for ( int i = 0; i < nVecs; ++i )
+	{
+		vecs[i].Init( RandomBenchCoord( random ), RandomBenchCoord( random ), RandomBenchCoord( random ) );
+	}
+
+	static uint32 s_Data[( nVecs * 72 ) / 32 + 1];
+	bf_write buf( s_Data, sizeof( s_Data ) );
+	int nPasses = MAX( nIterations / 100, 1 );
+
+	CFastTimer refTimer;
+	refTimer.Start();
+	for ( int nPass = 0; nPass < nPasses; ++nPass )
+	{
+		buf.Reset();
+		for ( int i = 0; i < nVecs; ++i )
+		{
+			RefWriteBitVec3Coord( buf, vecs[i] );
+		}
+	}
+	refTimer.End();
+
+	CFastTimer newTimer;
+	newTimer.Start();
+	for ( int nPass = 0; nPass < nPasses; ++nPass )
+	{
+		buf.Reset();
+		for ( int i = 0; i < nVecs; ++i )
+		{
+			buf.WriteBitVec3Coord( vecs[i] );
+		}
+	}
+	newTimer.End();
+
+	CFastTimer arrayTimer;
+	arrayTimer.Start();
+	for ( int nPass = 0; nPass < nPasses; ++nPass )
+	{
+		buf.Reset();
+		buf.WriteBitVec3CoordArray( vecs, nVecs );
+	}
+	arrayTimer.End();
+
+	bf_read read( s_Data, sizeof( s_Data ), buf.GetNumBitsWritten() );
+
+	CFastTimer refReadTimer;
+	refReadTimer.Start();
+	for ( int nPass = 0; nPass < nPasses; ++nPass )
+	{
+		read.Seek( 0 );
+		for ( int i = 0; i < nVecs; ++i )
+		{
+			RefReadBitVec3Coord( read, vecs[i] );
+		}
+	}
+	refReadTimer.End();
+
+	CFastTimer readTimer;
+	readTimer.Start();
+	for ( int nPass = 0; nPass < nPasses; ++nPass )
+	{
+		read.Seek( 0 );
+		read.ReadBitVec3CoordArray( vecs, nVecs );
+	}
+	readTimer.End();
+
+	Msg( "  %d x %d vectors: write field by field %8.3f ms  packed %8.3f ms  array %8.3f ms\n", nPasses, nVecs,
+		refTimer.GetDuration().GetMillisecondsF(), newTimer.GetDuration().GetMillisecondsF(), arrayTimer.GetDuration().GetMillisecondsF() );
+	Msg( "  %d x %d vectors: read field by field %8.3f ms  packed %8.3f ms\n", nPasses, nVecs,
+		refReadTimer.GetDuration().GetMillisecondsF(), readTimer.GetDuration().GetMillisecondsF() );
+}
+
+
+//-----------------------------------------------------------------------------
+// Thread safe memory pools
+//-----------------------------------------------------------------------------
+#define MEMPOOL_BENCH_BLOCKS	256
+
+struct MemPoolStressJob_t
+{
+	void *m_pPool;
+	int m_nJob;
+	int m_nOps;
+	void *m_pLive[MEMPOOL_BENCH_BLOCKS];	// what the job still holds, freed by a neighbour
+	int m_nErrors;
+};
+
+// Every block gets its owner and slot written into it, and checked before it's freed
+static void TagBenchBlock( void *pBlock, int nJob, int nSlot )
+{
+	((int *)pBlock)[0] = nJob;
+	((int *)pBlock)[1] = nSlot;
+}
+
+static bool CheckBenchBlock( const void *pBlock, int nJob, int nSlot )
+{
+	return ((const int *)pBlock)[0] == nJob && ((const int *)pBlock)[1] == nSlot;
+}
+
+// Churns allocs and frees on a private working set, leaving it fully allocated
+template < class POOL >
+static void ProcessMemPoolChurnJob( MemPoolStressJob_t &job )
+{
+	POOL *pPool = (POOL *)job.m_pPool;
+	for ( int i = 0; i < MEMPOOL_BENCH_BLOCKS; ++i )
+	{
+		job.m_pLive[i] = pPool->Alloc();
+		TagBenchBlock( job.m_pLive[i], job.m_nJob, i );
+	}
+
+	unsigned int nSeed = job.m_nJob * 2654435761u + 1;
+	for ( int i = 0; i < job.m_nOps; ++i )
+	{
+		nSeed = nSeed * 1664525 + 1013904223;
+		int nSlot = ( nSeed >> 16 ) % MEMPOOL_BENCH_BLOCKS;
+		if ( !CheckBenchBlock( job.m_pLive[nSlot], job.m_nJob, nSlot ) )
+		{
+			++job.m_nErrors;
+		}
+		pPool->Free( job.m_pLive[nSlot] );
+		job.m_pLive[nSlot] = pPool->Alloc();
+		TagBenchBlock( job.m_pLive[nSlot], job.m_nJob, nSlot );
+	}
+}
+
+// Frees the working set the churn pass left in the neighbouring job, which most
+// likely ran on another thread
+template < class POOL >
+static void ProcessMemPoolHandoffJob( MemPoolStressJob_t &job )
+{
+	POOL *pPool = (POOL *)job.m_pPool;
+	MemPoolStressJob_t &neighbour = ( &job )[ job.m_nJob & 1 ? -1 : 1 ];
+	for ( int i = 0; i < MEMPOOL_BENCH_BLOCKS; ++i )
+	{
+		if ( !CheckBenchBlock( neighbour.m_pLive[i], neighbour.m_nJob, i ) )
+		{
+			++job.m_nErrors;
+		}
+		pPool->Free( neighbour.m_pLive[i] );
+	}
+}
+
+template < class POOL >
+static void BenchMemPool( const char *pName, POOL &pool, int nJobs, int nOps, int nRounds )
+{
+	CUtlVector<MemPoolStressJob_t> jobs;
+	jobs.SetCount( nJobs );
+	FOR_EACH_VEC( jobs, i )
+	{
+		jobs[i].m_pPool = &pool;
+		jobs[i].m_nJob = i;
+		jobs[i].m_nOps = nOps / nJobs;
+		jobs[i].m_nErrors = 0;
+	}
+
+	CFastTimer timer;
+	timer.Start();
+	for ( int nRound = 0; nRound < nRounds; ++nRound )
+	{
+		ParallelProcess( "BenchMemPoolChurn", jobs.Base(), jobs.Count(), &ProcessMemPoolChurnJob<POOL> );
+		ParallelProcess( "BenchMemPoolHandoff", jobs.Base(), jobs.Count(), &ProcessMemPoolHandoffJob<POOL> );
+	}
+	timer.End();
+
+	int nErrors = 0;
+	FOR_EACH_VEC( jobs, i )
+	{
+		nErrors += jobs[i].m_nErrors;
+	}
+
+	Msg( "  %-16s %8.3f ms  (count %d, peak %d, expected peak %d, %d corrupt blocks)\n", pName,
+		timer.GetDuration().GetMillisecondsF(), pool.Count(), pool.PeakCount(), nJobs * MEMPOOL_BENCH_BLOCKS, nErrors );
+}
+
+CON_COMMAND_F( cl_bench_mempool, "Stress tests the thread safe memory pools with allocs and frees across threads. Usage: cl_bench_mempool [jobs] [ops] [rounds]", FCVAR_CHEAT )
+{
+	// The handoff pass pairs jobs up, so keep the count even
+	int nJobs = ( args.ArgC() > 1 ) ? clamp( atoi( args[1] ), 2, 128 ) & ~1 : 16;
+	int nOps = ( args.ArgC() > 2 ) ? MAX( atoi( args[2] ), 1 ) : 1000000;
+	int nRounds = ( args.ArgC() > 3 ) ? MAX( atoi( args[3] ), 1 ) : 8;
+
+	Msg( "cl_bench_mempool: %d jobs, %d ops per round, %d rounds\n", nJobs, nOps, nRounds );
+	{
+		CMemoryPoolMT pool( 64, 512, UTLMEMORYPOOL_GROW_SLOW, "cl_bench_mempool" );
+		BenchMemPool( "CMemoryPoolMT", pool, nJobs, nOps, nRounds );
+	}
+	{
+		CMemoryPoolTS pool( 64, 512, UTLMEMORYPOOL_GROW_SLOW, "cl_bench_mempool" );
+		BenchMemPool( "CMemoryPoolTS", pool, nJobs, nOps, nRounds );
+	}
+}
+
+
+//-----------------------------------------------------------------------------
+// CRC32
+//-----------------------------------------------------------------------------
+
+// One byte at a time straight off the table, the way the CRC is defined
+static CRC32_t RefCRC32( const unsigned char *pData, int nLength )
+{
+	CRC32_t crc;
+	CRC32_Init( &crc );
+	while ( nLength-- )
+	{
+		crc = CRC32_GetTableEntry( ( crc ^ *pData++ ) & 0xff ) ^ ( crc >> 8 );
+	}
+	CRC32_Final( &crc );
+	return crc;
+}
+
+// Checks random lengths, offsets and split points against the reference
+static int CheckCRC32( const unsigned char *pData, int nSize, IUniformRandomStream &random, int nIterations )
+{
+	int nErrors = 0;
+	for ( int i = 0; i < nIterations; ++i )
+	{
+		int nOffset = random.RandomInt( 0, 15 );
+		int nLength = random.RandomInt( 0, MIN( nSize - nOffset, 4096 ) );
+		int nSplit = random.RandomInt( 0, nLength );
+
+		CRC32_t crc;
+		CRC32_Init( &crc );
+		CRC32_ProcessBuffer( &crc, pData + nOffset, nSplit );
+		CRC32_ProcessBuffer( &crc, pData + nOffset + nSplit, nLength - nSplit );
+		CRC32_Final( &crc );
+
+		if ( crc != RefCRC32( pData + nOffset, nLength ) )
+		{
+			++nErrors;
+		}
+	}
+	return nErrors;
+}
+
+CON_COMMAND_F( cl_bench_crc, "Checks the CRC32 paths against a byte at a time reference and times them. Usage: cl_bench_crc [megabytes]", FCVAR_CHEAT )
+{
+	int nSize = ( ( args.ArgC() > 1 ) ? clamp( atoi( args[1] ), 1, 256 ) : 16 ) * 1024 * 1024;
+
+	CUniformRandomStream random;
+	random.SetSeed( 0x5eed );
+
+	CUtlVector<unsigned char> data;
+	data.SetCount( nSize );
+	for ( int i = 0; i < nSize; ++i )
+	{
+		data[i] = (unsigned char)random.RandomInt( 0, 255 );
+	}
+
+	bool bHardware = CRC32_EnableHardwareAcceleration( true );
+	Msg( "cl_bench_crc: %d MB, PCLMULQDQ %s\n", nSize / ( 1024 * 1024 ), bHardware ? "available" : "not available" );
+
+	CFastTimer refTimer;
+	refTimer.Start();
+	CRC32_t refCrc = RefCRC32( data.Base(), nSize );
+	refTimer.End();
+	Msg( "  %-24s %8.3f ms\n", "byte at a time", refTimer.GetDuration().GetMillisecondsF() );
+
+	for ( int nPass = 0; nPass < 2; ++nPass )
+	{
+		bool bUsing = CRC32_EnableHardwareAcceleration( nPass == 1 );
+		if ( nPass == 1 && !bUsing )
+			break;
+
+		int nErrors = CheckCRC32( data.Base(), nSize, random, 20000 );
+
+		CFastTimer timer;
+		timer.Start();
+		CRC32_t crc = CRC32_ProcessSingleBuffer( data.Base(), nSize );
+		timer.End();
+
+		Msg( "  %-24s %8.3f ms  (%d mismatches)\n", bUsing ? "PCLMULQDQ" : "slicing-by-8", timer.GetDuration().GetMillisecondsF(),
+			nErrors + ( crc != refCrc ) );
+	}
+
+	CRC32_EnableHardwareAcceleration( true );
+}
+
+
+//-----------------------------------------------------------------------------
+// String hashes
+//-----------------------------------------------------------------------------
+template < class FUNCTOR >
+static void BenchStringHash( const char *pName, const CUtlVector<CUtlString> &names, int nPasses, FUNCTOR hash )
+{
+	uint32 nSum = 0;
+	CFastTimer timer;
+	timer.Start();
+	for ( int nPass = 0; nPass < nPasses; ++nPass )
+	{
+		FOR_EACH_VEC( names, i )
+		{
+			nSum += hash( names[i].Get() );
+		}
+	}
+	timer.End();
+
+	Msg( "  %-24s %8.3f ms  (sum %08x)\n", pName, timer.GetDuration().GetMillisecondsF(), nSum );
+}
+
+struct HashStringFunctor_t				{ uint32 operator()( const char *p ) const { return HashString( p ); } };
+struct HashStringCaselessFunctor_t		{ uint32 operator()( const char *p ) const { return HashStringCaseless( p ); } };
+struct MurmurHash2Functor_t				{ uint32 operator()( const char *p ) const { return MurmurHash2( p, V_strlen( p ), 0 ); } };
+struct HashStringFastFunctor_t			{ uint32 operator()( const char *p ) const { return HashStringFast( p ); } };
+struct HashStringFastCaselessFunctor_t	{ uint32 operator()( const char *p ) const { return HashStringFastCaseless( p ); } };
+
+// The fast hashes have to give the same value at every alignment, and the caseless
+// one has to match hashing the lowercased string
+static int CheckHashStringFast( const CUtlVector<CUtlString> &names )
+{
+	int nErrors = 0;
+	char szCopy[256 + 8], szLower[256];
+	FOR_EACH_VEC( names, i )
+	{
+		const char *pName = names[i].Get();
+		V_strncpy( szLower, pName, sizeof( szLower ) );
+		V_strlower( szLower );
+
+		uint32 nHash = HashStringFast( szLower );
+		if ( HashStringFastCaseless( pName ) != nHash )
+		{
+			++nErrors;
+		}
+
+		for ( int nOffset = 0; nOffset < 8; ++nOffset )
+		{
+			V_strncpy( szCopy + nOffset, szLower, sizeof( szCopy ) - nOffset );
+			if ( HashStringFast( szCopy + nOffset ) != nHash )
+			{
+				++nErrors;
+			}
+		}
+	}
+	return nErrors;
+}
+
+CON_COMMAND_F( cl_bench_stringhash, "Times the generic string hashes on symbol-like names. Usage: cl_bench_stringhash [strings] [passes]", FCVAR_CHEAT )
+{
+	int nStrings = ( args.ArgC() > 1 ) ? clamp( atoi( args[1] ), 1, 1000000 ) : 20000;
+	int nPasses = ( args.ArgC() > 2 ) ? MAX( atoi( args[2] ), 1 ) : 100;
+
+	CUtlVector<CUtlString> names;
+	BuildBenchSymbolNames( nStrings, names );
+
+	Msg( "cl_bench_stringhash: %d strings, %d passes, %d alignment/case mismatches\n", nStrings, nPasses, CheckHashStringFast( names ) );
+	BenchStringHash( "HashString", names, nPasses, HashStringFunctor_t() );
+	BenchStringHash( "HashStringCaseless", names, nPasses, HashStringCaselessFunctor_t() );
+	BenchStringHash( "MurmurHash2 + strlen", names, nPasses, MurmurHash2Functor_t() );
+	BenchStringHash( "HashStringFast", names, nPasses, HashStringFastFunctor_t() );
+	BenchStringHash( "HashStringFastCaseless", names, nPasses, HashStringFastCaselessFunctor_t() );
+}
+
+
+//-----------------------------------------------------------------------------
+// Streaming decompression
+//-----------------------------------------------------------------------------
+class CBenchMemoryStreamSource : public ICompressedStreamSource
+{
+public:
+	CBenchMemoryStreamSource( const unsigned char *pData, int nSize ) : m_pData( pData ), m_nBytesLeft( nSize ) {}
+
+	virtual int ReadCompressed( void *pDest, int nMaxBytes )
+	{
+		int nBytes = MIN( nMaxBytes, m_nBytesLeft );
+		memcpy( pDest, m_pData, nBytes );
+		m_pData += nBytes;
+		m_nBytesLeft -= nBytes;
+		return nBytes;
+	}
+
+private:
+	const unsigned char *m_pData;
+	int m_nBytesLeft;
+};
+
+// Feeds the stream random slices of input and output, returns true if it reproduced the original
+static bool CheckSnappyStreamChunked( const unsigned char *pCompressed, int nCompressedSize, const CUtlVector<unsigned char> &original, CUniformRandomStream &random )
+{
+	CSnappyStream stream;
+	CUtlVector<unsigned char> output;
+	output.SetCount( original.Count() );
+
+	int nIn = 0;
+	int nOut = 0;
+	while ( !stream.IsFinished() )
+	{
+		unsigned int nMaxIn = MIN( random.RandomInt( 1, 4096 ), nCompressedSize - nIn );
+		unsigned int nMaxOut = MIN( random.RandomInt( 1, 4096 ), original.Count() - nOut );
+		unsigned int nRead, nWritten;
+		if ( !stream.Read( pCompressed + nIn, nMaxIn, output.Base() + nOut, nMaxOut, nRead, nWritten ) )
+			return false;
+		if ( !nRead && !nWritten && nIn == nCompressedSize )
+			return false;
+		nIn += nRead;
+		nOut += nWritten;
+	}
+
+	return nIn == nCompressedSize && nOut == original.Count() && !V_memcmp( output.Base(), original.Base(), nOut );
+}
+
+CON_COMMAND_F( cl_bench_decompress, "Checks the streaming snappy decoder and compressed stream reader against snappy::RawUncompress, then times them. Usage: cl_bench_decompress [megabytes]", FCVAR_CHEAT )
+{
+	int nSize = ( ( args.ArgC() > 1 ) ? clamp( atoi( args[1] ), 1, 256 ) : 16 ) * 1024 * 1024;
+
+	// Text-like data, so there are plenty of back references
+	CUtlVector<CUtlString> names;
+	BuildBenchSymbolNames( 4096, names );
+
+	CUniformRandomStream random;
+	random.SetSeed( 0x5eed );
+
+	CUtlVector<unsigned char> original;
+	original.EnsureCapacity( nSize );
+	while ( original.Count() < nSize )
+	{
+		const CUtlString &name = names[random.RandomInt( 0, names.Count() - 1 )];
+		int nCopy = MIN( name.Length() + 1, nSize - original.Count() );
+		original.AddMultipleToTail( nCopy, (const unsigned char *)name.Get() );
+	}
+
+	CUtlVector<unsigned char> compressed;
+	compressed.SetCount( snappy::MaxCompressedLength( nSize ) );
+	size_t nCompressedSize;
+	snappy::RawCompress( (const char *)original.Base(), nSize, (char *)compressed.Base(), &nCompressedSize );
+
+	Msg( "cl_bench_decompress: %d MB -> %d KB snappy\n", nSize / ( 1024 * 1024 ), (int)( nCompressedSize / 1024 ) );
+
+	// Correctness. Random slicing, then corrupted input that must fail without crashing.
+	int nErrors = 0;
+	for ( int i = 0; i < 4; ++i )
+	{
+		nErrors += !CheckSnappyStreamChunked( compressed.Base(), nCompressedSize, original, random );
+	}
+
+	int nRejected = 0;
+	CUtlVector<unsigned char> corrupt;
+	for ( int i = 0; i < 64; ++i )
+	{
+		int nCorruptSize = MIN( (int)nCompressedSize, 16 * 1024 );
+		corrupt.CopyArray( compressed.Base(), nCorruptSize );
+		for ( int j = 0; j < 8; ++j )
+		{
+			corrupt[random.RandomInt( 0, nCorruptSize - 1 )] = (unsigned char)random.RandomInt( 0, 255 );
+		}
+
+		CBenchMemoryStreamSource source( corrupt.Base(), nCorruptSize );
+		CCompressedStreamReader reader( &source, COMPRESSED_STREAM_SNAPPY, 1024 );
+		CUtlBuffer output;
+		nRejected += !reader.ReadAll( output );
+	}
+
+	Msg( "  %d mismatches, %d of 64 corrupt streams rejected\n", nErrors, nRejected );
+
+	CUtlVector<unsigned char> output;
+	output.SetCount( nSize );
+
+	CFastTimer refTimer;
+	refTimer.Start();
+	bool bRefOk = snappy::RawUncompress( (const char *)compressed.Base(), nCompressedSize, (char *)output.Base() );
+	refTimer.End();
+	Msg( "  %-28s %8.3f ms  (%s)\n", "snappy::RawUncompress", refTimer.GetDuration().GetMillisecondsF(),
+		bRefOk && !V_memcmp( output.Base(), original.Base(), nSize ) ? "ok" : "FAILED" );
+
+	static const int s_nSegmentSizes[] = { 4 * 1024, 64 * 1024, 1024 * 1024 };
+	for ( int i = 0; i < ARRAYSIZE( s_nSegmentSizes ); ++i )
+	{
+		// Decode into one reused segment, the way a consumer parsing as it goes would
+		CBenchMemoryStreamSource source( compressed.Base(), nCompressedSize );
+		CCompressedStreamReader reader( &source, COMPRESSED_STREAM_SNAPPY );
+		CUtlBuffer segment( 0, s_nSegmentSizes[i], 0 );
+
+		CRC32_t crc;
+		CRC32_Init( &crc );
+
+		CFastTimer timer;
+		timer.Start();
+		int nTotal = 0;
+		bool bOk = true;
+		while ( !reader.IsFinished() )
+		{
+			segment.Clear();
+			int nBytes = reader.ReadSegment( segment, s_nSegmentSizes[i] );
+			if ( nBytes <= 0 )
+			{
+				bOk = false;
+				break;
+			}
+			CRC32_ProcessBuffer( &crc, segment.Base(), nBytes );
+			nTotal += nBytes;
+		}
+		timer.End();
+		CRC32_Final( &crc );
+
+		char szLabel[64];
+		V_snprintf( szLabel, sizeof( szLabel ), "stream reader, %d KB segments", s_nSegmentSizes[i] / 1024 );
+		Msg( "  %-28s %8.3f ms  (%s)\n", szLabel, timer.GetDuration().GetMillisecondsF(),
+			bOk && nTotal == nSize && crc == CRC32_ProcessSingleBuffer( original.Base(), nSize ) ? "ok" : "FAILED" );
+	}
+}
+
+
+//-----------------------------------------------------------------------------
+// String compares and path fixups
+//-----------------------------------------------------------------------------
+
+// The byte at a time loops the SSE2 versions in strtools replace
+static int RefStricmp( const char *str1, const char *str2, int n )
+{
+	const unsigned char *s1 = (const unsigned char*)str1;
+	const unsigned char *s2 = (const unsigned char*)str2;
+	for ( ; n > 0 && *s1; --n, ++s1, ++s2 )
+	{
+		if ( *s1 != *s2 )
+		{
+			unsigned char c1 = *s1 | 0x20;
+			unsigned char c2 = *s2 | 0x20;
+			if ( c1 != c2 || (unsigned char)(c1 - 'a') > ('z' - 'a') )
+			{
+				if ( (c1 | c2) >= 0x80 ) return strnicmp( (const char*)s1, (const char*)s2, n );
+				if ((unsigned char)(c1 - 'a') > ('z' - 'a')) c1 = *s1;
+				if ((unsigned char)(c2 - 'a') > ('z' - 'a')) c2 = *s2;
+				return c1 > c2 ? 1 : -1;
+			}
+		}
+	}
+	return (n > 0 && *s2) ? -1 : 0;
+}
+
+static int RefToLower( char c )
+{
+	int i = (unsigned char)c;
+	if ( i < 0x80 )
+		return ( i >= 'A' && i <= 'Z' ) ? i + 0x20 : i;
+	return isupper( i ) ? i + 0x20 : i;
+}
+
+static const char *RefStristr( const char *pStr, const char *pSearch )
+{
+	for ( const char *pLetter = pStr; *pLetter; ++pLetter )
+	{
+		if ( RefToLower( *pLetter ) != RefToLower( *pSearch ) )
+			continue;
+
+		const char *pMatch = pLetter + 1;
+		const char *pTest = pSearch + 1;
+		for ( ; *pTest; ++pMatch, ++pTest )
+		{
+			if ( !*pMatch )
+				return NULL;
+			if ( RefToLower( *pMatch ) != RefToLower( *pTest ) )
+				break;
+		}
+		if ( !*pTest )
+			return pLetter;
+	}
+	return NULL;
+}
+
+static void RefFixSlashes( char *pName, char separator )
+{
+	for ( ; *pName; ++pName )
+	{
+		if ( *pName == '/' || *pName == '\\' )
+		{
+			*pName = separator;
+		}
+	}
+}
+
+static void RefFixDoubleSlashes( char *pStr )
+{
+	int len = V_strlen( pStr );
+	for ( int i = 1; i < len - 1; i++ )
+	{
+		if ( ( pStr[i] == '/' || pStr[i] == '\\' ) && ( pStr[i+1] == '/' || pStr[i+1] == '\\' ) )
+		{
+			V_memmove( &pStr[i], &pStr[i+1], len - i );
+			--len;
+		}
+	}
+}
+
+static inline int Sign( int n )
+{
+	return ( n > 0 ) - ( n < 0 );
+}
+
+static void RandomBenchPath( IUniformRandomStream &random, char *pDest, int nLength )
+{
+	static const char s_Alphabet[] = "aAmMzZ09_.@[`{//\\\\\xc4\xe4";
+	for ( int i = 0; i < nLength; ++i )
+	{
+		pDest[i] = s_Alphabet[random.RandomInt( 0, sizeof( s_Alphabet ) - 2 )];
+	}
+	pDest[nLength] = 0;
+}
+
+// Random strings, half of them ending right at a page boundary so the 16 byte
+// loads have to take the near-page path. Returns the number of mismatches.
+static int CheckStrTools( IUniformRandomStream &random, int nIterations )
+{
+	const int nPageSize = 4096;
+	char *pBuffer = (char *)MemAlloc_AllocAligned( nPageSize * 4, nPageSize );
+	char *pPage1 = pBuffer + nPageSize;
+	char *pPage2 = pBuffer + nPageSize * 3;
+
+	int nErrors = 0;
+	for ( int i = 0; i < nIterations; ++i )
+	{
+		int nLength1 = random.RandomInt( 0, 70 );
+		char *s1 = random.RandomInt( 0, 1 ) ? pPage1 - nLength1 - 1 : pPage1 + random.RandomInt( 0, 64 );
+		RandomBenchPath( random, s1, nLength1 );
+
+		// Half the time compare against a case flipped copy with the odd change
+		int nLength2 = nLength1;
+		char *s2;
+		if ( random.RandomInt( 0, 1 ) )
+		{
+			s2 = random.RandomInt( 0, 1 ) ? pPage2 - nLength2 - 1 : pPage2 + random.RandomInt( 0, 64 );
+			for ( int j = 0; j <= nLength1; ++j )
+			{
+				char c = s1[j];
+				if ( V_isalpha( c ) && random.RandomInt( 0, 1 ) )
+				{
+					c ^= 0x20;
+				}
+				else if ( c && random.RandomInt( 0, 63 ) == 0 )
+				{
+					c = '_';
+				}
+				s2[j] = c;
+			}
+		}
+		else
+		{
+			nLength2 = random.RandomInt( 0, 70 );
+			s2 = random.RandomInt( 0, 1 ) ? pPage2 - nLength2 - 1 : pPage2 + random.RandomInt( 0, 64 );
+			RandomBenchPath( random, s2, nLength2 );
+		}
+
+		nErrors += Sign( V_stricmp( s1, s2 ) ) != Sign( RefStricmp( s1, s2, INT_MAX ) );
+
+		int n = random.RandomInt( 0, 80 );
+		nErrors += Sign( V_strnicmp( s1, s2, n ) ) != Sign( RefStricmp( s1, s2, n ) );
+
+		char szSearch[8];
+		int nStart = random.RandomInt( 0, nLength1 );
+		V_strncpy( szSearch, s2 + MIN( nStart, nLength2 ), random.RandomInt( 1, sizeof( szSearch ) ) );
+		nErrors += V_stristr( s1, szSearch ) != RefStristr( s1, szSearch );
+
+		char szOriginal[80], szRef[80];
+		V_strncpy( szOriginal, s1, sizeof( szOriginal ) );
+		V_strncpy( szRef, s1, sizeof( szRef ) );
+		char separator = random.RandomInt( 0, 1 ) ? '/' : '\\';
+		V_FixSlashes( s1, separator );
+		RefFixSlashes( szRef, separator );
+		nErrors += V_strcmp( s1, szRef ) != 0;
+
+		V_strncpy( s1, szOriginal, nLength1 + 1 );
+		V_strncpy( szRef, szOriginal, sizeof( szRef ) );
+		V_FixDoubleSlashes( s1 );
+		RefFixDoubleSlashes( szRef );
+		nErrors += V_strcmp( s1, szRef ) != 0;
+	}
+
+	MemAlloc_FreeAligned( pBuffer );
+	return nErrors;
+}
+
+template < class FUNCTOR >
+static void BenchStrTools( const char *pName, const CUtlVector<CUtlString> &names, const CUtlVector<CUtlString> &others, int nPasses, FUNCTOR func )
+{
+	int nSum = 0;
+	CFastTimer timer;
+	timer.Start();
+	for ( int nPass = 0; nPass < nPasses; ++nPass )
+	{
+		FOR_EACH_VEC( names, i )
+		{
+			nSum += func( names[i].Get(), others[i].Get() );
+		}
+	}
+	timer.End();
+
+	Msg( "  %-24s %8.3f ms  (sum %d)\n", pName, timer.GetDuration().GetMillisecondsF(), nSum );
+}
+
+struct StricmpFunctor_t			{ int operator()( const char *a, const char *b ) const { return Sign( V_stricmp( a, b ) ); } };
+struct RefStricmpFunctor_t		{ int operator()( const char *a, const char *b ) const { return Sign( RefStricmp( a, b, INT_MAX ) ); } };
+struct StrnicmpFunctor_t		{ int operator()( const char *a, const char *b ) const { return Sign( V_strnicmp( a, b, 32 ) ); } };
+struct RefStrnicmpFunctor_t		{ int operator()( const char *a, const char *b ) const { return Sign( RefStricmp( a, b, 32 ) ); } };
+struct StristrFunctor_t			{ int operator()( const char *a, const char * ) const { return V_stristr( a, ".single" ) != NULL; } };
+struct RefStristrFunctor_t		{ int operator()( const char *a, const char * ) const { return RefStristr( a, ".single" ) != NULL; } };
+
+template < void (*FIXUP)( char * ) >
+struct FixupFunctor_t
+{
+	int operator()( const char *a, const char * ) const
+	{
+		char szPath[MAX_PATH];
+		V_strncpy( szPath, a, sizeof( szPath ) );
+		FIXUP( szPath );
+		return szPath[0];
+	}
+};
+
+static void FixSlashesDefault( char *pName )		{ V_FixSlashes( pName ); }
+static void RefFixSlashesDefault( char *pName )		{ RefFixSlashes( pName, CORRECT_PATH_SEPARATOR ); }
+
+CON_COMMAND_F( cl_bench_strtools, "Checks the SSE2 string compares and path fixups against the byte at a time loops, then times them. Usage: cl_bench_strtools [strings] [passes]", FCVAR_CHEAT )
+{
+	int nStrings = ( args.ArgC() > 1 ) ? clamp( atoi( args[1] ), 1, 1000000 ) : 20000;
+	int nPasses = ( args.ArgC() > 2 ) ? MAX( atoi( args[2] ), 1 ) : 100;
+
+	CUniformRandomStream random;
+	random.SetSeed( 0x5eed );
+
+	int nErrors = CheckStrTools( random, 200000 );
+
+	// Compare each name against an upper cased copy, so every compare runs to the end
+	CUtlVector<CUtlString> names, others;
+	BuildBenchSymbolNames( nStrings, names );
+	others.EnsureCapacity( nStrings );
+	FOR_EACH_VEC( names, i )
+	{
+		char szUpper[128];
+		V_strncpy( szUpper, names[i].Get(), sizeof( szUpper ) );
+		V_strupr( szUpper );
+		V_FixSlashes( szUpper, '\\' );
+		others.AddToTail( szUpper );
+	}
+
+	Msg( "cl_bench_strtools: %d strings, %d passes, %d mismatches\n", nStrings, nPasses, nErrors );
+	BenchStrTools( "byte loop stricmp", names, others, nPasses, RefStricmpFunctor_t() );
+	BenchStrTools( "V_stricmp", names, others, nPasses, StricmpFunctor_t() );
+	BenchStrTools( "byte loop strnicmp", names, others, nPasses, RefStrnicmpFunctor_t() );
+	BenchStrTools( "V_strnicmp", names, others, nPasses, StrnicmpFunctor_t() );
+	BenchStrTools( "byte loop stristr", names, others, nPasses, RefStristrFunctor_t() );
+	BenchStrTools( "V_stristr", names, others, nPasses, StristrFunctor_t() );
+	BenchStrTools( "byte loop FixSlashes", others, others, nPasses, FixupFunctor_t<RefFixSlashesDefault>() );
+	BenchStrTools( "V_FixSlashes", others, others, nPasses, FixupFunctor_t<FixSlashesDefault>() );
+	BenchStrTools( "byte loop FixDoubleSlash", others, others, nPasses, FixupFunctor_t<RefFixDoubleSlashes>() );
+	BenchStrTools( "V_FixDoubleSlashes", others, others, nPasses, FixupFunctor_t<V_FixDoubleSlashes>() );
+}
+
+
+//-----------------------------------------------------------------------------
+// Hashtables
+//-----------------------------------------------------------------------------
+enum StringPoolOpType_t
+{
+	STRINGPOOL_ALLOC = 0,		// AllocPooledString
+	STRINGPOOL_ALLOC_KEYED,		// AllocPooledString_StaticConstantStringPointer
+	STRINGPOOL_FIND,			// FindPooledString
+};
+
+struct StringPoolOpEntry_t
+{
+	StringPoolOpType_t	m_nOp;
+	const char			*m_pString;
+};
+
+// Replays one level's worth of traffic through the same pair of tables CGameStringPool keeps.
+// Returns the number of results that differ from pExpected, and fills in pResults if it is given.
+template < class STRINGS, class KEYS >
+static int ReplayStringPoolOps( STRINGS &strings, KEYS &keyCache, const CUtlVector<StringPoolOpEntry_t> &ops, const char **pResults, const char * const *pExpected )
+{
+	int nErrors = 0;
+	FOR_EACH_VEC( ops, i )
+	{
+		const char *pResult;
+		const char *pString = ops[i].m_pString;
+		switch ( ops[i].m_nOp )
+		{
+		case STRINGPOOL_ALLOC:
+			pResult = strings[ strings.Insert( pString ) ].Get();
+			break;
+
+		case STRINGPOOL_ALLOC_KEYED:
+			{
+				const char * &cached = keyCache[ keyCache.Insert( pString, NULL ) ];
+				if ( !cached )
+				{
+					cached = strings[ strings.Insert( pString ) ].Get();
+				}
+				pResult = cached;
+			}
+			break;
+
+		default:
+			{
+				UtlHashHandle_t h = strings.Find( pString );
+				pResult = ( h == strings.InvalidHandle() ) ? NULL : strings[h].Get();
+			}
+			break;
+		}
+
+		if ( pResults )
+		{
+			pResults[i] = pResult;
+		}
+		if ( pExpected && ( !pResult != !pExpected[i] || ( pResult && V_strcmp( pResult, pExpected[i] ) ) ) )
+		{
+			++nErrors;
+		}
+	}
+	return nErrors;
+}
+
+// Roughly what the string pool sees while a large co-op map spawns: classnames and
+// models repeat across thousands of entities, most targetnames are unique, entity
+// I/O looks up names that mostly exist, and every precache site hands in the same
+// constant pointers.
+static void BuildStringPoolTrace( IUniformRandomStream &random, int nEntities, CUtlVector<CUtlString> &strings, CUtlVector<StringPoolOpEntry_t> &ops )
+{
+	static const char *s_pClasses[] = { "prop_dynamic", "prop_physics", "func_brush", "trigger_multiple", "logic_relay", "info_target",
+		"env_sprite", "light_spot", "npc_zombie", "ambient_generic", "path_track", "func_door", "point_template", "info_node" };
+
+	int nModels = nEntities / 8 + 1;
+	int nNames = nEntities / 2 + 1;
+	int nConstants = 512;
+
+	strings.EnsureCapacity( ARRAYSIZE( s_pClasses ) + nModels + nNames * 2 + nConstants );
+	for ( int i = 0; i < ARRAYSIZE( s_pClasses ); ++i )
+	{
+		strings.AddToTail( s_pClasses[i] );
+	}
+	int nFirstModel = strings.Count();
+
+	char szName[MAX_PATH];
+	for ( int i = 0; i < nModels; ++i )
+	{
+		V_snprintf( szName, sizeof( szName ), "models/props_coop/section%02d/prop_%04d.mdl", i % 40, i );
+		strings.AddToTail( szName );
+	}
+	int nFirstName = strings.Count();
+	for ( int i = 0; i < nNames; ++i )
+	{
+		V_snprintf( szName, sizeof( szName ), "area%02d_%s_%d", i % 60, s_pClasses[i % ARRAYSIZE( s_pClasses )], i );
+		strings.AddToTail( szName );
+	}
+	int nFirstMissing = strings.Count();
+	for ( int i = 0; i < nNames; ++i )
+	{
+		V_snprintf( szName, sizeof( szName ), "!missing_%d", i );
+		strings.AddToTail( szName );
+	}
+	int nFirstConstant = strings.Count();
+	for ( int i = 0; i < nConstants; ++i )
+	{
+		V_snprintf( szName, sizeof( szName ), "Constant.Sound%d", i );
+		strings.AddToTail( szName );
+	}
+
+	// Keep the pointers stable from here on
+	ops.EnsureCapacity( nEntities * 8 );
+	for ( int i = 0; i < nEntities; ++i )
+	{
+		StringPoolOpEntry_t op;
+
+		op.m_nOp = STRINGPOOL_ALLOC;
+		op.m_pString = strings[random.RandomInt( 0, ARRAYSIZE( s_pClasses ) - 1 )].Get();
+		ops.AddToTail( op );
+
+		op.m_pString = strings[nFirstModel + random.RandomInt( 0, nModels - 1 )].Get();
+		ops.AddToTail( op );
+
+		if ( random.RandomInt( 0, 1 ) )
+		{
+			op.m_pString = strings[nFirstName + random.RandomInt( 0, nNames - 1 )].Get();
+			ops.AddToTail( op );
+		}
+
+		// Spawn and precache code
+		op.m_nOp = STRINGPOOL_ALLOC_KEYED;
+		for ( int j = random.RandomInt( 1, 3 ); j > 0; --j )
+		{
+			op.m_pString = strings[nFirstConstant + random.RandomInt( 0, nConstants - 1 )].Get();
+			ops.AddToTail( op );
+		}
+
+		// Outputs resolving their targets, about one in eight misses
+		op.m_nOp = STRINGPOOL_FIND;
+		for ( int j = random.RandomInt( 0, 2 ); j > 0; --j )
+		{
+			int nFirst = random.RandomInt( 0, 7 ) ? nFirstName : nFirstMissing;
+			op.m_pString = strings[nFirst + random.RandomInt( 0, nNames - 1 )].Get();
+			ops.AddToTail( op );
+		}
+	}
+}
+
+template < class STRINGS, class KEYS >
+static void BenchStringPool( const char *pName, const CUtlVector<StringPoolOpEntry_t> &ops, int nLevels, const char * const *pExpected )
+{
+	STRINGS strings( 256 );
+	KEYS keyCache;
+
+	int nErrors = 0;
+	CFastTimer timer;
+	timer.Start();
+	for ( int nLevel = 0; nLevel < nLevels; ++nLevel )
+	{
+		// CGameStringPool::FreeAll at level shutdown
+		strings.Purge();
+		keyCache.Purge();
+		nErrors += ReplayStringPoolOps( strings, keyCache, ops, NULL, nLevel ? NULL : pExpected );
+	}
+	timer.End();
+
+	Msg( "  %-24s %8.3f ms  (%d strings, %d mismatches)\n", pName, timer.GetDuration().GetMillisecondsF(), strings.Count(), nErrors );
+}
+
+CON_COMMAND_F( cl_bench_hashtable, "Replays the string pool traffic of a large map load through CUtlHashtable and CUtlSwissHashtable. Usage: cl_bench_hashtable [entities] [levels]", FCVAR_CHEAT )
+{
+	int nEntities = ( args.ArgC() > 1 ) ? clamp( atoi( args[1] ), 1, 1000000 ) : 8192;
+	int nLevels = ( args.ArgC() > 2 ) ? MAX( atoi( args[2] ), 1 ) : 50;
+
+	CUniformRandomStream random;
+	random.SetSeed( 0x5eed );
+
+	CUtlVector<CUtlString> strings;
+	CUtlVector<StringPoolOpEntry_t> ops;
+	BuildStringPoolTrace( random, nEntities, strings, ops );
+
+	// The existing table gives the expected answers
+	CUtlVector<const char *> expected;
+	expected.SetCount( ops.Count() );
+	{
+		CUtlHashtable<CUtlConstString> refStrings( 256 );
+		CUtlHashtable<const void*, const char*> refKeys;
+		ReplayStringPoolOps( refStrings, refKeys, ops, expected.Base(), NULL );
+	}
+
+	Msg( "cl_bench_hashtable: %d entities, %d pool ops per level, %d levels\n", nEntities, ops.Count(), nLevels );
+	BenchStringPool< CUtlHashtable<CUtlConstString>, CUtlHashtable<const void*, const char*> >( "CUtlHashtable", ops, nLevels, expected.Base() );
+	BenchStringPool< CUtlSwissHashtable<CUtlConstString>, CUtlSwissHashtable<const void*, const char*> >( "CUtlSwissHashtable", ops, nLevels, expected.Base() );
+
+	// Lookups only, once the level is loaded
+	CUtlVector<const char *> lookups;
+	FOR_EACH_VEC( ops, i )
+	{
+		lookups.AddToTail( ops[i].m_pString );
+	}
+
+	CUtlHashtable<CUtlConstString> oldTable( 256 );
+	CUtlSwissHashtable<CUtlConstString> newTable( 256 );
+	FOR_EACH_VEC( strings, i )
+	{
+		if ( i & 1 )
+		{
+			oldTable.Insert( strings[i].Get() );
+			newTable.Insert( strings[i].Get() );
+		}
+	}
+
+	for ( int nPass = 0; nPass < 2; ++nPass )
+	{
+		int nFound = 0;
+		CFastTimer timer;
+		timer.Start();
+		for ( int nLevel = 0; nLevel < nLevels; ++nLevel )
+		{
+			FOR_EACH_VEC( lookups, i )
+			{
+				if ( nPass == 0 )
+					nFound += oldTable.Find( lookups[i] ) != oldTable.InvalidHandle();
+				else
+					nFound += newTable.Find( lookups[i] ) != newTable.InvalidHandle();
+			}
+		}
+		timer.End();
+		Msg( "  %-24s %8.3f ms  (%d found)\n", nPass ? "CUtlSwissHashtable Find" : "CUtlHashtable Find", timer.GetDuration().GetMillisecondsF(), nFound );
+	}
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: Compares parsing and freeing the script files as heap KeyValues
+//			against arena KeyValues.
+//-----------------------------------------------------------------------------
+static int CountKeyValuesNodes( KeyValues *pKV )
+{
+	int nCount = 0;
+	for ( ; pKV; pKV = pKV->GetNextKey() )
+	{
+		nCount += 1 + CountKeyValuesNodes( pKV->GetFirstSubKey() );
+	}
+	return nCount;
+}
+
+static void LoadKeyValuesBenchFiles( const char *pWildcard, CUtlVector<CUtlBuffer*> &files, CUtlVector<CUtlString> &names )
+{
+	char szDir[MAX_PATH];
+	V_ExtractFilePath( pWildcard, szDir, sizeof( szDir ) );
+
+	FileFindHandle_t hFind;
+	for ( const char *pFileName = filesystem->FindFirst( pWildcard, &hFind ); pFileName && pFileName[0]; pFileName = filesystem->FindNext( hFind ) )
+	{
+		if ( filesystem->FindIsDirectory( hFind ) )
+			continue;
+
+		char szPath[MAX_PATH];
+		V_ComposeFileName( szDir, pFileName, szPath, sizeof( szPath ) );
+
+		CUtlBuffer *pBuf = new CUtlBuffer( 0, 0, CUtlBuffer::TEXT_BUFFER );
+		if ( !filesystem->ReadFile( szPath, "GAME", *pBuf ) )
+		{
+			delete pBuf;
+			continue;
+		}
+
+		files.AddToTail( pBuf );
+		names.AddToTail( szPath );
+	}
+	filesystem->FindClose( hFind );
+}
+
+CON_COMMAND_F( cl_bench_kv_arena, "Times parsing and freeing scripts/*.txt and resource/*.res with heap and arena KeyValues. Usage: cl_bench_kv_arena [iterations]", FCVAR_CHEAT )
+{
+	int nIterations = ( args.ArgC() > 1 ) ? MAX( atoi( args[1] ), 1 ) : 10;
+
+	CUtlVector<CUtlBuffer*> files;
+	CUtlVector<CUtlString> names;
+	LoadKeyValuesBenchFiles( "scripts/*.txt", files, names );
+	LoadKeyValuesBenchFiles( "resource/*.res", files, names );
+	if ( !files.Count() )
+	{
+		Warning( "cl_bench_kv_arena: no files found\n" );
+		return;
+	}
+
+	double flTime[2] = { 0.0, 0.0 };
+	int nNodes[2] = { 0, 0 };
+
+	for ( int nIteration = 0; nIteration < nIterations; ++nIteration )
+	{
+		for ( int nMode = 0; nMode < 2; ++nMode )
+		{
+			for ( int i = 0; i < files.Count(); ++i )
+			{
+				files[i]->SeekGet( CUtlBuffer::SEEK_HEAD, 0 );
+
+				CFastTimer timer;
+				timer.Start();
+				KeyValues *pKV = nMode ? KeyValues::CreateInArena( "bench" ) : new KeyValues( "bench" );
+				bool bLoaded = pKV->LoadFromBuffer( names[i].Get(), *files[i] );
+				timer.End();
+
+				if ( bLoaded && nIteration == 0 )
+				{
+					nNodes[nMode] += CountKeyValuesNodes( pKV );
+				}
+
+				CFastTimer freeTimer;
+				freeTimer.Start();
+				pKV->deleteThis();
+				freeTimer.End();
+
+				flTime[nMode] += timer.GetDuration().GetMillisecondsF() + freeTimer.GetDuration().GetMillisecondsF();
+			}
+		}
+	}
+
+	Msg( "cl_bench_kv_arena: %d files, %d iterations\n", files.Count(), nIterations );
+	Msg( "  heap:  %8.3f ms per pass, %d nodes\n", flTime[0] / nIterations, nNodes[0] );
+	Msg( "  arena: %8.3f ms per pass, %d nodes\n", flTime[1] / nIterations, nNodes[1] );
+
+	files.PurgeAndDeleteElements();
+}
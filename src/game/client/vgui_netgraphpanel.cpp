@@ -229,8 +229,8 @@ CNetGraphPanel::CNetGraphPanel( VPANEL parent )
 
 	InitColors();
 
-	cl_updaterate = cvar->FindVar( "cl_updaterate" );
-	cl_cmdrate = cvar->FindVar( "cl_cmdrate" );
+	cl_updaterate = ConVar_FindVar( "cl_updaterate" );
+	cl_cmdrate = ConVar_FindVar( "cl_cmdrate" );
 	assert( cl_updaterate && cl_cmdrate );
 
 	memset( sendcolor, 0, 3 );
@@ -295,8 +295,8 @@ void CViewRender::Init( void )
 
 	m_bDrawOverlay = false;
 
-	m_pDrawEntities		= cvar->FindVar( "r_drawentities" );
-	m_pDrawBrushModels	= cvar->FindVar( "r_drawbrushmodels" );
+	m_pDrawEntities		= ConVar_FindVar( "r_drawentities" );
+	m_pDrawBrushModels	= ConVar_FindVar( "r_drawbrushmodels" );
 
 	beams->InitBeams();
 	tempents->Init();
@@ -71,7 +71,7 @@ static inline int WireFrameMode( void )
 {
 	if ( !sv_cheats )
 	{
-		sv_cheats = cvar->FindVar( "sv_cheats" );
+		sv_cheats = ConVar_FindVar( "sv_cheats" );
 	}
 
 	if ( sv_cheats && sv_cheats->GetBool() )
@@ -84,7 +84,7 @@ static inline bool ShouldDrawInWireFrameMode( void )
 {
 	if ( !sv_cheats )
 	{
-		sv_cheats = cvar->FindVar( "sv_cheats" );
+		sv_cheats = ConVar_FindVar( "sv_cheats" );
 	}
 
 	if ( sv_cheats && sv_cheats->GetBool() )
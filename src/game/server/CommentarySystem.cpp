@@ -697,7 +697,7 @@ public:
 		// Reset any convars that have been changed by the commentary
 		for ( int i = 0; i < m_ModifiedConvars.Count(); i++ )
 		{
-			ConVar *pConVar = (ConVar *)cvar->FindVar( m_ModifiedConvars[i].pszConvar );
+			ConVar *pConVar = ConVar_FindVar( m_ModifiedConvars[i].pszConvar );
 			if ( pConVar )
 			{
 				pConVar->SetValue( m_ModifiedConvars[i].pszOrgValue );
@@ -739,7 +739,7 @@ public:
 		// Set any convars that have already been changed by the commentary before the save
 		for ( int i = 0; i < m_ModifiedConvars.Count(); i++ )
 		{
-			ConVar *pConVar = (ConVar *)cvar->FindVar( m_ModifiedConvars[i].pszConvar );
+			ConVar *pConVar = ConVar_FindVar( m_ModifiedConvars[i].pszConvar );
 			if ( pConVar )
 			{
 				//Msg("    Restoring Convar %s: value %s (org %s)\n", m_ModifiedConvars[i].pszConvar, m_ModifiedConvars[i].pszCurrentValue, m_ModifiedConvars[i].pszOrgValue );
@@ -3454,9 +3454,10 @@ void CAI_BaseNPC::UpdateEfficiency( bool bInPVS )
 
 	//---------------------------------
 
-	if ( !IsRetail() && ai_efficiency_override.GetInt() > AIE_NORMAL && ai_efficiency_override.GetInt() <= AIE_DORMANT )
+	int iEfficiencyOverride = ai_efficiency_override.GetInt();
+	if ( !IsRetail() && iEfficiencyOverride > AIE_NORMAL && iEfficiencyOverride <= AIE_DORMANT )
 	{
-		SetEfficiency( (AI_Efficiency_t)ai_efficiency_override.GetInt() );
+		SetEfficiency( (AI_Efficiency_t)iEfficiencyOverride );
 		return;
 	}
 
@@ -3988,7 +3989,7 @@ bool CAI_BaseNPC::PreNPCThink()
 
 	if ( frameTimeLimit == FLT_MAX )
 	{
-		pHostTimescale = cvar->FindVar( "host_timescale" );
+		pHostTimescale = ConVar_FindVar( "host_timescale" );
 	}
 
 	bool bUseThinkLimits = ( !m_bInChoreo && ShouldUseFrameThinkLimits() );
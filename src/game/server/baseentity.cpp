@@ -4678,7 +4678,7 @@ void ModelSoundsCacheShutdown()
 	g_ModelSoundsCache.Shutdown();
 }
 
-static CUtlSymbolTable g_ModelSoundsSymbolHelper( 0, 32, true );
+static CUtlSymbolTableHash g_ModelSoundsSymbolHelper( 32, true );
 class CModelSoundsCacheSaver: public CAutoGameSystem
 {
 public:
@@ -7050,7 +7050,7 @@ void CBaseEntity::RemoveRecipientsIfNotCloseCaptioning( CRecipientFilter& filter
 		static ConVar *s_pCloseCaption = NULL;
 		if ( !s_pCloseCaption )
 		{
-			s_pCloseCaption = cvar->FindVar( "closecaption" );
+			s_pCloseCaption = ConVar_FindVar( "closecaption" );
 			if ( !s_pCloseCaption )
 			{
 				Error( "XBOX couldn't find closecaption convar!!!" );
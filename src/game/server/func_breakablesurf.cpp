@@ -19,6 +19,9 @@
 #include "globals.h"
 #include "physics_impact_damage.h"
 #include "te_effect_dispatch.h"
+#ifdef USE_NAV_MESH
+#include "nav_mesh.h"
+#endif
 
 //=============================================================================
 // HPE_BEGIN
@@ -614,6 +617,13 @@ void CBreakableSurface::Die( CBaseEntity *pBreaker, const Vector &vAttackDir )
 	m_bIsBroken = true;
 	m_iHealth = 0.0f;
 
+#ifdef USE_NAV_MESH
+	if ( TheNavMesh )
+	{
+		TheNavMesh->OnBreakableBroken( this );
+	}
+#endif
+
 	if (pBreaker)
 	{
 		m_OnBreak.FireOutput( pBreaker, this );
@@ -106,6 +106,6 @@ void InitializeCvars( void )
 	// Register cvars here:
 	ConVar_Register( FCVAR_GAMEDLL, &g_ConVarAccessor ); 
 
-	g_pDeveloper	= cvar->FindVar( "developer" );
+	g_pDeveloper	= ConVar_FindVar( "developer" );
 }
 
@@ -72,6 +72,7 @@
 #include "ienginevgui.h"
 #endif
 #include "ragdoll_shared.h"
+#include "bone_setup.h"
 #include "toolframework/iserverenginetools.h"
 #include "sceneentity.h"
 #include "appframework/IAppSystemGroup.h"
@@ -664,15 +665,15 @@ bool CServerGameDLL::DLLInit( CreateInterfaceFn appSystemFactory,
 		return false;
 	}
 
-	sv_cheats = g_pCVar->FindVar( "sv_cheats" );
+	sv_cheats = ConVar_FindVar( "sv_cheats" );
 	if ( !sv_cheats )
 		return false;
 
-	g_pcv_commentary = g_pCVar->FindVar( "commentary" );
-	g_pcv_ThreadMode = g_pCVar->FindVar( "host_thread_mode" );
-	g_pcv_hideServer = g_pCVar->FindVar( "hide_server" );
+	g_pcv_commentary = ConVar_FindVar( "commentary" );
+	g_pcv_ThreadMode = ConVar_FindVar( "host_thread_mode" );
+	g_pcv_hideServer = ConVar_FindVar( "hide_server" );
 
-	sv_maxreplay = g_pCVar->FindVar( "sv_maxreplay" );
+	sv_maxreplay = ConVar_FindVar( "sv_maxreplay" );
 
 	g_pGameSaveRestoreBlockSet->AddBlockHandler( GetEntitySaveRestoreBlockHandler() );
 	g_pGameSaveRestoreBlockSet->AddBlockHandler( GetPhysSaveRestoreBlockHandler() );
@@ -1386,6 +1387,8 @@ void CServerGameDLL::LevelShutdown( void )
 
 	InvalidateQueryCache();
 
+	Studio_FlushPoseCache();
+
 	IGameSystem::LevelShutdownPostEntityAllSystems();
 
 	// In case we quit out during initial load
@@ -2836,8 +2839,8 @@ void CServerGameClients::ClientSettingsChanged( edict_t *pEdict )
 	// its virtualized value has changed.		
 	
 	player->m_nUpdateRate = Q_atoi( QUICKGETCVARVALUE("cl_updaterate") );
-	static const ConVar *pMinUpdateRate = g_pCVar->FindVar( "sv_minupdaterate" );
-	static const ConVar *pMaxUpdateRate = g_pCVar->FindVar( "sv_maxupdaterate" );
+	static const ConVar *pMinUpdateRate = ConVar_FindVar( "sv_minupdaterate" );
+	static const ConVar *pMaxUpdateRate = ConVar_FindVar( "sv_maxupdaterate" );
 	if ( pMinUpdateRate && pMaxUpdateRate )
 		player->m_nUpdateRate = clamp( player->m_nUpdateRate, (int) pMinUpdateRate->GetFloat(), (int) pMaxUpdateRate->GetFloat() );
 
@@ -2849,8 +2852,8 @@ void CServerGameClients::ClientSettingsChanged( edict_t *pEdict )
 			flLerpRatio = 1.0f;
 		float flLerpAmount = Q_atof( QUICKGETCVARVALUE("cl_interp") );
 
-		static const ConVar *pMin = g_pCVar->FindVar( "sv_client_min_interp_ratio" );
-		static const ConVar *pMax = g_pCVar->FindVar( "sv_client_max_interp_ratio" );
+		static const ConVar *pMin = ConVar_FindVar( "sv_client_min_interp_ratio" );
+		static const ConVar *pMax = ConVar_FindVar( "sv_client_max_interp_ratio" );
 		if ( pMin && pMax && pMin->GetFloat() != -1 )
 		{
 			flLerpRatio = clamp( flLerpRatio, pMin->GetFloat(), pMax->GetFloat() );
@@ -8,6 +8,9 @@
 #include "entityoutput.h"
 #include "ndebugoverlay.h"
 #include "modelentities.h"
+#ifdef USE_NAV_MESH
+#include "nav_mesh.h"
+#endif
 
 // memdbgon must be the last include file in a .cpp file!!!
 #include "tier0/memdbgon.h"
@@ -171,6 +174,13 @@ void CFuncBrush::TurnOff( void )
 
 	AddEffects( EF_NODRAW );
 	m_iDisabled = TRUE;
+
+#ifdef USE_NAV_MESH
+	if ( TheNavMesh )
+	{
+		TheNavMesh->OnBrushChanged( this );
+	}
+#endif
 }
 
 
@@ -188,6 +198,13 @@ void CFuncBrush::TurnOn( void )
 	}
 
 	RemoveEffects( EF_NODRAW );
+
+#ifdef USE_NAV_MESH
+	if ( TheNavMesh )
+	{
+		TheNavMesh->OnBrushChanged( this );
+	}
+#endif
 }
 
 
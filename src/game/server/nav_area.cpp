@@ -3724,6 +3724,18 @@ static Vector FindPositionInArea( CNavArea *area, NavCornerType corner )
 	return pos;
 }
 
+//--------------------------------------------------------------------------------------------------------------
+/**
+ * Flag the given hiding spot as in cover or exposed
+ */
+static void ClassifyHidingSpotCover( HidingSpot *&spot )
+{
+	spot->SetFlags( IsHidingSpotInCover( spot->GetPosition() ) ? HidingSpot::IN_COVER : HidingSpot::EXPOSED );
+}
+
+// when non-NULL, ComputeHidingSpots() collects new spots here instead of tracing their cover itself
+static CUtlVector< HidingSpot * > *s_deferredCoverSpots = NULL;
+
 //--------------------------------------------------------------------------------------------------------------
 /**
  * Analyze local area neighborhood to find "hiding spots" for this area
@@ -3838,13 +3850,42 @@ void CNavArea::ComputeHidingSpots( void )
 			{
 				HidingSpot *spot = TheNavMesh->CreateHidingSpot();
 				spot->SetPosition( pos );
-				spot->SetFlags( IsHidingSpotInCover( pos ) ? HidingSpot::IN_COVER : HidingSpot::EXPOSED );
 				m_hidingSpots.AddToTail( spot );
+
+				if ( s_deferredCoverSpots )
+				{
+					s_deferredCoverSpots->AddToTail( spot );
+				}
+				else
+				{
+					ClassifyHidingSpotCover( spot );
+				}
 			}
 		}
 	}
 }
 
+
+//--------------------------------------------------------------------------------------------------------------
+/**
+ * Compute the hiding spots of a batch of areas.
+ * Spots are created serially in area order, so their IDs do not depend on the number of threads,
+ * then the cover traces for the whole batch are run in parallel.
+ */
+void ComputeHidingSpotsInParallel( CNavArea **areas, int count )
+{
+	CUtlVector< HidingSpot * > spots;
+
+	s_deferredCoverSpots = &spots;
+	for( int i=0; i<count; ++i )
+	{
+		areas[i]->ComputeHidingSpots();
+	}
+	s_deferredCoverSpots = NULL;
+
+	ParallelProcess( "ComputeHidingSpotsInParallel", spots.Base(), spots.Count(), &ClassifyHidingSpotCover, NULL, NULL, NavGenerationMaxParallel() );
+}
+
 //--------------------------------------------------------------------------------------------------------------
 /**
  * Determine how much walkable area we can see from the spot, and how far away we can see.
@@ -3966,6 +4007,36 @@ void CNavArea::ComputeSniperSpots( void )
 	}
 }
 
+//--------------------------------------------------------------------------------------------------------------
+static void ClassifySniperSpotJob( HidingSpot *&spot )
+{
+	ClassifySniperSpot( spot );
+}
+
+
+//--------------------------------------------------------------------------------------------------------------
+/**
+ * Find the sniper spots of a batch of areas.
+ * Each spot only writes its own flags, so the result does not depend on the number of threads.
+ */
+void ComputeSniperSpotsInParallel( CNavArea **areas, int count )
+{
+	if (nav_quicksave.GetBool())
+		return;
+
+	CUtlVector< HidingSpot * > spots;
+	for( int i=0; i<count; ++i )
+	{
+		const HidingSpotVector *areaSpots = areas[i]->GetHidingSpots();
+		FOR_EACH_VEC( (*areaSpots), it )
+		{
+			spots.AddToTail( (*areaSpots)[ it ] );
+		}
+	}
+
+	ParallelProcess( "ComputeSniperSpotsInParallel", spots.Base(), spots.Count(), &ClassifySniperSpotJob, NULL, NULL, NavGenerationMaxParallel() );
+}
+
 //--------------------------------------------------------------------------------------------------------------
 /**
  * Given the areas we are moving between, return the spots we will encounter
@@ -4810,46 +4881,31 @@ void CNavArea::UnblockArea( int teamID )
 
 //--------------------------------------------------------------------------------------------------------------
 /**
- * Updates the (un)blocked status of the nav area
- * The semantics of this method have gotten very muddled - needs refactoring (MSB 5/7/09)
+ * Return the hull that must be clear of solid geometry for this area to be unblocked
  */
-void CNavArea::UpdateBlocked( bool force, int teamID )
+void CNavArea::GetBlockedTestHull( Vector *origin, Extent *bounds ) const
 {
-	VPROF( "CNavArea::UpdateBlocked" );
-	if ( !force && !m_blockedTimer.IsElapsed() )
-	{
-		return;
-	}
-
-	const float MaxBlockedCheckInterval = 5;
-	float interval = m_blockedTimer.GetCountdownDuration() + 1;
-	if ( interval > MaxBlockedCheckInterval )
-	{
-		interval = MaxBlockedCheckInterval;
-	}
-	m_blockedTimer.Start( interval );
-
-	if ( ( m_attributeFlags & NAV_MESH_NAV_BLOCKER ) )
-	{
-		if ( force )
-		{
-			UpdateBlockedFromNavBlockers();
-		}
-		return;
-	}
-
-	Vector origin = GetCenter();
-	origin.z += HalfHumanHeight;
+	*origin = GetCenter();
+	origin->z += HalfHumanHeight;
 
 	const float sizeX = MAX( 1, MIN( GetSizeX()/2 - 5, HalfHumanWidth ) );
 	const float sizeY = MAX( 1, MIN( GetSizeY()/2 - 5, HalfHumanWidth ) );
-	Extent bounds;
-	bounds.lo.Init( -sizeX, -sizeY, 0 );
-	bounds.hi.Init( sizeX, sizeY, VEC_DUCK_HULL_MAX.z - HalfHumanHeight );
+	bounds->lo.Init( -sizeX, -sizeY, 0 );
+	bounds->hi.Init( sizeX, sizeY, VEC_DUCK_HULL_MAX.z - HalfHumanHeight );
+}
 
-	bool wasBlocked = IsBlocked( TEAM_ANY );
 
-	// See if spot is valid
+//--------------------------------------------------------------------------------------------------------------
+/**
+ * Return true if solid brushes overlap the space a player needs in this area.
+ * Doesn't change any state, so callers can test many areas before applying the results.
+ */
+bool CNavArea::IsBlockedByGeometry( void ) const
+{
+	Vector origin;
+	Extent bounds;
+	GetBlockedTestHull( &origin, &bounds );
+
 #ifdef TERROR
 	// don't unblock func_doors
 	CTraceFilterWalkableEntities filter( NULL, COLLISION_GROUP_PLAYER_MOVEMENT, WALK_THRU_PROP_DOORS | WALK_THRU_BREAKABLES );
@@ -4870,7 +4926,19 @@ void CNavArea::UpdateBlocked( bool force, int teamID )
 
 	}
 
-	if ( !tr.startsolid )
+	return tr.startsolid;
+}
+
+
+//--------------------------------------------------------------------------------------------------------------
+/**
+ * Update the (un)blocked status of the nav area from the result of IsBlockedByGeometry()
+ */
+void CNavArea::ApplyBlockedTest( bool isBlockedByGeometry, bool force, int teamID )
+{
+	bool wasBlocked = IsBlocked( TEAM_ANY );
+
+	if ( !isBlockedByGeometry )
 	{
 		// unblock ourself
 #ifdef TERROR
@@ -4881,6 +4949,9 @@ void CNavArea::UpdateBlocked( bool force, int teamID )
 #endif
 
 		{
+			Vector origin;
+			Extent bounds;
+			GetBlockedTestHull( &origin, &bounds );
 			NDebugOverlay::Box( origin, bounds.lo, bounds.hi, 0, 255, 0, 10, 5.0f );
 		}
 		else
@@ -4929,9 +5000,47 @@ void CNavArea::UpdateBlocked( bool force, int teamID )
 			TheNavMesh->OnAreaUnblocked( this );
 		}
 	}
+}
+
+
+//--------------------------------------------------------------------------------------------------------------
+/**
+ * Updates the (un)blocked status of the nav area
+ * The semantics of this method have gotten very muddled - needs refactoring (MSB 5/7/09)
+ */
+void CNavArea::UpdateBlocked( bool force, int teamID )
+{
+	VPROF( "CNavArea::UpdateBlocked" );
+	if ( !force && !m_blockedTimer.IsElapsed() )
+	{
+		return;
+	}
+
+	const float MaxBlockedCheckInterval = 5;
+	float interval = m_blockedTimer.GetCountdownDuration() + 1;
+	if ( interval > MaxBlockedCheckInterval )
+	{
+		interval = MaxBlockedCheckInterval;
+	}
+	m_blockedTimer.Start( interval );
+
+	if ( ( m_attributeFlags & NAV_MESH_NAV_BLOCKER ) )
+	{
+		if ( force )
+		{
+			UpdateBlockedFromNavBlockers();
+		}
+		return;
+	}
+
+	ApplyBlockedTest( IsBlockedByGeometry(), force, teamID );
 
 	if ( TheNavMesh->GetMarkedArea() == this )
 	{
+		Vector origin;
+		Extent bounds;
+		GetBlockedTestHull( &origin, &bounds );
+
 		if ( IsBlocked( teamID ) )
 		{
 			NDebugOverlay::Box( origin, bounds.lo, bounds.hi, 255, 0, 0, 64, 3.0f );
@@ -4953,6 +5062,20 @@ void CNavArea::CheckFloor( CBaseEntity *ignore )
 	if ( IsBlocked( TEAM_ANY ) )
 		return;
 
+	// If the center is open space, we're effectively blocked
+	if ( !HasFloor( ignore ) )
+	{
+		MarkAsBlocked( TEAM_ANY, NULL );
+	}
+}
+
+
+//--------------------------------------------------------------------------------------------------------------
+/**
+ * Return true if there is solid ground under the center of the nav area
+ */
+bool CNavArea::HasFloor( CBaseEntity *ignore ) const
+{
 	Vector origin = GetCenter();
 	origin.z -= JumpCrouchHeight;
 
@@ -4972,14 +5095,8 @@ void CNavArea::CheckFloor( CBaseEntity *ignore )
 		COLLISION_GROUP_PLAYER_MOVEMENT,
 		&tr );
 
-	// If the center is open space, we're effectively blocked
-	if ( !tr.startsolid )
-	{
-		MarkAsBlocked( TEAM_ANY, NULL );
-	}
-
 	/*
-	if ( IsBlocked( TEAM_ANY ) )
+	if ( !tr.startsolid )
 	{
 		NDebugOverlay::Box( origin, mins, maxs, 255, 0, 0, 64, 3.0f );
 	}
@@ -4988,6 +5105,8 @@ void CNavArea::CheckFloor( CBaseEntity *ignore )
 		NDebugOverlay::Box( origin, mins, maxs, 0, 255, 0, 64, 3.0f );
 	}
 	*/
+
+	return tr.startsolid;
 }
 
 
@@ -5573,6 +5692,16 @@ void CNavArea::ComputeVisToArea( CNavArea *&pOtherArea )
 }
 
 
+//--------------------------------------------------------------------------------------------------------
+static int CompareAreaBindInfoID( const void *a, const void *b )
+{
+	unsigned int idA = ((const CNavArea::AreaBindInfo *)a)->area->GetID();
+	unsigned int idB = ((const CNavArea::AreaBindInfo *)b)->area->GetID();
+
+	return ( idA < idB ) ? -1 : ( idA > idB ) ? 1 : 0;
+}
+
+
 //--------------------------------------------------------------------------------------------------------
 /**
  * Determine visibility from this area to all potentially/completely visible areas in the mesh
@@ -5610,14 +5739,22 @@ void CNavArea::ComputeVisibilityToMesh( void )
 	SetupPVS();
 
 	g_pCurVisArea = this;
-	ParallelProcess( "CNavArea::ComputeVisibilityToMesh", collector.m_area.Base(), collector.m_area.Count(), &ComputeVisToArea );
+	ParallelProcess( "CNavArea::ComputeVisibilityToMesh", collector.m_area.Base(), collector.m_area.Count(), &ComputeVisToArea, NULL, NULL, NavGenerationMaxParallel() );
 
-	m_potentiallyVisibleAreas.EnsureCapacity( g_ComputedVis.Count() );
+	int firstComputed = m_potentiallyVisibleAreas.Count();
+	m_potentiallyVisibleAreas.EnsureCapacity( firstComputed + g_ComputedVis.Count() );
 	while ( g_ComputedVis.Count() )
 	{
 		g_ComputedVis.PopItem( &m_potentiallyVisibleAreas[ m_potentiallyVisibleAreas.AddToTail() ] );
 	}
 
+	// the jobs finish in any order - sort so the saved mesh does not depend on thread timing
+	int numComputed = m_potentiallyVisibleAreas.Count() - firstComputed;
+	if ( numComputed > 1 )
+	{
+		qsort( &m_potentiallyVisibleAreas[ firstComputed ], numComputed, sizeof( AreaBindInfo ), CompareAreaBindInfoID );
+	}
+
 	FOR_EACH_VEC( collector.m_area, it )
 	{
 		visPair.SetPair( this, (CNavArea *)collector.m_area[it] );
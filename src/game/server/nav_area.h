@@ -314,8 +314,12 @@ public:
 	virtual void UpdateBlocked( bool force = false, int teamID = TEAM_ANY );		// Updates the (un)blocked status of the nav area (throttled)
 	virtual bool IsBlocked( int teamID, bool ignoreNavBlockers = false ) const;
 	void UnblockArea( int teamID = TEAM_ANY );					// clear blocked status for the given team(s)
+	bool IsBlockedByGeometry( void ) const;						// trace for solid brushes where a player would stand, without changing any state
+	void ApplyBlockedTest( bool isBlockedByGeometry, bool force = true, int teamID = TEAM_ANY );	// update blocked status from the result of IsBlockedByGeometry()
 
 	void CheckFloor( CBaseEntity *ignore );						// Checks if there is a floor under the nav area, in case a breakable floor is gone
+	bool HasFloor( CBaseEntity *ignore ) const;					// trace for ground under the center of the area
+	void GetBlockedTestHull( Vector *origin, Extent *bounds ) const;	// the hull that must be clear of solid geometry for this area to be unblocked
 
 	void MarkObstacleToAvoid( float obstructionHeight );
 	void UpdateAvoidanceObstacles( void );
@@ -770,6 +774,9 @@ private:
 typedef CUtlVector< CNavArea * > NavAreaVector;
 extern NavAreaVector TheNavAreas;
 
+extern void ComputeHidingSpotsInParallel( CNavArea **areas, int count );	// hiding spots are created in area order, cover traces run in parallel
+extern void ComputeSniperSpotsInParallel( CNavArea **areas, int count );	// classify the hiding spots of the given areas in parallel
+
 
 //--------------------------------------------------------------------------------------------------------------
 //--------------------------------------------------------------------------------------------------------------
@@ -36,7 +36,59 @@
 /// IMPORTANT: If this version changes, the swap function in makegamedata 
 /// must be updated to match. If not, this will break the Xbox 360.
 // TODO: Was changed from 15, update when latest 360 code is integrated (MSB 5/5/09)
-const int NavCurrentVersion = 16;
+const int NavCurrentVersion = 17;
+
+/// The last version that stored connections and visibility lists as plain 32-bit IDs
+const int NavLegacyVersion = 16;
+
+ConVar nav_save_compact( "nav_save_compact", "1", FCVAR_CHEAT, "If zero, nav files are saved in the previous (version 16) format, for comparing load times and file sizes." );
+
+
+//--------------------------------------------------------------------------------------------------------------
+//
+// Compact encoding used by version 17+. Area IDs in connection and visibility lists
+// are stored as the zig-zag encoded difference from the previous ID in the list
+// (starting at the owning area's ID), as a variable length integer. Since areas are
+// mostly connected to and see areas created near them, most IDs fit in one or two bytes.
+//
+static void PutNavVarInt( CUtlBuffer &fileBuffer, unsigned int value )
+{
+	while ( value >= 0x80 )
+	{
+		fileBuffer.PutUnsignedChar( (unsigned char)( value | 0x80 ) );
+		value >>= 7;
+	}
+	fileBuffer.PutUnsignedChar( (unsigned char)value );
+}
+
+static unsigned int GetNavVarInt( CUtlBuffer &fileBuffer )
+{
+	unsigned int value = 0;
+	for ( int shift = 0; shift < 35; shift += 7 )
+	{
+		unsigned char byte = fileBuffer.GetUnsignedChar();
+		value |= (unsigned int)( byte & 0x7F ) << shift;
+
+		if ( !( byte & 0x80 ) || !fileBuffer.IsValid() )
+			break;
+	}
+	return value;
+}
+
+static void PutNavDeltaID( CUtlBuffer &fileBuffer, unsigned int id, unsigned int *prevID )
+{
+	int delta = (int)( id - *prevID );
+	PutNavVarInt( fileBuffer, ( (unsigned int)delta << 1 ) ^ (unsigned int)( delta >> 31 ) );
+	*prevID = id;
+}
+
+static unsigned int GetNavDeltaID( CUtlBuffer &fileBuffer, unsigned int *prevID )
+{
+	unsigned int zigzag = GetNavVarInt( fileBuffer );
+	int delta = (int)( zigzag >> 1 ) ^ -(int)( zigzag & 1 );
+	*prevID += delta;
+	return *prevID;
+}
 
 //--------------------------------------------------------------------------------------------------------------
 //
@@ -229,6 +281,19 @@ void CNavArea::Save( CUtlBuffer &fileBuffer, unsigned int version ) const
 	{
 		// save number of connections for this direction
 		unsigned int count = m_connect[d].Count();
+
+		if ( version > NavLegacyVersion )
+		{
+			PutNavVarInt( fileBuffer, count );
+
+			unsigned int prevID = m_id;
+			FOR_EACH_VEC( m_connect[d], it )
+			{
+				PutNavDeltaID( fileBuffer, m_connect[d][ it ].area->m_id, &prevID );
+			}
+			continue;
+		}
+
 		fileBuffer.PutUnsignedInt( count );
 
 		FOR_EACH_VEC( m_connect[d], it )
@@ -364,16 +429,47 @@ void CNavArea::Save( CUtlBuffer &fileBuffer, unsigned int version ) const
 
 	// save visible area set
 	unsigned int visibleAreaCount = m_potentiallyVisibleAreas.Count();
-	fileBuffer.PutUnsignedInt( visibleAreaCount );
 
-	for ( int vit=0; vit<m_potentiallyVisibleAreas.Count(); ++vit )
+	if ( version > NavLegacyVersion )
 	{
-		CNavArea *area = m_potentiallyVisibleAreas[ vit ].area;
+		// store runs of areas sharing the same visibility attributes, each as a count and the attributes followed by the IDs
+		PutNavVarInt( fileBuffer, visibleAreaCount );
+
+		unsigned int prevID = m_id;
+		int vit = 0;
+		while ( vit < m_potentiallyVisibleAreas.Count() )
+		{
+			unsigned char attributes = m_potentiallyVisibleAreas[ vit ].attributes;
+
+			int runLength = 1;
+			while ( vit + runLength < m_potentiallyVisibleAreas.Count() && m_potentiallyVisibleAreas[ vit + runLength ].attributes == attributes )
+			{
+				++runLength;
+			}
 
-		unsigned int id = area ? area->GetID() : 0;
+			PutNavVarInt( fileBuffer, runLength );
+			fileBuffer.PutUnsignedChar( attributes );
 
-		fileBuffer.PutUnsignedInt( id );
-		fileBuffer.PutUnsignedChar( m_potentiallyVisibleAreas[ vit ].attributes );
+			for ( int r=0; r<runLength; ++r, ++vit )
+			{
+				CNavArea *area = m_potentiallyVisibleAreas[ vit ].area;
+				PutNavDeltaID( fileBuffer, area ? area->GetID() : 0, &prevID );
+			}
+		}
+	}
+	else
+	{
+		fileBuffer.PutUnsignedInt( visibleAreaCount );
+
+		for ( int vit=0; vit<m_potentiallyVisibleAreas.Count(); ++vit )
+		{
+			CNavArea *area = m_potentiallyVisibleAreas[ vit ].area;
+
+			unsigned int id = area ? area->GetID() : 0;
+
+			fileBuffer.PutUnsignedInt( id );
+			fileBuffer.PutUnsignedChar( m_potentiallyVisibleAreas[ vit ].attributes );
+		}
 	}
 
 	// store area we inherit visibility from
@@ -441,14 +537,18 @@ NavErrorType CNavArea::Load( CUtlBuffer &fileBuffer, unsigned int version, unsig
 	for( int d=0; d<NUM_DIRECTIONS; d++ )
 	{
 		// load number of connections for this direction
-		unsigned int count = fileBuffer.GetUnsignedInt();
+		bool isCompact = ( version > NavLegacyVersion );
+		unsigned int count = isCompact ? GetNavVarInt( fileBuffer ) : fileBuffer.GetUnsignedInt();
 		Assert( fileBuffer.IsValid() );
+		if ( !fileBuffer.IsValid() )
+			return NAV_CORRUPT_DATA;
 
+		unsigned int prevID = m_id;
 		m_connect[d].EnsureCapacity( count );
 		for( unsigned int i=0; i<count; ++i )
 		{
 			NavConnect connect;
-			connect.id = fileBuffer.GetUnsignedInt();
+			connect.id = isCompact ? GetNavDeltaID( fileBuffer, &prevID ) : fileBuffer.GetUnsignedInt();
 			Assert( fileBuffer.IsValid() );
 
 			// don't allow self-referential connections
@@ -641,7 +741,11 @@ NavErrorType CNavArea::Load( CUtlBuffer &fileBuffer, unsigned int version, unsig
 		return NAV_OK;
 
 	// load visibility information
-	unsigned int visibleAreaCount = fileBuffer.GetUnsignedInt();
+	bool isCompact = ( version > NavLegacyVersion );
+	unsigned int visibleAreaCount = isCompact ? GetNavVarInt( fileBuffer ) : fileBuffer.GetUnsignedInt();
+	if ( !fileBuffer.IsValid() )
+		return NAV_CORRUPT_DATA;
+
 	if ( !IsX360() )
 	{
 		m_potentiallyVisibleAreas.EnsureCapacity( visibleAreaCount );
@@ -655,13 +759,39 @@ NavErrorType CNavArea::Load( CUtlBuffer &fileBuffer, unsigned int version, unsig
 */
 	}
 
-	for( unsigned int j=0; j<visibleAreaCount; ++j )
+	if ( isCompact )
 	{
-		AreaBindInfo info;
-		info.id = fileBuffer.GetUnsignedInt();
-		info.attributes = fileBuffer.GetUnsignedChar();
+		unsigned int prevID = m_id;
+		unsigned int loaded = 0;
+		while ( loaded < visibleAreaCount )
+		{
+			unsigned int runLength = GetNavVarInt( fileBuffer );
+			unsigned char attributes = fileBuffer.GetUnsignedChar();
+			if ( !fileBuffer.IsValid() || runLength == 0 || runLength > visibleAreaCount - loaded )
+				return NAV_CORRUPT_DATA;
+
+			for( unsigned int r=0; r<runLength; ++r )
+			{
+				AreaBindInfo info;
+				info.id = GetNavDeltaID( fileBuffer, &prevID );
+				info.attributes = attributes;
 
-		m_potentiallyVisibleAreas.AddToTail( info );
+				m_potentiallyVisibleAreas.AddToTail( info );
+			}
+
+			loaded += runLength;
+		}
+	}
+	else
+	{
+		for( unsigned int j=0; j<visibleAreaCount; ++j )
+		{
+			AreaBindInfo info;
+			info.id = fileBuffer.GetUnsignedInt();
+			info.attributes = fileBuffer.GetUnsignedChar();
+
+			m_potentiallyVisibleAreas.AddToTail( info );
+		}
 	}
 
 	// read area from which we inherit visibility
@@ -1114,7 +1244,9 @@ bool CNavMesh::Save( void ) const
 	// 14 - Added a bool for if the nav needs analysis
 	// 15 - removed approach areas
 	// 16 - Added visibility data to the base mesh
-	fileBuffer.PutUnsignedInt( NavCurrentVersion );
+	// 17 - Connection and visibility lists use delta encoded variable length IDs, visibility attributes are run-length encoded
+	unsigned int saveVersion = nav_save_compact.GetBool() ? NavCurrentVersion : NavLegacyVersion;
+	fileBuffer.PutUnsignedInt( saveVersion );
 
 	// The sub-version number is maintained and owned by classes derived from CNavMesh and CNavArea
 	// and allows them to track their custom data just as we do at this top level
@@ -1160,7 +1292,7 @@ bool CNavMesh::Save( void ) const
 		{
 			CNavArea *area = TheNavAreas[ it ];
 
-			area->Save( fileBuffer, NavCurrentVersion );
+			area->Save( fileBuffer, saveVersion );
 		}
 	}
 
@@ -1176,7 +1308,7 @@ bool CNavMesh::Save( void ) const
 		for ( int i=0; i<m_ladders.Count(); ++i )
 		{
 			CNavLadder *ladder = m_ladders[i];
-			ladder->Save( fileBuffer, NavCurrentVersion );
+			ladder->Save( fileBuffer, saveVersion );
 		}
 	}
 	
@@ -1192,7 +1324,7 @@ bool CNavMesh::Save( void ) const
 	}
 
 	unsigned int navSize = filesystem->Size( filename );
-	DevMsg( "Size of nav file '%s' is %u bytes.\n", filename, navSize );
+	DevMsg( "Size of nav file '%s' is %u bytes (version %u).\n", filename, navSize, saveVersion );
 
 	return true;
 }
@@ -1295,6 +1427,81 @@ void CommandNavCheckFileConsistency( void )
 static ConCommand nav_check_file_consistency( "nav_check_file_consistency", CommandNavCheckFileConsistency, "Scans the maps directory and reports any missing/out-of-date navigation files.", FCVAR_GAMEDLL | FCVAR_CHEAT );
 
 
+//--------------------------------------------------------------------------------------------------------------
+/**
+ * Report how big the current mesh is in the legacy and compact file formats, how long each takes
+ * to serialize, and roughly how much memory the loaded mesh occupies.
+ */
+void CNavMesh::CommandNavFileStats( void ) const
+{
+	if ( !TheNavAreas.Count() )
+	{
+		Msg( "No navigation mesh loaded.\n" );
+		return;
+	}
+
+	const unsigned int versions[] = { NavLegacyVersion, NavCurrentVersion };
+	for ( int v=0; v<ARRAYSIZE( versions ); ++v )
+	{
+		CUtlBuffer fileBuffer( 4096, 1024*1024 );
+
+		double startTime = Plat_FloatTime();
+		FOR_EACH_VEC( TheNavAreas, it )
+		{
+			TheNavAreas[ it ]->Save( fileBuffer, versions[v] );
+		}
+		double saveTime = Plat_FloatTime() - startTime;
+
+		Msg( "Version %u: %d bytes of area data (%.1f bytes/area), serialized in %.1f ms\n",
+			 versions[v], fileBuffer.TellMaxPut(), (float)fileBuffer.TellMaxPut() / TheNavAreas.Count(), saveTime * 1000.0 );
+	}
+
+	// estimate resident memory
+	int connectCount = 0, visibleCount = 0, visibleAllocated = 0, encounterCount = 0, encounterSpotCount = 0;
+	FOR_EACH_VEC( TheNavAreas, it )
+	{
+		const CNavArea *area = TheNavAreas[ it ];
+
+		for ( int d=0; d<NUM_DIRECTIONS; ++d )
+		{
+			connectCount += area->m_connect[d].Count() + area->m_incomingConnect[d].Count();
+		}
+
+		visibleCount += area->m_potentiallyVisibleAreas.Count();
+		visibleAllocated += area->m_potentiallyVisibleAreas.NumAllocated();
+
+		encounterCount += area->m_spotEncounters.Count();
+		FOR_EACH_VEC( area->m_spotEncounters, eit )
+		{
+			encounterSpotCount += area->m_spotEncounters[ eit ]->spots.Count();
+		}
+	}
+
+	int areaBytes = TheNavAreas.Count() * sizeof( CNavArea );
+	int connectBytes = connectCount * sizeof( NavConnect );
+	int visibleBytes = visibleAllocated * sizeof( CNavArea::AreaBindInfo );
+	int spotBytes = TheHidingSpots.Count() * sizeof( HidingSpot ) + encounterCount * sizeof( SpotEncounter ) + encounterSpotCount * sizeof( SpotOrder );
+
+	Msg( "Resident memory (approximate):\n" );
+	Msg( "  %6d areas               %8d KB\n", TheNavAreas.Count(), areaBytes / 1024 );
+	Msg( "  %6d connections         %8d KB\n", connectCount, connectBytes / 1024 );
+	Msg( "  %6d visibility entries  %8d KB (%d allocated)\n", visibleCount, visibleBytes / 1024, visibleAllocated );
+	Msg( "  %6d hiding spots        %8d KB (with %d encounter paths)\n", TheHidingSpots.Count(), spotBytes / 1024, encounterCount );
+	Msg( "  total                      %8d KB\n", ( areaBytes + connectBytes + visibleBytes + spotBytes ) / 1024 );
+}
+
+
+//--------------------------------------------------------------------------------------------------------------
+void CommandNavFileStats( void )
+{
+	if ( !UTIL_IsCommandIssuedByServerAdmin() )
+		return;
+
+	TheNavMesh->CommandNavFileStats();
+}
+static ConCommand nav_file_stats( "nav_file_stats", CommandNavFileStats, "Reports the size of the current navigation mesh in the legacy and compact nav file formats, and its approximate resident memory.", FCVAR_GAMEDLL | FCVAR_CHEAT );
+
+
 //--------------------------------------------------------------------------------------------------------------
 /**
  * Reads the used place names from the nav file (can be used to selectively precache before the nav is loaded)
@@ -1383,6 +1590,8 @@ NavErrorType CNavMesh::Load( void )
 {
 	MDLCACHE_CRITICAL_SECTION();
 
+	double loadStartTime = Plat_FloatTime();
+
 	// free previous navigation mesh data
 	Reset();
 	placeDirectory.Reset();
@@ -1513,9 +1722,17 @@ NavErrorType CNavMesh::Load( void )
 	for( i=0; i<count; ++i )
 	{
 		CNavArea *area = TheNavMesh->CreateArea();
-		area->Load( fileBuffer, version, subVersion );
 		TheNavAreas.AddToTail( area );
 
+		if ( area->Load( fileBuffer, version, subVersion ) != NAV_OK )
+		{
+			Msg( "Corrupt navigation area data in '%s'.\n", filename );
+
+			// the areas loaded so far still hold raw IDs instead of bound pointers - don't leave them in the mesh
+			DestroyNavigationMesh();
+			return NAV_CORRUPT_DATA;
+		}
+
 		area->GetExtent( &areaExtent );
 
 		if (areaExtent.lo.x < extent.lo.x)
@@ -1573,6 +1790,9 @@ NavErrorType CNavMesh::Load( void )
 
 	WarnIfMeshNeedsAnalysis( version );
 
+	DevMsg( "Loaded %d navigation areas from '%s' (version %u, %d bytes) in %.1f ms.\n",
+		TheNavAreas.Count(), filename, version, fileBuffer.TellMaxPut(), ( Plat_FloatTime() - loadStartTime ) * 1000.0 );
+
 	return loadResult;
 }
 
@@ -17,6 +17,8 @@
 #include "viewport_panel_names.h"
 //#include "terror/TerrorShared.h"
 #include "fmtstr.h"
+#include "utlhashtable.h"
+#include "vstdlib/jobthread.h"
 
 #ifdef TERROR
 #include "func_simpleladder.h"
@@ -42,15 +44,84 @@ ConVar nav_generate_fixup_jump_areas( "nav_generate_fixup_jump_areas", "1", FCVA
 ConVar nav_generate_incremental_range( "nav_generate_incremental_range", "2000", FCVAR_CHEAT );
 ConVar nav_generate_incremental_tolerance( "nav_generate_incremental_tolerance", "0", FCVAR_CHEAT, "Z tolerance for adding new nav areas." );
 ConVar nav_area_max_size( "nav_area_max_size", "50", FCVAR_CHEAT, "Max area size created in nav generation" );
+ConVar nav_generate_threads( "nav_generate_threads", "0", FCVAR_CHEAT, "Max number of threads, counting the main thread, used by the trace-heavy phases of nav generation (0 = every thread pool thread plus the main thread, 1 or 2 = serial). The generated mesh is identical for any value." );
+ConVar nav_generate_sample_batch( "nav_generate_sample_batch", "1024", FCVAR_CHEAT, "Number of walkable space steps traced ahead in parallel while sampling." );
+ConVar nav_generate_area_batch( "nav_generate_area_batch", "64", FCVAR_CHEAT, "Number of nav areas processed per parallel batch when finding hiding and sniper spots." );
 
 // Common bounding box for traces
 Vector NavTraceMins( -0.45, -0.45, 0 );
 Vector NavTraceMaxs( 0.45, 0.45, HumanCrouchHeight );
 bool FindGroundForNode( Vector *pos, Vector *normal );	// find a ground Z for pos that is clear for NavTraceMins -> NavTraceMaxs
 
+//--------------------------------------------------------------------------------------------------------------
+/**
+ * Max jobs to queue for the parallel phases of mesh generation. CParallelProcessor::Run
+ * also works on the calling thread, so the main thread is one of the nav_generate_threads.
+ * Run never queues a single job, which makes a limit of 2 threads run serially.
+ */
+int NavGenerationMaxParallel( void )
+{
+	int threads = nav_generate_threads.GetInt();
+	if ( threads <= 0 )
+		return INT_MAX;
+
+	return ( threads > 1 ) ? threads - 1 : 1;
+}
+
 const float MaxTraversableHeight = StepHeight;		// max internal obstacle height that can occur between nav nodes and safely disregarded
 const float MinObstacleAreaWidth = 10.0f;			// min width of a nav area we will generate on top of an obstacle
 
+//--------------------------------------------------------------------------------------------------------------
+/**
+ * The result of trying to take one sampling step in a cardinal direction.
+ */
+struct NavSampleProbe
+{
+	Vector to;									// where the new node goes
+	Vector toNormal;
+	float obstacleHeight;
+	float obstacleStartDist;
+	float obstacleEndDist;
+	bool canMove;								// false if no node can be placed in this direction
+	bool isOnDisplacement;
+};
+
+struct NavSampleStepKey
+{
+	Vector from;
+	int dir;
+};
+
+struct NavSampleStepKeyHashFunctor
+{
+	unsigned int operator()( const NavSampleStepKey &key ) const
+	{
+		return HashBlock( &key, sizeof( key ) );
+	}
+};
+
+struct NavSampleStepKeyEqualFunctor
+{
+	bool operator()( const NavSampleStepKey &lhs, const NavSampleStepKey &rhs ) const
+	{
+		return V_memcmp( &lhs, &rhs, sizeof( NavSampleStepKey ) ) == 0;
+	}
+};
+
+struct NavSampleStepJob
+{
+	NavSampleStepKey key;
+	NavSampleProbe probe;
+};
+
+// Probes traced ahead of the sampling walk, keyed by the exact position of the node they step from.
+// A probe only depends on its inputs, so consuming one from here gives the same mesh as tracing it in place.
+static CUtlHashtable< NavSampleStepKey, NavSampleProbe, NavSampleStepKeyHashFunctor, NavSampleStepKeyEqualFunctor > s_sampleStepCache;
+static int s_sampleStepsTraced = 0;
+static int s_sampleStepsPrefetched = 0;
+
+const int MaxSampleStepCacheSize = 1 << 20;
+
 //--------------------------------------------------------------------------------------------------------------
 /**
  * Shortest path cost, paying attention to "blocked" areas
@@ -88,7 +159,7 @@ public:
 				dist = (area->GetCenter() - fromArea->GetCenter()).Length();
 			}
 
-			float cost = dist + fromArea->GetCostSoFar();
+			float cost = dist + NavAreaCostSoFar( fromArea );
 
 			return cost;
 		}
@@ -3469,8 +3540,14 @@ void CNavMesh::BeginGeneration( bool incremental )
 	// initialize seed list index
 	m_seedIdx = 0;
 
+	// throw away anything traced ahead for a previous mesh
+	s_sampleStepCache.Purge();
+	s_sampleStepsTraced = 0;
+	s_sampleStepsPrefetched = 0;
+
 	Msg( "Generating Navigation Mesh...\n" );
 	m_generationStartTime = Plat_FloatTime();
+	m_generationPhaseStartTime = m_generationStartTime;
 }
 
 
@@ -3538,6 +3615,7 @@ void CNavMesh::BeginAnalysis( bool quitWhenFinished )
 	m_bQuitWhenFinished = quitWhenFinished;
 	lastMsgTime = 0.0f;
 	m_generationStartTime = Plat_FloatTime();
+	m_generationPhaseStartTime = m_generationStartTime;
 }
 
 
@@ -3617,6 +3695,18 @@ static void HideAnalysisProgress( void )
 }
 
 
+//--------------------------------------------------------------------------------------------------------------
+/**
+ * Report that a generation phase is done, and how long it took
+ */
+void CNavMesh::EndGenerationPhase( const char *msg )
+{
+	float now = Plat_FloatTime();
+	Msg( "%s...DONE (%.2f seconds)\n", msg, now - m_generationPhaseStartTime );
+	m_generationPhaseStartTime = now;
+}
+
+
 //--------------------------------------------------------------------------------------------------------------
 /**
  * Process the auto-generation for 'maxTime' seconds. return false if generation is complete.
@@ -3648,6 +3738,10 @@ bool CNavMesh::UpdateGeneration( float maxTime )
 			}
 
 			// sampling is complete, now build nav areas
+			EndGenerationPhase( "Sampling walkable space" );
+			Msg( "  %u nodes, %d steps traced, %d taken from the parallel trace-ahead\n", CNavNode::GetListLength(), s_sampleStepsTraced, s_sampleStepsPrefetched );
+			s_sampleStepCache.Purge();
+
 			m_generationState = CREATE_AREAS_FROM_SAMPLES;
 
 			return true;
@@ -3696,6 +3790,8 @@ bool CNavMesh::UpdateGeneration( float maxTime )
 				}
 			}
 
+			EndGenerationPhase( "Creating navigation areas from sampled data" );
+
 			m_generationState = FIND_HIDING_SPOTS;
 			m_generationIndex = 0;
 			return true;
@@ -3706,10 +3802,10 @@ bool CNavMesh::UpdateGeneration( float maxTime )
 		{
 			while( m_generationIndex < TheNavAreas.Count() )
 			{
-				CNavArea *area = TheNavAreas[ m_generationIndex ];
-				++m_generationIndex;
-
-				area->ComputeHidingSpots();
+				// hiding spots are created in area order, and their cover is traced in parallel a batch of areas at a time
+				int batchCount = MIN( MAX( nav_generate_area_batch.GetInt(), 1 ), TheNavAreas.Count() - m_generationIndex );
+				ComputeHidingSpotsInParallel( TheNavAreas.Base() + m_generationIndex, batchCount );
+				m_generationIndex += batchCount;
 
 				// don't go over our time allotment
 				if( Plat_FloatTime() - startTime > maxTime )
@@ -3719,7 +3815,7 @@ bool CNavMesh::UpdateGeneration( float maxTime )
 				}
 			}
 
-			Msg( "Finding hiding spots...DONE\n" );
+			EndGenerationPhase( "Finding hiding spots" );
 
 			m_generationState = FIND_ENCOUNTER_SPOTS;
 			m_generationIndex = 0;
@@ -3744,7 +3840,7 @@ bool CNavMesh::UpdateGeneration( float maxTime )
 				}
 			}
 
-			Msg( "Finding encounter spots...DONE\n" );
+			EndGenerationPhase( "Finding encounter spots" );
 
 			m_generationState = FIND_SNIPER_SPOTS;
 			m_generationIndex = 0;
@@ -3756,10 +3852,9 @@ bool CNavMesh::UpdateGeneration( float maxTime )
 		{
 			while( m_generationIndex < TheNavAreas.Count() )
 			{
-				CNavArea *area = TheNavAreas[ m_generationIndex ];
-				++m_generationIndex;
-
-				area->ComputeSniperSpots();
+				int batchCount = MIN( MAX( nav_generate_area_batch.GetInt(), 1 ), TheNavAreas.Count() - m_generationIndex );
+				ComputeSniperSpotsInParallel( TheNavAreas.Base() + m_generationIndex, batchCount );
+				m_generationIndex += batchCount;
 
 				// don't go over our time allotment
 				if( Plat_FloatTime() - startTime > maxTime )
@@ -3769,7 +3864,7 @@ bool CNavMesh::UpdateGeneration( float maxTime )
 				}
 			}
 
-			Msg( "Finding sniper spots...DONE\n" );
+			EndGenerationPhase( "Finding sniper spots" );
 
 			m_generationState = COMPUTE_MESH_VISIBILITY;
 			m_generationIndex = 0;
@@ -3801,7 +3896,7 @@ bool CNavMesh::UpdateGeneration( float maxTime )
 
 			EndVisibilityComputations();
 
-			Msg( "Computing mesh visibility...DONE\n" );
+			EndGenerationPhase( "Computing mesh visibility" );
 
 			m_generationState = FIND_EARLIEST_OCCUPY_TIMES;
 			m_generationIndex = 0;
@@ -3826,7 +3921,7 @@ bool CNavMesh::UpdateGeneration( float maxTime )
 				}
 			}
 
-			Msg( "Finding earliest occupy times...DONE\n" );
+			EndGenerationPhase( "Finding earliest occupy times" );
 
 #ifdef NAV_ANALYZE_LIGHT_INTENSITY
 			bool shouldSkipLightComputation = ( m_generationMode == GENERATE_INCREMENTAL || engine->IsDedicatedServer() );
@@ -3864,7 +3959,7 @@ bool CNavMesh::UpdateGeneration( float maxTime )
 
 			if ( !s_unlitAreas.Count() || !host )
 			{
-				Msg( "Finding light intensity...DONE\n" );
+				EndGenerationPhase( "Finding light intensity" );
 
 				m_generationState = CUSTOM;
 				m_generationIndex = 0;
@@ -3935,7 +4030,7 @@ bool CNavMesh::UpdateGeneration( float maxTime )
 				}
 			}
 
-			Msg( "Finding light intensity...DONE\n" );
+			EndGenerationPhase( "Finding light intensity" );
 
 			m_generationState = CUSTOM;
 			m_generationIndex = 0;
@@ -3969,7 +4064,7 @@ bool CNavMesh::UpdateGeneration( float maxTime )
 			PostCustomAnalysis();
 
 			EndCustomAnalysis();
-			Msg( "Custom game-specific analysis...DONE\n" );
+			EndGenerationPhase( "Custom game-specific analysis" );
 
 			m_generationState = SAVE_NAV_MESH;
 			m_generationIndex = 0;
@@ -4339,6 +4434,375 @@ static bool IsNodeOverlapped( const Vector& pos, const Vector& offset )
 }
 
 
+//--------------------------------------------------------------------------------------------------------------
+/**
+ * Trace one "step" from the given position in a cardinal direction, and determine if and where
+ * a new node can be placed. This only depends on its inputs and on data that is constant while sampling,
+ * so it can be run ahead of time on worker threads.
+ */
+void CNavMesh::ProbeSampleStep( const Vector &from, NavDirType dir, NavSampleProbe *probe ) const
+{
+	probe->canMove = false;
+
+	// start at current node position
+	Vector pos = from;
+
+	// snap to grid
+	int cx = SnapToGrid( pos.x );
+	int cy = SnapToGrid( pos.y );
+
+	// attempt to move to adjacent node
+	switch( dir )
+	{
+		case NORTH:		cy -= GenerationStepSize; break;
+		case SOUTH:		cy += GenerationStepSize; break;
+		case EAST:		cx += GenerationStepSize; break;
+		case WEST:		cx -= GenerationStepSize; break;
+	}
+
+	pos.x = cx;
+	pos.y = cy;
+
+	// sanity check to not generate across the world for incremental generation
+	const float incrementalRange = nav_generate_incremental_range.GetFloat();
+	if ( m_generationMode == GENERATE_INCREMENTAL && incrementalRange > 0 )
+	{
+		bool inRange = false;
+		for ( int i=0; i<m_walkableSeeds.Count(); ++i )
+		{
+			const Vector &seedPos = m_walkableSeeds[i].pos;
+			if ( (seedPos - pos).IsLengthLessThan( incrementalRange ) )
+			{
+				inRange = true;
+				break;
+			}
+		}
+
+		if ( !inRange )
+		{
+			return;
+		}
+	}
+
+	if ( m_generationMode == GENERATE_SIMPLIFY )
+	{
+		if ( !m_simplifyGenerationExtent.Contains( pos ) )
+		{
+			return;
+		}
+	}
+
+	// test if we can move to new position
+	trace_t result;
+	CTraceFilterWalkableEntities filter( NULL, COLLISION_GROUP_NONE, WALK_THRU_EVERYTHING );
+	Vector to, toNormal;
+	float obstacleHeight = 0, obstacleStartDist = 0, obstacleEndDist = GenerationStepSize;
+	if ( TraceAdjacentNode( 0, from, pos, &result ) )
+	{
+		to = result.endpos;
+		toNormal = result.plane.normal;
+	}
+	else
+	{
+		// test going up ClimbUpHeight
+		bool success = false;
+		for ( float height = StepHeight; height <= ClimbUpHeight; height += 1.0f )
+		{						
+			trace_t tr;
+			Vector start( from );
+			Vector end( pos );
+			start.z += height;
+			end.z += height;
+			UTIL_TraceHull( start, end, NavTraceMins, NavTraceMaxs, GetGenerationTraceMask(), &filter, &tr );
+			if ( !tr.startsolid && tr.fraction == 1.0f )
+			{
+				if ( !StayOnFloor( &tr ) )
+				{
+					break;
+				}
+
+				to = tr.endpos;
+				toNormal = tr.plane.normal;
+
+				start = end = from;
+				end.z += height;
+				UTIL_TraceHull( start, end, NavTraceMins, NavTraceMaxs, GetGenerationTraceMask(), &filter, &tr );
+				if ( tr.fraction < 1.0f )
+				{
+					break;
+				}
+
+				// keep track of far up we had to go to find a path to the next node
+				obstacleHeight = height;
+				success = true;
+				break;
+			}
+			else
+			{
+				// Could not trace from node to node at this height, something is in the way.
+				// Trace in the other direction to see if we hit something
+				Vector vecToObstacleStart = tr.endpos - start;
+				Assert( vecToObstacleStart.LengthSqr() <= Square( GenerationStepSize ) );
+				if ( vecToObstacleStart.LengthSqr() <= Square( GenerationStepSize ) )
+				{
+					UTIL_TraceHull( end, start, NavTraceMins, NavTraceMaxs, GetGenerationTraceMask(), &filter, &tr );
+					if ( !tr.startsolid && tr.fraction < 1.0 )
+					{
+						// We hit something going the other direction.  There is some obstacle between the two nodes.
+						Vector vecToObstacleEnd = tr.endpos - start;
+						Assert( vecToObstacleEnd.LengthSqr() <= Square( GenerationStepSize ) );
+						if ( vecToObstacleEnd.LengthSqr() <= Square( GenerationStepSize )  )
+						{
+							// Remember the distances to start and end of the obstacle (with respect to the "from" node).
+							// Keep track of the last distances to obstacle as we keep increasing the height we do a trace for.
+							// If we do eventually clear the obstacle, these values will be the start and end distance to the
+							// very tip of the obstacle.
+							obstacleStartDist = vecToObstacleStart.Length();
+							obstacleEndDist = vecToObstacleEnd.Length();
+							if ( obstacleEndDist == 0 )
+							{
+								obstacleEndDist = GenerationStepSize;
+							}
+						}								
+					}
+				}
+			}
+		}
+
+		if ( !success )
+		{
+			return;
+		}
+	}
+
+	// Don't generate nodes if we spill off the end of the world onto skybox
+	if ( result.surface.flags & ( SURF_SKY|SURF_SKY2D ) )
+	{
+		return;
+	}
+
+	// If we're incrementally generating, don't overlap existing nav areas.
+	Vector testPos( to );
+	bool overlapSE = IsNodeOverlapped( testPos, Vector(  1,  1, HalfHumanHeight ) );
+	bool overlapSW = IsNodeOverlapped( testPos, Vector( -1,  1, HalfHumanHeight ) );
+	bool overlapNE = IsNodeOverlapped( testPos, Vector(  1, -1, HalfHumanHeight ) );
+	bool overlapNW = IsNodeOverlapped( testPos, Vector( -1, -1, HalfHumanHeight ) );
+	if ( overlapSE && overlapSW && overlapNE && overlapNW && m_generationMode != GENERATE_SIMPLIFY )
+	{
+		return;
+	}
+
+	int nTolerance = nav_generate_incremental_tolerance.GetInt();
+	if ( nTolerance > 0 && m_generationMode == GENERATE_INCREMENTAL )
+	{
+		bool bValid = false;
+		int zPos = to.z;
+		for ( int i=0; i<m_walkableSeeds.Count(); ++i )
+		{
+			const Vector &seedPos = m_walkableSeeds[i].pos;
+			int zMin = seedPos.z - nTolerance;
+			int zMax = seedPos.z + nTolerance;
+
+			if ( zPos >= zMin && zPos <= zMax )
+			{
+				bValid = true;
+				break;
+			}
+		}
+
+		if ( !bValid )
+			return;
+	}
+
+
+	bool isOnDisplacement = result.IsDispSurface();
+
+	if ( nav_displacement_test.GetInt() > 0 )
+	{
+		// Test for nodes under displacement surfaces.
+		// This happens during development, and is a pain because the space underneath a displacement
+		// is not 'solid'.
+		Vector start = to + Vector( 0, 0, 0 );
+		Vector end = start + Vector( 0, 0, nav_displacement_test.GetInt() );
+		UTIL_TraceHull( start, end, NavTraceMins, NavTraceMaxs, GetGenerationTraceMask(), &filter, &result );
+
+		if ( result.fraction > 0 )
+		{
+			end = start;
+			start = result.endpos;
+			UTIL_TraceHull( start, end, NavTraceMins, NavTraceMaxs, GetGenerationTraceMask(), &filter, &result );
+			if ( result.fraction < 1 )
+			{
+				// if we made it down to within StepHeight, maybe we're on a static prop
+				if ( result.endpos.z > to.z + StepHeight )
+				{
+					return;
+				}
+			}
+		}
+	}
+
+	float deltaZ = to.z - from.z;
+	// If there's an obstacle in the way and it's traversable, or the obstacle is not higher than the destination node itself minus a small epsilon
+	// (meaning the obstacle was just the height change to get to the destination node, no extra obstacle between the two), clear obstacle height
+	// and distances
+	if ( ( obstacleHeight < MaxTraversableHeight ) || ( deltaZ > ( obstacleHeight - 2.0f ) ) )
+	{
+		obstacleHeight = 0;
+		obstacleStartDist = 0;
+		obstacleEndDist = GenerationStepSize;
+	}
+
+	probe->to = to;
+	probe->toNormal = toNormal;
+	probe->obstacleHeight = obstacleHeight;
+	probe->obstacleStartDist = obstacleStartDist;
+	probe->obstacleEndDist = obstacleEndDist;
+	probe->isOnDisplacement = isOnDisplacement;
+	probe->canMove = true;
+}
+
+
+//--------------------------------------------------------------------------------------------------------------
+void CNavMesh::ProbeSampleStepJob( NavSampleStepJob &job )
+{
+	ProbeSampleStep( job.key.from, (NavDirType)job.key.dir, &job.probe );
+}
+
+
+//--------------------------------------------------------------------------------------------------------------
+/**
+ * Trace ahead of the sampling walk. Starting at the given node, expand breadth-first through the
+ * positions new nodes will most likely be created at, tracing each ring of steps in parallel,
+ * until a batch worth of steps has been traced.
+ */
+void CNavMesh::PrefetchSampleSteps( CNavNode *node )
+{
+	struct Frontier
+	{
+		Vector pos;
+		NavDirType arrivalDir;
+	};
+
+	CUtlVector< Frontier > frontier, nextFrontier;
+	CUtlVector< NavSampleStepJob > jobs;
+
+	Frontier start;
+	start.pos = *node->GetPosition();
+	start.arrivalDir = NUM_DIRECTIONS;
+	frontier.AddToTail( start );
+
+	const int batchSize = MAX( nav_generate_sample_batch.GetInt(), 1 );
+	int traced = 0;
+
+	while( frontier.Count() && traced < batchSize )
+	{
+		jobs.RemoveAll();
+
+		FOR_EACH_VEC( frontier, fit )
+		{
+			const Frontier &f = frontier[ fit ];
+
+			for( int dir = NORTH; dir < NUM_DIRECTIONS; dir++ )
+			{
+				if ( f.arrivalDir == NUM_DIRECTIONS )
+				{
+					// the real node - only its unsearched directions will be needed
+					if ( node->HasVisited( (NavDirType)dir ) )
+						continue;
+				}
+				else if ( dir == OppositeDirection( f.arrivalDir ) )
+				{
+					// stepping back is usually marked as visited by the connection that got us here
+					continue;
+				}
+
+				NavSampleStepJob job;
+				job.key.from = f.pos;
+				job.key.dir = dir;
+
+				if ( s_sampleStepCache.Find( job.key ) != s_sampleStepCache.InvalidHandle() )
+					continue;
+
+				// reserve the slot so a position reached twice in this ring is only traced once
+				s_sampleStepCache.Insert( job.key );
+				jobs.AddToTail( job );
+			}
+		}
+
+		ParallelProcess< NavSampleStepJob, CNavMesh, CNavMesh >( "CNavMesh::PrefetchSampleSteps", jobs.Base(), jobs.Count(), this, &CNavMesh::ProbeSampleStepJob, NULL, NULL, NavGenerationMaxParallel() );
+		traced += jobs.Count();
+
+		nextFrontier.RemoveAll();
+		FOR_EACH_VEC( jobs, jit )
+		{
+			const NavSampleStepJob &job = jobs[ jit ];
+			s_sampleStepCache.Element( s_sampleStepCache.Find( job.key ) ) = job.probe;
+
+			// keep going from where the walk will create new nodes
+			if ( job.probe.canMove && CNavNode::GetNode( job.probe.to ) == NULL )
+			{
+				Frontier next;
+				next.pos = job.probe.to;
+				next.arrivalDir = (NavDirType)job.key.dir;
+				nextFrontier.AddToTail( next );
+			}
+		}
+
+		frontier.Swap( nextFrontier );
+	}
+
+	s_sampleStepsTraced += traced;
+}
+
+
+//--------------------------------------------------------------------------------------------------------------
+/**
+ * Return the result of stepping from the given node in the given direction
+ */
+void CNavMesh::GetSampleStep( CNavNode *node, NavDirType dir, NavSampleProbe *probe )
+{
+	if ( NavGenerationMaxParallel() == 1 )
+	{
+		// serial generation - just trace it
+		ProbeSampleStep( *node->GetPosition(), dir, probe );
+		++s_sampleStepsTraced;
+		return;
+	}
+
+	NavSampleStepKey key;
+	key.from = *node->GetPosition();
+	key.dir = dir;
+
+	UtlHashHandle_t h = s_sampleStepCache.Find( key );
+	if ( h == s_sampleStepCache.InvalidHandle() )
+	{
+		// speculative probes that were never used pile up - throwing them away is always safe
+		if ( s_sampleStepCache.Count() > MaxSampleStepCacheSize )
+		{
+			s_sampleStepCache.Purge();
+		}
+
+		PrefetchSampleSteps( node );
+		h = s_sampleStepCache.Find( key );
+	}
+	else
+	{
+		++s_sampleStepsPrefetched;
+	}
+
+	if ( h == s_sampleStepCache.InvalidHandle() )
+	{
+		ProbeSampleStep( *node->GetPosition(), dir, probe );
+		++s_sampleStepsTraced;
+		return;
+	}
+
+	*probe = s_sampleStepCache.Element( h );
+	s_sampleStepCache.Remove( key );
+}
+
+
 //--------------------------------------------------------------------------------------------------------------
 /**
  * Search the world and build a map of possible movements.
@@ -4396,225 +4860,23 @@ bool CNavMesh::SampleStep( void )
 			if (!m_currentNode->HasVisited( (NavDirType)dir ))
 			{
 				// have not searched in this direction yet
-
-				// start at current node position
-				Vector pos = *m_currentNode->GetPosition();
-
-				// snap to grid
-				int cx = SnapToGrid( pos.x );
-				int cy = SnapToGrid( pos.y );
-
-				// attempt to move to adjacent node
-				switch( dir )
-				{
-					case NORTH:		cy -= GenerationStepSize; break;
-					case SOUTH:		cy += GenerationStepSize; break;
-					case EAST:		cx += GenerationStepSize; break;
-					case WEST:		cx -= GenerationStepSize; break;
-				}
-
-				pos.x = cx;
-				pos.y = cy;
-
 				m_generationDir = (NavDirType)dir;
 
+				// test if we can move to the adjacent node
+				NavSampleProbe probe;
+				GetSampleStep( m_currentNode, m_generationDir, &probe );
+
 				// mark direction as visited
 				m_currentNode->MarkAsVisited( m_generationDir );
 
-				// sanity check to not generate across the world for incremental generation
-				const float incrementalRange = nav_generate_incremental_range.GetFloat();
-				if ( m_generationMode == GENERATE_INCREMENTAL && incrementalRange > 0 )
-				{
-					bool inRange = false;
-					for ( int i=0; i<m_walkableSeeds.Count(); ++i )
-					{
-						const Vector &seedPos = m_walkableSeeds[i].pos;
-						if ( (seedPos - pos).IsLengthLessThan( incrementalRange ) )
-						{
-							inRange = true;
-							break;
-						}
-					}
-
-					if ( !inRange )
-					{
-						return true;
-					}
-				}
-
-				if ( m_generationMode == GENERATE_SIMPLIFY )
-				{
-					if ( !m_simplifyGenerationExtent.Contains( pos ) )
-					{
-						return true;
-					}
-				}
-
-				// test if we can move to new position
-				trace_t result;
-				Vector from( *m_currentNode->GetPosition() );
-				CTraceFilterWalkableEntities filter( NULL, COLLISION_GROUP_NONE, WALK_THRU_EVERYTHING );
-				Vector to, toNormal;
-				float obstacleHeight = 0, obstacleStartDist = 0, obstacleEndDist = GenerationStepSize;
-				if ( TraceAdjacentNode( 0, from, pos, &result ) )
-				{
-					to = result.endpos;
-					toNormal = result.plane.normal;
-				}
-				else
-				{
-					// test going up ClimbUpHeight
-					bool success = false;
-					for ( float height = StepHeight; height <= ClimbUpHeight; height += 1.0f )
-					{						
-						trace_t tr;
-						Vector start( from );
-						Vector end( pos );
-						start.z += height;
-						end.z += height;
-						UTIL_TraceHull( start, end, NavTraceMins, NavTraceMaxs, GetGenerationTraceMask(), &filter, &tr );
-						if ( !tr.startsolid && tr.fraction == 1.0f )
-						{
-							if ( !StayOnFloor( &tr ) )
-							{
-								break;
-							}
-
-							to = tr.endpos;
-							toNormal = tr.plane.normal;
-
-							start = end = from;
-							end.z += height;
-							UTIL_TraceHull( start, end, NavTraceMins, NavTraceMaxs, GetGenerationTraceMask(), &filter, &tr );
-							if ( tr.fraction < 1.0f )
-							{
-								break;
-							}
-
-							// keep track of far up we had to go to find a path to the next node
-							obstacleHeight = height;
-							success = true;
-							break;
-						}
-						else
-						{
-							// Could not trace from node to node at this height, something is in the way.
-							// Trace in the other direction to see if we hit something
-							Vector vecToObstacleStart = tr.endpos - start;
-							Assert( vecToObstacleStart.LengthSqr() <= Square( GenerationStepSize ) );
-							if ( vecToObstacleStart.LengthSqr() <= Square( GenerationStepSize ) )
-							{
-								UTIL_TraceHull( end, start, NavTraceMins, NavTraceMaxs, GetGenerationTraceMask(), &filter, &tr );
-								if ( !tr.startsolid && tr.fraction < 1.0 )
-								{
-									// We hit something going the other direction.  There is some obstacle between the two nodes.
-									Vector vecToObstacleEnd = tr.endpos - start;
-									Assert( vecToObstacleEnd.LengthSqr() <= Square( GenerationStepSize ) );
-									if ( vecToObstacleEnd.LengthSqr() <= Square( GenerationStepSize )  )
-									{
-										// Remember the distances to start and end of the obstacle (with respect to the "from" node).
-										// Keep track of the last distances to obstacle as we keep increasing the height we do a trace for.
-										// If we do eventually clear the obstacle, these values will be the start and end distance to the
-										// very tip of the obstacle.
-										obstacleStartDist = vecToObstacleStart.Length();
-										obstacleEndDist = vecToObstacleEnd.Length();
-										if ( obstacleEndDist == 0 )
-										{
-											obstacleEndDist = GenerationStepSize;
-										}
-									}								
-								}
-							}
-						}
-					}
-
-					if ( !success )
-					{
-						return true;
-					}
-				}
-
-				// Don't generate nodes if we spill off the end of the world onto skybox
-				if ( result.surface.flags & ( SURF_SKY|SURF_SKY2D ) )
-				{
-					return true;
-				}
-
-				// If we're incrementally generating, don't overlap existing nav areas.
-				Vector testPos( to );
-				bool overlapSE = IsNodeOverlapped( testPos, Vector(  1,  1, HalfHumanHeight ) );
-				bool overlapSW = IsNodeOverlapped( testPos, Vector( -1,  1, HalfHumanHeight ) );
-				bool overlapNE = IsNodeOverlapped( testPos, Vector(  1, -1, HalfHumanHeight ) );
-				bool overlapNW = IsNodeOverlapped( testPos, Vector( -1, -1, HalfHumanHeight ) );
-				if ( overlapSE && overlapSW && overlapNE && overlapNW && m_generationMode != GENERATE_SIMPLIFY )
+				if ( !probe.canMove )
 				{
 					return true;
 				}
 
-				int nTolerance = nav_generate_incremental_tolerance.GetInt();
-				if ( nTolerance > 0 && m_generationMode == GENERATE_INCREMENTAL )
-				{
-					bool bValid = false;
-					int zPos = to.z;
-					for ( int i=0; i<m_walkableSeeds.Count(); ++i )
-					{
-						const Vector &seedPos = m_walkableSeeds[i].pos;
-						int zMin = seedPos.z - nTolerance;
-						int zMax = seedPos.z + nTolerance;
-
-						if ( zPos >= zMin && zPos <= zMax )
-						{
-							bValid = true;
-							break;
-						}
-					}
-
-					if ( !bValid )
-						return true;
-				}
-
-
-				bool isOnDisplacement = result.IsDispSurface();
-
-				if ( nav_displacement_test.GetInt() > 0 )
-				{
-					// Test for nodes under displacement surfaces.
-					// This happens during development, and is a pain because the space underneath a displacement
-					// is not 'solid'.
-					Vector start = to + Vector( 0, 0, 0 );
-					Vector end = start + Vector( 0, 0, nav_displacement_test.GetInt() );
-					UTIL_TraceHull( start, end, NavTraceMins, NavTraceMaxs, GetGenerationTraceMask(), &filter, &result );
-
-					if ( result.fraction > 0 )
-					{
-						end = start;
-						start = result.endpos;
-						UTIL_TraceHull( start, end, NavTraceMins, NavTraceMaxs, GetGenerationTraceMask(), &filter, &result );
-						if ( result.fraction < 1 )
-						{
-							// if we made it down to within StepHeight, maybe we're on a static prop
-							if ( result.endpos.z > to.z + StepHeight )
-							{
-								return true;
-							}
-						}
-					}
-				}
-
-				float deltaZ = to.z - m_currentNode->GetPosition()->z;
-				// If there's an obstacle in the way and it's traversable, or the obstacle is not higher than the destination node itself minus a small epsilon
-				// (meaning the obstacle was just the height change to get to the destination node, no extra obstacle between the two), clear obstacle height
-				// and distances
-				if ( ( obstacleHeight < MaxTraversableHeight ) || ( deltaZ > ( obstacleHeight - 2.0f ) ) )
-				{
-					obstacleHeight = 0;
-					obstacleStartDist = 0;
-					obstacleEndDist = GenerationStepSize;
-				}
-
 				// we can move here
 				// create a new navigation node, and update current node pointer
-				AddNode( to, toNormal, m_generationDir, m_currentNode, isOnDisplacement, obstacleHeight, obstacleStartDist, obstacleEndDist );
+				AddNode( probe.to, probe.toNormal, m_generationDir, m_currentNode, probe.isOnDisplacement, probe.obstacleHeight, probe.obstacleStartDist, probe.obstacleEndDist );
 
 				return true;
 			}
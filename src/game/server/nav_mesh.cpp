@@ -46,8 +46,11 @@ ConVar nav_show_func_nav_avoid( "nav_show_func_nav_avoid", "0", FCVAR_GAMEDLL |
 ConVar nav_show_func_nav_prefer( "nav_show_func_nav_prefer", "0", FCVAR_GAMEDLL | FCVAR_CHEAT, "Show areas of designer-placed bot preference due to func_nav_prefer entities" );
 ConVar nav_show_func_nav_prerequisite( "nav_show_func_nav_prerequisite", "0", FCVAR_GAMEDLL | FCVAR_CHEAT, "Show areas of designer-placed bot preference due to func_nav_prerequisite entities" );
 ConVar nav_max_vis_delta_list_length( "nav_max_vis_delta_list_length", "64", FCVAR_CHEAT );
+ConVar nav_update_geometry( "nav_update_geometry", "1", FCVAR_GAMEDLL | FCVAR_CHEAT, "Re-test the blocked status of nav areas under brushes that move, break, or toggle solidity." );
+ConVar nav_update_geometry_budget( "nav_update_geometry_budget", "1", FCVAR_GAMEDLL | FCVAR_CHEAT, "Milliseconds per frame spent re-testing nav areas under changed brushes." );
 
 extern ConVar nav_show_potentially_visible;
+extern ConVar nav_debug_blocked;
 
 #ifdef STAGING_ONLY
 int g_DebugPathfindCounter = 0;
@@ -161,6 +164,9 @@ void CNavMesh::DestroyNavigationMesh( bool incremental )
 	m_blockedAreas.RemoveAll();
 	m_avoidanceObstacleAreas.RemoveAll();
 	m_transientAreas.RemoveAll();
+	m_geometryChanges.RemoveAll();
+	m_geometryChangeAreas.RemoveAll();
+	m_geometryChangeBlocked.RemoveAll();
 
 	if ( !incremental )
 	{
@@ -265,6 +271,7 @@ void CNavMesh::Update( void )
 		m_updateBlockedAreasTimer.Invalidate();
 	}
 
+	UpdateGeometryChanges();
 	UpdateBlockedAreas();
 	UpdateAvoidanceObstacleAreas();
 
@@ -418,8 +425,16 @@ void CNavMesh::FireGameEvent( IGameEvent *gameEvent )
 
 	if ( FStrEq( gameEvent->GetName(), "break_prop" ) || FStrEq( gameEvent->GetName(), "break_breakable" ) )
 	{
-		CheckAreasOverlappingBreakable collector( UTIL_EntityByIndex( gameEvent->GetInt( "entindex" ) ) );
-		ForAllAreas( collector );
+		CBaseEntity *broken = UTIL_EntityByIndex( gameEvent->GetInt( "entindex" ) );
+		if ( nav_update_geometry.GetBool() )
+		{
+			OnBreakableBroken( broken );
+		}
+		else if ( broken )
+		{
+			CheckAreasOverlappingBreakable collector( broken );
+			ForAllAreas( collector );
+		}
 	}
 
 	if ( FStrEq( gameEvent->GetName(), "round_start" ) || FStrEq( gameEvent->GetName(), "teamplay_round_start" ) )
@@ -564,6 +579,16 @@ void CNavMesh::RemoveNavArea( CNavArea *area )
 	m_avoidanceObstacleAreas.FindAndRemove( area );
 	m_blockedAreas.FindAndRemove( area );
 
+	int geometryChangeIdx = m_geometryChangeAreas.Find( area );
+	if ( geometryChangeIdx != m_geometryChangeAreas.InvalidIndex() )
+	{
+		m_geometryChangeAreas.Remove( geometryChangeIdx );
+		if ( geometryChangeIdx < m_geometryChangeBlocked.Count() )
+		{
+			m_geometryChangeBlocked.Remove( geometryChangeIdx );
+		}
+	}
+
 	--m_areaCount;
 }
 
@@ -3152,6 +3177,167 @@ void CNavMesh::UpdateBlockedAreas( void )
 }
 
 
+//--------------------------------------------------------------------------------------------------------
+// invoked when a breakable is broken
+void CNavMesh::OnBreakableBroken( CBaseEntity *broken )
+{
+	QueueGeometryChange( broken, true );
+}
+
+
+//--------------------------------------------------------------------------------------------------------
+// invoked when a brush entity moves, or is toggled solid/non-solid
+void CNavMesh::OnBrushChanged( CBaseEntity *brush )
+{
+	QueueGeometryChange( brush, false );
+}
+
+
+//--------------------------------------------------------------------------------------------------------
+/**
+ * Remember the volume a brush occupies, so the areas under it can be re-tested once it comes to rest.
+ * Repeated changes to the same brush are merged into one.
+ */
+void CNavMesh::QueueGeometryChange( CBaseEntity *entity, bool isBroken )
+{
+	if ( !entity || !nav_update_geometry.GetBool() || IsGenerating() || !IsLoaded() )
+	{
+		return;
+	}
+
+	Extent extent;
+	extent.Init( entity );
+
+	// the change at the head of the queue is already being tested, so it can't grow
+	int first = ( m_geometryChangeAreas.Count() > 0 ) ? 1 : 0;
+	for ( int it = first; it < m_geometryChanges.Count(); ++it )
+	{
+		GeometryChange &change = m_geometryChanges[ it ];
+		if ( change.entity == entity )
+		{
+			change.extent.Encompass( extent );
+			change.isBroken |= isBroken;
+			return;
+		}
+	}
+
+	int idx = m_geometryChanges.AddToTail();
+	m_geometryChanges[ idx ].entity = entity;
+	m_geometryChanges[ idx ].extent = extent;
+	m_geometryChanges[ idx ].isBroken = isBroken;
+}
+
+
+//--------------------------------------------------------------------------------------------------------
+/**
+ * Re-test the areas under the first changed brush that has come to rest.
+ * The traces are spread over frames to stay within nav_update_geometry_budget, and the
+ * results are applied together so bots never see half of a change.
+ */
+void CNavMesh::UpdateGeometryChanges( void )
+{
+	VPROF( "CNavMesh::UpdateGeometryChanges" );
+
+	if ( m_geometryChanges.Count() == 0 )
+	{
+		return;
+	}
+
+	if ( m_geometryChangeAreas.Count() == 0 )
+	{
+		// pick the first brush that is no longer moving
+		int changeIdx;
+		for ( changeIdx = 0; changeIdx < m_geometryChanges.Count(); ++changeIdx )
+		{
+			CBaseEntity *entity = m_geometryChanges[ changeIdx ].entity;
+			if ( entity == NULL || !entity->IsMoving() )
+			{
+				break;
+			}
+		}
+
+		if ( changeIdx == m_geometryChanges.Count() )
+		{
+			return;
+		}
+
+		GeometryChange &change = m_geometryChanges[ changeIdx ];
+		if ( change.entity != NULL )
+		{
+			// include where the brush came to rest
+			Extent extent;
+			extent.Init( change.entity );
+			change.extent.Encompass( extent );
+		}
+
+		const float expand = 10.0f;
+		change.extent.lo -= Vector( expand, expand, expand );
+		change.extent.hi += Vector( expand, expand, expand );
+
+		CollectAreasOverlappingExtent( change.extent, &m_geometryChangeAreas );
+		m_geometryChangeBlocked.RemoveAll();
+		m_geometryChangeBlocked.EnsureCapacity( m_geometryChangeAreas.Count() );
+
+		// move the change being processed to the head of the queue
+		GeometryChange current = change;
+		m_geometryChanges.Remove( changeIdx );
+		m_geometryChanges.InsertBefore( 0, current );
+
+		if ( m_geometryChangeAreas.Count() == 0 )
+		{
+			m_geometryChanges.Remove( 0 );
+			return;
+		}
+	}
+
+	const GeometryChange &change = m_geometryChanges[ 0 ];
+	CBaseEntity *ignore = change.isBroken ? change.entity.Get() : NULL;
+
+	const double deadline = Plat_FloatTime() + nav_update_geometry_budget.GetFloat() / 1000.0f;
+	while ( m_geometryChangeBlocked.Count() < m_geometryChangeAreas.Count() )
+	{
+		CNavArea *area = m_geometryChangeAreas[ m_geometryChangeBlocked.Count() ];
+		m_geometryChangeBlocked.AddToTail( area->IsBlockedByGeometry() || !area->HasFloor( ignore ) );
+
+		if ( Plat_FloatTime() > deadline )
+		{
+			return;
+		}
+	}
+
+	// every area has been tested - apply all of the results at once
+	int changedCount = 0;
+	FOR_EACH_VEC( m_geometryChangeAreas, it )
+	{
+		CNavArea *area = m_geometryChangeAreas[ it ];
+		if ( area->HasAttributes( NAV_MESH_NAV_BLOCKER ) )
+		{
+			// func_nav_blocker owns this area's blocked status
+			continue;
+		}
+
+		bool wasBlocked = area->IsBlocked( TEAM_ANY );
+		area->ApplyBlockedTest( m_geometryChangeBlocked[ it ] );
+		if ( wasBlocked != area->IsBlocked( TEAM_ANY ) )
+		{
+			++changedCount;
+		}
+	}
+
+	if ( nav_debug_blocked.GetBool() )
+	{
+		CBaseEntity *entity = change.entity;
+		DevMsg( "Nav geometry change from %s: %d areas re-tested, %d changed blocked status\n",
+			entity ? entity->GetDebugName() : "(removed entity)", m_geometryChangeAreas.Count(), changedCount );
+		NDebugOverlay::Box( vec3_origin, change.extent.lo, change.extent.hi, 255, 255, 0, 32, 3.0f );
+	}
+
+	m_geometryChanges.Remove( 0 );
+	m_geometryChangeAreas.RemoveAll();
+	m_geometryChangeBlocked.RemoveAll();
+}
+
+
 //--------------------------------------------------------------------------------------------------------
 void CNavMesh::RegisterAvoidanceObstacle( INavAvoidanceObstacle *obstruction )
 {
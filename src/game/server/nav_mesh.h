@@ -31,12 +31,16 @@
 class CNavArea;
 class CBaseEntity; 
 class CBreakable;
+struct NavSampleProbe;
+struct NavSampleStepJob;
 
 extern ConVar nav_edit;
 extern ConVar nav_quicksave;
 extern ConVar nav_show_approach_points;
 extern ConVar nav_show_danger;
 
+extern int NavGenerationMaxParallel( void );				// max jobs to queue for the parallel phases of mesh generation, from nav_generate_threads
+
 //--------------------------------------------------------------------------------------------------------
 class NavAreaCollector
 {
@@ -298,7 +302,8 @@ public:
 	virtual void OnRoundRestart( void );								// invoked when a game round restarts
 	virtual void OnRoundRestartPreEntity( void );						// invoked when a game round restarts, but before entities are deleted and recreated
 	virtual void OnBreakableCreated( CBaseEntity *breakable ) { }		// invoked when a breakable is created
-	virtual void OnBreakableBroken( CBaseEntity *broken ) { }			// invoked when a breakable is broken
+	virtual void OnBreakableBroken( CBaseEntity *broken );				// invoked when a breakable is broken
+	virtual void OnBrushChanged( CBaseEntity *brush );					// invoked when a brush entity moves, or is toggled solid/non-solid
 	virtual void OnAreaBlocked( CNavArea *area );						// invoked when the area becomes blocked
 	virtual void OnAreaUnblocked( CNavArea *area );						// invoked when the area becomes un-blocked
 	virtual void OnAvoidanceObstacleEnteredArea( CNavArea *area );					// invoked when the area becomes obstructed
@@ -439,6 +444,7 @@ public:
 	void CommandNavSaveSelected( const CCommand &args );				// Save selected set to disk
 	void CommandNavMergeMesh( const CCommand &args );					// Merge a saved selected set into the current mesh
 	void CommandNavMarkWalkable( void );
+	void CommandNavFileStats( void ) const;								// report the size of the mesh in each nav file version, and its resident memory
 
 	void AddToDragSelectionSet( CNavArea *pArea );
 	void RemoveFromDragSelectionSet( CNavArea *pArea );
@@ -1163,6 +1169,10 @@ private:
 	void DestroyLadders( void );
 
 	bool SampleStep( void );									// sample the walkable areas of the map
+	void ProbeSampleStep( const Vector &from, NavDirType dir, NavSampleProbe *probe ) const;	// trace one step from 'from' - pure function of its inputs, safe to run on worker threads
+	void GetSampleStep( CNavNode *node, NavDirType dir, NavSampleProbe *probe );		// return the probe for this step, computing a parallel batch of speculative probes if needed
+	void PrefetchSampleSteps( CNavNode *node );				// compute the probes of the unsampled space around 'node' in parallel
+	void ProbeSampleStepJob( NavSampleStepJob &job );
 	void CreateNavAreasFromNodes( void );						// cover all of the sampled nodes with nav areas
 
 	bool TestArea( CNavNode *node, int width, int height );		// check if an area of size (width, height) can fit, starting from node as upper left corner
@@ -1219,6 +1229,8 @@ private:
 	int m_sampleTick;											// counter for displaying pseudo-progress while sampling walkable space
 	bool m_bQuitWhenFinished;
 	float m_generationStartTime;
+	float m_generationPhaseStartTime;							// when the current generation phase began, for per-phase timing
+	void EndGenerationPhase( const char *msg );				// report a generation phase as done along with how long it took
 	Extent m_simplifyGenerationExtent;
 
 	char *m_spawnName;											// name of player spawn entity, used to initiate sampling
@@ -1244,6 +1256,18 @@ private:
 	void UpdateBlockedAreas( void );
 	CUtlVector< CNavArea * > m_blockedAreas;
 
+	struct GeometryChange
+	{
+		EHANDLE entity;											// the brush that changed, NULL once it has been removed
+		Extent extent;											// union of every volume the brush occupied since the change was queued
+		bool isBroken;											// the brush is going away - ignore it when looking for floors
+	};
+	void QueueGeometryChange( CBaseEntity *entity, bool isBroken );
+	void UpdateGeometryChanges( void );							// re-test walkability of areas under changed brushes, within nav_update_geometry_budget
+	CUtlVector< GeometryChange > m_geometryChanges;
+	CUtlVector< CNavArea * > m_geometryChangeAreas;			// areas overlapping the change being processed
+	CUtlVector< bool > m_geometryChangeBlocked;				// result of IsBlockedByGeometry() for each of m_geometryChangeAreas tested so far
+
 	CUtlVector< int > m_storedSelectedSet;						// "Stored" selected set, so we can do some editing and then restore the old selected set.  Done by ID, so we don't have to worry about split/delete/etc.
 
 	void BeginVisibilityComputations( void );
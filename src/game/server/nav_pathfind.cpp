@@ -0,0 +1,337 @@
+//========= Copyright Valve Corporation, All rights reserved. ============//
+//
+// Purpose: 
+//
+// $NoKeywords: $
+//
+//=============================================================================//
+// nav_pathfind.cpp
+// Reentrant path-finding over the Navigation Mesh
+
+#include "cbase.h"
+
+#include "tier0/vprof.h"
+#include "tier0/fasttimer.h"
+#include "vstdlib/jobthread.h"
+#include "vstdlib/random.h"
+
+#include "nav_mesh.h"
+#include "nav_pathfind.h"
+
+// memdbgon must be the last include file in a .cpp file!!!
+#include "tier0/memdbgon.h"
+
+
+CTHREADLOCALPTR( CNavAreaSearch ) CNavAreaSearch::s_activeSearch;
+
+
+//--------------------------------------------------------------------------------------------------------------
+CNavAreaSearch::CNavAreaSearch( void )
+{
+	m_generation = 0;
+	m_status = SEARCH_FAILED;
+	m_startArea = NULL;
+	m_goalArea = NULL;
+	m_endArea = NULL;
+	m_closestArea = NULL;
+	m_goalPos = vec3_origin;
+	m_hasGoalPos = false;
+	m_closestAreaDist = 0.0f;
+	m_maxPathLength = 0.0f;
+	m_teamID = TEAM_ANY;
+	m_ignoreNavBlockers = false;
+	m_stepCount = 0;
+}
+
+
+//--------------------------------------------------------------------------------------------------------------
+/**
+ * Invalidate all nodes of the previous search in O(1)
+ */
+void CNavAreaSearch::NewGeneration( void )
+{
+	m_openHeap.RemoveAll();
+
+	++m_generation;
+	if ( m_generation == 0 )
+	{
+		// wrapped - stale nodes could now look current
+		for( int i=0; i<m_nodes.Count(); ++i )
+		{
+			m_nodes[i].generation = 0;
+		}
+		m_generation = 1;
+	}
+
+	// area IDs are compacted on load, so this is usually enough to never grow mid-search
+	if ( m_nodes.Count() <= TheNavAreas.Count() )
+	{
+		int oldCount = m_nodes.Count();
+		m_nodes.SetCount( TheNavAreas.Count() + 1 );
+		for( int i=oldCount; i<m_nodes.Count(); ++i )
+		{
+			m_nodes[i].generation = 0;
+		}
+	}
+}
+
+
+//--------------------------------------------------------------------------------------------------------------
+CNavAreaSearch::SearchNode *CNavAreaSearch::VisitNode( CNavArea *area )
+{
+	unsigned int id = area->GetID();
+	if ( id >= (unsigned int)m_nodes.Count() )
+	{
+		int oldCount = m_nodes.Count();
+		m_nodes.SetCount( id + 1 );
+		for( int i=oldCount; i<m_nodes.Count(); ++i )
+		{
+			m_nodes[i].generation = 0;
+		}
+	}
+
+	SearchNode *node = &m_nodes[ id ];
+	if ( node->generation != m_generation )
+	{
+		node->area = area;
+		node->parent = NULL;
+		node->parentHow = NUM_TRAVERSE_TYPES;
+		node->costSoFar = 0.0f;
+		node->totalCost = 0.0f;
+		node->pathLengthSoFar = 0.0f;
+		node->heapIndex = -1;
+		node->generation = m_generation;
+	}
+
+	return node;
+}
+
+
+//--------------------------------------------------------------------------------------------------------------
+void CNavAreaSearch::HeapPush( SearchNode *node )
+{
+	Assert( node->heapIndex < 0 );
+	node->heapIndex = m_openHeap.AddToTail( node->area->GetID() );
+	HeapSiftUp( node->heapIndex );
+}
+
+
+//--------------------------------------------------------------------------------------------------------------
+CNavAreaSearch::SearchNode *CNavAreaSearch::HeapPop( void )
+{
+	Assert( !IsHeapEmpty() );
+
+	SearchNode *top = &m_nodes[ m_openHeap[0] ];
+	top->heapIndex = -1;
+
+	int last = m_openHeap.Count() - 1;
+	if ( last > 0 )
+	{
+		m_openHeap[0] = m_openHeap[ last ];
+		m_nodes[ m_openHeap[0] ].heapIndex = 0;
+		m_openHeap.RemoveMultipleFromTail( 1 );
+		HeapSiftDown( 0 );
+	}
+	else
+	{
+		m_openHeap.RemoveAll();
+	}
+
+	return top;
+}
+
+
+//--------------------------------------------------------------------------------------------------------------
+void CNavAreaSearch::HeapSiftUp( int index )
+{
+	unsigned int id = m_openHeap[ index ];
+	float cost = m_nodes[ id ].totalCost;
+
+	while( index > 0 )
+	{
+		int parent = ( index - 1 ) / 2;
+		unsigned int parentID = m_openHeap[ parent ];
+		if ( m_nodes[ parentID ].totalCost <= cost )
+			break;
+
+		m_openHeap[ index ] = parentID;
+		m_nodes[ parentID ].heapIndex = index;
+		index = parent;
+	}
+
+	m_openHeap[ index ] = id;
+	m_nodes[ id ].heapIndex = index;
+}
+
+
+//--------------------------------------------------------------------------------------------------------------
+void CNavAreaSearch::HeapSiftDown( int index )
+{
+	int count = m_openHeap.Count();
+	unsigned int id = m_openHeap[ index ];
+	float cost = m_nodes[ id ].totalCost;
+
+	while( true )
+	{
+		int child = 2 * index + 1;
+		if ( child >= count )
+			break;
+
+		if ( child + 1 < count && m_nodes[ m_openHeap[ child + 1 ] ].totalCost < m_nodes[ m_openHeap[ child ] ].totalCost )
+		{
+			++child;
+		}
+
+		unsigned int childID = m_openHeap[ child ];
+		if ( cost <= m_nodes[ childID ].totalCost )
+			break;
+
+		m_openHeap[ index ] = childID;
+		m_nodes[ childID ].heapIndex = index;
+		index = child;
+	}
+
+	m_openHeap[ index ] = id;
+	m_nodes[ id ].heapIndex = index;
+}
+
+
+//--------------------------------------------------------------------------------------------------------------
+float CNavAreaSearch::GetTravelDistance( const CNavArea *area ) const
+{
+	if ( !IsVisited( area ) )
+		return -1.0f;
+
+	float distance = 0.0f;
+	for( const CNavArea *parent = GetParent( area ); parent; area = parent, parent = GetParent( area ) )
+	{
+		distance += ( area->GetCenter() - parent->GetCenter() ).Length();
+	}
+
+	return distance;
+}
+
+
+//--------------------------------------------------------------------------------------------------------------
+//--------------------------------------------------------------------------------------------------------------
+/**
+ * Benchmark path-finding throughput over the loaded mesh
+ */
+struct NavPathBenchPair_t
+{
+	CNavArea *startArea;
+	CNavArea *goalArea;
+	bool legacyFound;
+	float legacyCost;
+	bool found;
+	float cost;
+};
+
+struct NavPathBenchBatch_t
+{
+	NavPathBenchPair_t *pairs;
+	int count;
+	int steps;
+};
+
+static void NavPathBenchRunBatch( NavPathBenchBatch_t &batch )
+{
+	CNavAreaSearch search;
+	ShortestPathCost costFunc;
+
+	batch.steps = 0;
+	for( int i=0; i<batch.count; ++i )
+	{
+		NavPathBenchPair_t &pair = batch.pairs[i];
+		pair.found = search.BuildPath( pair.startArea, pair.goalArea, NULL, costFunc );
+		pair.cost = pair.found ? search.GetCostSoFar( pair.goalArea ) : 0.0f;
+		batch.steps += search.GetStepCount();
+	}
+}
+
+CON_COMMAND_F( nav_bench_pathfind, "Measures path-finding throughput between random pairs of areas. Arguments: [pair count] [thread batches]", FCVAR_CHEAT )
+{
+	if ( !UTIL_IsCommandIssuedByServerAdmin() )
+		return;
+
+	int areaCount = TheNavAreas.Count();
+	if ( areaCount < 2 )
+	{
+		Msg( "No navigation mesh loaded.\n" );
+		return;
+	}
+
+	int pairCount = ( args.ArgC() > 1 ) ? MAX( 1, atoi( args[1] ) ) : 1000;
+	int batchCount = ( args.ArgC() > 2 ) ? clamp( atoi( args[2] ), 1, pairCount ) : 8;
+
+	// fixed seed so runs on the same mesh are comparable
+	CUniformRandomStream random;
+	random.SetSeed( 1234 );
+
+	CUtlVector< NavPathBenchPair_t > pairs;
+	pairs.SetCount( pairCount );
+	for( int i=0; i<pairCount; ++i )
+	{
+		pairs[i].startArea = TheNavAreas[ random.RandomInt( 0, areaCount-1 ) ];
+		pairs[i].goalArea = TheNavAreas[ random.RandomInt( 0, areaCount-1 ) ];
+	}
+
+	ShortestPathCost costFunc;
+	CFastTimer timer;
+
+	// legacy per-area search
+	timer.Start();
+	for( int i=0; i<pairCount; ++i )
+	{
+		NavPathBenchPair_t &pair = pairs[i];
+		pair.legacyFound = NavAreaBuildPath( pair.startArea, pair.goalArea, NULL, costFunc );
+		pair.legacyCost = pair.legacyFound ? pair.goalArea->GetCostSoFar() : 0.0f;
+	}
+	timer.End();
+	float legacyTime = timer.GetDuration().GetMillisecondsF();
+
+	// reentrant search, single thread
+	NavPathBenchBatch_t serialBatch;
+	serialBatch.pairs = pairs.Base();
+	serialBatch.count = pairCount;
+
+	timer.Start();
+	NavPathBenchRunBatch( serialBatch );
+	timer.End();
+	float serialTime = timer.GetDuration().GetMillisecondsF();
+
+	int mismatches = 0;
+	for( int i=0; i<pairCount; ++i )
+	{
+		const NavPathBenchPair_t &pair = pairs[i];
+		if ( pair.found != pair.legacyFound || fabs( pair.cost - pair.legacyCost ) > 0.001f * Max( 1.0f, pair.legacyCost ) )
+		{
+			++mismatches;
+		}
+	}
+
+	// reentrant search, one search context per batch
+	CUtlVector< NavPathBenchBatch_t > batches;
+	batches.SetCount( batchCount );
+	int pairsPerBatch = ( pairCount + batchCount - 1 ) / batchCount;
+	for( int i=0; i<batchCount; ++i )
+	{
+		int first = MIN( i * pairsPerBatch, pairCount );
+		batches[i].pairs = pairs.Base() + first;
+		batches[i].count = MIN( pairsPerBatch, pairCount - first );
+	}
+
+	timer.Start();
+	ParallelProcess( "nav_bench_pathfind", batches.Base(), batches.Count(), &NavPathBenchRunBatch );
+	timer.End();
+	float parallelTime = timer.GetDuration().GetMillisecondsF();
+
+	Msg( "%d paths over %d areas (%d areas expanded by the reentrant search):\n", pairCount, areaCount, serialBatch.steps );
+	Msg( "  NavAreaBuildPath:            %8.2f ms  (%.1f paths/ms)\n", legacyTime, pairCount / Max( legacyTime, 0.001f ) );
+	Msg( "  CNavAreaSearch:              %8.2f ms  (%.1f paths/ms)\n", serialTime, pairCount / Max( serialTime, 0.001f ) );
+	Msg( "  CNavAreaSearch x %2d batches: %8.2f ms  (%.1f paths/ms)\n", batchCount, parallelTime, pairCount / Max( parallelTime, 0.001f ) );
+	if ( mismatches )
+	{
+		Warning( "  %d paths differ from NavAreaBuildPath\n", mismatches );
+	}
+}
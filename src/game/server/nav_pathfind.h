@@ -34,6 +34,141 @@ enum RouteType
 };
 
 
+//--------------------------------------------------------------------------------------------------------------
+/**
+ * A reentrant A* search over the nav mesh.
+ * NavAreaBuildPath() keeps its open and closed lists in the CNavArea objects themselves, so only one
+ * search can be in flight at a time. A CNavAreaSearch owns its search state instead: a binary heap for
+ * the open list and a node per area, stamped with a search generation so nothing needs to be reset
+ * between searches. Separate instances can run concurrently on worker threads, and a search can be
+ * advanced a bounded number of steps at a time to spread a long query across several ticks.
+ *
+ * The nav mesh itself must not be edited while searches are running.
+ * Cost functors must use NavAreaCostSoFar( fromArea ) rather than fromArea->GetCostSoFar(), since
+ * the per-area cost fields are not written by this search.
+ */
+class CNavAreaSearch
+{
+public:
+	enum SearchStatus
+	{
+		SEARCH_FAILED,
+		SEARCH_IN_PROGRESS,
+		SEARCH_SUCCEEDED,
+	};
+
+	CNavAreaSearch( void );
+
+	// Find path from startArea to goalArea (or goalPos), with the same semantics as NavAreaBuildPath()
+	template< typename CostFunctor >
+	bool BuildPath( CNavArea *startArea, CNavArea *goalArea, const Vector *goalPos, CostFunctor &costFunc, CNavArea **closestArea = NULL, float maxPathLength = 0.0f, int teamID = TEAM_ANY, bool ignoreNavBlockers = false );
+
+	// Time-sliced interface - Begin() a search, then Continue() it until it no longer returns SEARCH_IN_PROGRESS.
+	// The cost functor must be the same object for every Continue() of a search.
+	template< typename CostFunctor >
+	SearchStatus Begin( CNavArea *startArea, CNavArea *goalArea, const Vector *goalPos, CostFunctor &costFunc, float maxPathLength = 0.0f, int teamID = TEAM_ANY, bool ignoreNavBlockers = false );
+
+	template< typename CostFunctor >
+	SearchStatus Continue( CostFunctor &costFunc, int maxSteps = 0 );	// expand at most 'maxSteps' areas, or until done if zero
+
+	SearchStatus GetStatus( void ) const			{ return m_status; }
+	CNavArea *GetStartArea( void ) const			{ return m_startArea; }
+	CNavArea *GetEndArea( void ) const				{ return m_endArea; }		// the area reached if the search succeeded
+	CNavArea *GetClosestArea( void ) const			{ return m_closestArea; }	// the area closest to the goal visited so far
+	int GetStepCount( void ) const					{ return m_stepCount; }		// number of areas expanded so far
+
+	// results of the last search, following the path back from any visited area
+	bool IsVisited( const CNavArea *area ) const	{ return GetNode( area ) != NULL; }
+	CNavArea *GetParent( const CNavArea *area ) const;
+	NavTraverseType GetParentHow( const CNavArea *area ) const;
+	float GetCostSoFar( const CNavArea *area ) const;
+	float GetPathLengthSoFar( const CNavArea *area ) const;
+	float GetTravelDistance( const CNavArea *area ) const;	// distance along the path from the start area to this area, or -1 if not visited
+
+	static CNavAreaSearch *GetActiveSearch( void )	{ return GETLOCAL( s_activeSearch ); }
+
+	/**
+	 * Makes a search the one NavAreaCostSoFar() consults on this thread, restoring the previous one on scope exit
+	 */
+	class CActiveScope
+	{
+	public:
+		CActiveScope( CNavAreaSearch *search )		{ m_prevSearch = GETLOCAL( s_activeSearch ); s_activeSearch = search; }
+		~CActiveScope()								{ s_activeSearch = m_prevSearch; }
+
+	private:
+		CNavAreaSearch *m_prevSearch;
+	};
+
+private:
+	struct SearchNode
+	{
+		CNavArea *area;
+		CNavArea *parent;
+		float costSoFar;
+		float totalCost;
+		float pathLengthSoFar;
+		unsigned int generation;				// node is only valid if this matches m_generation
+		int heapIndex;							// index into m_openHeap, or -1 if closed
+		unsigned char parentHow;
+	};
+
+	const SearchNode *GetNode( const CNavArea *area ) const
+	{
+		unsigned int id = area->GetID();
+		if ( id >= (unsigned int)m_nodes.Count() || m_nodes[ id ].generation != m_generation )
+			return NULL;
+		return &m_nodes[ id ];
+	}
+
+	SearchNode *GetNode( const CNavArea *area )
+	{
+		return const_cast< SearchNode * >( const_cast< const CNavAreaSearch * >( this )->GetNode( area ) );
+	}
+
+	SearchNode *VisitNode( CNavArea *area );			// return the node for this area, initializing it if not yet visited in this search
+	void NewGeneration( void );
+
+	// binary min-heap on totalCost, storing area IDs
+	bool IsHeapEmpty( void ) const					{ return m_openHeap.Count() == 0; }
+	void HeapPush( SearchNode *node );
+	SearchNode *HeapPop( void );
+	void HeapSiftUp( int index );
+	void HeapSiftDown( int index );
+
+	CUtlVector< SearchNode > m_nodes;					// indexed by area ID
+	CUtlVector< unsigned int > m_openHeap;
+	unsigned int m_generation;
+
+	SearchStatus m_status;
+	CNavArea *m_startArea;
+	CNavArea *m_goalArea;
+	CNavArea *m_endArea;
+	CNavArea *m_closestArea;
+	Vector m_goalPos;
+	bool m_hasGoalPos;
+	float m_closestAreaDist;
+	float m_maxPathLength;
+	int m_teamID;
+	bool m_ignoreNavBlockers;
+	int m_stepCount;
+
+	static CTHREADLOCALPTR( CNavAreaSearch ) s_activeSearch;
+};
+
+
+//--------------------------------------------------------------------------------------------------------------
+/**
+ * Return the cost so far of an area in the search currently running on this thread.
+ * Cost functors should use this so they work with both NavAreaBuildPath() and CNavAreaSearch.
+ */
+inline float NavAreaCostSoFar( const CNavArea *area )
+{
+	const CNavAreaSearch *search = CNavAreaSearch::GetActiveSearch();
+	return search ? search->GetCostSoFar( area ) : area->GetCostSoFar();
+}
+
+
 //--------------------------------------------------------------------------------------------------------------
 /**
  * Functor used with NavAreaBuildPath()
@@ -66,7 +201,7 @@ public:
 				dist = ( area->GetCenter() - fromArea->GetCenter() ).Length();
 			}
 
-			float cost = dist + fromArea->GetCostSoFar();
+			float cost = dist + NavAreaCostSoFar( fromArea );
 
 			// if this is a "crouch" area, add penalty
 			if ( area->GetAttributes() & NAV_MESH_CROUCH )
@@ -105,6 +240,9 @@ bool NavAreaBuildPath( CNavArea *startArea, CNavArea *goalArea, const Vector *go
 {
 	VPROF_BUDGET( "NavAreaBuildPath", "NextBotSpiky" );
 
+	// cost functors must see this search's costs, not those of a CNavAreaSearch running further up the stack
+	CNavAreaSearch::CActiveScope noActiveSearch( NULL );
+
 	if ( closestArea )
 	{
 		*closestArea = startArea;
@@ -427,6 +565,368 @@ bool NavAreaBuildPath( CNavArea *startArea, CNavArea *goalArea, const Vector *go
 }
 
 
+//--------------------------------------------------------------------------------------------------------------
+inline CNavArea *CNavAreaSearch::GetParent( const CNavArea *area ) const
+{
+	const SearchNode *node = GetNode( area );
+	return node ? node->parent : NULL;
+}
+
+inline NavTraverseType CNavAreaSearch::GetParentHow( const CNavArea *area ) const
+{
+	const SearchNode *node = GetNode( area );
+	return node ? (NavTraverseType)node->parentHow : NUM_TRAVERSE_TYPES;
+}
+
+inline float CNavAreaSearch::GetCostSoFar( const CNavArea *area ) const
+{
+	const SearchNode *node = GetNode( area );
+	return node ? node->costSoFar : 0.0f;
+}
+
+inline float CNavAreaSearch::GetPathLengthSoFar( const CNavArea *area ) const
+{
+	const SearchNode *node = GetNode( area );
+	return node ? node->pathLengthSoFar : 0.0f;
+}
+
+
+//--------------------------------------------------------------------------------------------------------------
+template< typename CostFunctor >
+bool CNavAreaSearch::BuildPath( CNavArea *startArea, CNavArea *goalArea, const Vector *goalPos, CostFunctor &costFunc, CNavArea **closestArea, float maxPathLength, int teamID, bool ignoreNavBlockers )
+{
+	VPROF_BUDGET( "CNavAreaSearch::BuildPath", "NextBotSpiky" );
+
+	SearchStatus status = Begin( startArea, goalArea, goalPos, costFunc, maxPathLength, teamID, ignoreNavBlockers );
+	if ( status == SEARCH_IN_PROGRESS )
+	{
+		status = Continue( costFunc );
+	}
+
+	if ( closestArea )
+	{
+		*closestArea = ( status == SEARCH_SUCCEEDED ) ? m_endArea : m_closestArea;
+	}
+
+	return ( status == SEARCH_SUCCEEDED );
+}
+
+
+//--------------------------------------------------------------------------------------------------------------
+template< typename CostFunctor >
+CNavAreaSearch::SearchStatus CNavAreaSearch::Begin( CNavArea *startArea, CNavArea *goalArea, const Vector *goalPos, CostFunctor &costFunc, float maxPathLength, int teamID, bool ignoreNavBlockers )
+{
+	NewGeneration();
+
+	m_startArea = startArea;
+	m_endArea = NULL;
+	m_closestArea = startArea;
+	m_maxPathLength = maxPathLength;
+	m_teamID = teamID;
+	m_ignoreNavBlockers = ignoreNavBlockers;
+	m_stepCount = 0;
+	m_status = SEARCH_FAILED;
+
+	if ( startArea == NULL )
+		return m_status;
+
+	if ( goalArea != NULL && goalArea->IsBlocked( teamID, ignoreNavBlockers ) )
+		goalArea = NULL;
+
+	if ( goalArea == NULL && goalPos == NULL )
+		return m_status;
+
+	m_goalArea = goalArea;
+	m_hasGoalPos = ( goalPos != NULL );
+	m_goalPos = ( goalPos ) ? *goalPos : goalArea->GetCenter();
+
+	SearchNode *startNode = VisitNode( startArea );
+
+	// if we are already in the goal area, build trivial path
+	if ( startArea == goalArea )
+	{
+		m_endArea = startArea;
+		m_status = SEARCH_SUCCEEDED;
+		return m_status;
+	}
+
+	float initCost;
+	{
+		CActiveScope scope( this );
+		initCost = costFunc( startArea, NULL, NULL, NULL, -1.0f );
+	}
+	if ( initCost < 0.0f )
+		return m_status;
+
+	startNode->costSoFar = initCost;
+	startNode->totalCost = ( startArea->GetCenter() - m_goalPos ).Length();
+	m_closestAreaDist = startNode->totalCost;
+
+	HeapPush( startNode );
+
+	m_status = SEARCH_IN_PROGRESS;
+	return m_status;
+}
+
+
+//--------------------------------------------------------------------------------------------------------------
+template< typename CostFunctor >
+CNavAreaSearch::SearchStatus CNavAreaSearch::Continue( CostFunctor &costFunc, int maxSteps )
+{
+	if ( m_status != SEARCH_IN_PROGRESS )
+		return m_status;
+
+	CActiveScope scope( this );
+
+	const bool bHaveMaxPathLength = ( m_maxPathLength > 0.0f );
+	int stepsLeft = ( maxSteps > 0 ) ? maxSteps : INT_MAX;
+
+	while( !IsHeapEmpty() )
+	{
+		if ( stepsLeft-- <= 0 )
+			return m_status;
+
+		++m_stepCount;
+
+		SearchNode *node = HeapPop();
+		CNavArea *area = node->area;
+
+		// don't consider blocked areas
+		if ( area->IsBlocked( m_teamID, m_ignoreNavBlockers ) )
+			continue;
+
+		// check if we have found the goal area or position
+		if ( area == m_goalArea || ( m_goalArea == NULL && m_hasGoalPos && area->Contains( m_goalPos ) ) )
+		{
+			m_endArea = area;
+			m_status = SEARCH_SUCCEEDED;
+			return m_status;
+		}
+
+		// search adjacent areas - same order as NavAreaBuildPath(): floor, ladders, elevators
+		enum SearchType
+		{
+			SEARCH_FLOOR, SEARCH_LADDERS, SEARCH_ELEVATORS
+		};
+		SearchType searchWhere = SEARCH_FLOOR;
+		int searchIndex = 0;
+
+		int dir = NORTH;
+		const NavConnectVector *floorList = area->GetAdjacentAreas( NORTH );
+
+		bool ladderUp = true;
+		const NavLadderConnectVector *ladderList = NULL;
+		enum { AHEAD = 0, LEFT, RIGHT, BEHIND, NUM_TOP_DIRECTIONS };
+		int ladderTopDir = AHEAD;
+		float length = -1;
+
+		while( true )
+		{
+			CNavArea *newArea = NULL;
+			NavTraverseType how;
+			const CNavLadder *ladder = NULL;
+			const CFuncElevator *elevator = NULL;
+
+			if ( searchWhere == SEARCH_FLOOR )
+			{
+				if ( searchIndex >= floorList->Count() )
+				{
+					++dir;
+
+					if ( dir == NUM_DIRECTIONS )
+					{
+						searchWhere = SEARCH_LADDERS;
+
+						ladderList = area->GetLadders( CNavLadder::LADDER_UP );
+						searchIndex = 0;
+						ladderTopDir = AHEAD;
+					}
+					else
+					{
+						floorList = area->GetAdjacentAreas( (NavDirType)dir );
+						searchIndex = 0;
+					}
+
+					continue;
+				}
+
+				const NavConnect &floorConnect = floorList->Element( searchIndex );
+				newArea = floorConnect.area;
+				length = floorConnect.length;
+				how = (NavTraverseType)dir;
+				++searchIndex;
+			}
+			else if ( searchWhere == SEARCH_LADDERS )
+			{
+				if ( searchIndex >= ladderList->Count() )
+				{
+					if ( !ladderUp )
+					{
+						searchWhere = SEARCH_ELEVATORS;
+						searchIndex = 0;
+						ladder = NULL;
+					}
+					else
+					{
+						ladderUp = false;
+						ladderList = area->GetLadders( CNavLadder::LADDER_DOWN );
+						searchIndex = 0;
+					}
+					continue;
+				}
+
+				if ( ladderUp )
+				{
+					ladder = ladderList->Element( searchIndex ).ladder;
+
+					// do not use BEHIND connection, as its very hard to get to when going up a ladder
+					if ( ladderTopDir == AHEAD )
+					{
+						newArea = ladder->m_topForwardArea;
+					}
+					else if ( ladderTopDir == LEFT )
+					{
+						newArea = ladder->m_topLeftArea;
+					}
+					else if ( ladderTopDir == RIGHT )
+					{
+						newArea = ladder->m_topRightArea;
+					}
+					else
+					{
+						++searchIndex;
+						ladderTopDir = AHEAD;
+						continue;
+					}
+
+					how = GO_LADDER_UP;
+					++ladderTopDir;
+				}
+				else
+				{
+					newArea = ladderList->Element( searchIndex ).ladder->m_bottomArea;
+					how = GO_LADDER_DOWN;
+					ladder = ladderList->Element(searchIndex).ladder;
+					++searchIndex;
+				}
+
+				if ( newArea == NULL )
+					continue;
+
+				length = -1.0f;
+			}
+			else // if ( searchWhere == SEARCH_ELEVATORS )
+			{
+				const NavConnectVector &elevatorAreas = area->GetElevatorAreas();
+
+				elevator = area->GetElevator();
+
+				if ( elevator == NULL || searchIndex >= elevatorAreas.Count() )
+				{
+					// done searching connected areas
+					elevator = NULL;
+					break;
+				}
+
+				newArea = elevatorAreas[ searchIndex++ ].area;
+				if ( newArea->GetCenter().z > area->GetCenter().z )
+				{
+					how = GO_ELEVATOR_UP;
+				}
+				else
+				{
+					how = GO_ELEVATOR_DOWN;
+				}
+
+				length = -1.0f;
+			}
+
+			// don't backtrack
+			Assert( newArea );
+			if ( newArea == node->parent )
+				continue;
+			if ( newArea == area ) // self neighbor?
+				continue;
+
+			// don't consider blocked areas
+			if ( newArea->IsBlocked( m_teamID, m_ignoreNavBlockers ) )
+				continue;
+
+			float newCostSoFar = costFunc( newArea, area, ladder, elevator, length );
+
+			// NaNs really mess this function up causing tough to track down hangs. If
+			//  we get inf back, clamp it down to a really high number.
+			if ( IS_NAN( newCostSoFar ) )
+				newCostSoFar = 1e30f;
+
+			// check if cost functor says this area is a dead-end
+			if ( newCostSoFar < 0.0f )
+				continue;
+
+			// make sure that any jump to a new area incurs some cost (see NavAreaBuildPath)
+			Assert( newCostSoFar >= node->costSoFar );
+			float minNewCostSoFar = node->costSoFar * 1.00001f + 0.00001f;
+			newCostSoFar = Max( newCostSoFar, minNewCostSoFar );
+
+			float newLengthSoFar = 0.0f;
+			if ( bHaveMaxPathLength )
+			{
+				float deltaLength = ( newArea->GetCenter() - area->GetCenter() ).Length();
+				newLengthSoFar = node->pathLengthSoFar + deltaLength;
+				if ( newLengthSoFar > m_maxPathLength )
+					continue;
+			}
+
+			// NOTE: VisitNode() may grow m_nodes, so refetch our node afterwards
+			unsigned int areaID = area->GetID();
+			SearchNode *newNode = GetNode( newArea );
+			if ( newNode && newNode->costSoFar <= newCostSoFar )
+			{
+				// this is a worse path - skip it
+				continue;
+			}
+
+			if ( !newNode )
+			{
+				newNode = VisitNode( newArea );
+				node = &m_nodes[ areaID ];
+			}
+
+			// compute estimate of distance left to go
+			float distSq = ( newArea->GetCenter() - m_goalPos ).LengthSqr();
+			float newCostRemaining = ( distSq > 0.0 ) ? FastSqrt( distSq ) : 0.0 ;
+
+			// track closest area to goal in case path fails
+			if ( newCostRemaining < m_closestAreaDist )
+			{
+				m_closestArea = newArea;
+				m_closestAreaDist = newCostRemaining;
+			}
+
+			newNode->costSoFar = newCostSoFar;
+			newNode->totalCost = newCostSoFar + newCostRemaining;
+			newNode->pathLengthSoFar = newLengthSoFar;
+			newNode->parent = area;
+			newNode->parentHow = (unsigned char)how;
+
+			if ( newNode->heapIndex >= 0 )
+			{
+				// already open, cost went down
+				HeapSiftUp( newNode->heapIndex );
+			}
+			else
+			{
+				// new, or reopened from the closed set
+				HeapPush( newNode );
+			}
+		}
+	}
+
+	m_status = SEARCH_FAILED;
+	return m_status;
+}
+
+
 //--------------------------------------------------------------------------------------------------------------
 /**
  * Compute distance between two areas. Return -1 if can't reach 'endArea' from 'startArea'.
@@ -231,7 +231,7 @@ void CSDKPlayer::InitialSpawn( void )
 {
 	BaseClass::InitialSpawn();
 
-	const ConVar *hostname = cvar->FindVar( "hostname" );
+	const ConVar *hostname = ConVar_FindVar( "hostname" );
 	const char *title = (hostname) ? hostname->GetString() : "MESSAGE OF THE DAY";
 
 	// open info panel on client showing MOTD:
@@ -10,6 +10,9 @@
 #include "doors.h"
 #include "entitylist.h"
 #include "globals.h"
+#ifdef USE_NAV_MESH
+#include "nav_mesh.h"
+#endif
 
 // memdbgon must be the last include file in a .cpp file!!!
 #include "tier0/memdbgon.h"
@@ -221,6 +224,14 @@ void CBaseToggle::LinearMove( const Vector &vecDest, float flSpeed )
 
 	// scale the destdelta vector by the time spent traveling to get velocity
 	SetLocalVelocity( vecDestDelta / flTravelTime );
+
+	// re-test the nav areas around us once we come to rest
+#ifdef USE_NAV_MESH
+	if ( TheNavMesh )
+	{
+		TheNavMesh->OnBrushChanged( this );
+	}
+#endif
 }
 
 
@@ -298,6 +309,14 @@ void CBaseToggle::AngularMove( const QAngle &vecDestAngle, float flSpeed )
 
 	// scale the destdelta vector by the time spent traveling to get velocity
 	SetLocalAngularVelocity( vecDestDelta * (1.0 / flTravelTime) );
+
+	// re-test the nav areas around us once we come to rest
+#ifdef USE_NAV_MESH
+	if ( TheNavMesh )
+	{
+		TheNavMesh->OnBrushChanged( this );
+	}
+#endif
 }
 
 
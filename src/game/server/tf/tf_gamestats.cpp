@@ -124,13 +124,13 @@ void CTFGameStats::Event_LevelInit( void )
 	// Get the host ip and port.
 	int nIPAddr = 0;
 	short nPort = 0;
-	ConVar *hostip = cvar->FindVar( "hostip" );
+	ConVar *hostip = ConVar_FindVar( "hostip" );
 	if ( hostip )
 	{
 		nIPAddr = hostip->GetInt();
 	}			
 
-	ConVar *hostport = cvar->FindVar( "hostip" );
+	ConVar *hostport = ConVar_FindVar( "hostip" );
 	if ( hostport )
 	{
 		nPort = hostport->GetInt();
@@ -141,7 +141,7 @@ public:
 #if !defined( CLIENT_DLL )
 	bool			m_bLogPrecache;
 	FileHandle_t	m_hPrecacheLogFile;
-	CUtlSymbolTable m_PrecachedScriptSounds;
+	CUtlSymbolTableHash m_PrecachedScriptSounds;
 public:
 	CSoundEmitterSystem( char const *pszName ) :
 		m_bLogPrecache( false ),
@@ -222,7 +222,7 @@ public:
 #if !defined( CLIENT_DLL )
 		m_bLogPrecache = CommandLine()->CheckParm( "-makereslists" ) ? true : false;
 #endif
-		g_pClosecaption = cvar->FindVar("closecaption");
+		g_pClosecaption = ConVar_FindVar("closecaption");
 		Assert(g_pClosecaption);
 		return soundemitterbase->ModInit();
 	}
@@ -411,7 +411,7 @@ public:
 #if !defined( CLIENT_DLL )
 			if ( soundname[ 0 ] )
 			{
-				static CUtlSymbolTable s_PrecacheScriptSoundFailures;
+				static CUtlSymbolTableHash s_PrecacheScriptSoundFailures;
 
 				// Make sure we only show the message once
 				if ( UTL_INVAL_SYMBOL == s_PrecacheScriptSoundFailures.Find( soundname ) )
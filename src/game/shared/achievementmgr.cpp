@@ -446,7 +446,7 @@ void CAchievementMgr::Update( float frametime )
 #ifdef CLIENT_DLL
 	if ( !sv_cheats )
 	{
-		sv_cheats = cvar->FindVar( "sv_cheats" );
+		sv_cheats = ConVar_FindVar( "sv_cheats" );
 	}
 #endif
 
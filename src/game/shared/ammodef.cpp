@@ -225,7 +225,7 @@ void CAmmoDef::AddAmmoType(char const* name, int damageType, int tracerType,
 
 	if (plr_cvar)
 	{
-		m_AmmoType[m_nAmmoIndex].pPlrDmgCVar	= cvar->FindVar(plr_cvar);
+		m_AmmoType[m_nAmmoIndex].pPlrDmgCVar	= ConVar_FindVar(plr_cvar);
 		if (!m_AmmoType[m_nAmmoIndex].pPlrDmgCVar)
 		{
 			Msg("ERROR: Ammo (%s) found no CVar named (%s)\n",name,plr_cvar);
@@ -234,7 +234,7 @@ void CAmmoDef::AddAmmoType(char const* name, int damageType, int tracerType,
 	}
 	if (npc_cvar)
 	{
-		m_AmmoType[m_nAmmoIndex].pNPCDmgCVar	= cvar->FindVar(npc_cvar);
+		m_AmmoType[m_nAmmoIndex].pNPCDmgCVar	= ConVar_FindVar(npc_cvar);
 		if (!m_AmmoType[m_nAmmoIndex].pNPCDmgCVar)
 		{
 			Msg("ERROR: Ammo (%s) found no CVar named (%s)\n",name,npc_cvar);
@@ -243,7 +243,7 @@ void CAmmoDef::AddAmmoType(char const* name, int damageType, int tracerType,
 	}
 	if (carry_cvar)
 	{
-		m_AmmoType[m_nAmmoIndex].pMaxCarryCVar= cvar->FindVar(carry_cvar);
+		m_AmmoType[m_nAmmoIndex].pMaxCarryCVar= ConVar_FindVar(carry_cvar);
 		if (!m_AmmoType[m_nAmmoIndex].pMaxCarryCVar)
 		{
 			Msg("ERROR: Ammo (%s) found no CVar named (%s)\n",name,carry_cvar);
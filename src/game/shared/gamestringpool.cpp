@@ -7,7 +7,7 @@
 
 #include "cbase.h"
 
-#include "utlhashtable.h"
+#include "utlswisshashtable.h"
 #ifndef GC
 #include "igamesystem.h"
 #endif
@@ -38,8 +38,9 @@ class CGameStringPool : public CBaseGameSystem
 		m_KeyLookupCache.Purge();
 	}
 
-	CUtlHashtable<CUtlConstString> m_Strings;
-	CUtlHashtable<const void*, const char*> m_KeyLookupCache;
+	// Nearly every call is a lookup of a string that is already pooled
+	CUtlSwissHashtable<CUtlConstString> m_Strings;
+	CUtlSwissHashtable<const void*, const char*> m_KeyLookupCache;
 
 public:
 
@@ -52,7 +53,7 @@ public:
 		CUtlVector<const char*> strings( 0, m_Strings.Count() );
 		for (UtlHashHandle_t i = m_Strings.FirstHandle(); i != m_Strings.InvalidHandle(); i = m_Strings.NextHandle(i))
 		{
-			strings.AddToTail( strings[i] );
+			strings.AddToTail( m_Strings[i] );
 		}
 		struct _Local {
 			static int __cdecl F(const char * const *a, const char * const *b) { return strcmp(*a, *b); }
@@ -21,6 +21,8 @@
 #include "predictioncopy.h"
 #include "engine/ivmodelinfo.h"
 #include "tier1/fmtstr.h"
+#include "tier1/utlmap.h"
+#include "mathlib/ssemath.h"
 
 // memdbgon must be the last include file in a .cpp file!!!
 #include "tier0/memdbgon.h"
@@ -1238,6 +1240,187 @@ void CPredictionCopy::TransferData_R( int chaincount, datamap_t *dmap )
 	}
 }
 
+//-----------------------------------------------------------------------------
+// Purpose: Returns true if the float arrays are equal the way the Compare 
+//			functions test them, so -0 matches 0 and NaN never matches.
+//-----------------------------------------------------------------------------
+static bool FloatsEqual_SIMD( const float *pA, const float *pB, int count )
+{
+	int i = 0;
+	for ( ; i + 4 <= count; i += 4 )
+	{
+		if ( TestSignSIMD( CmpEqSIMD( LoadUnalignedSIMD( pA + i ), LoadUnalignedSIMD( pB + i ) ) ) != 0xf )
+			return false;
+	}
+
+	for ( ; i < count; i++ )
+	{
+		if ( pA[ i ] != pB[ i ] )
+			return false;
+	}
+
+	return true;
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: The memory one kind of transfer of a datamap touches, flattened into
+//			runs of contiguous fields
+//-----------------------------------------------------------------------------
+struct PredictionCopyRun_t
+{
+	int		m_nDestOffset;
+	int		m_nSrcOffset;
+	int		m_nSize;
+	bool	m_bFloats;
+};
+
+class CPredictionCopyPlan
+{
+public:
+	CPredictionCopyPlan() : m_bValid( true ) {}
+
+	void	AddRun( CUtlVector< PredictionCopyRun_t > &runs, int nDestOffset, int nSrcOffset, int nSize, bool bFloats );
+	void	Finish( void );
+
+	void	Copy( void *pDest, void const *pSrc ) const;
+	bool	IsIdentical( void const *pDest, void const *pSrc ) const;
+
+	// Strings and fields behind pointers can't be planned, those maps always walk
+	bool	m_bValid;
+
+	CUtlVector< PredictionCopyRun_t >	m_CopyRuns;
+	// Only the fields that get error checked
+	CUtlVector< PredictionCopyRun_t >	m_CompareRuns;
+
+private:
+	bool	MergeRuns( CUtlVector< PredictionCopyRun_t > &runs );
+};
+
+void CPredictionCopyPlan::AddRun( CUtlVector< PredictionCopyRun_t > &runs, int nDestOffset, int nSrcOffset, int nSize, bool bFloats )
+{
+	PredictionCopyRun_t &run = runs[ runs.AddToTail() ];
+	run.m_nDestOffset = nDestOffset;
+	run.m_nSrcOffset = nSrcOffset;
+	run.m_nSize = nSize;
+	run.m_bFloats = bFloats;
+}
+
+static int __cdecl PredictionCopyRunLessFunc( const PredictionCopyRun_t *pLeft, const PredictionCopyRun_t *pRight )
+{
+	return pLeft->m_nDestOffset - pRight->m_nDestOffset;
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: Sorts the runs by destination and joins the ones that are contiguous
+//			on both sides. Returns false if any fields overlap, since then the
+//			walk's field order matters.
+//-----------------------------------------------------------------------------
+bool CPredictionCopyPlan::MergeRuns( CUtlVector< PredictionCopyRun_t > &runs )
+{
+	if ( !runs.Count() )
+		return true;
+
+	runs.Sort( PredictionCopyRunLessFunc );
+
+	int nMerged = 0;
+	for ( int i = 1; i < runs.Count(); i++ )
+	{
+		PredictionCopyRun_t &last = runs[ nMerged ];
+		const PredictionCopyRun_t &run = runs[ i ];
+
+		if ( run.m_nDestOffset < last.m_nDestOffset + last.m_nSize )
+			return false;
+
+		if ( run.m_nDestOffset == last.m_nDestOffset + last.m_nSize &&
+			 run.m_nSrcOffset == last.m_nSrcOffset + last.m_nSize &&
+			 run.m_bFloats == last.m_bFloats )
+		{
+			last.m_nSize += run.m_nSize;
+			continue;
+		}
+
+		runs[ ++nMerged ] = run;
+	}
+
+	runs.SetCountNonDestructively( nMerged + 1 );
+	return true;
+}
+
+void CPredictionCopyPlan::Finish( void )
+{
+	if ( m_bValid )
+	{
+		m_bValid = MergeRuns( m_CopyRuns ) && MergeRuns( m_CompareRuns );
+	}
+
+	if ( !m_bValid )
+	{
+		m_CopyRuns.Purge();
+		m_CompareRuns.Purge();
+	}
+}
+
+void CPredictionCopyPlan::Copy( void *pDest, void const *pSrc ) const
+{
+	const PredictionCopyRun_t *pRun = m_CopyRuns.Base();
+	for ( int i = m_CopyRuns.Count(); --i >= 0; ++pRun )
+	{
+		memcpy( (char *)pDest + pRun->m_nDestOffset, (char const *)pSrc + pRun->m_nSrcOffset, pRun->m_nSize );
+	}
+}
+
+bool CPredictionCopyPlan::IsIdentical( void const *pDest, void const *pSrc ) const
+{
+	const PredictionCopyRun_t *pRun = m_CompareRuns.Base();
+	for ( int i = m_CompareRuns.Count(); --i >= 0; ++pRun )
+	{
+		char const *pDestData = (char const *)pDest + pRun->m_nDestOffset;
+		char const *pSrcData = (char const *)pSrc + pRun->m_nSrcOffset;
+
+		if ( pRun->m_bFloats )
+		{
+			if ( !FloatsEqual_SIMD( (float const *)pDestData, (float const *)pSrcData, pRun->m_nSize / sizeof( float ) ) )
+				return false;
+		}
+		else if ( memcmp( pDestData, pSrcData, pRun->m_nSize ) )
+		{
+			return false;
+		}
+	}
+
+	return true;
+}
+
+struct PredictionCopyPlanKey_t
+{
+	datamap_t	*m_pMap;
+	int			m_nType;
+	int			m_nDestOffsetIndex;
+	int			m_nSrcOffsetIndex;
+};
+
+static bool PredictionCopyPlanKeyLessFunc( const PredictionCopyPlanKey_t &lhs, const PredictionCopyPlanKey_t &rhs )
+{
+	if ( lhs.m_pMap != rhs.m_pMap )
+		return lhs.m_pMap < rhs.m_pMap;
+	if ( lhs.m_nType != rhs.m_nType )
+		return lhs.m_nType < rhs.m_nType;
+	if ( lhs.m_nDestOffsetIndex != rhs.m_nDestOffsetIndex )
+		return lhs.m_nDestOffsetIndex < rhs.m_nDestOffsetIndex;
+	return lhs.m_nSrcOffsetIndex < rhs.m_nSrcOffsetIndex;
+}
+
+class CPredictionCopyPlanCache
+{
+public:
+	CPredictionCopyPlanCache() : m_Plans( 0, 0, PredictionCopyPlanKeyLessFunc ) {}
+	~CPredictionCopyPlanCache() { m_Plans.PurgeAndDeleteElements(); }
+
+	CUtlMap< PredictionCopyPlanKey_t, CPredictionCopyPlan * > m_Plans;
+};
+
+static CPredictionCopyPlanCache g_PredictionCopyPlans;
+
 static int g_nChainCount = 1;
 
 static typedescription_t *FindFieldByName_R( const char *fieldname, datamap_t *dmap )
@@ -1325,6 +1508,7 @@ typedescription_t *FindFieldByName( const char *fieldname, datamap_t *dmap )
 
 static ConVar pwatchent( "pwatchent", "-1", FCVAR_CHEAT, "Entity to watch for prediction system changes." );
 static ConVar pwatchvar( "pwatchvar", "", FCVAR_CHEAT, "Entity variable to watch in prediction system for changes." );
+static ConVar cl_pred_copy_plans( "cl_pred_copy_plans", "1", 0, "Store and restore predicted fields with precompiled memcpy runs instead of walking the datamap." );
 
 //-----------------------------------------------------------------------------
 // Purpose: 
@@ -1391,11 +1575,160 @@ int CPredictionCopy::TransferData( const char *operation, int entindex, datamap_
 	
 	DetermineWatchField( operation, entindex, dmap );
 
+	// Plain copies and silent error counts don't need to walk the fields one at a time
+	if ( cl_pred_copy_plans.GetBool() && !m_pWatchField && !m_bDescribeFields && !m_bReportErrors )
+	{
+		if ( m_bPerformCopy && !m_bErrorCheck )
+		{
+			CPredictionCopyPlan *pPlan = GetPlan( dmap );
+			if ( pPlan->m_bValid )
+			{
+				pPlan->Copy( m_pDest, m_pSrc );
+				return 0;
+			}
+		}
+		else if ( !m_bPerformCopy && m_bErrorCheck )
+		{
+			// Only proves there are no errors, the walk still counts them otherwise
+			CPredictionCopyPlan *pPlan = GetPlan( dmap );
+			if ( pPlan->m_bValid && pPlan->IsIdentical( m_pDest, m_pSrc ) )
+				return 0;
+		}
+	}
+
 	TransferData_R( g_nChainCount, dmap );
 
 	return m_nErrorCount;
 }
 
+//-----------------------------------------------------------------------------
+// Purpose: Finds or builds the plan for this map, transfer type and packing
+//-----------------------------------------------------------------------------
+CPredictionCopyPlan *CPredictionCopy::GetPlan( datamap_t *dmap )
+{
+	PredictionCopyPlanKey_t key;
+	key.m_pMap = dmap;
+	key.m_nType = m_nType;
+	key.m_nDestOffsetIndex = m_nDestOffsetIndex;
+	key.m_nSrcOffsetIndex = m_nSrcOffsetIndex;
+
+	unsigned short i = g_PredictionCopyPlans.m_Plans.Find( key );
+	if ( i != g_PredictionCopyPlans.m_Plans.InvalidIndex() )
+		return g_PredictionCopyPlans.m_Plans[ i ];
+
+	CPredictionCopyPlan *pPlan = new CPredictionCopyPlan;
+
+	// Same order as TransferData_R, so the same fields are overridden
+	++g_nChainCount;
+	for ( datamap_t *pMap = dmap; pMap && pPlan->m_bValid; pMap = pMap->baseMap )
+	{
+		BuildPlan_R( pPlan, g_nChainCount, pMap->dataDesc, pMap->dataNumFields, 0, 0 );
+	}
+	pPlan->Finish();
+
+	g_PredictionCopyPlans.m_Plans.Insert( key, pPlan );
+	return pPlan;
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: Records the fields CopyFields would transfer, using the same rules
+//			for skipping fields
+//-----------------------------------------------------------------------------
+void CPredictionCopy::BuildPlan_R( CPredictionCopyPlan *pPlan, int chain_count, typedescription_t *pFields, int fieldCount, int nDestBase, int nSrcBase )
+{
+	for ( int i = 0; i < fieldCount && pPlan->m_bValid; i++ )
+	{
+		typedescription_t *pField = &pFields[ i ];
+		int flags = pField->flags;
+
+		if ( pField->override_field != NULL )
+		{
+			pField->override_field->override_count = chain_count;
+		}
+
+		if ( pField->override_count == chain_count )
+			continue;
+
+		if ( pField->fieldType != FIELD_EMBEDDED )
+		{
+			if ( flags & FTYPEDESC_PRIVATE )
+				continue;
+
+			if ( m_nType == PC_NON_NETWORKED_ONLY && ( flags & FTYPEDESC_INSENDTABLE ) )
+				continue;
+
+			if ( m_nType == PC_NETWORKED_ONLY && !( flags & FTYPEDESC_INSENDTABLE ) )
+				continue;
+		}
+
+		int nDestOffset = nDestBase + pField->fieldOffset[ m_nDestOffsetIndex ];
+		int nSrcOffset = nSrcBase + pField->fieldOffset[ m_nSrcOffsetIndex ];
+		int count = pField->fieldSize;
+
+		int size = 0;
+		bool bFloats = false;
+
+		switch ( pField->fieldType )
+		{
+		case FIELD_EMBEDDED:
+			if ( ( flags & FTYPEDESC_PTR ) && ( (m_nSrcOffsetIndex == PC_DATA_NORMAL) || (m_nDestOffsetIndex == PC_DATA_NORMAL) ) )
+			{
+				pPlan->m_bValid = false;
+			}
+			else
+			{
+				BuildPlan_R( pPlan, chain_count, pField->td->dataDesc, pField->td->dataNumFields, nDestOffset, nSrcOffset );
+			}
+			break;
+		case FIELD_STRING:
+			pPlan->m_bValid = false;
+			break;
+		case FIELD_FLOAT:
+			size = sizeof( float ) * count;
+			bFloats = true;
+			break;
+		case FIELD_VECTOR:
+			size = sizeof( Vector ) * count;
+			bFloats = true;
+			break;
+		case FIELD_QUATERNION:
+			size = sizeof( Quaternion ) * count;
+			bFloats = true;
+			break;
+		case FIELD_COLOR32:
+			size = 4 * count;
+			break;
+		case FIELD_BOOLEAN:
+			size = sizeof( bool ) * count;
+			break;
+		case FIELD_INTEGER:
+			size = sizeof( int ) * count;
+			break;
+		case FIELD_SHORT:
+			size = sizeof( short ) * count;
+			break;
+		case FIELD_CHARACTER:
+			size = count;
+			break;
+		case FIELD_EHANDLE:
+			size = sizeof( EHANDLE ) * count;
+			break;
+		default:
+			// CopyFields doesn't transfer anything else either
+			break;
+		}
+
+		if ( size <= 0 )
+			continue;
+
+		pPlan->AddRun( pPlan->m_CopyRuns, nDestOffset, nSrcOffset, size, false );
+		if ( !( flags & FTYPEDESC_NOERRORCHECK ) )
+		{
+			pPlan->AddRun( pPlan->m_CompareRuns, nDestOffset, nSrcOffset, size, bFloats );
+		}
+	}
+}
+
 /*
 //-----------------------------------------------------------------------------
 // Purpose: Simply dumps all data fields in object
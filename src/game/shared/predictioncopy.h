@@ -41,6 +41,8 @@ enum
 #define PC_DATA_PACKED			true
 #define PC_DATA_NORMAL			false
 
+class CPredictionCopyPlan;
+
 typedef void ( *FN_FIELD_COMPARE )( const char *classname, const char *fieldname, const char *fieldtype,
 	bool networked, bool noterrorchecked, bool differs, bool withintolerance, const char *value );
 
@@ -85,6 +87,10 @@ public:
 private:
 	void	TransferData_R( int chaincount, datamap_t *dmap );
 
+	// Precompiled copy/compare runs for plain copies and silent error counts
+	CPredictionCopyPlan *GetPlan( datamap_t *dmap );
+	void	BuildPlan_R( CPredictionCopyPlan *pPlan, int chaincount, typedescription_t *pFields, int fieldCount, int nDestBase, int nSrcBase );
+
 	void	DetermineWatchField( const char *operation, int entindex,  datamap_t *dmap );
 	void	DumpWatchField( typedescription_t *field );
 	void	WatchMsg( PRINTF_FORMAT_STRING const char *fmt, ... );
@@ -1179,3 +1179,29 @@ const char* UTIL_GetActiveHolidayString()
 	return NULL;
 #endif
 }
+
+#if defined( CLIENT_DLL )
+CON_COMMAND_F( cl_findvar_audit, "Counts the convars this dll looks up by name through ConVar_FindVar, ConVarRef and ConVarHandle. Usage: cl_findvar_audit start|stop|[count]", FCVAR_CHEAT )
+#else
+CON_COMMAND_F( sv_findvar_audit, "Counts the convars this dll looks up by name through ConVar_FindVar, ConVarRef and ConVarHandle. Usage: sv_findvar_audit start|stop|[count]", FCVAR_CHEAT )
+#endif
+{
+#ifndef CLIENT_DLL
+	if ( !UTIL_IsCommandIssuedByServerAdmin() )
+		return;
+#endif
+
+	if ( args.ArgC() > 1 && !Q_stricmp( args[1], "start" ) )
+	{
+		ConVar_EnableFindVarAudit( true );
+		return;
+	}
+
+	if ( args.ArgC() > 1 && !Q_stricmp( args[1], "stop" ) )
+	{
+		ConVar_EnableFindVarAudit( false );
+	}
+
+	int nCount = args.ArgC() > 1 ? atoi( args[1] ) : 0;
+	ConVar_PrintFindVarAudit( nCount > 0 ? nCount : 20 );
+}
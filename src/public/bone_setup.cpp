@@ -21,6 +21,7 @@
 #include "convar.h"
 #include "tier0/tslist.h"
 #include "vphysics_interface.h"
+#include "utlhashtable.h"
 #ifdef CLIENT_DLL
 	#include "posedebugger.h"
 #endif
@@ -2118,6 +2119,280 @@ bool CalcPoseSingle(
 
 
 
+//-----------------------------------------------------------------------------
+// Shared pose cache
+//
+// Crowds of the same model tend to play the same handful of sequences, so
+// CalcPoseSingle() keeps decoding identical local poses from the compressed
+// animation data.  When enabled, the cycle and the sequence's blend parameters
+// are snapped to buckets and the decoded pose is stored in an LRU shared by
+// every entity.  Snapping happens on both the hit and miss path, so the result
+// never depends on what happens to be in the cache.
+//-----------------------------------------------------------------------------
+static ConVar anim_posecache( "anim_posecache", "0", FCVAR_REPLICATED, "Share decoded sequence poses between entities of the same model. Quantizes cycle and blend parameters." );
+static ConVar anim_posecache_cycle_steps( "anim_posecache_cycle_steps", "256", FCVAR_REPLICATED, "Number of cycle buckets per sequence used by the pose cache.", true, 16, true, 4096 );
+static ConVar anim_posecache_pose_steps( "anim_posecache_pose_steps", "32", FCVAR_REPLICATED, "Number of buckets per blend pose parameter used by the pose cache.", true, 4, true, 1024 );
+static ConVar anim_posecache_size( "anim_posecache_size", "2048", 0, "Memory cap of the pose cache, in KB.", true, 64, false, 0 );
+
+struct posecachekey_t
+{
+	const studiohdr_t	*pStudioHdr;
+	int					checksum;
+	int					sequence;
+	int					boneMask;
+	int					cycleBucket;
+	int					poseBucket[2];
+
+	bool operator==( const posecachekey_t &src ) const
+	{
+		return pStudioHdr == src.pStudioHdr && checksum == src.checksum && sequence == src.sequence && boneMask == src.boneMask &&
+			cycleBucket == src.cycleBucket && poseBucket[0] == src.poseBucket[0] && poseBucket[1] == src.poseBucket[1];
+	}
+};
+
+struct PoseCacheKeyHashFunctor
+{
+	unsigned int operator()( const posecachekey_t &key ) const
+	{
+		unsigned int hash = PointerHashFunctor()( key.pStudioHdr );
+		hash = HashIntAlternate( hash ^ key.sequence );
+		hash = HashIntAlternate( hash ^ ( key.cycleBucket | ( key.boneMask << 16 ) ) );
+		return HashIntAlternate( hash ^ ( key.poseBucket[0] | ( key.poseBucket[1] << 16 ) ) );
+	}
+};
+
+struct posecacheparams_t
+{
+	posecachekey_t		key;
+	int					numbones;
+	const Vector		*pos;
+	const Quaternion	*q;
+	bool				bValid;		// CalcPoseSingle() result; false means the pose was all zeros
+};
+
+class CPoseCacheEntry
+{
+public:
+	// you must implement these static functions for the ResourceManager
+	// -----------------------------------------------------------
+	static CPoseCacheEntry *CreateResource( const posecacheparams_t &params )
+	{
+		unsigned int size = EstimatedSize( params );
+		CPoseCacheEntry *pMem = (CPoseCacheEntry *)malloc( size );
+		pMem->m_key = params.key;
+		pMem->m_size = size;
+		pMem->m_numbones = params.numbones;
+		pMem->m_bValid = params.bValid;
+		memcpy( pMem->Quaternions(), params.q, params.numbones * sizeof(Quaternion) );
+		memcpy( pMem->Positions(), params.pos, params.numbones * sizeof(Vector) );
+		return pMem;
+	}
+	static unsigned int EstimatedSize( const posecacheparams_t &params )
+	{
+		return sizeof(CPoseCacheEntry) + params.numbones * ( sizeof(Quaternion) + sizeof(Vector) );
+	}
+	// -----------------------------------------------------------
+	// member functions that must be present for the ResourceManager
+	void				DestroyResource() { free( this ); }
+	CPoseCacheEntry		*GetData() { return this; }
+	unsigned int		Size() { return m_size; }
+	// -----------------------------------------------------------
+
+	Quaternion			*Quaternions() { return (Quaternion *)( this + 1 ); }
+	Vector				*Positions() { return (Vector *)( Quaternions() + m_numbones ); }
+
+	posecachekey_t		m_key;
+	unsigned int		m_size;
+	int					m_numbones;
+	bool				m_bValid;
+};
+
+static CDataManager<CPoseCacheEntry, posecacheparams_t, CPoseCacheEntry *, CThreadFastMutex> g_StudioPoseCache( 2048 * 1024 );
+
+// Maps a key to the handle of its entry. Handles of entries the LRU has evicted
+// simply stop resolving, and are pruned once they pile up.
+static CUtlHashtable<posecachekey_t, memhandle_t, PoseCacheKeyHashFunctor> g_StudioPoseCacheIndex;
+
+static CInterlockedInt g_nPoseCacheHits;
+static CInterlockedInt g_nPoseCacheMisses;
+static CInterlockedInt g_nPoseCacheUncacheable;
+
+//-----------------------------------------------------------------------------
+// Purpose: snap a blend pose parameter used by seqdesc to its bucket
+//-----------------------------------------------------------------------------
+static int QuantizePoseParameter( const CStudioHdr *pStudioHdr, mstudioseqdesc_t &seqdesc, int iSequence, int iLocalIndex, float flPoseParameter[], int nSteps )
+{
+	int iPose = pStudioHdr->GetSharedPoseParameter( iSequence, seqdesc.paramindex[iLocalIndex] );
+	if ( iPose == -1 )
+		return -1;
+
+	int nBucket = clamp( RoundFloatToInt( flPoseParameter[iPose] * nSteps ), 0, nSteps );
+	flPoseParameter[iPose] = (float)nBucket / (float)nSteps;
+	return nBucket;
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: CalcPoseSingle() through the shared pose cache.  Callers must make
+//			sure the sequence has no local layers or ik locks.
+//-----------------------------------------------------------------------------
+static bool CalcPoseSingleCached(
+	const CStudioHdr *pStudioHdr,
+	Vector pos[], 
+	Quaternion q[], 
+	mstudioseqdesc_t &seqdesc,
+	int sequence, 
+	float cycle,
+	const float poseParameter[],
+	int boneMask,
+	float flTime
+	)
+{
+	const studiohdr_t *pRenderHdr = pStudioHdr->GetRenderHdr();
+
+	// realtime and cyclepose sequences derive their cycle from elsewhere
+	if ( !pRenderHdr || sequence >= pStudioHdr->GetNumSeq() || ( seqdesc.flags & ( STUDIO_REALTIME | STUDIO_CYCLEPOSE ) ) )
+	{
+		++g_nPoseCacheUncacheable;
+		return CalcPoseSingle( pStudioHdr, pos, q, seqdesc, sequence, cycle, poseParameter, boneMask, flTime );
+	}
+
+	int nCycleSteps = anim_posecache_cycle_steps.GetInt();
+	int nPoseSteps = anim_posecache_pose_steps.GetInt();
+
+	// same wrapping as CalcPoseSingle, then snap
+	if ( cycle < 0 || cycle >= 1 )
+	{
+		if ( seqdesc.flags & STUDIO_LOOPING )
+		{
+			cycle = cycle - (int)cycle;
+			if ( cycle < 0 ) cycle += 1;
+		}
+		else
+		{
+			cycle = clamp( cycle, 0.0f, 1.0f );
+		}
+	}
+
+	posecachekey_t key;
+	key.pStudioHdr = pRenderHdr;
+	key.checksum = pRenderHdr->checksum;
+	key.sequence = sequence;
+	key.boneMask = boneMask;
+	key.cycleBucket = clamp( RoundFloatToInt( cycle * nCycleSteps ), 0, nCycleSteps );
+	if ( key.cycleBucket == nCycleSteps && ( seqdesc.flags & STUDIO_LOOPING ) )
+	{
+		key.cycleBucket = 0;
+	}
+	cycle = (float)key.cycleBucket / (float)nCycleSteps;
+
+	float flPoseParameter[MAXSTUDIOPOSEPARAM];
+	memcpy( flPoseParameter, poseParameter, pStudioHdr->GetNumPoseParameters() * sizeof(float) );
+	key.poseBucket[0] = QuantizePoseParameter( pStudioHdr, seqdesc, sequence, 0, flPoseParameter, nPoseSteps );
+	key.poseBucket[1] = QuantizePoseParameter( pStudioHdr, seqdesc, sequence, 1, flPoseParameter, nPoseSteps );
+
+	int numbones = pStudioHdr->numbones();
+
+	{
+		AUTO_LOCK( g_StudioPoseCache.AccessMutex() );
+
+		UtlHashHandle_t h = g_StudioPoseCacheIndex.Find( key );
+		if ( h != g_StudioPoseCacheIndex.InvalidHandle() )
+		{
+			CPoseCacheEntry *pEntry = g_StudioPoseCache.GetResource_NoLock( g_StudioPoseCacheIndex.Element( h ) );
+			if ( pEntry && pEntry->m_key == key && pEntry->m_numbones == numbones )
+			{
+				++g_nPoseCacheHits;
+				if ( pEntry->m_bValid )
+				{
+					memcpy( q, pEntry->Quaternions(), numbones * sizeof(Quaternion) );
+					memcpy( pos, pEntry->Positions(), numbones * sizeof(Vector) );
+				}
+				return pEntry->m_bValid;
+			}
+		}
+	}
+
+	++g_nPoseCacheMisses;
+	bool bResult = CalcPoseSingle( pStudioHdr, pos, q, seqdesc, sequence, cycle, flPoseParameter, boneMask, flTime );
+
+	posecacheparams_t params;
+	params.key = key;
+	params.numbones = numbones;
+	params.pos = pos;
+	params.q = q;
+	params.bValid = bResult;
+
+	AUTO_LOCK( g_StudioPoseCache.AccessMutex() );
+
+	unsigned int nTargetSize = (unsigned int)anim_posecache_size.GetInt() * 1024;
+	if ( g_StudioPoseCache.TargetSize() != nTargetSize )
+	{
+		g_StudioPoseCache.SetTargetSize( nTargetSize );
+	}
+
+	// another thread may have filled the same slot while we were decoding
+	UtlHashHandle_t h = g_StudioPoseCacheIndex.Find( key );
+	if ( h != g_StudioPoseCacheIndex.InvalidHandle() && g_StudioPoseCache.GetResource_NoLockNoLRUTouch( g_StudioPoseCacheIndex.Element( h ) ) )
+		return bResult;
+
+	// drop index entries whose resources have been evicted
+	int nLiveEntries = g_StudioPoseCache.UsedSize() / CPoseCacheEntry::EstimatedSize( params ) + 1;
+	if ( g_StudioPoseCacheIndex.Count() > 1024 && g_StudioPoseCacheIndex.Count() > 4 * nLiveEntries )
+	{
+		for ( UtlHashHandle_t i = g_StudioPoseCacheIndex.FirstHandle(); i != g_StudioPoseCacheIndex.InvalidHandle(); )
+		{
+			if ( !g_StudioPoseCache.GetResource_NoLockNoLRUTouch( g_StudioPoseCacheIndex.Element( i ) ) )
+			{
+				i = g_StudioPoseCacheIndex.RemoveAndAdvance( i );
+			}
+			else
+			{
+				i = g_StudioPoseCacheIndex.NextHandle( i );
+			}
+		}
+	}
+
+	memhandle_t hEntry = g_StudioPoseCache.CreateResource( params );
+	g_StudioPoseCacheIndex.Element( g_StudioPoseCacheIndex.Insert( key ) ) = hEntry;
+	return bResult;
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: Studio header pointers are reused across level loads, so the pose
+//			cache must be dropped whenever models are unloaded
+//-----------------------------------------------------------------------------
+void Studio_FlushPoseCache()
+{
+	AUTO_LOCK( g_StudioPoseCache.AccessMutex() );
+	g_StudioPoseCache.FlushAll();
+	g_StudioPoseCacheIndex.Purge();
+}
+
+#if defined( CLIENT_DLL )
+CON_COMMAND_F( cl_anim_posecache_stats, "Display status of the animation pose cache (client only)", FCVAR_CHEAT )
+#else
+CON_COMMAND( sv_anim_posecache_stats, "Display status of the animation pose cache (server only)" )
+#endif
+{
+	int nHits = g_nPoseCacheHits;
+	int nMisses = g_nPoseCacheMisses;
+	int nLookups = nHits + nMisses;
+
+	AUTO_LOCK( g_StudioPoseCache.AccessMutex() );
+	Msg( "Pose cache %s: %d lookups, %d hits (%.1f%%), %d misses, %d uncacheable\n",
+		anim_posecache.GetBool() ? "enabled" : "disabled",
+		nLookups, nHits, nLookups ? 100.0f * nHits / nLookups : 0.0f, nMisses, (int)g_nPoseCacheUncacheable );
+	Msg( "  %d keys indexed, %u / %u KB used\n", g_StudioPoseCacheIndex.Count(), g_StudioPoseCache.UsedSize() / 1024, g_StudioPoseCache.TargetSize() / 1024 );
+
+	if ( args.ArgC() > 1 && !V_stricmp( args[1], "reset" ) )
+	{
+		g_nPoseCacheHits = 0;
+		g_nPoseCacheMisses = 0;
+		g_nPoseCacheUncacheable = 0;
+	}
+}
+
+
 //-----------------------------------------------------------------------------
 // Purpose: calculate a pose for a single sequence
 //			adds autolayers, runs local ik rukes
@@ -2433,7 +2708,19 @@ void CBoneSetup::AccumulatePose(
 		::InitPose( m_pStudioHdr, pos2, q2, m_boneMask );
 	}
 
-	if (CalcPoseSingle( m_pStudioHdr, pos2, q2, seqdesc, sequence, cycle, m_flPoseParameter, m_boneMask, flTime ))
+	// the pose cache only holds the bare sequence pose, so anything that feeds
+	// back into it (local layers, ik) has to take the slow path
+	bool bPose;
+	if ( anim_posecache.GetBool() && !pIKContext && !seqdesc.numiklocks && !(seqdesc.flags & STUDIO_LOCAL) )
+	{
+		bPose = CalcPoseSingleCached( m_pStudioHdr, pos2, q2, seqdesc, sequence, cycle, m_flPoseParameter, m_boneMask, flTime );
+	}
+	else
+	{
+		bPose = CalcPoseSingle( m_pStudioHdr, pos2, q2, seqdesc, sequence, cycle, m_flPoseParameter, m_boneMask, flTime );
+	}
+
+	if ( bPose )
 	{
 		// this weight is wrong, the IK rules won't composite at the correct intensity
 		AddLocalLayers( pos2, q2, seqdesc, sequence, cycle, 1.0, flTime, pIKContext );
@@ -39,6 +39,7 @@ class CUtlBuffer;
 class Color;
 typedef void * FileHandle_t;
 class CKeyValuesGrowableStringTable;
+class CKeyValuesArena;
 
 //-----------------------------------------------------------------------------
 // Purpose: Simple recursive data access class
@@ -80,6 +81,18 @@ public:
 
 	KeyValues( const char *setName );
 
+	//	Creates a root KeyValues whose descendants and their strings are bump
+	//	allocated from one arena, released all at once by deleteThis() on the root.
+	//	Use it for short lived trees like parsed script files.
+	//
+	//	An arena root can be handed around and attached anywhere like any other
+	//	KeyValues. Nodes inside the tree cannot outlive the root, so attaching one
+	//	outside its tree (AddSubKey, SetNextKey) attaches a heap copy of it instead;
+	//	keep using the tree you attached it to, not the original pointer. Arena trees
+	//	must not be deleted by another module's KeyValues code.
+	static KeyValues *CreateInArena( const char *setName, int nBlockSize = 0 );
+	bool IsInArena() const { return m_bArenaNode != 0; }
+
 	//
 	// AutoDelete class to automatically free the keyvalues.
 	// Simply construct it with the keyvalues you allocated and it will free them when falls out of scope.
@@ -120,6 +133,8 @@ public:
 	// File access. Set UsesEscapeSequences true, if resource file/buffer uses Escape Sequences (eg \n, \t)
 	void UsesEscapeSequences(bool state); // default false
 	void UsesConditionals(bool state); // default true
+	// With -kv_compiled_cache, LoadFromFile keeps a binary image of each file (and its #include/#base files)
+	// under kvcache/ and loads that instead of parsing when the sources' sizes and CRCs still match.
 	bool LoadFromFile( IBaseFileSystem *filesystem, const char *resourceName, const char *pathID = NULL, bool refreshCache = false );
 	bool SaveToFile( IBaseFileSystem *filesystem, const char *resourceName, const char *pathID = NULL, bool sortKeys = false, bool bAllowEmptyString = false, bool bCacheResult = false );
 
@@ -310,6 +325,15 @@ private:
 	void FreeAllocatedValue();
 	void AllocateValueBlock(int size);
 
+	// Arena support; these fall back to the heap for regular nodes
+	CKeyValuesArena *GetArena() const;
+	KeyValues *AllocKey( const char *keyName );
+	char *AllocValueString( int nBytes );
+	wchar_t *AllocValueWString( int nChars );
+	KeyValues *AdoptNode( KeyValues *pNode );
+	friend class CKeyValuesArena;
+	friend class CKeyValuesCompiledCache;
+
 	int m_iKeyName;	// keyname is a symbol defined in KeyValuesSystem
 
 	// These are needed out of the union because the API returns string pointers
@@ -328,7 +352,7 @@ private:
 	char	   m_iDataType;
 	char	   m_bHasEscapeSequences; // true, if while parsing this KeyValue, Escape Sequences are used (default false)
 	char	   m_bEvaluateConditionals; // true, if while parsing this KeyValue, conditionals blocks are evaluated (default true)
-	char	   unused[1];
+	char	   m_bArenaNode; // true if this node is allocated in a CKeyValuesArena
 
 	KeyValues *m_pPeer;	// pointer to next key in list
 	KeyValues *m_pSub;	// pointer to Start of a new sub key list
@@ -183,6 +183,11 @@ public:
 	// Write signed or unsigned. Range is only checked in debug.
 	void			WriteUBitLong( unsigned int data, int numbits, bool bCheckRange=true );
 	void			WriteSBitLong( int data, int numbits );
+
+	// Like WriteUBitLong, but the caller has already made sure numbits fit. data must not
+	// have bits set above numbits. WriteUBit64NoCheck writes up to 64 bits, low bits first.
+	void			WriteUBitLongNoCheck( unsigned int data, int numbits );
+	void			WriteUBit64NoCheck( uint64 data, int numbits );
 	
 	// Tell it whether or not the data is unsigned. If it's signed,
 	// cast to unsigned before passing in (it will cast back inside).
@@ -217,6 +222,11 @@ public:
 	void			WriteBitVec3Normal( const Vector& fa );
 	void			WriteBitAngles( const QAngle& fa );
 
+	// Same bits as calling WriteBitVec3Coord/WriteBitAngles for each element, but packed
+	// through a 64-bit accumulator with one room check for the whole array when it fits.
+	void			WriteBitVec3CoordArray( const Vector *pVecs, int nCount );
+	void			WriteBitAnglesArray( const QAngle *pAngles, int nCount );
+
 
 // Byte functions.
 public:
@@ -409,6 +419,13 @@ BITBUF_INLINE void bf_write::WriteUBitLong( unsigned int curData, int numbits, b
 		return;
 	}
 
+	WriteUBitLongNoCheck( curData, numbits );
+}
+
+BITBUF_INLINE void bf_write::WriteUBitLongNoCheck( unsigned int curData, int numbits ) RESTRICT
+{
+	Assert( numbits >= 0 && numbits <= 32 && numbits <= GetNumBitsLeft() );
+
 	int iCurBitMasked = m_iCurBit & 31;
 	int iDWord = m_iCurBit >> 5;
 	m_iCurBit += numbits;
@@ -439,6 +456,19 @@ BITBUF_INLINE void bf_write::WriteUBitLong( unsigned int curData, int numbits, b
 	StoreLittleDWord( pOut, 0, dword1 );
 }
 
+BITBUF_INLINE void bf_write::WriteUBit64NoCheck( uint64 data, int numbits )
+{
+	if ( numbits > 32 )
+	{
+		WriteUBitLongNoCheck( (unsigned int)data, 32 );
+		WriteUBitLongNoCheck( (unsigned int)( data >> 32 ), numbits - 32 );
+	}
+	else
+	{
+		WriteUBitLongNoCheck( (unsigned int)data, numbits );
+	}
+}
+
 // writes an unsigned integer with variable bit length
 BITBUF_INLINE void bf_write::WriteUBitVar( unsigned int data )
 {
@@ -534,6 +564,8 @@ protected:
 
 	unsigned int	CheckReadUBitLong(int numbits);		// For debugging.
 	int				ReadOneBitNoCheck();				// Faster version, doesn't check bounds and is inlined.
+	unsigned int	ReadUBitLongNoCheck( int numbits ) RESTRICT;	// Same, for callers that checked for the longest encoding up front.
+	float			ReadBitCoordNoCheck();
 	bool			CheckForOverflow(int nBits);
 
 
@@ -592,6 +624,10 @@ public:
 	void			ReadBitVec3Normal( Vector& fa );
 	void			ReadBitAngles( QAngle& fa );
 
+	// Reads what WriteBitVec3CoordArray/WriteBitAnglesArray wrote.
+	void			ReadBitVec3CoordArray( Vector *pVecs, int nCount );
+	void			ReadBitAnglesArray( QAngle *pAngles, int nCount );
+
 	// Faster for comparisons but do not fully decode float values
 	unsigned int	ReadBitCoordBits();
 	unsigned int	ReadBitCoordMPBits( bool bIntegral, bool bLowPrecision );
@@ -778,6 +814,13 @@ BITBUF_INLINE unsigned int bf_read::ReadUBitLong( int numbits ) RESTRICT
 		return 0;
 	}
 
+	return ReadUBitLongNoCheck( numbits );
+}
+
+BITBUF_INLINE unsigned int bf_read::ReadUBitLongNoCheck( int numbits ) RESTRICT
+{
+	Assert( numbits > 0 && numbits <= 32 && numbits <= GetNumBitsLeft() );
+
 	unsigned int iStartBit = m_iCurBit & 31u;
 	int iLastBit = m_iCurBit + numbits - 1;
 	unsigned int iWordOffset1 = m_iCurBit >> 5;
@@ -17,6 +17,10 @@ void CRC32_ProcessBuffer( CRC32_t *pulCRC, const void *p, int len );
 void CRC32_Final( CRC32_t *pulCRC );
 CRC32_t	CRC32_GetTableEntry( unsigned int slot );
 
+// Large buffers use PCLMULQDQ folding when the CPU has it, which is on by default.
+// The result is the same either way. Returns whether the fast path is now in use.
+bool CRC32_EnableHardwareAcceleration( bool bEnable );
+
 inline CRC32_t CRC32_ProcessSingleBuffer( const void *p, int len )
 {
 	CRC32_t crc;
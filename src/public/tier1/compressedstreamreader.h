@@ -0,0 +1,94 @@
+//========= Copyright Valve Corporation, All rights reserved. ============//
+//
+// Purpose: Decodes a compressed lump or pak entry while it is still being
+//			read, so the compressed data never has to be resident in full.
+//
+// $NoKeywords: $
+//===========================================================================//
+
+#ifndef COMPRESSEDSTREAMREADER_H
+#define COMPRESSEDSTREAMREADER_H
+#ifdef _WIN32
+#pragma once
+#endif
+
+#include "tier1/utlbuffer.h"
+#include "tier1/lzmaDecoder.h"
+#include "tier1/snappystream.h"
+
+class CJob;
+
+enum CompressedStreamFormat_t
+{
+	COMPRESSED_STREAM_LZMA = 0,		// source engine lzma_header_t followed by the lzma data
+	COMPRESSED_STREAM_LZMA_ZIP,		// zip entry, call InitZIPHeader() with the sizes from the zip directory
+	COMPRESSED_STREAM_SNAPPY,		// raw snappy, as written by snappy::Compress()
+};
+
+//-----------------------------------------------------------------------------
+// Supplies compressed bytes to a CCompressedStreamReader
+//-----------------------------------------------------------------------------
+abstract_class ICompressedStreamSource
+{
+public:
+	// Reads up to nMaxBytes into pDest. Returns the number of bytes read, 0 at the end of the data or -1 on error.
+	// Called from a thread pool job when threads are available, but never concurrently with itself.
+	virtual int ReadCompressed( void *pDest, int nMaxBytes ) = 0;
+};
+
+//-----------------------------------------------------------------------------
+// Pulls compressed data from a source in chunks and decodes it into caller
+// buffers. The next chunk is read on g_pThreadPool while the current one is
+// decoded, so only two chunks of compressed data are ever held.
+//-----------------------------------------------------------------------------
+class CCompressedStreamReader
+{
+public:
+	CCompressedStreamReader( ICompressedStreamSource *pSource, CompressedStreamFormat_t format, int nChunkSize = 64 * 1024 );
+	~CCompressedStreamReader();
+
+	// Must be called before reading a COMPRESSED_STREAM_LZMA_ZIP stream.
+	void	InitZIPHeader( unsigned int nCompressedSize, unsigned int nOriginalSize );
+
+	// Appends up to nMaxBytes of decoded data at output's put position. Returns the number of bytes written, which
+	// is only less than nMaxBytes at the end of the stream, or -1 if the data is truncated or corrupt.
+	int		ReadSegment( CUtlBuffer &output, int nMaxBytes );
+
+	// Decodes the rest of the stream into output.
+	bool	ReadAll( CUtlBuffer &output );
+
+	bool	IsFinished() const;
+
+	// Uncompressed bytes still to come. Returns false until the stream header has been read.
+	bool	GetExpectedBytesRemaining( /* out */ unsigned int &nBytesRemaining );
+
+	// Compressed bytes the decoder has consumed so far, including the stream header.
+	unsigned int GetCompressedBytesRead() const { return m_nCompressedBytesRead; }
+
+private:
+	void	ReadAhead();
+	void	StartReadAhead();
+	bool	FinishReadAhead();
+	bool	Decode( CUtlBuffer &output, unsigned int nMaxBytes );
+
+	ICompressedStreamSource		*m_pSource;
+	CompressedStreamFormat_t	m_Format;
+	CLZMAStream					m_LZMAStream;
+	CSnappyStream				m_SnappyStream;
+
+	// Compressed bytes read but not consumed by the decoder yet
+	CUtlBuffer					m_Input;
+	unsigned int				m_nCompressedBytesRead;
+
+	// The chunk being read by m_pReadJob
+	unsigned char				*m_pReadAhead;
+	int							m_nReadAheadBytes;
+	int							m_nChunkSize;
+	CJob						*m_pReadJob;
+	bool						m_bReadPending;
+
+	bool						m_bSourceDone;
+	bool						m_bError;
+};
+
+#endif // COMPRESSEDSTREAMREADER_H
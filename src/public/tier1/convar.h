@@ -319,6 +319,7 @@ class ConVar : public ConCommandBase, public IConVar
 {
 friend class CCvar;
 friend class ConVarRef;
+friend class ConVarHandle;
 
 public:
 	typedef ConCommandBase BaseClass;
@@ -557,6 +558,105 @@ FORCEINLINE_CVAR const char *ConVarRef::GetDefault() const
 }
 
 
+//-----------------------------------------------------------------------------
+// A ConVarRef for statics and globals: the name is looked up the first time
+// the handle is used rather than when it is constructed, and the result is
+// kept, so reading a convar owned by another module costs no string lookup.
+// Reads go straight to the value fields of the root ConVar without a lock.
+// Each value is an aligned 32 bit field, so a read never sees a torn value.
+// A convar that doesn't exist yet reads as 0 and is looked up again on the
+// next use.
+//-----------------------------------------------------------------------------
+class ConVarHandle
+{
+public:
+	explicit ConVarHandle( const char *pName ) : m_pName( pName ), m_pConVarState( NULL ) {}
+
+	bool IsValid() const;
+	ConVar *GetConVar() const;
+	const char *GetName() const { return m_pName; }
+
+	// Get/Set value
+	float GetFloat( void ) const;
+	int GetInt( void ) const;
+	bool GetBool() const { return !!GetInt(); }
+	const char *GetString( void ) const;
+
+	void SetValue( const char *pValue );
+	void SetValue( float flValue );
+	void SetValue( int nValue );
+	void SetValue( bool bValue );
+	void Revert();
+
+private:
+	ConVar *Resolve() const;
+	ConVar *ResolveSlow() const;
+
+	const char *m_pName;
+
+	// Root ConVar once found. Only ever goes from NULL to its final value.
+	mutable ConVar *m_pConVarState;
+};
+
+FORCEINLINE_CVAR ConVar *ConVarHandle::Resolve() const
+{
+	return m_pConVarState ? m_pConVarState : ResolveSlow();
+}
+
+FORCEINLINE_CVAR bool ConVarHandle::IsValid() const
+{
+	return Resolve() == m_pConVarState;
+}
+
+FORCEINLINE_CVAR ConVar *ConVarHandle::GetConVar() const
+{
+	return IsValid() ? m_pConVarState : NULL;
+}
+
+FORCEINLINE_CVAR float ConVarHandle::GetFloat( void ) const
+{
+	return Resolve()->m_fValue;
+}
+
+FORCEINLINE_CVAR int ConVarHandle::GetInt( void ) const
+{
+	return Resolve()->m_nValue;
+}
+
+FORCEINLINE_CVAR const char *ConVarHandle::GetString( void ) const
+{
+	return Resolve()->GetString();
+}
+
+FORCEINLINE_CVAR void ConVarHandle::SetValue( const char *pValue )
+{
+	Resolve()->SetValue( pValue );
+}
+
+FORCEINLINE_CVAR void ConVarHandle::SetValue( float flValue )
+{
+	Resolve()->SetValue( flValue );
+}
+
+FORCEINLINE_CVAR void ConVarHandle::SetValue( int nValue )
+{
+	Resolve()->SetValue( nValue );
+}
+
+FORCEINLINE_CVAR void ConVarHandle::SetValue( bool bValue )
+{
+	Resolve()->SetValue( bValue ? 1 : 0 );
+}
+
+FORCEINLINE_CVAR void ConVarHandle::Revert()
+{
+	if ( IsValid() )
+	{
+		m_pConVarState->Revert();
+	}
+}
+
+
 //-----------------------------------------------------------------------------
 // Called by the framework to register ConCommands with the ICVar
 //-----------------------------------------------------------------------------
@@ -570,6 +670,16 @@ void ConVar_Unregister( );
 void ConVar_PrintFlags( const ConCommandBase *var );
 void ConVar_PrintDescription( const ConCommandBase *pVar );
 
+// g_pCVar->FindVar, counting the lookup by name while an audit is running.
+// ConVarRef and ConVarHandle look their convars up through this.
+ConVar *ConVar_FindVar( const char *pName );
+
+// Starts counting FindVar lookups in this module, clearing the old counts, or stops
+void ConVar_EnableFindVarAudit( bool bEnable );
+
+// Lists the most frequently looked up convar names in this module
+void ConVar_PrintFindVarAudit( int nMaxEntries );
+
 
 //-----------------------------------------------------------------------------
 // Purpose: Utility class to quickly allow ConCommands to call member methods
@@ -35,6 +35,7 @@ struct lzma_header_t
 #pragma pack()
 
 class CLZMAStream;
+class CUtlBuffer;
 
 class CLZMA
 {
@@ -68,10 +69,18 @@ public:
 	           unsigned char *pOutput, unsigned int nMaxOutputBytes,
 	           /* out */ unsigned int &nCompressedBytesRead, /* out */ unsigned int &nOutputBytesWritten );
 
+	// Same as above, but consumes from input's get position and appends up to nMaxOutputBytes at output's put
+	// position, growing output as needed. Successive calls can target the same buffer or separate segments, the
+	// decoder keeps its own dictionary.
+	bool Read( CUtlBuffer &input, CUtlBuffer &output, unsigned int nMaxOutputBytes );
+
 	// Get the expected uncompressed bytes yet to be read from this stream. Returns false if not yet known, such as
 	// before being fed the header.
 	bool GetExpectedBytesRemaining( /* out */ unsigned int &nBytesRemaining );
 
+	// True once all of the expected output has been produced.
+	bool IsFinished() const { return m_bParsedHeader && m_nActualBytesRead == m_nActualSize; }
+
 private:
 	enum eHeaderParse
 	{
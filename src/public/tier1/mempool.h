@@ -123,7 +123,71 @@ public:
 	// Frees everything
 	void		Clear() { AUTO_LOCK( m_mutex ); return CUtlMemoryPool::Clear(); }
 private:
-	CThreadFastMutex m_mutex; // @TODO: Rework to use tslist (toml 7/6/2007)
+	CThreadFastMutex m_mutex; // @TODO: Rework to use tslist (toml 7/6/2007) -- see CMemoryPoolTS
+};
+
+
+//-----------------------------------------------------------------------------
+// Thread safe pool that keeps a small magazine of free blocks for each thread,
+// so most Alloc/Free calls don't touch anything shared. When a thread's
+// magazine fills up, half of it goes onto a lock-free list that every thread
+// refills from before taking the mutex on the underlying pool. That's also how
+// blocks freed on a different thread than the one that allocated them get back
+// into circulation. Blocks are aligned to TSLIST_NODE_ALIGNMENT.
+//
+// Left separate from CMemoryPoolMT, whose layout prebuilt libraries depend on.
+//-----------------------------------------------------------------------------
+class CMemoryPoolTS
+{
+public:
+	CMemoryPoolTS( int blockSize, int numElements, int growMode = UTLMEMORYPOOL_GROW_FAST, const char *pszAllocOwner = NULL );
+	~CMemoryPoolTS();
+
+	void*		Alloc();
+	void*		Alloc( size_t amount );
+	void*		AllocZero();
+	void*		AllocZero( size_t amount );
+	void		Free( void *pMem );
+
+	// Frees everything. No other thread may be using the pool.
+	void		Clear();
+
+	// Hands the calling thread's cached blocks back to the shared list. Worker threads
+	// should call this before exiting, or their blocks stay parked until Clear().
+	void		FlushThreadCache();
+
+	// Blocks handed out and not yet freed. Blocks sitting in the caches don't count.
+	int			Count() const		{ return m_nBlocksAllocated; }
+	int			PeakCount() const	{ return m_nPeakAlloc; }
+	int			BlockSize() const	{ return m_nBlockSize; }
+
+private:
+	enum
+	{
+		MAGAZINE_SIZE = 32,
+	};
+
+	struct Magazine_t
+	{
+		int		m_nCount;
+		void	*m_pBlocks[MAGAZINE_SIZE];
+	};
+
+	Magazine_t	*GetMagazine();
+	bool		Refill( Magazine_t *pMagazine );
+	void		Spill( Magazine_t *pMagazine, int nBlocks );
+	void		ReturnCachedBlocks();
+
+	CTSListBase					m_FreeBlocks;
+	CThreadLocalPtr<Magazine_t>	m_pLocalMagazine;
+	CInterlockedInt				m_nBlocksAllocated;
+	CInterlockedInt				m_nPeakAlloc;
+	int							m_nBlockSize;
+
+	// Everything below is guarded by m_mutex
+	CThreadFastMutex			m_mutex;
+	CUtlMemoryPool				m_Pool;
+	CUtlVector<Magazine_t *>	m_Magazines;
 };
 
 
@@ -363,6 +427,18 @@ inline void CClassMemoryPool<T>::Clear()
 #define DEFINE_FIXEDSIZE_ALLOCATOR_MT( _class, _initsize, _grow )					\
 	CMemoryPoolMT   _class::s_Allocator(sizeof(_class), _initsize, _grow, #_class " pool")
 
+#define DECLARE_FIXEDSIZE_ALLOCATOR_TS( _class )									\
+	public:																		\
+	   inline void* operator new( size_t size ) { MEM_ALLOC_CREDIT_(#_class " pool"); return s_Allocator.Alloc(size); }   \
+	   inline void* operator new( size_t size, int nBlockUse, const char *pFileName, int nLine ) { MEM_ALLOC_CREDIT_(#_class " pool"); return s_Allocator.Alloc(size); }   \
+	   inline void  operator delete( void* p ) { s_Allocator.Free(p); }		\
+	   inline void  operator delete( void* p, int nBlockUse, const char *pFileName, int nLine ) { s_Allocator.Free(p); }   \
+	private:																		\
+		static   CMemoryPoolTS   s_Allocator
+
+#define DEFINE_FIXEDSIZE_ALLOCATOR_TS( _class, _initsize, _grow )					\
+	CMemoryPoolTS   _class::s_Allocator(sizeof(_class), _initsize, _grow, #_class " pool")
+
 //-----------------------------------------------------------------------------
 // Macros that make it simple to make a class use a fixed-size allocator
 // This version allows us to use a memory pool which is externally defined...
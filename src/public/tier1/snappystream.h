@@ -0,0 +1,74 @@
+//========= Copyright Valve Corporation, All rights reserved. ============//
+//
+// Purpose: Incremental decoder for raw snappy data (see tier1/snappy.h), for
+//			when neither the whole compressed input nor the whole output is
+//			available at once.
+//
+// $NoKeywords: $
+//===========================================================================//
+
+#ifndef SNAPPYSTREAM_H
+#define SNAPPYSTREAM_H
+#ifdef _WIN32
+#pragma once
+#endif
+
+class CUtlBuffer;
+
+//-----------------------------------------------------------------------------
+// Decodes the output of snappy::Compress / snappy::RawCompress a piece at a
+// time, with the same interface as CLZMAStream. Back references are resolved
+// against a private window of the last snappy::kBlockSize output bytes, so
+// each call may write into an unrelated output buffer.
+//-----------------------------------------------------------------------------
+class CSnappyStream
+{
+public:
+	CSnappyStream();
+	~CSnappyStream();
+
+	// Attempt to read up to nMaxInputBytes from the compressed stream, writing up to nMaxOutputBytes to pOutput.
+	// Makes progress until blocked on input or output, and never reads past the end of the stream.
+	// Returns false if the data is corrupt, or if called at EOF (GetExpectedBytesRemaining == 0)
+	bool Read( const unsigned char *pInput, unsigned int nMaxInputBytes,
+	           unsigned char *pOutput, unsigned int nMaxOutputBytes,
+	           /* out */ unsigned int &nCompressedBytesRead, /* out */ unsigned int &nOutputBytesWritten );
+
+	// Same as above, but consumes from input's get position and appends up to nMaxOutputBytes at output's put
+	// position, growing output as needed.
+	bool Read( CUtlBuffer &input, CUtlBuffer &output, unsigned int nMaxOutputBytes );
+
+	// Get the expected uncompressed bytes yet to be read from this stream. Returns false if not yet known, such as
+	// before being fed the length preamble.
+	bool GetExpectedBytesRemaining( /* out */ unsigned int &nBytesRemaining );
+
+	// True once all of the expected output has been produced.
+	bool IsFinished() const { return m_eState == eState_Tag && m_nTagBytes == 0 && m_nActualBytesRead == m_nActualSize; }
+
+private:
+	enum eState
+	{
+		eState_Preamble,		// reading the varint uncompressed length
+		eState_Tag,				// reading a tag and its length/offset bytes
+		eState_Literal,			// copying m_nPending literal bytes from the input
+		eState_Copy,			// copying m_nPending bytes from m_nCopyOffset back in the window
+		eState_Error
+	};
+
+	bool ParseTag();
+	void AppendToWindow( const unsigned char *pData, unsigned int nBytes );
+
+	unsigned char	*m_pWindow;
+	unsigned int	m_nWindowPos;
+
+	unsigned int	m_nActualSize;
+	unsigned int	m_nActualBytesRead;
+	unsigned int	m_nPending;
+	unsigned int	m_nCopyOffset;
+
+	eState			m_eState;
+	unsigned int	m_nTagBytes;
+	unsigned char	m_Tag[5];
+};
+
+#endif // SNAPPYSTREAM_H
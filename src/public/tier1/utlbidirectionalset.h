@@ -241,8 +241,30 @@ bool CBidirectionalSet<CBucketHandle,CElementHandle,S,I>::IsElementInBucket( CBu
 template< class CBucketHandle, class CElementHandle, class S, class I >
 void CBidirectionalSet<CBucketHandle,CElementHandle,S,I>::RemoveElementFromBucket( CBucketHandlePram bucket, CElementHandlePram element )
 {
-	// FIXME: Implement me!
-	Assert(0);
+	Assert( m_FirstBucket && m_FirstElement );
+
+	// Find the bucket in the element's list of buckets
+	I i = m_FirstBucket( element );
+	while ( i != m_BucketsUsedByElement.InvalidIndex() )
+	{
+		if ( m_BucketsUsedByElement[i].m_Bucket == bucket )
+			break;
+		i = m_BucketsUsedByElement.Next( i );
+	}
+
+	if ( i == m_BucketsUsedByElement.InvalidIndex() )
+		return;
+
+	// Unhook the element from the bucket's list of elements
+	I elementListIndex = m_BucketsUsedByElement[i].m_ElementListIndex;
+	if ( elementListIndex == m_FirstElement( bucket ) )
+		m_FirstElement( bucket ) = m_ElementsInBucket.Next( elementListIndex );
+	m_ElementsInBucket.Free( elementListIndex );
+
+	// Unhook the bucket from the element's list of buckets
+	if ( i == m_FirstBucket( element ) )
+		m_FirstBucket( element ) = m_BucketsUsedByElement.Next( i );
+	m_BucketsUsedByElement.Free( i );
 }
 
 
@@ -0,0 +1,547 @@
+//========= Copyright Valve Corporation, All rights reserved. ============//
+//
+// Purpose: an open addressing hashtable with one control byte per slot,
+// probed sixteen slots at a time. Same interface as CUtlHashtable for the
+// common operations, for dictionaries that see far more lookups than
+// removals (string pools, name -> object maps).
+//
+// Usage notes:
+// - handles are NOT STABLE across insertion. Removal does not move any
+//   other element, so handles stay valid across Remove/RemoveAndAdvance.
+// - Insert() first searches for an existing match and returns it if found
+// - a value type of "empty_t" can be used to eliminate value storage and
+//   switch Element() to return const Key references instead of values
+// - hash functor is exposed via GetHashRef(), comparison via GetEqualRef()
+// - hashes are not stored, so growing the table re-hashes every key
+//
+// Implementation notes:
+// - the table is an array of control bytes plus a parallel array of
+//   key/value pairs. A control byte is CTRL_EMPTY, CTRL_DELETED, or the
+//   low 7 bits of the hash of the key in that slot.
+// - slots are split into groups of 16. The rest of the hash picks the
+//   first group to look at; further groups are probed quadratically.
+// - a lookup compares the 7 hash bits against a whole group at once and
+//   only calls the equality functor on matching slots. A group with an
+//   empty slot ends the probe sequence.
+// - removal leaves a CTRL_DELETED tombstone unless its group already has
+//   an empty slot. Tombstones are reused by insertion and cleared when
+//   the table is rebuilt.
+// - load (including tombstones) is kept below 7/8.
+//
+// CUtlSwissHashtable< const char* >  setOfStringPointers;
+// CUtlSwissHashtable< CUtlConstString, int >  mapFromStringsToInts;
+//
+// $NoKeywords: $
+//=============================================================================//
+
+#ifndef UTLSWISSHASHTABLE_H
+#define UTLSWISSHASHTABLE_H
+#pragma once
+
+#include "utlhashtable.h"
+
+// Groups are matched with SSE2 wherever the compiler may assume it, otherwise
+// a byte at a time.
+#if ( defined( _M_X64 ) || ( defined( _M_IX86_FP ) && _M_IX86_FP >= 2 ) || defined( __SSE2__ ) ) && !defined( _X360 ) && !defined( _PS3 )
+#define UTLSWISSHASHTABLE_SSE2
+#include <emmintrin.h>
+#endif
+
+#if defined( _MSC_VER ) && !defined( _X360 )
+#include <intrin.h>
+#pragma intrinsic(_BitScanForward)
+#endif
+
+template <typename KeyT, typename ValueT = empty_t, typename KeyHashT = DefaultHashFunctor<KeyT>, typename KeyIsEqualT = DefaultEqualFunctor<KeyT>, typename AlternateKeyT = typename ArgumentTypeInfo<KeyT>::Alt_t >
+class CUtlSwissHashtable
+{
+public:
+	typedef UtlHashHandle_t handle_t;
+
+protected:
+	typedef CUtlKeyValuePair<KeyT, ValueT> KVPair;
+	typedef typename ArgumentTypeInfo<KeyT>::Arg_t KeyArg_t;
+	typedef typename ArgumentTypeInfo<ValueT>::Arg_t ValueArg_t;
+	typedef typename ArgumentTypeInfo<AlternateKeyT>::Arg_t KeyAlt_t;
+
+	enum
+	{
+		GROUP_SIZE = 16,
+		CTRL_EMPTY = 0x80,		// must be the only values with the high bit set
+		CTRL_DELETED = 0xFE,
+		MASK_H2 = 0x7F,
+	};
+
+	CUtlMemory< uint8 > m_ctrl;
+	CUtlMemory< KVPair > m_slots;
+	int m_nUsed;
+	int m_nGrowthLeft;		// insertions into empty slots left before the table must be rebuilt
+	int m_nMinSize;
+	KeyIsEqualT m_eq;
+	KeyHashT m_hash;
+
+	static FORCEINLINE uint8 H2( unsigned int h ) { return (uint8)( h & MASK_H2 ); }
+	FORCEINLINE unsigned int FirstGroup( unsigned int h ) const { return ( h >> 7 ) & GroupMask(); }
+	FORCEINLINE unsigned int GroupMask() const { return ( (unsigned int)m_ctrl.Count() / GROUP_SIZE ) - 1; }
+
+	// Bit i of each mask is set if slot i of the group at pCtrl qualifies
+	static FORCEINLINE uint32 MatchH2( const uint8 *pCtrl, uint8 h2 );
+	static FORCEINLINE uint32 MatchEmpty( const uint8 *pCtrl );
+	static FORCEINLINE uint32 MatchEmptyOrDeleted( const uint8 *pCtrl );
+	static FORCEINLINE uint32 MatchFull( const uint8 *pCtrl );
+	static FORCEINLINE int LowestBit( uint32 mask );
+
+	// Build a new table of at least this many slots and move the contents over
+	void DoRealloc( int size );
+
+	// First empty or deleted slot in the probe sequence for this hash
+	int FindInsertSlot( unsigned int h ) const;
+
+	// Claim a slot for a key known not to be in the table, leaves the KVPair unconstructed
+	int DoInsertUnconstructed( unsigned int h );
+
+	template <typename KeyParamT> handle_t DoLookup( KeyParamT x, unsigned int h ) const;
+	template <typename KeyParamT> handle_t DoInsert( KeyParamT k, unsigned int h );
+	template <typename KeyParamT> handle_t DoInsert( KeyParamT k, typename ArgumentTypeInfo<ValueT>::Arg_t v, unsigned int h, bool *pDidInsert );
+	void DoRemoveAt( handle_t idx );
+
+public:
+	explicit CUtlSwissHashtable( int minimumSize = 32 )
+		: m_nUsed(0), m_nGrowthLeft(0), m_nMinSize(MAX(GROUP_SIZE, minimumSize)), m_eq(), m_hash() { }
+
+	CUtlSwissHashtable( int minimumSize, const KeyHashT &hash, KeyIsEqualT const &eq = KeyIsEqualT() )
+		: m_nUsed(0), m_nGrowthLeft(0), m_nMinSize(MAX(GROUP_SIZE, minimumSize)), m_eq(eq), m_hash(hash) { }
+
+	~CUtlSwissHashtable() { RemoveAll(); }
+
+	// Functor/function-pointer access
+	KeyHashT& GetHashRef() { return m_hash; }
+	KeyIsEqualT& GetEqualRef() { return m_eq; }
+	KeyHashT const &GetHashRef() const { return m_hash; }
+	KeyIsEqualT const &GetEqualRef() const { return m_eq; }
+
+	// Handle validation
+	bool IsValidHandle( handle_t idx ) const { return (unsigned)idx < (unsigned)m_ctrl.Count() && !( m_ctrl[idx] & CTRL_EMPTY ); }
+	static handle_t InvalidHandle() { return (handle_t) -1; }
+
+	// Iteration functions
+	handle_t FirstHandle() const { return NextHandle( (handle_t) -1 ); }
+	handle_t NextHandle( handle_t start ) const;
+
+	// Returns the number of unique keys in the table
+	int Count() const { return m_nUsed; }
+
+	// Key lookup, returns InvalidHandle() if not found
+	handle_t Find( KeyArg_t k ) const { return DoLookup<KeyArg_t>( k, m_hash(k) ); }
+	handle_t Find( KeyArg_t k, unsigned int hash) const { Assert( hash == m_hash(k) ); return DoLookup<KeyArg_t>( k, hash ); }
+	// Alternate-type key lookup, returns InvalidHandle() if not found
+	handle_t Find( KeyAlt_t k ) const { return DoLookup<KeyAlt_t>( k, m_hash(k) ); }
+	handle_t Find( KeyAlt_t k, unsigned int hash) const { Assert( hash == m_hash(k) ); return DoLookup<KeyAlt_t>( k, hash ); }
+
+	// True if the key is in the table
+	bool HasElement( KeyArg_t k ) const { return InvalidHandle() != Find( k ); }
+	bool HasElement( KeyAlt_t k ) const { return InvalidHandle() != Find( k ); }
+
+	// Key insertion or lookup, always returns a valid handle
+	handle_t Insert( KeyArg_t k ) { return DoInsert<KeyArg_t>( k, m_hash(k) ); }
+	handle_t Insert( KeyArg_t k, ValueArg_t v, bool *pDidInsert = NULL ) { return DoInsert<KeyArg_t>( k, v, m_hash(k), pDidInsert ); }
+	handle_t Insert( KeyArg_t k, ValueArg_t v, unsigned int hash, bool *pDidInsert = NULL ) { Assert( hash == m_hash(k) ); return DoInsert<KeyArg_t>( k, v, hash, pDidInsert ); }
+	// Alternate-type key insertion or lookup, always returns a valid handle
+	handle_t Insert( KeyAlt_t k ) { return DoInsert<KeyAlt_t>( k, m_hash(k) ); }
+	handle_t Insert( KeyAlt_t k, ValueArg_t v, bool *pDidInsert = NULL ) { return DoInsert<KeyAlt_t>( k, v, m_hash(k), pDidInsert ); }
+	handle_t Insert( KeyAlt_t k, ValueArg_t v, unsigned int hash, bool *pDidInsert = NULL ) { Assert( hash == m_hash(k) ); return DoInsert<KeyAlt_t>( k, v, hash, pDidInsert ); }
+
+	// Key removal, returns false if not found
+	bool Remove( KeyArg_t k ) { handle_t idx = Find( k ); if ( idx == InvalidHandle() ) return false; DoRemoveAt( idx ); return true; }
+	bool Remove( KeyArg_t k, unsigned int hash ) { handle_t idx = Find( k, hash ); if ( idx == InvalidHandle() ) return false; DoRemoveAt( idx ); return true; }
+	// Alternate-type key removal, returns false if not found
+	bool Remove( KeyAlt_t k ) { handle_t idx = Find( k ); if ( idx == InvalidHandle() ) return false; DoRemoveAt( idx ); return true; }
+	bool Remove( KeyAlt_t k, unsigned int hash ) { handle_t idx = Find( k, hash ); if ( idx == InvalidHandle() ) return false; DoRemoveAt( idx ); return true; }
+
+	// Remove while iterating, returns the next handle for forward iteration
+	handle_t RemoveAndAdvance( handle_t idx ) { Assert( IsValidHandle( idx ) ); DoRemoveAt( idx ); return NextHandle( idx ); }
+
+	// Nuke contents
+	void RemoveAll();
+
+	// Nuke and release memory.
+	void Purge() { RemoveAll(); m_ctrl.Purge(); m_slots.Purge(); m_nGrowthLeft = 0; }
+
+	// Reserve table capacity up front to avoid reallocation during insertions
+	void Reserve( int expected ) { if ( expected > m_nUsed + m_nGrowthLeft ) DoRealloc( expected * 8 / 7 + 1 ); }
+
+	// Shrink to best-fit size and clear out tombstones
+	void Compact( bool bMinimal ) { DoRealloc( bMinimal ? m_nUsed * 8 / 7 + 1 : ( m_nUsed * 16 / 7 ) ); }
+
+	// Access functions. Note: if ValueT is empty_t, all functions return const keys.
+	typedef typename KVPair::ValueReturn_t Element_t;
+	KeyT const &Key( handle_t idx ) const { Assert( IsValidHandle( idx ) ); return m_slots[idx].m_key; }
+	Element_t const &Element( handle_t idx ) const { Assert( IsValidHandle( idx ) ); return m_slots[idx].GetValue(); }
+	Element_t &Element(handle_t idx) { Assert( IsValidHandle( idx ) ); return m_slots[idx].GetValue(); }
+	Element_t const &operator[]( handle_t idx ) const { return Element( idx ); }
+	Element_t &operator[]( handle_t idx ) { return Element( idx ); }
+
+	void ReplaceKey( handle_t idx, KeyArg_t k ) { Assert( m_eq( m_slots[idx].m_key, k ) && m_hash( k ) == m_hash( m_slots[idx].m_key ) ); m_slots[idx].m_key = k; }
+	void ReplaceKey( handle_t idx, KeyAlt_t k ) { Assert( m_eq( m_slots[idx].m_key, k ) && m_hash( k ) == m_hash( m_slots[idx].m_key ) ); m_slots[idx].m_key = k; }
+
+	Element_t const &Get( KeyArg_t k, Element_t const &defaultValue ) const { handle_t h = Find( k ); if ( h != InvalidHandle() ) return Element( h ); return defaultValue; }
+	Element_t const &Get( KeyAlt_t k, Element_t const &defaultValue ) const { handle_t h = Find( k ); if ( h != InvalidHandle() ) return Element( h ); return defaultValue; }
+
+	Element_t const *GetPtr( KeyArg_t k ) const { handle_t h = Find(k); if ( h != InvalidHandle() ) return &Element( h ); return NULL; }
+	Element_t const *GetPtr( KeyAlt_t k ) const { handle_t h = Find(k); if ( h != InvalidHandle() ) return &Element( h ); return NULL; }
+	Element_t *GetPtr( KeyArg_t k ) { handle_t h = Find( k ); if ( h != InvalidHandle() ) return &Element( h ); return NULL; }
+	Element_t *GetPtr( KeyAlt_t k ) { handle_t h = Find( k ); if ( h != InvalidHandle() ) return &Element( h ); return NULL; }
+
+	// Swap memory and contents with another identical hashtable
+	// (NOTE: if using function pointers or functors with state,
+	//  it is up to the caller to ensure that they are compatible!)
+	void Swap( CUtlSwissHashtable &other )
+	{
+		m_ctrl.Swap( other.m_ctrl );
+		m_slots.Swap( other.m_slots );
+		::V_swap( m_nUsed, other.m_nUsed );
+		::V_swap( m_nGrowthLeft, other.m_nGrowthLeft );
+	}
+
+#if _DEBUG
+	// Validate the integrity of the hashtable
+	void DbgCheckIntegrity() const;
+#endif
+
+private:
+	CUtlSwissHashtable( const CUtlSwissHashtable& copyConstructorIsNotImplemented );
+	CUtlSwissHashtable &operator=( const CUtlSwissHashtable& assignmentIsNotImplemented );
+};
+
+
+#ifdef UTLSWISSHASHTABLE_SSE2
+
+template <typename KeyT, typename ValueT, typename KeyHashT, typename KeyIsEqualT, typename AltKeyT>
+FORCEINLINE uint32 CUtlSwissHashtable<KeyT, ValueT, KeyHashT, KeyIsEqualT, AltKeyT>::MatchH2( const uint8 *pCtrl, uint8 h2 )
+{
+	__m128i ctrl = _mm_loadu_si128( (const __m128i *)pCtrl );
+	return (uint32)_mm_movemask_epi8( _mm_cmpeq_epi8( ctrl, _mm_set1_epi8( (char)h2 ) ) );
+}
+
+template <typename KeyT, typename ValueT, typename KeyHashT, typename KeyIsEqualT, typename AltKeyT>
+FORCEINLINE uint32 CUtlSwissHashtable<KeyT, ValueT, KeyHashT, KeyIsEqualT, AltKeyT>::MatchEmpty( const uint8 *pCtrl )
+{
+	return MatchH2( pCtrl, CTRL_EMPTY );
+}
+
+template <typename KeyT, typename ValueT, typename KeyHashT, typename KeyIsEqualT, typename AltKeyT>
+FORCEINLINE uint32 CUtlSwissHashtable<KeyT, ValueT, KeyHashT, KeyIsEqualT, AltKeyT>::MatchEmptyOrDeleted( const uint8 *pCtrl )
+{
+	// Both are negative as signed bytes
+	return (uint32)_mm_movemask_epi8( _mm_loadu_si128( (const __m128i *)pCtrl ) );
+}
+
+#else
+
+template <typename KeyT, typename ValueT, typename KeyHashT, typename KeyIsEqualT, typename AltKeyT>
+FORCEINLINE uint32 CUtlSwissHashtable<KeyT, ValueT, KeyHashT, KeyIsEqualT, AltKeyT>::MatchH2( const uint8 *pCtrl, uint8 h2 )
+{
+	uint32 mask = 0;
+	for ( int i = 0; i < GROUP_SIZE; ++i )
+	{
+		mask |= (uint32)( pCtrl[i] == h2 ) << i;
+	}
+	return mask;
+}
+
+template <typename KeyT, typename ValueT, typename KeyHashT, typename KeyIsEqualT, typename AltKeyT>
+FORCEINLINE uint32 CUtlSwissHashtable<KeyT, ValueT, KeyHashT, KeyIsEqualT, AltKeyT>::MatchEmpty( const uint8 *pCtrl )
+{
+	return MatchH2( pCtrl, CTRL_EMPTY );
+}
+
+template <typename KeyT, typename ValueT, typename KeyHashT, typename KeyIsEqualT, typename AltKeyT>
+FORCEINLINE uint32 CUtlSwissHashtable<KeyT, ValueT, KeyHashT, KeyIsEqualT, AltKeyT>::MatchEmptyOrDeleted( const uint8 *pCtrl )
+{
+	uint32 mask = 0;
+	for ( int i = 0; i < GROUP_SIZE; ++i )
+	{
+		mask |= (uint32)( pCtrl[i] >> 7 ) << i;
+	}
+	return mask;
+}
+
+#endif // UTLSWISSHASHTABLE_SSE2
+
+template <typename KeyT, typename ValueT, typename KeyHashT, typename KeyIsEqualT, typename AltKeyT>
+FORCEINLINE uint32 CUtlSwissHashtable<KeyT, ValueT, KeyHashT, KeyIsEqualT, AltKeyT>::MatchFull( const uint8 *pCtrl )
+{
+	return MatchEmptyOrDeleted( pCtrl ) ^ 0xFFFF;
+}
+
+template <typename KeyT, typename ValueT, typename KeyHashT, typename KeyIsEqualT, typename AltKeyT>
+FORCEINLINE int CUtlSwissHashtable<KeyT, ValueT, KeyHashT, KeyIsEqualT, AltKeyT>::LowestBit( uint32 mask )
+{
+	Assert( mask );
+#if defined( _MSC_VER ) && !defined( _X360 )
+	unsigned long nBit;
+	_BitScanForward( &nBit, mask );
+	return (int)nBit;
+#elif defined( __GNUC__ )
+	return __builtin_ctz( mask );
+#else
+	int nBit = 0;
+	while ( !( mask & 1 ) )
+	{
+		mask >>= 1;
+		++nBit;
+	}
+	return nBit;
+#endif
+}
+
+
+// Allocate an empty table and then move all existing entries over.
+template <typename KeyT, typename ValueT, typename KeyHashT, typename KeyIsEqualT, typename AltKeyT>
+void CUtlSwissHashtable<KeyT, ValueT, KeyHashT, KeyIsEqualT, AltKeyT>::DoRealloc( int size )
+{
+	size = SmallestPowerOfTwoGreaterOrEqual( MAX( m_nMinSize, size ) );
+	Assert( size >= GROUP_SIZE && size > m_nUsed );
+
+	CUtlMemory<uint8> oldCtrl;
+	CUtlMemory<KVPair> oldSlots;
+	oldCtrl.Swap( m_ctrl );
+	oldSlots.Swap( m_slots );
+
+	m_ctrl.EnsureCapacity( size );
+	m_slots.EnsureCapacity( size );
+	memset( m_ctrl.Base(), CTRL_EMPTY, size );
+	m_nGrowthLeft = size - size / 8 - m_nUsed;
+
+	// Keys are relocated bitwise, the same as CUtlHashtable does
+	const uint8 *pOldCtrl = oldCtrl.Base();
+	KVPair *pOldSlots = oldSlots.Base();
+	int nLeftToMove = m_nUsed;
+	for ( int i = 0; nLeftToMove && i < oldCtrl.Count(); ++i )
+	{
+		if ( !( pOldCtrl[i] & CTRL_EMPTY ) )
+		{
+			unsigned int h = m_hash( pOldSlots[i].m_key );
+			int newIdx = FindInsertSlot( h );
+			m_ctrl[newIdx] = H2( h );
+			memcpy( (void*)&m_slots[newIdx], (const void*)&pOldSlots[i], sizeof( KVPair ) );
+			--nLeftToMove;
+		}
+	}
+	Assert( nLeftToMove == 0 );
+}
+
+
+template <typename KeyT, typename ValueT, typename KeyHashT, typename KeyIsEqualT, typename AltKeyT>
+int CUtlSwissHashtable<KeyT, ValueT, KeyHashT, KeyIsEqualT, AltKeyT>::FindInsertSlot( unsigned int h ) const
+{
+	const uint8 *pCtrl = m_ctrl.Base();
+	unsigned int groupmask = GroupMask();
+	unsigned int group = FirstGroup( h );
+	for ( unsigned int nProbe = 1; ; ++nProbe )
+	{
+		uint32 mask = MatchEmptyOrDeleted( pCtrl + group * GROUP_SIZE );
+		if ( mask )
+		{
+			return group * GROUP_SIZE + LowestBit( mask );
+		}
+
+		// Triangular steps visit every group of a power of two table
+		Assert( nProbe <= groupmask + 1 );
+		group = ( group + nProbe ) & groupmask;
+	}
+}
+
+
+template <typename KeyT, typename ValueT, typename KeyHashT, typename KeyIsEqualT, typename AltKeyT>
+int CUtlSwissHashtable<KeyT, ValueT, KeyHashT, KeyIsEqualT, AltKeyT>::DoInsertUnconstructed( unsigned int h )
+{
+	if ( m_ctrl.Count() == 0 )
+	{
+		DoRealloc( m_nMinSize );
+	}
+
+	int idx = FindInsertSlot( h );
+	if ( m_nGrowthLeft == 0 && m_ctrl[idx] == CTRL_EMPTY )
+	{
+		// Out of empty slots. Rebuilding at a load of 7/16 doubles the
+		// table if it is really full, or just drops tombstones if not.
+		DoRealloc( ( m_nUsed + 1 ) * 16 / 7 );
+		idx = FindInsertSlot( h );
+	}
+
+	if ( m_ctrl[idx] == CTRL_EMPTY )
+	{
+		--m_nGrowthLeft;
+	}
+	m_ctrl[idx] = H2( h );
+	++m_nUsed;
+	return idx;
+}
+
+
+// Key lookup
+template <typename KeyT, typename ValueT, typename KeyHashT, typename KeyIsEqualT, typename AltKeyT>
+template <typename KeyParamT>
+UtlHashHandle_t CUtlSwissHashtable<KeyT, ValueT, KeyHashT, KeyIsEqualT, AltKeyT>::DoLookup( KeyParamT x, unsigned int h ) const
+{
+	if ( m_nUsed == 0 )
+	{
+		// Empty table.
+		return (handle_t) -1;
+	}
+
+	const uint8 *pCtrl = m_ctrl.Base();
+	const KVPair *pSlots = m_slots.Base();
+	unsigned int groupmask = GroupMask();
+	unsigned int group = FirstGroup( h );
+	uint8 h2 = H2( h );
+	for ( unsigned int nProbe = 1; ; ++nProbe )
+	{
+		const uint8 *pGroup = pCtrl + group * GROUP_SIZE;
+		for ( uint32 mask = MatchH2( pGroup, h2 ); mask; mask &= mask - 1 )
+		{
+			unsigned int idx = group * GROUP_SIZE + LowestBit( mask );
+			if ( m_eq( pSlots[idx].m_key, x ) )
+				return (handle_t) idx;
+		}
+
+		// Insertion would have stopped at the first empty slot
+		if ( MatchEmpty( pGroup ) )
+			return (handle_t) -1;
+
+		if ( nProbe > groupmask )
+			return (handle_t) -1;
+		group = ( group + nProbe ) & groupmask;
+	}
+}
+
+
+// Key insertion, or return index of existing key if found
+template <typename KeyT, typename ValueT, typename KeyHashT, typename KeyIsEqualT, typename AltKeyT>
+template <typename KeyParamT>
+UtlHashHandle_t CUtlSwissHashtable<KeyT, ValueT, KeyHashT, KeyIsEqualT, AltKeyT>::DoInsert( KeyParamT k, unsigned int h )
+{
+	handle_t idx = DoLookup<KeyParamT>( k, h );
+	if ( idx == (handle_t) -1 )
+	{
+		idx = (handle_t) DoInsertUnconstructed( h );
+		ConstructOneArg( &m_slots[ idx ], k );
+	}
+	return idx;
+}
+
+// Key insertion, or return index of existing key if found
+template <typename KeyT, typename ValueT, typename KeyHashT, typename KeyIsEqualT, typename AltKeyT>
+template <typename KeyParamT>
+UtlHashHandle_t CUtlSwissHashtable<KeyT, ValueT, KeyHashT, KeyIsEqualT, AltKeyT>::DoInsert( KeyParamT k, typename ArgumentTypeInfo<ValueT>::Arg_t v, unsigned int h, bool *pDidInsert )
+{
+	handle_t idx = DoLookup<KeyParamT>( k, h );
+	if ( idx == (handle_t) -1 )
+	{
+		idx = (handle_t) DoInsertUnconstructed( h );
+		ConstructTwoArg( &m_slots[ idx ], k, v );
+		if ( pDidInsert ) *pDidInsert = true;
+	}
+	else
+	{
+		if ( pDidInsert ) *pDidInsert = false;
+	}
+	return idx;
+}
+
+
+template <typename KeyT, typename ValueT, typename KeyHashT, typename KeyIsEqualT, typename AltKeyT>
+void CUtlSwissHashtable<KeyT, ValueT, KeyHashT, KeyIsEqualT, AltKeyT>::DoRemoveAt( handle_t idx )
+{
+	Assert( IsValidHandle( idx ) );
+	Destruct( &m_slots[idx] );
+	--m_nUsed;
+
+	// If the group already has an empty slot, no probe sequence ever went
+	// past it, so this slot can go straight back to empty.
+	if ( MatchEmpty( m_ctrl.Base() + ( idx & ~( GROUP_SIZE - 1 ) ) ) )
+	{
+		m_ctrl[idx] = CTRL_EMPTY;
+		++m_nGrowthLeft;
+	}
+	else
+	{
+		m_ctrl[idx] = CTRL_DELETED;
+	}
+}
+
+
+// Burn it with fire.
+template <typename KeyT, typename ValueT, typename KeyHashT, typename KeyIsEqualT, typename AltKeyT>
+void CUtlSwissHashtable<KeyT, ValueT, KeyHashT, KeyIsEqualT, AltKeyT>::RemoveAll()
+{
+	int size = m_ctrl.Count();
+	if ( size == 0 )
+		return;
+
+	int used = m_nUsed;
+	uint8 *pCtrl = m_ctrl.Base();
+	for ( int i = 0; used && i < size; ++i )
+	{
+		if ( !( pCtrl[i] & CTRL_EMPTY ) )
+		{
+			Destruct( &m_slots[i] );
+			--used;
+		}
+	}
+	memset( pCtrl, CTRL_EMPTY, size );
+	m_nUsed = 0;
+	m_nGrowthLeft = size - size / 8;
+}
+
+
+template <typename KeyT, typename ValueT, typename KeyHashT, typename KeyIsEqualT, typename AltKeyT>
+UtlHashHandle_t CUtlSwissHashtable<KeyT, ValueT, KeyHashT, KeyIsEqualT, AltKeyT>::NextHandle( handle_t start ) const
+{
+	const uint8 *pCtrl = m_ctrl.Base();
+	int size = m_ctrl.Count();
+	int i = (int)start + 1;
+
+	// Finish the current group a slot at a time, then skip whole groups
+	for ( ; i < size && ( i & ( GROUP_SIZE - 1 ) ); ++i )
+	{
+		if ( !( pCtrl[i] & CTRL_EMPTY ) )
+			return (handle_t) i;
+	}
+	for ( ; i < size; i += GROUP_SIZE )
+	{
+		uint32 mask = MatchFull( pCtrl + i );
+		if ( mask )
+			return (handle_t)( i + LowestBit( mask ) );
+	}
+	return (handle_t) -1;
+}
+
+
+#if _DEBUG
+template <typename KeyT, typename ValueT, typename KeyHashT, typename KeyIsEqualT, typename AltKeyT>
+void CUtlSwissHashtable<KeyT, ValueT, KeyHashT, KeyIsEqualT, AltKeyT>::DbgCheckIntegrity() const
+{
+	int count = 0, empty = 0;
+	for ( int i = 0; i < m_ctrl.Count(); ++i )
+	{
+		uint8 ctrl = m_ctrl[i];
+		if ( ctrl == CTRL_EMPTY )
+		{
+			++empty;
+		}
+		else if ( ctrl != CTRL_DELETED )
+		{
+			++count;
+			Assert( !( ctrl & CTRL_EMPTY ) );
+			Assert( ctrl == H2( m_hash( m_slots[i].m_key ) ) );
+			Assert( Find( m_slots[i].m_key ) == (handle_t)i );
+		}
+	}
+	Assert( count == Count() );
+	Assert( m_ctrl.Count() == 0 || empty - m_ctrl.Count() / 8 == m_nGrowthLeft );
+}
+#endif
+
+#endif // UTLSWISSHASHTABLE_H
@@ -23,6 +23,7 @@
 //-----------------------------------------------------------------------------
 class CUtlSymbolTable;
 class CUtlSymbolTableMT;
+class CUtlSymbolTableHashMT;
 
 
 //-----------------------------------------------------------------------------
@@ -67,10 +68,10 @@ protected:
 	static void Initialize();
 	
 	// returns the current symbol table
-	static CUtlSymbolTableMT* CurrTable();
+	static CUtlSymbolTableHashMT* CurrTable();
 		
 	// The standard global symbol table
-	static CUtlSymbolTableMT* s_pSymbolTable; 
+	static CUtlSymbolTableHashMT* s_pSymbolTable; 
 
 	static bool s_bAllowStaticSymbolTable;
 
@@ -212,6 +213,126 @@ private:
 };
 
 
+//-----------------------------------------------------------------------------
+// CUtlSymbolTableHash:
+// description:
+//    Same interface as CUtlSymbolTable, but looks strings up in an open
+//    addressed hash table instead of a tree of string compares. Each slot
+//    packs the top 16 bits of the string's hash next to its symbol, so most
+//    probes that don't match never touch the string. Symbols are handed out
+//    in insertion order.
+//
+//    Strings, the symbol->string blocks and old slot arrays are never moved
+//    or freed until RemoveAll(), which is what lets CUtlSymbolTableHashMT
+//    read without a lock.
+//-----------------------------------------------------------------------------
+class CUtlSymbolTableHash
+{
+public:
+	// constructor, destructor
+	CUtlSymbolTableHash( int initSize = 32, bool caseInsensitive = false );
+	~CUtlSymbolTableHash();
+
+	// Finds and/or creates a symbol based on the string
+	CUtlSymbol AddString( const char* pString );
+
+	// Finds the symbol for pString
+	CUtlSymbol Find( const char* pString ) const;
+
+	// Look up the string associated with a particular symbol
+	const char* String( CUtlSymbol id ) const;
+
+	// Remove all symbols in the table.
+	void  RemoveAll();
+
+	int GetNumStrings( void ) const
+	{
+		return m_nSymbols;
+	}
+
+protected:
+	enum
+	{
+		SYMBOL_BLOCK_SHIFT = 8,
+		SYMBOL_BLOCK_SIZE = ( 1 << SYMBOL_BLOCK_SHIFT ),
+		SYMBOL_BLOCK_COUNT = ( 0x10000 >> SYMBOL_BLOCK_SHIFT ),
+	};
+
+	// Slot layout is ( hash >> 16 ) << 16 | symbol; a slot with UTL_INVAL_SYMBOL is empty
+	struct SlotArray_t
+	{
+		int		m_nMask;
+		uint32	m_Slots[1];
+	};
+
+	unsigned int HashString( const char *pString ) const;
+	bool StringsMatch( const char *pString, UtlSymId_t id ) const;
+	UtlSymId_t FindHashed( const char *pString, unsigned int nHash ) const;
+	CUtlSymbol Insert( const char *pString, unsigned int nHash );
+	void Grow();
+	const char *CopyString( const char *pString );
+
+	static SlotArray_t *AllocSlotArray( int nSlots );
+
+	SlotArray_t * volatile m_pSlotArray;
+	const char ** volatile m_pSymbolBlocks[SYMBOL_BLOCK_COUNT];
+	volatile int m_nSymbols;
+	bool m_bInsensitive;
+
+	// Slot arrays that were outgrown, freed in RemoveAll
+	CUtlVector<SlotArray_t*> m_RetiredSlotArrays;
+
+	// Stores the string data
+	CUtlVector<char*> m_StringPools;
+	char *m_pPoolCursor;
+	int m_nPoolSpaceLeft;
+};
+
+
+//-----------------------------------------------------------------------------
+// CUtlSymbolTableHashMT:
+// description:
+//    Thread safe CUtlSymbolTableHash for tables that are mostly read. Find()
+//    and String() never lock; only AddString() of a new string takes the
+//    mutex. A Find() that races an insert of the same string may miss it.
+//    RemoveAll() must not run while other threads use the table.
+//-----------------------------------------------------------------------------
+class CUtlSymbolTableHashMT : private CUtlSymbolTableHash
+{
+public:
+	CUtlSymbolTableHashMT( int initSize = 32, bool caseInsensitive = false )
+		: CUtlSymbolTableHash( initSize, caseInsensitive )
+	{
+	}
+
+	CUtlSymbol AddString( const char* pString );
+
+	CUtlSymbol Find( const char* pString ) const
+	{
+		return CUtlSymbolTableHash::Find( pString );
+	}
+
+	const char* String( CUtlSymbol id ) const
+	{
+		return CUtlSymbolTableHash::String( id );
+	}
+
+	void RemoveAll()
+	{
+		AUTO_LOCK( m_mutex );
+		CUtlSymbolTableHash::RemoveAll();
+	}
+
+	int GetNumStrings( void ) const
+	{
+		return CUtlSymbolTableHash::GetNumStrings();
+	}
+
+private:
+	CThreadFastMutex m_mutex;
+};
+
+
 
 //-----------------------------------------------------------------------------
 // CUtlFilenameSymbolTable:
@@ -24,6 +24,7 @@
 #include "utlstring.h"
 
 #include "tier1/lzmaDecoder.h"
+#include "tier1/compressedstreamreader.h"
 
 // Not every user of zip utils wants to link LZMA encoder
 #ifdef ZIP_SUPPORT_LZMA_ENCODE
@@ -1129,6 +1130,36 @@ void CZipFile::AddBufferToZip( const char *relativename, void *data, int length,
 }
 
 
+//-----------------------------------------------------------------------------
+// Feeds the compressed bytes of an entry in a zip on disk to a CCompressedStreamReader
+//-----------------------------------------------------------------------------
+class CZipEntryStreamSource : public ICompressedStreamSource
+{
+public:
+	CZipEntryStreamSource( HANDLE hZipFile, unsigned int nOffset, unsigned int nSize )
+		: m_hZipFile( hZipFile ), m_nBytesLeft( nSize )
+	{
+		CWin32File::FileSeek( hZipFile, nOffset, FILE_BEGIN );
+	}
+
+	virtual int ReadCompressed( void *pDest, int nMaxBytes )
+	{
+		unsigned int nBytes = Min( (unsigned int)nMaxBytes, m_nBytesLeft );
+		if ( !nBytes )
+			return 0;
+
+		if ( !CWin32File::FileRead( m_hZipFile, pDest, nBytes ) )
+			return -1;
+
+		m_nBytesLeft -= nBytes;
+		return nBytes;
+	}
+
+private:
+	HANDLE			m_hZipFile;
+	unsigned int	m_nBytesLeft;
+};
+
 //-----------------------------------------------------------------------------
 // Reads a file from the zip
 //-----------------------------------------------------------------------------
@@ -1159,6 +1190,38 @@ bool CZipFile::ReadFileFromZip( HANDLE hZipFile, const char *pRelativeName, bool
 
 	CZipEntry *pEntry = &m_Files[nIndex];
 
+	if ( !pEntry->m_pData && hZipFile && pEntry->m_eCompressionType == IZip::eCompressionType_LZMA )
+	{
+		// Decode while reading, rather than loading the whole compressed entry first. Binary
+		// data goes straight into the caller's buffer.
+		CZipEntryStreamSource source( hZipFile, pEntry->m_SourceDiskOffset, pEntry->m_nCompressedSize );
+		CCompressedStreamReader reader( &source, COMPRESSED_STREAM_LZMA_ZIP );
+		reader.InitZIPHeader( pEntry->m_nCompressedSize, pEntry->m_nUncompressedSize );
+
+		CUtlBuffer textBuffer;
+		CUtlBuffer &decompressBuffer = bTextMode ? textBuffer : buf;
+		if ( !bTextMode )
+		{
+			buf.SetBufferType( false, false );
+		}
+
+		int nStart = decompressBuffer.TellPut();
+		if ( !reader.ReadAll( decompressBuffer ) ||
+			 (int)reader.GetCompressedBytesRead() != pEntry->m_nCompressedSize ||
+			 decompressBuffer.TellPut() - nStart != pEntry->m_nUncompressedSize )
+		{
+			Error( "Zip: Failed decompressing LZMA data\n" );
+			return false;
+		}
+
+		if ( bTextMode )
+		{
+			buf.SetBufferType( true, false );
+			ReadTextData( (const char *)textBuffer.Base(), pEntry->m_nUncompressedSize, buf );
+		}
+		return true;
+	}
+
 	void *pData = pEntry->m_pData;
 	CUtlBuffer readBuffer;
 	if ( !pData && hZipFile )
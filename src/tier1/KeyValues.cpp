@@ -25,7 +25,11 @@
 #include "tier0/dbg.h"
 #include "tier0/mem.h"
 #include "utlbuffer.h"
+#include "checksum_crc.h"
+#include "tier0/threadtools.h"
 #include "utlhash.h"
+#include "utlmap.h"
+#include "utlstring.h"
 #include "utlvector.h"
 #include "utlqueue.h"
 #include "UtlSortVector.h"
@@ -221,6 +225,93 @@ static CLeakTrack track;
 
 #endif
 
+//-----------------------------------------------------------------------------
+// Bump allocator behind KeyValues::CreateInArena. Each node is preceded by a
+// pointer back to its arena, which is how GetArena() finds it without making
+// KeyValues any bigger.
+//-----------------------------------------------------------------------------
+#define KEYVALUES_ARENA_BLOCK_SIZE	( 16 * 1024 )
+#define KEYVALUES_ARENA_NODE_OFFSET	ALIGN_VALUE( sizeof( CKeyValuesArena * ), 8 )
+
+class CKeyValuesArena
+{
+public:
+	CKeyValuesArena( int nBlockSize )
+	{
+		m_nBlockSize = ( nBlockSize > 0 ) ? nBlockSize : KEYVALUES_ARENA_BLOCK_SIZE;
+		m_pBlocks = NULL;
+		m_pRoot = NULL;
+		m_bHasForeignNodes = false;
+	}
+
+	void *Alloc( int nBytes )
+	{
+		nBytes = ALIGN_VALUE( nBytes, 8 );
+		if ( !m_pBlocks || m_pBlocks->m_nUsed + nBytes > m_pBlocks->m_nSize )
+		{
+			// Big allocations get a block to themselves, behind the current one
+			int nSize = MAX( nBytes, m_nBlockSize );
+			Block_t *pBlock = (Block_t *)malloc( ALIGN_VALUE( sizeof( Block_t ), 8 ) + nSize );
+			pBlock->m_nSize = nSize;
+			pBlock->m_nUsed = 0;
+			if ( m_pBlocks && nBytes > m_nBlockSize / 2 )
+			{
+				pBlock->m_pNext = m_pBlocks->m_pNext;
+				m_pBlocks->m_pNext = pBlock;
+			}
+			else
+			{
+				pBlock->m_pNext = m_pBlocks;
+				m_pBlocks = pBlock;
+			}
+			pBlock->m_nUsed = nBytes;
+			return pBlock->Data();
+		}
+
+		void *pMem = m_pBlocks->Data() + m_pBlocks->m_nUsed;
+		m_pBlocks->m_nUsed += nBytes;
+		return pMem;
+	}
+
+	KeyValues *AllocKey( const char *keyName );
+
+	KeyValues *GetRoot() const { return m_pRoot; }
+
+	// Frees every node and string in the arena, and the arena itself
+	void Release()
+	{
+		// Heap nodes and other arenas' roots attached to the tree still need freeing one by one
+		if ( m_bHasForeignNodes )
+		{
+			m_pRoot->RemoveEverything();
+		}
+
+		while ( m_pBlocks )
+		{
+			Block_t *pNext = m_pBlocks->m_pNext;
+			free( m_pBlocks );
+			m_pBlocks = pNext;
+		}
+		delete this;
+	}
+
+	KeyValues	*m_pRoot;
+	bool		m_bHasForeignNodes;
+
+private:
+	struct Block_t
+	{
+		Block_t	*m_pNext;
+		int		m_nSize;
+		int		m_nUsed;
+
+		char *Data() { return (char *)this + ALIGN_VALUE( sizeof( Block_t ), 8 ); }
+	};
+
+	Block_t		*m_pBlocks;
+	int			m_nBlockSize;
+};
+
 
 //-----------------------------------------------------------------------------
 // Purpose: An arbitrarily growable string table for KeyValues key names. 
@@ -462,8 +553,7 @@ void KeyValues::Init()
 	m_bHasEscapeSequences = false;
 	m_bEvaluateConditionals = true;
 
-	// for future proof
-	memset( unused, 0, sizeof(unused) );
+	m_bArenaNode = false;
 }
 
 //-----------------------------------------------------------------------------
@@ -487,22 +577,113 @@ void KeyValues::RemoveEverything()
 	{
 		datNext = dat->m_pPeer;
 		dat->m_pPeer = NULL;
-		delete dat;
+		dat->deleteThis();
 	}
 
 	for ( dat = m_pPeer; dat && dat != this; dat = datNext )
 	{
 		datNext = dat->m_pPeer;
 		dat->m_pPeer = NULL;
-		delete dat;
+		dat->deleteThis();
 	}
 
-	delete [] m_sValue;
+	// Arena nodes outlive this, so don't leave them pointing at freed nodes
+	m_pSub = NULL;
+	m_pPeer = NULL;
+
+	FreeAllocatedValue();
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: Frees the string value storage; arena strings go with their arena
+//-----------------------------------------------------------------------------
+void KeyValues::FreeAllocatedValue()
+{
+	if ( !m_bArenaNode )
+	{
+		delete [] m_sValue;
+		delete [] m_wsValue;
+	}
 	m_sValue = NULL;
-	delete [] m_wsValue;
 	m_wsValue = NULL;
 }
 
+//-----------------------------------------------------------------------------
+// Purpose: Returns the arena this node lives in, or NULL for heap nodes
+//-----------------------------------------------------------------------------
+CKeyValuesArena *KeyValues::GetArena() const
+{
+	if ( !m_bArenaNode )
+		return NULL;
+
+	return *(CKeyValuesArena **)( (char *)this - KEYVALUES_ARENA_NODE_OFFSET );
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: Allocates a new node from the same place as this one
+//-----------------------------------------------------------------------------
+KeyValues *KeyValues::AllocKey( const char *keyName )
+{
+	CKeyValuesArena *pArena = GetArena();
+	if ( pArena )
+		return pArena->AllocKey( keyName );
+
+	return new KeyValues( keyName );
+}
+
+char *KeyValues::AllocValueString( int nBytes )
+{
+	CKeyValuesArena *pArena = GetArena();
+	if ( pArena )
+		return (char *)pArena->Alloc( nBytes );
+
+	return new char[nBytes];
+}
+
+wchar_t *KeyValues::AllocValueWString( int nChars )
+{
+	CKeyValuesArena *pArena = GetArena();
+	if ( pArena )
+		return (wchar_t *)pArena->Alloc( nChars * sizeof( wchar_t ) );
+
+	return new wchar_t[nChars];
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: Prepares a node to be linked into this node's tree. Nodes from
+//			inside another arena can't outlive it, so they are copied to the
+//			heap instead; anything not allocated in our arena makes it walk
+//			the tree when it's freed.
+//-----------------------------------------------------------------------------
+KeyValues *KeyValues::AdoptNode( KeyValues *pNode )
+{
+	CKeyValuesArena *pArena = GetArena();
+	CKeyValuesArena *pNodeArena = pNode->GetArena();
+	if ( pNodeArena == pArena )
+		return pNode;
+
+	if ( pNodeArena && pNodeArena->GetRoot() != pNode )
+	{
+		pNode = pNode->MakeCopy( true );
+	}
+
+	if ( pArena )
+	{
+		pArena->m_bHasForeignNodes = true;
+	}
+	return pNode;
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: Creates a root node that owns a new arena
+//-----------------------------------------------------------------------------
+KeyValues *KeyValues::CreateInArena( const char *setName, int nBlockSize )
+{
+	CKeyValuesArena *pArena = new CKeyValuesArena( nBlockSize );
+	pArena->m_pRoot = pArena->AllocKey( setName );
+	return pArena->m_pRoot;
+}
+
 //-----------------------------------------------------------------------------
 // Purpose: 
 // Input  : *f - 
@@ -640,6 +821,365 @@ void KeyValues::UsesConditionals(bool state)
 }
 
 
+//-----------------------------------------------------------------------------
+// Compiled KeyValues cache. The first time LoadFromFile parses a file, the
+// resulting tree (with conditionals, #include and #base already applied) is
+// written to kvcache/<pathID>/<file>.kvc together with the size and CRC of
+// every file read for it. Key names are written once and resolved to symbols
+// once per load. Later loads use the image instead of tokenizing as long as
+// every source still matches.
+//
+// The cache lives in the write path, so it's opt-in (-kv_compiled_cache):
+// an edited image would get past sv_pure just like the in-memory cache above.
+//-----------------------------------------------------------------------------
+#define KEYVALUES_COMPILED_ID		MAKEID( 'K', 'V', 'C', '1' )
+#define KEYVALUES_COMPILED_VERSION	1
+#define KEYVALUES_COMPILED_PATHID	"DEFAULT_WRITE_PATH"
+
+class CKeyValuesCompiledCache
+{
+public:
+	struct Dependency_t
+	{
+		CUtlString	m_FileName;
+		CUtlString	m_PathID;
+		int			m_nSize;		// -1 if the file was missing
+		CRC32_t		m_CRC;
+	};
+
+	// Files read while the outermost LoadFromFile on this thread is parsing
+	struct Context_t
+	{
+		CUtlVector< Dependency_t > m_Dependencies;
+	};
+
+	static bool IsEnabled();
+	static Context_t *GetContext()					{ return s_pContext; }
+	static void SetContext( Context_t *pContext )	{ s_pContext = pContext; }
+	static void AddDependency( Context_t *pContext, const char *pFileName, const char *pPathID, const void *pData, int nSize );
+
+	static void GetCacheFileName( const char *pResourceName, const char *pPathID, char *pOut, int nOutSize );
+	static bool Load( KeyValues *pKV, IBaseFileSystem *pFileSystem, const char *pCacheFile );
+	static void Save( KeyValues *pKV, IBaseFileSystem *pFileSystem, const char *pCacheFile, const Context_t &context );
+
+private:
+	static int GetFlags( KeyValues *pKV )	{ return ( pKV->m_bHasEscapeSequences ? 1 : 0 ) | ( pKV->m_bEvaluateConditionals ? 2 : 0 ); }
+	static const char *GetString( CUtlBuffer &buf );
+	static bool IsDependencyValid( IBaseFileSystem *pFileSystem, const char *pFileName, const char *pPathID, int nSize, CRC32_t crc );
+	static void CollectSymbols( KeyValues *pKV, CUtlMap< int, int > &symbolIndex, CUtlVector< const char * > &names );
+	static bool WriteNodes( KeyValues *pKV, CUtlBuffer &buf, const CUtlMap< int, int > &symbolIndex );
+	static bool ReadNodes( KeyValues *pOwner, KeyValues *&pFirst, CUtlBuffer &buf, const CUtlVector< int > &symbols, int nDepth );
+
+	static CThreadLocalPtr< Context_t > s_pContext;
+};
+
+CThreadLocalPtr< CKeyValuesCompiledCache::Context_t > CKeyValuesCompiledCache::s_pContext;
+
+bool CKeyValuesCompiledCache::IsEnabled()
+{
+	static bool s_bEnabled = !!CommandLine()->FindParm( "-kv_compiled_cache" );
+	return s_bEnabled;
+}
+
+void CKeyValuesCompiledCache::AddDependency( Context_t *pContext, const char *pFileName, const char *pPathID, const void *pData, int nSize )
+{
+	int i = pContext->m_Dependencies.AddToTail();
+	Dependency_t &dep = pContext->m_Dependencies[i];
+	dep.m_FileName = pFileName;
+	dep.m_PathID = pPathID ? pPathID : "";
+	dep.m_nSize = pData ? nSize : -1;
+	dep.m_CRC = pData ? CRC32_ProcessSingleBuffer( pData, nSize ) : 0;
+}
+
+void CKeyValuesCompiledCache::GetCacheFileName( const char *pResourceName, const char *pPathID, char *pOut, int nOutSize )
+{
+	Q_snprintf( pOut, nOutSize, "kvcache/%s/", pPathID ? pPathID : "_" );
+	int nPrefix = Q_strlen( pOut );
+	Q_strncat( pOut, pResourceName, nOutSize, COPY_ALL_CHARACTERS );
+	Q_strncat( pOut, ".kvc", nOutSize, COPY_ALL_CHARACTERS );
+
+	// Keep absolute paths, drive letters and ".." inside the cache directory
+	for ( char *p = pOut + nPrefix; *p; ++p )
+	{
+		if ( *p == '\\' )
+		{
+			*p = '/';
+		}
+		else if ( *p == ':' || ( p[0] == '.' && p[1] == '.' ) || ( *p == '/' && p[1] == '/' ) )
+		{
+			*p = '_';
+		}
+		*p = tolower( *p );
+	}
+	if ( pOut[nPrefix] == '/' )
+	{
+		pOut[nPrefix] = '_';
+	}
+}
+
+// Returns a string stored in the buffer and skips past it. The buffer must be null terminated.
+const char *CKeyValuesCompiledCache::GetString( CUtlBuffer &buf )
+{
+	int nLength = buf.PeekStringLength();
+	if ( nLength <= 0 )
+		return NULL;
+
+	const char *pString = (const char *)buf.PeekGet();
+	buf.SeekGet( CUtlBuffer::SEEK_CURRENT, nLength );
+	return pString;
+}
+
+bool CKeyValuesCompiledCache::IsDependencyValid( IBaseFileSystem *pFileSystem, const char *pFileName, const char *pPathID, int nSize, CRC32_t crc )
+{
+	if ( nSize < 0 )
+		return !pFileSystem->FileExists( pFileName, pPathID );
+
+	if ( !pFileSystem->FileExists( pFileName, pPathID ) || (int)pFileSystem->Size( pFileName, pPathID ) != nSize )
+		return false;
+
+	CUtlBuffer source;
+	if ( !pFileSystem->ReadFile( pFileName, pPathID, source ) || source.TellPut() != nSize )
+		return false;
+
+	return CRC32_ProcessSingleBuffer( source.Base(), nSize ) == crc;
+}
+
+bool CKeyValuesCompiledCache::Load( KeyValues *pKV, IBaseFileSystem *pFileSystem, const char *pCacheFile )
+{
+	CUtlBuffer buf;
+	if ( !pFileSystem->ReadFile( pCacheFile, KEYVALUES_COMPILED_PATHID, buf ) )
+		return false;
+	buf.PutChar( 0 );	// so a truncated image can't run GetString off the end
+
+	if ( buf.GetInt() != KEYVALUES_COMPILED_ID || buf.GetInt() != KEYVALUES_COMPILED_VERSION || buf.GetInt() != GetFlags( pKV ) )
+		return false;
+
+	int nDependencies = buf.GetInt();
+	for ( int i = 0; i < nDependencies; ++i )
+	{
+		const char *pFileName = GetString( buf );
+		const char *pPathID = GetString( buf );
+		int nSize = buf.GetInt();
+		CRC32_t crc = buf.GetUnsignedInt();
+		if ( !buf.IsValid() || !pFileName || !pPathID )
+			return false;
+
+		if ( !IsDependencyValid( pFileSystem, pFileName, *pPathID ? pPathID : NULL, nSize, crc ) )
+			return false;
+	}
+
+	int nSymbols = buf.GetInt();
+	if ( !buf.IsValid() || nSymbols < 0 || nSymbols > buf.TellMaxPut() )
+		return false;
+
+	CUtlVector< int > symbols;
+	symbols.EnsureCapacity( nSymbols );
+	for ( int i = 0; i < nSymbols; ++i )
+	{
+		const char *pName = GetString( buf );
+		if ( !pName )
+			return false;
+		symbols.AddToTail( KeyValues::s_pfGetSymbolForString( pName, true ) );
+	}
+
+	pKV->FreeAllocatedValue();
+	pKV->m_iDataType = KeyValues::TYPE_NONE;
+
+	KeyValues *pFirst = pKV;
+	if ( !ReadNodes( pKV, pFirst, buf, symbols, 0 ) )
+	{
+		// Corrupt image, throw away whatever was read and parse the source
+		pKV->RemoveEverything();
+		pKV->m_iDataType = KeyValues::TYPE_NONE;
+		return false;
+	}
+
+	return true;
+}
+
+bool CKeyValuesCompiledCache::ReadNodes( KeyValues *pOwner, KeyValues *&pFirst, CUtlBuffer &buf, const CUtlVector< int > &symbols, int nDepth )
+{
+	if ( nDepth > 100 )
+		return false;
+
+	KeyValues *pPrev = NULL;
+	for ( int nType = buf.GetUnsignedChar(); nType != KeyValues::TYPE_NUMTYPES; nType = buf.GetUnsignedChar() )
+	{
+		int nSymbol = buf.GetInt();
+		if ( !buf.IsValid() || nSymbol < 0 || nSymbol >= symbols.Count() )
+			return false;
+
+		// The caller's root is reused for the first key, everything else is linked in as soon as
+		// it exists so a failed read can be cleaned up from the root
+		KeyValues *dat;
+		if ( !pPrev && pFirst )
+		{
+			dat = pFirst;
+		}
+		else
+		{
+			dat = pOwner->AllocKey( "" );
+			dat->m_bHasEscapeSequences = pOwner->m_bHasEscapeSequences;
+			dat->m_bEvaluateConditionals = pOwner->m_bEvaluateConditionals;
+			if ( pPrev )
+			{
+				pPrev->m_pPeer = dat;
+			}
+			else
+			{
+				pFirst = dat;
+			}
+		}
+		pPrev = dat;
+
+		dat->m_iKeyName = symbols[nSymbol];
+		dat->m_iDataType = nType;
+
+		switch ( nType )
+		{
+		case KeyValues::TYPE_NONE:
+			if ( !ReadNodes( pOwner, dat->m_pSub, buf, symbols, nDepth + 1 ) )
+				return false;
+			break;
+
+		case KeyValues::TYPE_STRING:
+			{
+				int nLength = buf.PeekStringLength();
+				if ( nLength <= 0 )
+					return false;
+				dat->m_sValue = dat->AllocValueString( nLength );
+				buf.Get( dat->m_sValue, nLength );
+				break;
+			}
+
+		case KeyValues::TYPE_INT:
+			dat->m_iValue = buf.GetInt();
+			break;
+
+		case KeyValues::TYPE_FLOAT:
+			dat->m_flValue = buf.GetFloat();
+			break;
+
+		case KeyValues::TYPE_UINT64:
+			dat->m_sValue = dat->AllocValueString( sizeof( uint64 ) );
+			*( (uint64 *)dat->m_sValue ) = buf.GetInt64();
+			break;
+
+		case KeyValues::TYPE_COLOR:
+			for ( int i = 0; i < 4; ++i )
+			{
+				dat->m_Color[i] = buf.GetUnsignedChar();
+			}
+			break;
+
+		default:
+			return false;
+		}
+	}
+
+	return buf.IsValid();
+}
+
+void CKeyValuesCompiledCache::CollectSymbols( KeyValues *pKV, CUtlMap< int, int > &symbolIndex, CUtlVector< const char * > &names )
+{
+	for ( KeyValues *dat = pKV; dat; dat = dat->m_pPeer )
+	{
+		if ( symbolIndex.Find( dat->m_iKeyName ) == symbolIndex.InvalidIndex() )
+		{
+			symbolIndex.Insert( dat->m_iKeyName, names.AddToTail( dat->GetName() ) );
+		}
+		CollectSymbols( dat->m_pSub, symbolIndex, names );
+	}
+}
+
+bool CKeyValuesCompiledCache::WriteNodes( KeyValues *pKV, CUtlBuffer &buf, const CUtlMap< int, int > &symbolIndex )
+{
+	for ( KeyValues *dat = pKV; dat; dat = dat->m_pPeer )
+	{
+		// Text files never produce these, but programmatic edits could
+		if ( dat->m_pSub && dat->m_iDataType != KeyValues::TYPE_NONE )
+			return false;
+
+		buf.PutUnsignedChar( dat->m_iDataType );
+		buf.PutInt( symbolIndex[ symbolIndex.Find( dat->m_iKeyName ) ] );
+
+		switch ( dat->m_iDataType )
+		{
+		case KeyValues::TYPE_NONE:
+			if ( !WriteNodes( dat->m_pSub, buf, symbolIndex ) )
+				return false;
+			break;
+
+		case KeyValues::TYPE_STRING:
+			buf.PutString( dat->m_sValue ? dat->m_sValue : "" );
+			break;
+
+		case KeyValues::TYPE_INT:
+			buf.PutInt( dat->m_iValue );
+			break;
+
+		case KeyValues::TYPE_FLOAT:
+			buf.PutFloat( dat->m_flValue );
+			break;
+
+		case KeyValues::TYPE_UINT64:
+			buf.PutInt64( *( (int64 *)dat->m_sValue ) );
+			break;
+
+		case KeyValues::TYPE_COLOR:
+			for ( int i = 0; i < 4; ++i )
+			{
+				buf.PutUnsignedChar( dat->m_Color[i] );
+			}
+			break;
+
+		default:
+			// Wide strings come from unicode files, pointers can't be saved
+			return false;
+		}
+	}
+
+	buf.PutUnsignedChar( KeyValues::TYPE_NUMTYPES );
+	return buf.IsValid();
+}
+
+void CKeyValuesCompiledCache::Save( KeyValues *pKV, IBaseFileSystem *pFileSystem, const char *pCacheFile, const Context_t &context )
+{
+	CUtlMap< int, int > symbolIndex( DefLessFunc( int ) );
+	CUtlVector< const char * > names;
+	CollectSymbols( pKV, symbolIndex, names );
+
+	CUtlBuffer buf;
+	buf.PutInt( KEYVALUES_COMPILED_ID );
+	buf.PutInt( KEYVALUES_COMPILED_VERSION );
+	buf.PutInt( GetFlags( pKV ) );
+
+	buf.PutInt( context.m_Dependencies.Count() );
+	FOR_EACH_VEC( context.m_Dependencies, i )
+	{
+		const Dependency_t &dep = context.m_Dependencies[i];
+		buf.PutString( dep.m_FileName.Get() );
+		buf.PutString( dep.m_PathID.Get() );
+		buf.PutInt( dep.m_nSize );
+		buf.PutUnsignedInt( dep.m_CRC );
+	}
+
+	buf.PutInt( names.Count() );
+	FOR_EACH_VEC( names, i )
+	{
+		buf.PutString( names[i] );
+	}
+
+	if ( !WriteNodes( pKV, buf, symbolIndex ) )
+		return;
+
+	char szDir[MAX_PATH];
+	Q_ExtractFilePath( pCacheFile, szDir, sizeof( szDir ) );
+	( (IFileSystem *)pFileSystem )->CreateDirHierarchy( szDir, KEYVALUES_COMPILED_PATHID );
+	pFileSystem->WriteFile( pCacheFile, KEYVALUES_COMPILED_PATHID, buf );
+}
+
+
 //-----------------------------------------------------------------------------
 // Purpose: Load keyValues from disk
 //-----------------------------------------------------------------------------
@@ -682,8 +1222,9 @@ bool KeyValues::LoadFromFile( IBaseFileSystem *filesystem, const char *resourceN
 #endif
 
 	// If pathID is null, we cannot cache the result because that has a weird iterate-through-a-bunch-of-locations behavior.
-	const bool bUseCacheForRead = bUseCache && !refreshCache && pathID != NULL; 
-	const bool bUseCacheForWrite = bUseCache && pathID != NULL;
+	// The cache builds and copies trees with its own KeyValues code, which doesn't know about arenas.
+	const bool bUseCacheForRead = bUseCache && !refreshCache && pathID != NULL && !m_bArenaNode; 
+	const bool bUseCacheForWrite = bUseCache && pathID != NULL && !m_bArenaNode;
 
 	COM_TimestampedLog( "KeyValues::LoadFromFile(%s%s%s): Begin", pathID ? pathID : "", pathID && resourceName ? "/" : "", resourceName ? resourceName : "" );
 
@@ -693,9 +1234,30 @@ bool KeyValues::LoadFromFile( IBaseFileSystem *filesystem, const char *resourceN
 		return true;
 	}
 
+	// Files opened while another file is being compiled are only recorded as its dependencies.
+	// Only an empty root is compiled, since the image replaces the whole tree.
+	CKeyValuesCompiledCache::Context_t *pCompileContext = CKeyValuesCompiledCache::GetContext();
+	const bool bUseCompiledCache = !pCompileContext && CKeyValuesCompiledCache::IsEnabled() && !m_pSub && !m_pPeer;
+
+	char szCompiledFile[MAX_PATH];
+	if ( bUseCompiledCache )
+	{
+		CKeyValuesCompiledCache::GetCacheFileName( resourceName, pathID, szCompiledFile, sizeof( szCompiledFile ) );
+		if ( !refreshCache && CKeyValuesCompiledCache::Load( this, filesystem, szCompiledFile ) )
+		{
+			COM_TimestampedLog( "KeyValues::LoadFromFile(%s%s%s): End / CompiledCacheHit", pathID ? pathID : "", pathID && resourceName ? "/" : "", resourceName ? resourceName : "" );
+			return true;
+		}
+	}
+
 	FileHandle_t f = filesystem->Open(resourceName, "rb", pathID);
 	if ( !f )
 	{
+		if ( pCompileContext )
+		{
+			CKeyValuesCompiledCache::AddDependency( pCompileContext, resourceName, pathID, NULL, 0 );
+		}
+
 		COM_TimestampedLog("KeyValues::LoadFromFile(%s%s%s): End / FileNotFound", pathID ? pathID : "", pathID && resourceName ? "/" : "", resourceName ? resourceName : "");
 		return false;
 	}
@@ -718,7 +1280,30 @@ bool KeyValues::LoadFromFile( IBaseFileSystem *filesystem, const char *resourceN
 	{
 		buffer[fileSize] = 0; // null terminate file as EOF
 		buffer[fileSize+1] = 0; // double NULL terminating in case this is a unicode file
-		bRetOK = LoadFromBuffer( resourceName, buffer, filesystem );
+
+		if ( pCompileContext )
+		{
+			CKeyValuesCompiledCache::AddDependency( pCompileContext, resourceName, pathID, buffer, fileSize );
+			bRetOK = LoadFromBuffer( resourceName, buffer, filesystem );
+		}
+		else if ( bUseCompiledCache )
+		{
+			CKeyValuesCompiledCache::Context_t context;
+			CKeyValuesCompiledCache::AddDependency( &context, resourceName, pathID, buffer, fileSize );
+
+			CKeyValuesCompiledCache::SetContext( &context );
+			bRetOK = LoadFromBuffer( resourceName, buffer, filesystem );
+			CKeyValuesCompiledCache::SetContext( NULL );
+
+			if ( bRetOK )
+			{
+				CKeyValuesCompiledCache::Save( this, filesystem, szCompiledFile, context );
+			}
+		}
+		else
+		{
+			bRetOK = LoadFromBuffer( resourceName, buffer, filesystem );
+		}
 	}
 	
 	// The cache relies on the KeyValuesSystem string table, which will only be valid if we're
@@ -1037,7 +1622,7 @@ KeyValues *KeyValues::FindKey(const char *keyName, bool bCreate)
 		if (bCreate)
 		{
 			// we need to create a new key
-			dat = new KeyValues( searchStr );
+			dat = AllocKey( searchStr );
 //			Assert(dat != NULL);
 
 			dat->UsesEscapeSequences( m_bHasEscapeSequences != 0 );	// use same format as parent
@@ -1117,7 +1702,7 @@ KeyValues* KeyValues::CreateKey( const char *keyName )
 KeyValues* KeyValues::CreateKeyUsingKnownLastChild( const char *keyName, KeyValues *pLastChild )
 {
 	// Create a new key
-	KeyValues* dat = new KeyValues( keyName );
+	KeyValues* dat = AllocKey( keyName );
 
 	dat->UsesEscapeSequences( m_bHasEscapeSequences != 0 ); // use same format as parent does
 	dat->UsesConditionals( m_bEvaluateConditionals != 0 );
@@ -1135,6 +1720,8 @@ void KeyValues::AddSubkeyUsingKnownLastChild( KeyValues *pSubkey, KeyValues *pLa
 	Assert( pSubkey != NULL );
 	Assert( pSubkey->m_pPeer == NULL );
 
+	pSubkey = AdoptNode( pSubkey );
+
 	// Empty child list?
 	if ( pLastChild == NULL )
 	{
@@ -1170,6 +1757,8 @@ void KeyValues::AddSubKey( KeyValues *pSubkey )
 	Assert( pSubkey != NULL );
 	Assert( pSubkey->m_pPeer == NULL );
 
+	pSubkey = AdoptNode( pSubkey );
+
 	// add into subkey list
 	if ( m_pSub == NULL )
 	{
@@ -1245,7 +1834,7 @@ KeyValues *KeyValues::FindLastSubKey()
 //-----------------------------------------------------------------------------
 void KeyValues::SetNextKey( KeyValues *pDat )
 {
-	m_pPeer = pDat;
+	m_pPeer = pDat ? AdoptNode( pDat ) : NULL;
 }
 
 
@@ -1592,11 +2181,8 @@ void KeyValues::SetColor( const char *keyName, Color value)
 
 void KeyValues::SetStringValue( char const *strValue )
 {
-	// delete the old value
-	delete [] m_sValue;
-	// make sure we're not storing the WSTRING  - as we're converting over to STRING
-	delete [] m_wsValue;
-	m_wsValue = NULL;
+	// delete the old value, make sure we're not storing the WSTRING - as we're converting over to STRING
+	FreeAllocatedValue();
 
 	if (!strValue)
 	{
@@ -1606,7 +2192,7 @@ void KeyValues::SetStringValue( char const *strValue )
 
 	// allocate memory for the new value and copy it in
 	int len = Q_strlen( strValue );
-	m_sValue = new char[len + 1];
+	m_sValue = AllocValueString( len + 1 );
 	Q_memcpy( m_sValue, strValue, len+1 );
 
 	m_iDataType = TYPE_STRING;
@@ -1626,11 +2212,8 @@ void KeyValues::SetString( const char *keyName, const char *value )
 			return;
 		}
 
-		// delete the old value
-		delete [] dat->m_sValue;
-		// make sure we're not storing the WSTRING  - as we're converting over to STRING
-		delete [] dat->m_wsValue;
-		dat->m_wsValue = NULL;
+		// delete the old value, make sure we're not storing the WSTRING - as we're converting over to STRING
+		dat->FreeAllocatedValue();
 
 		if (!value)
 		{
@@ -1640,7 +2223,7 @@ void KeyValues::SetString( const char *keyName, const char *value )
 
 		// allocate memory for the new value and copy it in
 		int len = Q_strlen( value );
-		dat->m_sValue = new char[len + 1];
+		dat->m_sValue = dat->AllocValueString( len + 1 );
 		Q_memcpy( dat->m_sValue, value, len+1 );
 
 		dat->m_iDataType = TYPE_STRING;
@@ -1655,11 +2238,8 @@ void KeyValues::SetWString( const char *keyName, const wchar_t *value )
 	KeyValues *dat = FindKey( keyName, true );
 	if ( dat )
 	{
-		// delete the old value
-		delete [] dat->m_wsValue;
-		// make sure we're not storing the STRING  - as we're converting over to WSTRING
-		delete [] dat->m_sValue;
-		dat->m_sValue = NULL;
+		// delete the old value, make sure we're not storing the STRING - as we're converting over to WSTRING
+		dat->FreeAllocatedValue();
 
 		if (!value)
 		{
@@ -1669,7 +2249,7 @@ void KeyValues::SetWString( const char *keyName, const wchar_t *value )
 
 		// allocate memory for the new value and copy it in
 		int len = Q_wcslen( value );
-		dat->m_wsValue = new wchar_t[len + 1];
+		dat->m_wsValue = dat->AllocValueWString( len + 1 );
 		Q_memcpy( dat->m_wsValue, value, (len+1) * sizeof(wchar_t) );
 
 		dat->m_iDataType = TYPE_WSTRING;
@@ -1699,13 +2279,10 @@ void KeyValues::SetUint64( const char *keyName, uint64 value )
 
 	if ( dat )
 	{
-		// delete the old value
-		delete [] dat->m_sValue;
-		// make sure we're not storing the WSTRING  - as we're converting over to STRING
-		delete [] dat->m_wsValue;
-		dat->m_wsValue = NULL;
+		// delete the old value, make sure we're not storing the WSTRING - as we're converting over to STRING
+		dat->FreeAllocatedValue();
 
-		dat->m_sValue = new char[sizeof(uint64)];
+		dat->m_sValue = dat->AllocValueString( sizeof(uint64) );
 		*((uint64 *)dat->m_sValue) = value;
 		dat->m_iDataType = TYPE_UINT64;
 	}
@@ -1780,13 +2357,13 @@ void KeyValues::CopyKeyValuesFromRecursive( const KeyValues& rootSrc )
 
 			// Add children to the queue to process later. 
 			if (cs.src->m_pSub) {
-				cs.dst->m_pSub = localDst = new KeyValues( NULL );
+				cs.dst->m_pSub = localDst = AllocKey( NULL );
 				nodeQ.Insert({ localDst, cs.src->m_pSub });
 			}
 
 			// Process siblings until we hit the end of the line. 
 			if (cs.src->m_pPeer) {
-				cs.dst->m_pPeer = new KeyValues( NULL );
+				cs.dst->m_pPeer = AllocKey( NULL );
 			}
 			else {
 				cs.dst->m_pPeer = NULL;
@@ -1820,7 +2397,7 @@ void KeyValues::CopyKeyValue( const KeyValues& src, size_t tmpBufferSizeB, char*
 		if( src.m_sValue )
 		{
 			int len = Q_strlen(src.m_sValue) + 1;
-			m_sValue = new char[len];
+			m_sValue = AllocValueString( len );
 			Q_strncpy( m_sValue, src.m_sValue, len );
 		}
 		break;
@@ -1829,7 +2406,7 @@ void KeyValues::CopyKeyValue( const KeyValues& src, size_t tmpBufferSizeB, char*
 			m_iValue = src.m_iValue;
 			Q_snprintf( tmpBuffer, tmpBufferSizeB, "%d", m_iValue );
 			int len = Q_strlen(tmpBuffer) + 1;
-			m_sValue = new char[len];
+			m_sValue = AllocValueString( len );
 			Q_strncpy( m_sValue, tmpBuffer, len  );
 		}
 		break;
@@ -1838,7 +2415,7 @@ void KeyValues::CopyKeyValue( const KeyValues& src, size_t tmpBufferSizeB, char*
 			m_flValue = src.m_flValue;
 			Q_snprintf( tmpBuffer, tmpBufferSizeB, "%f", m_flValue );
 			int len = Q_strlen(tmpBuffer) + 1;
-			m_sValue = new char[len];
+			m_sValue = AllocValueString( len );
 			Q_strncpy( m_sValue, tmpBuffer, len );
 		}
 		break;
@@ -1849,7 +2426,7 @@ void KeyValues::CopyKeyValue( const KeyValues& src, size_t tmpBufferSizeB, char*
 		break;
 	case TYPE_UINT64:
 		{
-			m_sValue = new char[sizeof(uint64)];
+			m_sValue = AllocValueString( sizeof(uint64) );
 			Q_memcpy( m_sValue, src.m_sValue, sizeof(uint64) );
 		}
 		break;
@@ -1873,8 +2450,10 @@ void KeyValues::CopyKeyValue( const KeyValues& src, size_t tmpBufferSizeB, char*
 
 KeyValues& KeyValues::operator=( const KeyValues& src )
 {
+	char bArenaNode = m_bArenaNode;
 	RemoveEverything();
 	Init();	// reset all values
+	m_bArenaNode = bArenaNode;
 	CopyKeyValuesFromRecursive( src );
 	return *this;
 }
@@ -1891,7 +2470,7 @@ void KeyValues::CopySubkeys( KeyValues *pParent ) const
 	for ( KeyValues *sub = m_pSub; sub != NULL; sub = sub->m_pPeer )
 	{
 		// take a copy of the subkey
-		KeyValues *dat = sub->MakeCopy();
+		KeyValues *dat = pParent->AdoptNode( sub->MakeCopy() );
 		 
 		// add into subkey list
 		if (pPrev)
@@ -2014,7 +2593,10 @@ bool KeyValues::IsEmpty(const char *keyName)
 //-----------------------------------------------------------------------------
 void KeyValues::Clear( void )
 {
-	delete m_pSub;
+	if ( m_pSub )
+	{
+		m_pSub->deleteThis();
+	}
 	m_pSub = NULL;
 	m_iDataType = TYPE_NONE;
 }
@@ -2036,6 +2618,22 @@ KeyValues::types_t KeyValues::GetDataType(const char *keyName)
 //-----------------------------------------------------------------------------
 void KeyValues::deleteThis()
 {
+	if ( m_bArenaNode )
+	{
+		// Arena memory is only given back all at once, by the root. Anything
+		// else just lets go of the heap nodes hanging off it.
+		CKeyValuesArena *pArena = GetArena();
+		if ( pArena->GetRoot() == this )
+		{
+			pArena->Release();
+		}
+		else if ( pArena->m_bHasForeignNodes )
+		{
+			RemoveEverything();
+		}
+		return;
+	}
+
 	delete this;
 }
 
@@ -2102,7 +2700,7 @@ void KeyValues::ParseIncludedKeys( char const *resourceName, const char *filetoi
 	// Append included file
 	Q_strncat( fullpath, filetoinclude, sizeof( fullpath ), COPY_ALL_CHARACTERS );
 
-	KeyValues *newKV = new KeyValues( fullpath );
+	KeyValues *newKV = AllocKey( fullpath );
 
 	// CUtlSymbol save = s_CurrentFileSymbol;	// did that had any use ???
 
@@ -2270,7 +2868,7 @@ bool KeyValues::LoadFromBuffer( char const *resourceName, CUtlBuffer &buf, IBase
 
 		if ( !pCurrentKey )
 		{
-			pCurrentKey = new KeyValues( s );
+			pCurrentKey = AllocKey( s );
 			Assert( pCurrentKey );
 
 			pCurrentKey->UsesEscapeSequences( m_bHasEscapeSequences != 0 ); // same format has parent use
@@ -2468,11 +3066,7 @@ void KeyValues::RecursiveLoadFromBuffer( char const *resourceName, CUtlBuffer &b
 				break;
 			}
 			
-			if (dat->m_sValue)
-			{
-				delete[] dat->m_sValue;
-				dat->m_sValue = NULL;
-			}
+			dat->FreeAllocatedValue();
 
 			int len = Q_strlen( value );
 
@@ -2512,7 +3106,7 @@ void KeyValues::RecursiveLoadFromBuffer( char const *resourceName, CUtlBuffer &b
 							digit -= 'A' - ( '9' + 1 );
 					retVal = ( retVal * 16 ) + ( digit - '0' );
 				}
-				dat->m_sValue = new char[sizeof(uint64)];
+				dat->m_sValue = dat->AllocValueString( sizeof(uint64) );
 				*((uint64 *)dat->m_sValue) = retVal;
 				dat->m_iDataType = TYPE_UINT64;
 			}
@@ -2534,7 +3128,7 @@ void KeyValues::RecursiveLoadFromBuffer( char const *resourceName, CUtlBuffer &b
 			if (dat->m_iDataType == TYPE_STRING)
 			{
 				// copy in the string information
-				dat->m_sValue = new char[len+1];
+				dat->m_sValue = dat->AllocValueString( len+1 );
 				Q_memcpy( dat->m_sValue, value, len+1 );
 			}
 
@@ -2675,8 +3269,10 @@ bool KeyValues::ReadAsBinary( CUtlBuffer &buffer, int nStackDepth )
 	if ( !buffer.IsValid() ) // must be valid, no overflows etc
 		return false;
 
+	char bArenaNode = m_bArenaNode;
 	RemoveEverything(); // remove current content
 	Init();	// reset
+	m_bArenaNode = bArenaNode;
 	
 	if ( nStackDepth > 100 )
 	{
@@ -2706,7 +3302,7 @@ bool KeyValues::ReadAsBinary( CUtlBuffer &buffer, int nStackDepth )
 		{
 		case TYPE_NONE:
 			{
-				dat->m_pSub = new KeyValues("");
+				dat->m_pSub = AllocKey("");
 				dat->m_pSub->ReadAsBinary( buffer, nStackDepth + 1 );
 				break;
 			}
@@ -2717,7 +3313,7 @@ bool KeyValues::ReadAsBinary( CUtlBuffer &buffer, int nStackDepth )
 				token[KEYVALUES_TOKEN_SIZE-1] = 0;
 
 				int len = Q_strlen( token );
-				dat->m_sValue = new char[len + 1];
+				dat->m_sValue = dat->AllocValueString( len + 1 );
 				Q_memcpy( dat->m_sValue, token, len+1 );
 								
 				break;
@@ -2736,7 +3332,7 @@ bool KeyValues::ReadAsBinary( CUtlBuffer &buffer, int nStackDepth )
 
 		case TYPE_UINT64:
 			{
-				dat->m_sValue = new char[sizeof(uint64)];
+				dat->m_sValue = dat->AllocValueString( sizeof(uint64) );
 				*((uint64 *)dat->m_sValue) = buffer.GetInt64();
 				break;
 			}
@@ -2772,7 +3368,7 @@ bool KeyValues::ReadAsBinary( CUtlBuffer &buffer, int nStackDepth )
 			break;
 
 		// new peer follows
-		dat->m_pPeer = new KeyValues("");
+		dat->m_pPeer = AllocKey("");
 		dat = dat->m_pPeer;
 	}
 
@@ -2811,6 +3407,22 @@ void KeyValues::operator delete( void *pMem, int nBlockUse, const char *pFileNam
 	KeyValuesSystem()->FreeKeyValuesMemory(pMem);
 }
 
+//-----------------------------------------------------------------------------
+// Purpose: Constructs a node in the arena, behind a pointer back to it
+//-----------------------------------------------------------------------------
+KeyValues *CKeyValuesArena::AllocKey( const char *keyName )
+{
+	char *pMem = (char *)Alloc( KEYVALUES_ARENA_NODE_OFFSET + sizeof( KeyValues ) );
+	*(CKeyValuesArena **)pMem = this;
+
+	KeyValues *pKey = ::new( pMem + KEYVALUES_ARENA_NODE_OFFSET ) KeyValues( keyName );
+	pKey->m_bArenaNode = true;
+
+	// Arena nodes are never destructed one by one
+	TRACK_KV_REMOVE( pKey );
+	return pKey;
+}
+
 void KeyValues::UnpackIntoStructure( KeyValuesUnpackStructure const *pUnpackTable, void *pDest, size_t DestSizeInBytes )
 {
 #ifdef DBGFLAG_ASSERT
@@ -119,6 +119,116 @@ public:
 static CBitWriteMasksInit g_BitWriteMasksInit;
 
 
+// Longest encodings of the coordinate writers, used to check for room once up front
+#define BITCOORD_MAX_BITS		( 3 + COORD_INTEGER_BITS + COORD_FRACTIONAL_BITS )
+#define BITVEC3COORD_MAX_BITS	( 3 + 3 * BITCOORD_MAX_BITS )
+#define BITNORMAL_BITS			( 1 + NORMAL_FRACTIONAL_BITS )
+
+//-----------------------------------------------------------------------------
+// Collects small fields in a 64-bit word and writes them to the buffer in as few
+// read-modify-writes as possible. The bits come out exactly as if each field had
+// been written with WriteUBitLong; callers must have checked there's room.
+//-----------------------------------------------------------------------------
+class CBitWriteAccumulator
+{
+public:
+	CBitWriteAccumulator( bf_write *pBuf ) : m_pBuf( pBuf ), m_nData( 0 ), m_nBits( 0 ) {}
+
+	FORCEINLINE void Write( unsigned int data, int numbits )
+	{
+		if ( m_nBits + numbits > 64 )
+		{
+			Flush();
+		}
+		m_nData |= (uint64)data << m_nBits;
+		m_nBits += numbits;
+	}
+
+	FORCEINLINE void Flush()
+	{
+		if ( m_nBits )
+		{
+			m_pBuf->WriteUBit64NoCheck( m_nData, m_nBits );
+			m_nData = 0;
+			m_nBits = 0;
+		}
+	}
+
+	// Bits not yet counted in the buffer's m_iCurBit
+	int GetPendingBits() const { return m_nBits; }
+
+private:
+	bf_write	*m_pBuf;
+	uint64		m_nData;
+	int			m_nBits;
+};
+
+// The fields WriteBitCoord would write, packed into one value. Returns the bit count.
+static FORCEINLINE int EncodeBitCoord( const float f, unsigned int &bits )
+{
+	int		signbit = (f <= -COORD_RESOLUTION);
+	int		intval = (int)abs(f);
+	int		fractval = abs((int)(f*COORD_DENOMINATOR)) & (COORD_DENOMINATOR-1);
+
+	bits = ( intval ? 1 : 0 ) | ( fractval ? 2 : 0 );
+	if ( !intval && !fractval )
+		return 2;
+
+	bits |= signbit << 2;
+	int numbits = 3;
+	if ( intval )
+	{
+		// WriteUBitLong drops anything above COORD_INTEGER_BITS, so do the same
+		bits |= ( (unsigned int)( intval - 1 ) & ( ( 1 << COORD_INTEGER_BITS ) - 1 ) ) << numbits;
+		numbits += COORD_INTEGER_BITS;
+	}
+	if ( fractval )
+	{
+		bits |= (unsigned int)fractval << numbits;
+		numbits += COORD_FRACTIONAL_BITS;
+	}
+	return numbits;
+}
+
+static FORCEINLINE void AccumulateBitVec3Coord( CBitWriteAccumulator &acc, float x, float y, float z )
+{
+	int xflag = (x >= COORD_RESOLUTION) || (x <= -COORD_RESOLUTION);
+	int yflag = (y >= COORD_RESOLUTION) || (y <= -COORD_RESOLUTION);
+	int zflag = (z >= COORD_RESOLUTION) || (z <= -COORD_RESOLUTION);
+
+	acc.Write( xflag | ( yflag << 1 ) | ( zflag << 2 ), 3 );
+
+	unsigned int bits;
+	if ( xflag )
+	{
+		int numbits = EncodeBitCoord( x, bits );
+		acc.Write( bits, numbits );
+	}
+	if ( yflag )
+	{
+		int numbits = EncodeBitCoord( y, bits );
+		acc.Write( bits, numbits );
+	}
+	if ( zflag )
+	{
+		int numbits = EncodeBitCoord( z, bits );
+		acc.Write( bits, numbits );
+	}
+}
+
+// The fields WriteBitNormal would write, packed into one value
+static FORCEINLINE unsigned int EncodeBitNormal( float f )
+{
+	int	signbit = (f <= -NORMAL_RESOLUTION);
+
+	unsigned int fractval = abs( (int)(f*NORMAL_DENOMINATOR) );
+	if (fractval > NORMAL_DENOMINATOR)
+		fractval = NORMAL_DENOMINATOR;
+
+	return signbit | ( fractval << 1 );
+}
+
+
 // ---------------------------------------------------------------------------------------- //
 // bf_write
 // ---------------------------------------------------------------------------------------- //
@@ -271,6 +381,20 @@ void bf_write::WriteVarInt32( uint32 data )
 			return;
 		}
 	}
+	else if ( GetNumBitsLeft() >= bitbuf::kMaxVarint32Bytes * 8 )
+	{
+		// Unaligned, build the bytes up in a register
+		uint64 bits = 0;
+		int numbits = 0;
+		while ( data > 0x7F ) 
+		{
+			bits |= (uint64)( (data & 0x7F) | 0x80 ) << numbits;
+			numbits += 8;
+			data >>= 7;
+		}
+		bits |= (uint64)( data & 0x7F ) << numbits;
+		WriteUBit64NoCheck( bits, numbits + 8 );
+	}
 	else // Slow path
 	{
 		while ( data > 0x7F ) 
@@ -385,6 +509,18 @@ void bf_write::WriteVarInt64( uint64 data )
 		target[size-1] &= 0x7F;
 		m_iCurBit += size * 8;
 	}
+	else if ( GetNumBitsLeft() >= bitbuf::kMaxVarintBytes * 8 )
+	{
+		// Unaligned, build the bytes up in a register
+		CBitWriteAccumulator acc( this );
+		while ( data > 0x7F ) 
+		{
+			acc.Write( (data & 0x7F) | 0x80, 8 );
+			data >>= 7;
+		}
+		acc.Write( data & 0x7F, 8 );
+		acc.Flush();
+	}
 	else // slow path
 	{
 		while ( data > 0x7F ) 
@@ -621,6 +757,16 @@ void bf_write::WriteBitCoord (const float f)
 #if defined( BB_PROFILING )
 	VPROF( "bf_write::WriteBitCoord" );
 #endif
+	unsigned int bits;
+	int numbits = EncodeBitCoord( f, bits );
+	if ( GetNumBitsLeft() >= numbits )
+	{
+		WriteUBitLongNoCheck( bits, numbits );
+		return;
+	}
+
+	// Not enough room. Write the fields one at a time so the buffer overflows
+	// at the same field it always has.
 	int		signbit = (f <= -COORD_RESOLUTION);
 	int		intval = (int)abs(f);
 	int		fractval = abs((int)(f*COORD_DENOMINATOR)) & (COORD_DENOMINATOR-1);
@@ -653,6 +799,14 @@ void bf_write::WriteBitCoord (const float f)
 
 void bf_write::WriteBitVec3Coord( const Vector& fa )
 {
+	if ( GetNumBitsLeft() >= BITVEC3COORD_MAX_BITS )
+	{
+		CBitWriteAccumulator acc( this );
+		AccumulateBitVec3Coord( acc, fa[0], fa[1], fa[2] );
+		acc.Flush();
+		return;
+	}
+
 	int		xflag, yflag, zflag;
 
 	xflag = (fa[0] >= COORD_RESOLUTION) || (fa[0] <= -COORD_RESOLUTION);
@@ -673,6 +827,12 @@ void bf_write::WriteBitVec3Coord( const Vector& fa )
 
 void bf_write::WriteBitNormal( float f )
 {
+	if ( GetNumBitsLeft() >= BITNORMAL_BITS )
+	{
+		WriteUBitLongNoCheck( EncodeBitNormal( f ), BITNORMAL_BITS );
+		return;
+	}
+
 	int	signbit = (f <= -NORMAL_RESOLUTION);
 
 	// NOTE: Since +/-1 are valid values for a normal, I'm going to encode that as all ones
@@ -696,6 +856,28 @@ void bf_write::WriteBitVec3Normal( const Vector& fa )
 	xflag = (fa[0] >= NORMAL_RESOLUTION) || (fa[0] <= -NORMAL_RESOLUTION);
 	yflag = (fa[1] >= NORMAL_RESOLUTION) || (fa[1] <= -NORMAL_RESOLUTION);
 
+	// At most 2 + 2 * 12 + 1 bits, so it always goes out in one write when there's room
+	unsigned int bits = xflag | ( yflag << 1 );
+	int numbits = 2;
+	if ( xflag )
+	{
+		bits |= EncodeBitNormal( fa[0] ) << numbits;
+		numbits += BITNORMAL_BITS;
+	}
+	if ( yflag )
+	{
+		bits |= EncodeBitNormal( fa[1] ) << numbits;
+		numbits += BITNORMAL_BITS;
+	}
+	bits |= (unsigned int)( fa[2] <= -NORMAL_RESOLUTION ) << numbits;
+	++numbits;
+
+	if ( GetNumBitsLeft() >= numbits )
+	{
+		WriteUBitLongNoCheck( bits, numbits );
+		return;
+	}
+
 	WriteOneBit( xflag );
 	WriteOneBit( yflag );
 
@@ -716,6 +898,40 @@ void bf_write::WriteBitAngles( const QAngle& fa )
 	WriteBitVec3Coord( tmp );
 }
 
+void bf_write::WriteBitVec3CoordArray( const Vector *pVecs, int nCount )
+{
+	// Pack while even the longest encoding is sure to fit, then finish up with the
+	// checked writer so an overflow happens exactly where it would have
+	CBitWriteAccumulator acc( this );
+	int i = 0;
+	for ( ; i < nCount && GetNumBitsLeft() - acc.GetPendingBits() >= BITVEC3COORD_MAX_BITS; ++i )
+	{
+		AccumulateBitVec3Coord( acc, pVecs[i].x, pVecs[i].y, pVecs[i].z );
+	}
+	acc.Flush();
+
+	for ( ; i < nCount; ++i )
+	{
+		WriteBitVec3Coord( pVecs[i] );
+	}
+}
+
+void bf_write::WriteBitAnglesArray( const QAngle *pAngles, int nCount )
+{
+	CBitWriteAccumulator acc( this );
+	int i = 0;
+	for ( ; i < nCount && GetNumBitsLeft() - acc.GetPendingBits() >= BITVEC3COORD_MAX_BITS; ++i )
+	{
+		AccumulateBitVec3Coord( acc, pAngles[i].x, pAngles[i].y, pAngles[i].z );
+	}
+	acc.Flush();
+
+	for ( ; i < nCount; ++i )
+	{
+		WriteBitAngles( pAngles[i] );
+	}
+}
+
 void bf_write::WriteChar(int val)
 {
 	WriteSBitLong(val, sizeof(char) << 3);
@@ -1085,6 +1301,9 @@ float bf_read::ReadBitCoord (void)
 #if defined( BB_PROFILING )
 	VPROF( "bf_read::ReadBitCoord" );
 #endif
+	if ( GetNumBitsLeft() >= BITCOORD_MAX_BITS )
+		return ReadBitCoordNoCheck();
+
 	int		intval=0,fractval=0,signbit=0;
 	float	value = 0.0;
 
@@ -1123,6 +1342,34 @@ float bf_read::ReadBitCoord (void)
 	return value;
 }
 
+// Same as ReadBitCoord, for when there are at least BITCOORD_MAX_BITS left
+float bf_read::ReadBitCoordNoCheck()
+{
+	// Integer flag in bit 0, fraction flag in bit 1
+	unsigned int flags = ReadUBitLongNoCheck( 2 );
+	if ( !flags )
+		return 0.0f;
+
+	int signbit = ReadUBitLongNoCheck( 1 );
+	int intval = 0, fractval = 0;
+
+	if ( flags & 1 )
+	{
+		intval = ReadUBitLongNoCheck( COORD_INTEGER_BITS ) + 1;
+	}
+
+	if ( flags & 2 )
+	{
+		fractval = ReadUBitLongNoCheck( COORD_FRACTIONAL_BITS );
+	}
+
+	float value = intval + ((float)fractval * COORD_RESOLUTION);
+	if ( signbit )
+		value = -value;
+
+	return value;
+}
+
 float bf_read::ReadBitCoordMP( bool bIntegral, bool bLowPrecision )
 {
 #if defined( BB_PROFILING )
@@ -1276,6 +1523,18 @@ void bf_read::ReadBitVec3Coord( Vector& fa )
 	// the corresponding component will not be read and will be stack garbage.
 	fa.Init( 0, 0, 0 );
 
+	if ( GetNumBitsLeft() >= BITVEC3COORD_MAX_BITS )
+	{
+		unsigned int flags = ReadUBitLongNoCheck( 3 );
+		if ( flags & 1 )
+			fa[0] = ReadBitCoordNoCheck();
+		if ( flags & 2 )
+			fa[1] = ReadBitCoordNoCheck();
+		if ( flags & 4 )
+			fa[2] = ReadBitCoordNoCheck();
+		return;
+	}
+
 	xflag = ReadOneBit();
 	yflag = ReadOneBit(); 
 	zflag = ReadOneBit();
@@ -1290,6 +1549,16 @@ void bf_read::ReadBitVec3Coord( Vector& fa )
 
 float bf_read::ReadBitNormal (void)
 {
+	if ( GetNumBitsLeft() >= BITNORMAL_BITS )
+	{
+		// Sign in bit 0, fraction above it
+		unsigned int bits = ReadUBitLongNoCheck( BITNORMAL_BITS );
+		float value = (float)( bits >> 1 ) * NORMAL_RESOLUTION;
+		if ( bits & 1 )
+			value = -value;
+		return value;
+	}
+
 	// Read the sign bit
 	int	signbit = ReadOneBit();
 
@@ -1341,6 +1610,22 @@ void bf_read::ReadBitAngles( QAngle& fa )
 	fa.Init( tmp.x, tmp.y, tmp.z );
 }
 
+void bf_read::ReadBitVec3CoordArray( Vector *pVecs, int nCount )
+{
+	for ( int i = 0; i < nCount; ++i )
+	{
+		ReadBitVec3Coord( pVecs[i] );
+	}
+}
+
+void bf_read::ReadBitAnglesArray( QAngle *pAngles, int nCount )
+{
+	for ( int i = 0; i < nCount; ++i )
+	{
+		ReadBitAngles( pAngles[i] );
+	}
+}
+
 int64 bf_read::ReadLongLong()
 {
 	int64 retval;
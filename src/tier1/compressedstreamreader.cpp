@@ -0,0 +1,195 @@
+//========= Copyright Valve Corporation, All rights reserved. ============//
+//
+// Purpose: Decodes a compressed lump or pak entry while it is still being
+//			read.
+//
+// $NoKeywords: $
+//===========================================================================//
+
+#include "tier1/compressedstreamreader.h"
+#include "vstdlib/jobthread.h"
+
+// memdbgon must be the last include file in a .cpp file!!!
+#include "tier0/memdbgon.h"
+
+
+CCompressedStreamReader::CCompressedStreamReader( ICompressedStreamSource *pSource, CompressedStreamFormat_t format, int nChunkSize )
+	: m_pSource( pSource ),
+	  m_Format( format ),
+	  m_Input( 0, 2 * nChunkSize, 0 ),
+	  m_nCompressedBytesRead( 0 ),
+	  m_nReadAheadBytes( 0 ),
+	  m_nChunkSize( nChunkSize ),
+	  m_pReadJob( NULL ),
+	  m_bReadPending( false ),
+	  m_bSourceDone( false ),
+	  m_bError( false )
+{
+	Assert( nChunkSize > 0 );
+	m_pReadAhead = new unsigned char[nChunkSize];
+}
+
+CCompressedStreamReader::~CCompressedStreamReader()
+{
+	// The source and m_pReadAhead must outlive a read in flight
+	if ( m_pReadJob )
+	{
+		m_pReadJob->WaitForFinishAndRelease();
+		m_pReadJob = NULL;
+	}
+
+	delete[] m_pReadAhead;
+}
+
+void CCompressedStreamReader::InitZIPHeader( unsigned int nCompressedSize, unsigned int nOriginalSize )
+{
+	Assert( m_Format == COMPRESSED_STREAM_LZMA_ZIP );
+	m_LZMAStream.InitZIPHeader( nCompressedSize, nOriginalSize );
+}
+
+bool CCompressedStreamReader::IsFinished() const
+{
+	if ( m_Format == COMPRESSED_STREAM_SNAPPY )
+		return m_SnappyStream.IsFinished();
+
+	return m_LZMAStream.IsFinished();
+}
+
+bool CCompressedStreamReader::GetExpectedBytesRemaining( unsigned int &nBytesRemaining )
+{
+	if ( m_Format == COMPRESSED_STREAM_SNAPPY )
+		return m_SnappyStream.GetExpectedBytesRemaining( nBytesRemaining );
+
+	return m_LZMAStream.GetExpectedBytesRemaining( nBytesRemaining );
+}
+
+bool CCompressedStreamReader::Decode( CUtlBuffer &output, unsigned int nMaxBytes )
+{
+	if ( m_Format == COMPRESSED_STREAM_SNAPPY )
+		return m_SnappyStream.Read( m_Input, output, nMaxBytes );
+
+	return m_LZMAStream.Read( m_Input, output, nMaxBytes );
+}
+
+//-----------------------------------------------------------------------------
+// Runs on the thread pool, or inline when it has no idle threads
+//-----------------------------------------------------------------------------
+void CCompressedStreamReader::ReadAhead()
+{
+	m_nReadAheadBytes = m_pSource->ReadCompressed( m_pReadAhead, m_nChunkSize );
+}
+
+void CCompressedStreamReader::StartReadAhead()
+{
+	if ( m_bReadPending || m_bSourceDone )
+		return;
+
+	// Only worth a job if a thread can pick it up right away, otherwise the
+	// read would just queue up behind other work while the decoder waits.
+	m_bReadPending = true;
+	if ( g_pThreadPool && g_pThreadPool->NumIdleThreads() > 0 )
+	{
+		m_pReadJob = g_pThreadPool->AddCall( this, &CCompressedStreamReader::ReadAhead );
+	}
+	else
+	{
+		ReadAhead();
+	}
+}
+
+//-----------------------------------------------------------------------------
+// Waits for the chunk in flight and queues it for the decoder. Returns false
+// if there is no more input.
+//-----------------------------------------------------------------------------
+bool CCompressedStreamReader::FinishReadAhead()
+{
+	if ( !m_bReadPending )
+		return false;
+
+	if ( m_pReadJob )
+	{
+		m_pReadJob->WaitForFinishAndRelease();
+		m_pReadJob = NULL;
+	}
+	m_bReadPending = false;
+
+	if ( m_nReadAheadBytes <= 0 )
+	{
+		if ( m_nReadAheadBytes < 0 )
+		{
+			Warning( "Failed reading compressed stream\n" );
+		}
+		m_bSourceDone = true;
+		return false;
+	}
+
+	// Move what the decoder hasn't consumed yet to the front, so m_Input
+	// never holds more than a chunk or so of data.
+	int nRemaining = m_Input.GetBytesRemaining();
+	if ( m_Input.TellGet() > 0 )
+	{
+		if ( nRemaining > 0 )
+		{
+			memmove( m_Input.Base(), m_Input.PeekGet(), nRemaining );
+		}
+		m_Input.Clear();
+		m_Input.SeekPut( CUtlBuffer::SEEK_HEAD, nRemaining );
+	}
+	m_Input.Put( m_pReadAhead, m_nReadAheadBytes );
+	return true;
+}
+
+int CCompressedStreamReader::ReadSegment( CUtlBuffer &output, int nMaxBytes )
+{
+	if ( m_bError )
+		return -1;
+
+	int nStart = output.TellPut();
+	while ( output.TellPut() - nStart < nMaxBytes && !IsFinished() )
+	{
+		// Keep the next chunk in flight while this one decodes
+		StartReadAhead();
+
+		int nGet = m_Input.TellGet();
+		int nPut = output.TellPut();
+		if ( !Decode( output, nMaxBytes - ( nPut - nStart ) ) )
+		{
+			Warning( "Failed decoding compressed stream\n" );
+			m_bError = true;
+			return -1;
+		}
+		m_nCompressedBytesRead += m_Input.TellGet() - nGet;
+
+		if ( m_Input.TellGet() != nGet || output.TellPut() != nPut )
+			continue;
+
+		// The decoder is starved
+		if ( !FinishReadAhead() )
+		{
+			Warning( "Compressed stream is truncated\n" );
+			m_bError = true;
+			return -1;
+		}
+	}
+
+	return output.TellPut() - nStart;
+}
+
+bool CCompressedStreamReader::ReadAll( CUtlBuffer &output )
+{
+	while ( !IsFinished() )
+	{
+		// Size the output once the header says how big it is
+		unsigned int nRemaining;
+		int nSegment = m_nChunkSize;
+		if ( GetExpectedBytesRemaining( nRemaining ) )
+		{
+			nSegment = (int)Max( nRemaining, 1u );
+		}
+
+		if ( ReadSegment( output, nSegment ) < 0 )
+			return false;
+	}
+
+	return true;
+}
@@ -14,10 +14,12 @@
 #include "tier1/strtools.h"
 #include "tier1/characterset.h"
 #include "tier1/utlbuffer.h"
+#include "tier1/utldict.h"
 #include "tier1/tier1.h"
 #include "tier1/convar_serverbounded.h"
 #include "icvar.h"
 #include "tier0/dbg.h"
+#include "tier0/threadtools.h"
 #include "Color.h"
 #if defined( _X360 )
 #include "xbox/xbox_console.h"
@@ -1085,9 +1087,81 @@ ConVarRef::ConVarRef( const char *pName, bool bIgnoreMissing )
 	Init( pName, bIgnoreMissing );
 }
 
+//-----------------------------------------------------------------------------
+// FindVar lookup counts by name, for finding per frame lookups worth turning
+// into a ConVarHandle or a local ConVar. Only counted while an audit is
+// running, so lookups cost nothing extra otherwise.
+//-----------------------------------------------------------------------------
+static CThreadFastMutex s_FindVarAuditMutex;
+static volatile bool s_bFindVarAudit = false;
+
+static CUtlDict< int, int > &FindVarAuditCounts()
+{
+	static CUtlDict< int, int > s_FindVarCounts;
+	return s_FindVarCounts;
+}
+
+ConVar *ConVar_FindVar( const char *pName )
+{
+	if ( !g_pCVar )
+		return NULL;
+
+	if ( s_bFindVarAudit )
+	{
+		AUTO_LOCK( s_FindVarAuditMutex );
+		CUtlDict< int, int > &counts = FindVarAuditCounts();
+		int i = counts.Find( pName );
+		if ( i == counts.InvalidIndex() )
+		{
+			i = counts.Insert( pName, 0 );
+		}
+		counts[i]++;
+	}
+
+	return g_pCVar->FindVar( pName );
+}
+
+void ConVar_EnableFindVarAudit( bool bEnable )
+{
+	AUTO_LOCK( s_FindVarAuditMutex );
+	if ( bEnable && !s_bFindVarAudit )
+	{
+		FindVarAuditCounts().Purge();
+	}
+	s_bFindVarAudit = bEnable;
+}
+
+static int __cdecl FindVarAuditSortFunc( const int *pLeft, const int *pRight )
+{
+	CUtlDict< int, int > &counts = FindVarAuditCounts();
+	return counts[*pRight] - counts[*pLeft];
+}
+
+void ConVar_PrintFindVarAudit( int nMaxEntries )
+{
+	AUTO_LOCK( s_FindVarAuditMutex );
+	CUtlDict< int, int > &counts = FindVarAuditCounts();
+
+	CUtlVector< int > sorted;
+	sorted.EnsureCapacity( counts.Count() );
+	int nTotal = 0;
+	for ( int i = counts.First(); i != counts.InvalidIndex(); i = counts.Next( i ) )
+	{
+		sorted.AddToTail( i );
+		nTotal += counts[i];
+	}
+	sorted.Sort( FindVarAuditSortFunc );
+
+	ConMsg( "%d FindVar lookups of %d convars%s\n", nTotal, counts.Count(), s_bFindVarAudit ? " so far" : "" );
+	for ( int i = 0; i < sorted.Count() && i < nMaxEntries; i++ )
+	{
+		ConMsg( "%10d  %s\n", counts[sorted[i]], counts.GetElementName( sorted[i] ) );
+	}
+}
+
 void ConVarRef::Init( const char *pName, bool bIgnoreMissing )
 {
-	m_pConVar = g_pCVar ? g_pCVar->FindVar( pName ) : &s_EmptyConVar;
+	m_pConVar = g_pCVar ? ConVar_FindVar( pName ) : &s_EmptyConVar;
 	if ( !m_pConVar )
 	{
 		m_pConVar = &s_EmptyConVar;
@@ -1119,6 +1193,22 @@ bool ConVarRef::IsValid() const
 }
 
 
+//-----------------------------------------------------------------------------
+// Looks the handle's convar up. Missing convars aren't remembered, so a
+// handle used before the convar is registered finds it later on.
+//-----------------------------------------------------------------------------
+ConVar *ConVarHandle::ResolveSlow() const
+{
+	ConVar *pConVar = ConVar_FindVar( m_pName );
+	if ( !pConVar )
+		return &s_EmptyConVar;
+
+	// Read and write the root directly, same as ConVar does through m_pParent
+	m_pConVarState = pConVar->m_pParent;
+	return m_pConVarState;
+}
+
+
 //-----------------------------------------------------------------------------
 // Purpose: 
 //-----------------------------------------------------------------------------
@@ -137,6 +137,110 @@ unsigned FASTCALL HashStringCaselessConventional( const char *pszKey )
 	return hash;
 }
 
+//-----------------------------------------------------------------------------
+// Word at a time string hash
+//-----------------------------------------------------------------------------
+#define HASHSTRINGFAST_M	0x5bd1e995
+
+// Nonzero if any byte of n is zero
+static FORCEINLINE uint32 HasZeroByte( uint32 n )
+{
+	return ( n - 0x01010101 ) & ~n & 0x80808080;
+}
+
+// Lowercases the ASCII letters in all four bytes at once
+static FORCEINLINE uint32 LowerCaseWord( uint32 n )
+{
+	uint32 nHeptets = n & 0x7f7f7f7f;
+	uint32 nAtLeastA = nHeptets + 0x3f3f3f3f;	// high bit set where the byte is >= 'A'
+	uint32 nPastZ = nHeptets + 0x25252525;		// high bit set where the byte is > 'Z'
+	return n | ( ( nAtLeastA & ~nPastZ & ~n & 0x80808080 ) >> 2 );
+}
+
+static FORCEINLINE uint32 MixHashWord( uint32 h, uint32 k )
+{
+	k *= HASHSTRINGFAST_M;
+	k ^= k >> 24;
+	k *= HASHSTRINGFAST_M;
+	h *= HASHSTRINGFAST_M;
+	return h ^ k;
+}
+
+template < bool bCaseless >
+static FORCEINLINE uint32 HashStringFastInternal( const char *pszKey, uint32 nSeed )
+{
+	// Read aligned dwords and shift them together into the string's own four
+	// byte chunks, little endian, so the hash is the same at any alignment
+	int nShift = ( (uintp)pszKey & 3 ) * 8;
+	const uint32 *pWord = (const uint32 *)( (uintp)pszKey & ~(uintp)3 );
+	uint32 h = nSeed;
+	uint32 nLength = 0;
+
+	// Bytes in front of the string can't be taken for its terminator
+	uint32 nLow = LittleDWord( *pWord++ ) | ( ( 1u << nShift ) - 1 );
+	uint32 nChunk;
+	if ( !nShift )
+	{
+		for ( nChunk = nLow; !HasZeroByte( nChunk ); nChunk = LittleDWord( *pWord++ ) )
+		{
+			h = MixHashWord( h, bCaseless ? LowerCaseWord( nChunk ) : nChunk );
+			nLength += 4;
+		}
+	}
+	else
+	{
+		for ( ;; )
+		{
+			// Only read the next dword if the terminator isn't in this one
+			if ( HasZeroByte( nLow ) )
+			{
+				nChunk = nLow >> nShift;
+				break;
+			}
+
+			uint32 nHigh = LittleDWord( *pWord++ );
+			nChunk = ( nLow >> nShift ) | ( nHigh << ( 32 - nShift ) );
+			if ( HasZeroByte( nChunk ) )
+				break;
+
+			h = MixHashWord( h, bCaseless ? LowerCaseWord( nChunk ) : nChunk );
+			nLength += 4;
+			nLow = nHigh;
+		}
+	}
+
+	// Up to three bytes in front of the terminator
+	int nTail = 0;
+	while ( ( nChunk >> ( nTail * 8 ) ) & 0xff )
+	{
+		++nTail;
+	}
+	if ( nTail )
+	{
+		nChunk &= ( 1u << ( nTail * 8 ) ) - 1;
+		h ^= bCaseless ? LowerCaseWord( nChunk ) : nChunk;
+		h *= HASHSTRINGFAST_M;
+	}
+	nLength += nTail;
+
+	h ^= nLength;
+	h ^= h >> 13;
+	h *= HASHSTRINGFAST_M;
+	h ^= h >> 15;
+	return h;
+}
+
+uint32 HashStringFast( const char *pszKey, uint32 nSeed )
+{
+	return HashStringFastInternal< false >( pszKey, nSeed );
+}
+
+uint32 HashStringFastCaseless( const char *pszKey, uint32 nSeed )
+{
+	return HashStringFastInternal< true >( pszKey, nSeed );
+}
+
+
 //-----------------------------------------------------------------------------
 // int hash
 //-----------------------------------------------------------------------------
@@ -21,6 +21,7 @@
 // Ugly define to let us forward declare the anonymous-struct-typedef that is CLzmaDec in the header.
 #define CLzmaDec_t CLzmaDec
 #include "tier1/lzmaDecoder.h"
+#include "tier1/utlbuffer.h"
 
 // memdbgon must be the last include file in a .cpp file!!!
 #include "tier0/memdbgon.h"
@@ -126,6 +127,7 @@ void CLZMAStream::FreeDecoderState()
 	if ( m_pDecoderState )
 	{
 		LzmaDec_Free( m_pDecoderState, &g_Alloc );
+		delete m_pDecoderState;
 		m_pDecoderState = NULL;
 	}
 }
@@ -144,6 +146,7 @@ bool CLZMAStream::CreateDecoderState( const unsigned char *pProperties )
 	if ( LzmaDec_Allocate( m_pDecoderState, pProperties, LZMA_PROPS_SIZE, &g_Alloc) != SZ_OK )
 	{
 		AssertMsg( false, "Failed to allocate lzma decoder state" );
+		delete m_pDecoderState;
 		m_pDecoderState = NULL;
 		return false;
 	}
@@ -238,6 +241,35 @@ bool CLZMAStream::Read( unsigned char *pInput, unsigned int nMaxInputBytes,
 	return true;
 }
 
+// Decode from input's get position into output's put position, see header.
+bool CLZMAStream::Read( CUtlBuffer &input, CUtlBuffer &output, unsigned int nMaxOutputBytes )
+{
+	if ( m_bParsedHeader || m_bZIPStyleHeader )
+	{
+		// Don't grow the output past what the stream can still produce
+		nMaxOutputBytes = Min( nMaxOutputBytes, m_nActualSize - m_nActualBytesRead );
+	}
+
+	// A fixed external buffer just limits how much gets decoded
+	int nPut = output.TellPut();
+	if ( !output.IsExternallyAllocated() || output.IsGrowable() )
+	{
+		output.EnsureCapacity( nPut + nMaxOutputBytes );
+	}
+	nMaxOutputBytes = Min( nMaxOutputBytes, (unsigned int)Max( output.Size() - nPut, 0 ) );
+
+	int nInputAvailable = Max( input.GetBytesRemaining(), 0 );
+	unsigned int nCompressedBytesRead = 0;
+	unsigned int nOutputBytesWritten = 0;
+	bool bSuccess = Read( nInputAvailable ? (unsigned char *)input.PeekGet() : NULL, nInputAvailable,
+	                      (unsigned char *)output.Base() + nPut, nMaxOutputBytes,
+	                      nCompressedBytesRead, nOutputBytesWritten );
+
+	input.SeekGet( CUtlBuffer::SEEK_CURRENT, nCompressedBytesRead );
+	output.SeekPut( CUtlBuffer::SEEK_CURRENT, nOutputBytesWritten );
+	return bSuccess;
+}
+
 bool CLZMAStream::GetExpectedBytesRemaining( /* out */ unsigned int &nBytesRemaining )
 {
 	if ( !m_bParsedHeader && !m_bZIPStyleHeader ) {
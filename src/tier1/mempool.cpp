@@ -310,3 +310,197 @@ void CUtlMemoryPool::Free( void *memBlock )
 }
 
 
+
+
+//-----------------------------------------------------------------------------
+// CMemoryPoolTS
+//-----------------------------------------------------------------------------
+CMemoryPoolTS::CMemoryPoolTS( int blockSize, int numElements, int growMode, const char *pszAllocOwner ) :
+	m_Pool( blockSize, numElements, growMode, pszAllocOwner, TSLIST_NODE_ALIGNMENT )
+{
+	// Same rounding CUtlMemoryPool does, so free blocks can hold a list node
+	m_nBlockSize = AlignValue( MAX( blockSize, (int)sizeof( TSLNodeBase_t ) ), TSLIST_NODE_ALIGNMENT );
+}
+
+CMemoryPoolTS::~CMemoryPoolTS()
+{
+	// Put the cached blocks back so the pool only reports real leaks
+	ReturnCachedBlocks();
+	m_Magazines.PurgeAndDeleteElements();
+}
+
+
+//-----------------------------------------------------------------------------
+// Returns the calling thread's magazine, making one the first time through
+//-----------------------------------------------------------------------------
+CMemoryPoolTS::Magazine_t *CMemoryPoolTS::GetMagazine()
+{
+	Magazine_t *pMagazine = m_pLocalMagazine;
+	if ( !pMagazine )
+	{
+		pMagazine = new Magazine_t;
+		pMagazine->m_nCount = 0;
+
+		AUTO_LOCK( m_mutex );
+		m_Magazines.AddToTail( pMagazine );
+		m_pLocalMagazine = pMagazine;
+	}
+	return pMagazine;
+}
+
+
+//-----------------------------------------------------------------------------
+// Refills an empty magazine halfway, from the shared free list if it has
+// anything, otherwise from the pool. Returns false if the pool is out of memory.
+//-----------------------------------------------------------------------------
+bool CMemoryPoolTS::Refill( Magazine_t *pMagazine )
+{
+	Assert( pMagazine->m_nCount == 0 );
+
+	while ( pMagazine->m_nCount < MAGAZINE_SIZE / 2 )
+	{
+		void *pBlock = m_FreeBlocks.Pop();
+		if ( !pBlock )
+			break;
+		pMagazine->m_pBlocks[pMagazine->m_nCount++] = pBlock;
+	}
+
+	if ( pMagazine->m_nCount == 0 )
+	{
+		AUTO_LOCK( m_mutex );
+		while ( pMagazine->m_nCount < MAGAZINE_SIZE / 2 )
+		{
+			void *pBlock = m_Pool.Alloc();
+			if ( !pBlock )
+				break;
+			pMagazine->m_pBlocks[pMagazine->m_nCount++] = pBlock;
+		}
+	}
+
+	return ( pMagazine->m_nCount != 0 );
+}
+
+
+//-----------------------------------------------------------------------------
+// Moves blocks from the top of a magazine onto the shared free list
+//-----------------------------------------------------------------------------
+void CMemoryPoolTS::Spill( Magazine_t *pMagazine, int nBlocks )
+{
+	Assert( nBlocks <= pMagazine->m_nCount );
+	while ( nBlocks-- > 0 )
+	{
+		m_FreeBlocks.Push( (TSLNodeBase_t *)pMagazine->m_pBlocks[--pMagazine->m_nCount] );
+	}
+}
+
+
+//-----------------------------------------------------------------------------
+// Gives every cached block back to the pool
+//-----------------------------------------------------------------------------
+void CMemoryPoolTS::ReturnCachedBlocks()
+{
+	AUTO_LOCK( m_mutex );
+
+	void *pBlock;
+	while ( ( pBlock = m_FreeBlocks.Pop() ) != NULL )
+	{
+		m_Pool.Free( pBlock );
+	}
+
+	FOR_EACH_VEC( m_Magazines, i )
+	{
+		Magazine_t *pMagazine = m_Magazines[i];
+		while ( pMagazine->m_nCount > 0 )
+		{
+			m_Pool.Free( pMagazine->m_pBlocks[--pMagazine->m_nCount] );
+		}
+	}
+}
+
+
+void* CMemoryPoolTS::Alloc()
+{
+	return Alloc( m_nBlockSize );
+}
+
+
+void* CMemoryPoolTS::AllocZero()
+{
+	return AllocZero( m_nBlockSize );
+}
+
+
+void *CMemoryPoolTS::Alloc( size_t amount )
+{
+	if ( amount > (unsigned int)m_nBlockSize )
+		return NULL;
+
+	Magazine_t *pMagazine = GetMagazine();
+	if ( pMagazine->m_nCount == 0 && !Refill( pMagazine ) )
+		return NULL;
+
+	int nAllocated = ++m_nBlocksAllocated;
+	for ( int nPeak = m_nPeakAlloc; nAllocated > nPeak; nPeak = m_nPeakAlloc )
+	{
+		if ( m_nPeakAlloc.AssignIf( nPeak, nAllocated ) )
+			break;
+	}
+
+	return pMagazine->m_pBlocks[--pMagazine->m_nCount];
+}
+
+
+void *CMemoryPoolTS::AllocZero( size_t amount )
+{
+	void *mem = Alloc( amount );
+	if ( mem )
+	{
+		V_memset( mem, 0x00, amount );
+	}
+	return mem;
+}
+
+
+void CMemoryPoolTS::Free( void *pMem )
+{
+	if ( !pMem )
+		return;
+
+#ifdef _DEBUG
+	// invalidate the memory
+	memset( pMem, 0xDD, m_nBlockSize );
+#endif
+
+	--m_nBlocksAllocated;
+
+	Magazine_t *pMagazine = GetMagazine();
+	if ( pMagazine->m_nCount == MAGAZINE_SIZE )
+	{
+		Spill( pMagazine, MAGAZINE_SIZE / 2 );
+	}
+	pMagazine->m_pBlocks[pMagazine->m_nCount++] = pMem;
+}
+
+
+void CMemoryPoolTS::FlushThreadCache()
+{
+	Magazine_t *pMagazine = m_pLocalMagazine;
+	if ( pMagazine )
+	{
+		Spill( pMagazine, pMagazine->m_nCount );
+	}
+}
+
+
+void CMemoryPoolTS::Clear()
+{
+	AUTO_LOCK( m_mutex );
+
+	m_FreeBlocks.Detach();
+	FOR_EACH_VEC( m_Magazines, i )
+	{
+		m_Magazines[i]->m_nCount = 0;
+	}
+	m_Pool.Clear();
+	m_nBlocksAllocated = 0;
+}
@@ -12,6 +12,7 @@ bool CheckMMXTechnology(void) { return false; }
 bool CheckSSETechnology(void) { return false; }
 bool CheckSSE2Technology(void) { return false; }
 bool Check3DNowTechnology(void) { return false; }
+bool CheckPCLMULTechnology(void) { return false; }
 
 #elif defined( _WIN32 ) && !defined( _X360 )
 
@@ -269,6 +270,36 @@ bool Check3DNowTechnology(void)
     return retval;
 }
 
+bool CheckPCLMULTechnology(void)
+{
+    int retval = true;
+    unsigned int RegECX = 0;
+
+#ifdef CPUID
+	_asm pushad;
+#endif
+
+    __try
+	{
+        _asm
+		{
+            mov eax, 1      // set up CPUID to return processor version and features
+            CPUID           // code bytes = 0fh,  0a2h
+            mov RegECX, ecx // PCLMULQDQ is bit 1 of ecx
+		}
+    } 
+	__except(EXCEPTION_EXECUTE_HANDLER) 
+	{ 
+		retval = false; 
+	}
+
+#ifdef CPUID
+	_asm popad;
+#endif
+
+    return retval && ( RegECX & 0x2 );
+}
+
 #pragma optimize( "", on )
 
 #endif // _WIN32
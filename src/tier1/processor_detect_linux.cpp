@@ -45,3 +45,11 @@ bool Check3DNowTechnology(void)
     }
     return false;
 }
+
+bool CheckPCLMULTechnology(void)
+{
+    unsigned long eax,ebx,ecx,unused;
+    cpuid(1,eax,ebx,ecx,unused);
+
+    return ecx & 0x2;
+}
@@ -0,0 +1,319 @@
+//========= Copyright Valve Corporation, All rights reserved. ============//
+//
+// Purpose: Incremental decoder for raw snappy data
+//
+// $NoKeywords: $
+//===========================================================================//
+
+#include "tier0/platform.h"
+#include "tier0/basetypes.h"
+#include "tier0/dbg.h"
+#include "tier1/snappystream.h"
+#include "tier1/utlbuffer.h"
+
+// memdbgon must be the last include file in a .cpp file!!!
+#include "tier0/memdbgon.h"
+
+// snappy::kBlockSize. The compressor works on blocks of this size and never
+// emits an offset reaching further back.
+#define SNAPPY_WINDOW_SIZE		( 1 << 16 )
+#define SNAPPY_WINDOW_MASK		( SNAPPY_WINDOW_SIZE - 1 )
+
+// Tag element types, the low two bits of each tag byte
+enum
+{
+	SNAPPY_LITERAL = 0,
+	SNAPPY_COPY_1_BYTE_OFFSET = 1,
+	SNAPPY_COPY_2_BYTE_OFFSET = 2,
+	SNAPPY_COPY_4_BYTE_OFFSET = 3,
+};
+
+//-----------------------------------------------------------------------------
+// Total size of the tag starting with this byte, including itself
+//-----------------------------------------------------------------------------
+static inline unsigned int SnappyTagLength( unsigned char tag )
+{
+	switch ( tag & 3 )
+	{
+	case SNAPPY_LITERAL:
+		// Literals up to 60 bytes keep their length in the tag, longer
+		// ones follow it with a 1-4 byte length
+		return ( tag >> 2 ) < 60 ? 1 : ( tag >> 2 ) - 58;
+	case SNAPPY_COPY_1_BYTE_OFFSET:
+		return 2;
+	case SNAPPY_COPY_2_BYTE_OFFSET:
+		return 3;
+	default:
+		return 5;
+	}
+}
+
+CSnappyStream::CSnappyStream()
+	: m_pWindow( NULL ),
+	  m_nWindowPos( 0 ),
+	  m_nActualSize( 0 ),
+	  m_nActualBytesRead( 0 ),
+	  m_nPending( 0 ),
+	  m_nCopyOffset( 0 ),
+	  m_eState( eState_Preamble ),
+	  m_nTagBytes( 0 )
+{}
+
+CSnappyStream::~CSnappyStream()
+{
+	delete[] m_pWindow;
+}
+
+void CSnappyStream::AppendToWindow( const unsigned char *pData, unsigned int nBytes )
+{
+	while ( nBytes )
+	{
+		unsigned int nPos = m_nWindowPos & SNAPPY_WINDOW_MASK;
+		unsigned int nChunk = Min( nBytes, (unsigned int)SNAPPY_WINDOW_SIZE - nPos );
+		memcpy( m_pWindow + nPos, pData, nChunk );
+		m_nWindowPos += nChunk;
+		pData += nChunk;
+		nBytes -= nChunk;
+	}
+}
+
+//-----------------------------------------------------------------------------
+// Decodes the complete tag in m_Tag, setting up the literal or copy it starts
+//-----------------------------------------------------------------------------
+bool CSnappyStream::ParseTag()
+{
+	const unsigned char *pTag = m_Tag;
+	unsigned int nLength;
+
+	switch ( pTag[0] & 3 )
+	{
+	case SNAPPY_LITERAL:
+		nLength = pTag[0] >> 2;
+		if ( nLength >= 60 )
+		{
+			unsigned int nExtraBytes = nLength - 59;
+			nLength = 0;
+			for ( unsigned int i = 0; i < nExtraBytes; i++ )
+			{
+				nLength |= (unsigned int)pTag[1 + i] << ( i * 8 );
+			}
+		}
+		if ( nLength == 0xFFFFFFFF )
+			return false;
+		m_nPending = nLength + 1;
+		m_eState = eState_Literal;
+		break;
+
+	case SNAPPY_COPY_1_BYTE_OFFSET:
+		m_nPending = ( ( pTag[0] >> 2 ) & 7 ) + 4;
+		m_nCopyOffset = ( ( pTag[0] >> 5 ) << 8 ) | pTag[1];
+		m_eState = eState_Copy;
+		break;
+
+	case SNAPPY_COPY_2_BYTE_OFFSET:
+		m_nPending = ( pTag[0] >> 2 ) + 1;
+		m_nCopyOffset = pTag[1] | ( pTag[2] << 8 );
+		m_eState = eState_Copy;
+		break;
+
+	default:
+		m_nPending = ( pTag[0] >> 2 ) + 1;
+		m_nCopyOffset = pTag[1] | ( pTag[2] << 8 ) | ( pTag[3] << 16 ) | ( (unsigned int)pTag[4] << 24 );
+		m_eState = eState_Copy;
+		break;
+	}
+
+	m_nTagBytes = 0;
+
+	if ( m_nPending > m_nActualSize - m_nActualBytesRead )
+	{
+		Warning( "Snappy stream: element runs past the end of the output\n" );
+		return false;
+	}
+
+	if ( m_eState == eState_Copy &&
+		 ( m_nCopyOffset == 0 || m_nCopyOffset > m_nActualBytesRead || m_nCopyOffset > SNAPPY_WINDOW_SIZE ) )
+	{
+		Warning( "Snappy stream: bad copy offset %u\n", m_nCopyOffset );
+		return false;
+	}
+
+	return true;
+}
+
+// Attempt to read up to nMaxInputBytes from the compressed stream, writing up to nMaxOutputBytes to pOutput.
+// Returns false if read stops due to an error.
+bool CSnappyStream::Read( const unsigned char *pInput, unsigned int nMaxInputBytes,
+                          unsigned char *pOutput, unsigned int nMaxOutputBytes,
+                          /* out */ unsigned int &nCompressedBytesRead,
+                          /* out */ unsigned int &nOutputBytesWritten )
+{
+	nCompressedBytesRead = 0;
+	nOutputBytesWritten = 0;
+
+	if ( m_eState == eState_Error || IsFinished() )
+		return false;
+
+	const unsigned char *pIn = pInput;
+	const unsigned char *pInEnd = pInput + nMaxInputBytes;
+	unsigned char *pOut = pOutput;
+	unsigned char *pOutEnd = pOutput + nMaxOutputBytes;
+
+	for ( ;; )
+	{
+		if ( m_eState == eState_Preamble )
+		{
+			// Little endian base 128 varint, at most 5 bytes for 32 bits
+			while ( pIn < pInEnd )
+			{
+				unsigned char c = *pIn++;
+				if ( m_nTagBytes == 4 && c > 0xF )
+				{
+					Warning( "Snappy stream: bad length preamble\n" );
+					m_eState = eState_Error;
+					break;
+				}
+				m_nActualSize |= (unsigned int)( c & 0x7F ) << ( m_nTagBytes * 7 );
+				m_nTagBytes++;
+				if ( !( c & 0x80 ) )
+				{
+					m_nTagBytes = 0;
+					m_eState = eState_Tag;
+					break;
+				}
+			}
+			if ( m_eState != eState_Tag )
+				break;
+
+			if ( !m_pWindow && m_nActualSize )
+			{
+				m_pWindow = new unsigned char[SNAPPY_WINDOW_SIZE];
+			}
+		}
+		else if ( m_eState == eState_Tag )
+		{
+			if ( m_nTagBytes == 0 && m_nActualBytesRead == m_nActualSize )
+			{
+				// Done, leave anything after the stream alone
+				break;
+			}
+
+			if ( m_nTagBytes == 0 && pInEnd - pIn >= 5 )
+			{
+				// Common case, the whole tag is in this input. Parse it in place.
+				unsigned int nTagLength = SnappyTagLength( *pIn );
+				memcpy( m_Tag, pIn, nTagLength );
+				pIn += nTagLength;
+			}
+			else
+			{
+				if ( pIn == pInEnd )
+					break;
+
+				if ( m_nTagBytes == 0 )
+				{
+					m_Tag[m_nTagBytes++] = *pIn++;
+				}
+				unsigned int nTagLength = SnappyTagLength( m_Tag[0] );
+				unsigned int nCopy = Min( nTagLength - m_nTagBytes, (unsigned int)( pInEnd - pIn ) );
+				memcpy( m_Tag + m_nTagBytes, pIn, nCopy );
+				m_nTagBytes += nCopy;
+				pIn += nCopy;
+				if ( m_nTagBytes < nTagLength )
+					break;
+			}
+
+			if ( !ParseTag() )
+			{
+				m_eState = eState_Error;
+				break;
+			}
+		}
+		else if ( m_eState == eState_Literal )
+		{
+			unsigned int nCopy = Min( m_nPending, (unsigned int)Min( pInEnd - pIn, pOutEnd - pOut ) );
+			if ( !nCopy )
+				break;
+
+			memcpy( pOut, pIn, nCopy );
+			AppendToWindow( pOut, nCopy );
+			pIn += nCopy;
+			pOut += nCopy;
+			m_nActualBytesRead += nCopy;
+			m_nPending -= nCopy;
+			if ( !m_nPending )
+			{
+				m_eState = eState_Tag;
+			}
+		}
+		else if ( m_eState == eState_Copy )
+		{
+			// Copy at most m_nCopyOffset bytes at once, so a run that overlaps
+			// its own output repeats the pattern the way the format expects.
+			while ( m_nPending && pOut < pOutEnd )
+			{
+				unsigned int nSrc = ( m_nWindowPos - m_nCopyOffset ) & SNAPPY_WINDOW_MASK;
+				unsigned int nCopy = Min( Min( m_nPending, m_nCopyOffset ), (unsigned int)( pOutEnd - pOut ) );
+				nCopy = Min( nCopy, (unsigned int)SNAPPY_WINDOW_SIZE - nSrc );
+
+				memcpy( pOut, m_pWindow + nSrc, nCopy );
+				AppendToWindow( pOut, nCopy );
+				pOut += nCopy;
+				m_nActualBytesRead += nCopy;
+				m_nPending -= nCopy;
+			}
+
+			if ( m_nPending )
+				break;
+
+			m_eState = eState_Tag;
+		}
+		else
+		{
+			break;
+		}
+	}
+
+	nCompressedBytesRead = pIn - pInput;
+	nOutputBytesWritten = pOut - pOutput;
+
+	return m_eState != eState_Error;
+}
+
+// Decode from input's get position into output's put position, see header.
+bool CSnappyStream::Read( CUtlBuffer &input, CUtlBuffer &output, unsigned int nMaxOutputBytes )
+{
+	if ( m_eState != eState_Preamble )
+	{
+		// Don't grow the output past what the stream can still produce
+		nMaxOutputBytes = Min( nMaxOutputBytes, m_nActualSize - m_nActualBytesRead );
+	}
+
+	// A fixed external buffer just limits how much gets decoded
+	int nPut = output.TellPut();
+	if ( !output.IsExternallyAllocated() || output.IsGrowable() )
+	{
+		output.EnsureCapacity( nPut + nMaxOutputBytes );
+	}
+	nMaxOutputBytes = Min( nMaxOutputBytes, (unsigned int)Max( output.Size() - nPut, 0 ) );
+
+	int nInputAvailable = Max( input.GetBytesRemaining(), 0 );
+	unsigned int nCompressedBytesRead = 0;
+	unsigned int nOutputBytesWritten = 0;
+	bool bSuccess = Read( nInputAvailable ? (const unsigned char *)input.PeekGet() : NULL, nInputAvailable,
+	                      (unsigned char *)output.Base() + nPut, nMaxOutputBytes,
+	                      nCompressedBytesRead, nOutputBytesWritten );
+
+	input.SeekGet( CUtlBuffer::SEEK_CURRENT, nCompressedBytesRead );
+	output.SeekPut( CUtlBuffer::SEEK_CURRENT, nOutputBytesWritten );
+	return bSuccess;
+}
+
+bool CSnappyStream::GetExpectedBytesRemaining( /* out */ unsigned int &nBytesRemaining )
+{
+	if ( m_eState == eState_Preamble )
+		return false;
+
+	nBytesRemaining = m_nActualSize - m_nActualBytesRead;
+	return true;
+}
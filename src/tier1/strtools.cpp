@@ -75,6 +75,19 @@
 #if defined( _X360 )
 #include "xbox/xbox_win32stubs.h"
 #endif
+
+// The hot compare and path helpers have SSE2 versions. MSVC allows the intrinsics
+// whatever /arch is set to, GCC and clang only with -msse2.
+#if ( defined( _M_IX86 ) || defined( _M_X64 ) || defined( __i386__ ) || defined( __x86_64__ ) ) && !defined( _X360 ) && \
+	( defined( __SSE2__ ) || defined( _MSC_VER ) )
+#define STRTOOLS_SSE2
+#include <emmintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+#include "tier1/processor_detect.h"
+#endif
+
 #include "tier0/memdbgon.h"
 
 static int FastToLower( char c )
@@ -92,6 +105,61 @@ static int FastToLower( char c )
 	return i;
 }
 
+// ASCII only tolower(), matching what the case insensitive compares fold
+static inline unsigned char FoldASCII( unsigned char c )
+{
+	return ( (unsigned char)( c - 'A' ) <= ( 'Z' - 'A' ) ) ? c + ( 'a' - 'A' ) : c;
+}
+
+#ifdef STRTOOLS_SSE2
+
+#if defined( __SSE2__ ) || defined( _M_X64 ) || ( defined( _M_IX86_FP ) && _M_IX86_FP >= 2 )
+#define StrToolsHasSSE2()	true
+#else
+// Stays false until static init gets here, so very early callers take the byte loops
+static bool s_bStrToolsSSE2 = CheckSSE2Technology();
+#define StrToolsHasSSE2()	s_bStrToolsSSE2
+#endif
+
+// The SIMD loops read 16 bytes at a time and may read past the terminator, but
+// only within the page the string's current byte is on, so they can't fault
+// where a byte loop wouldn't.
+#define STRTOOLS_PAGE_SIZE	4096
+
+static inline bool CanLoad16( const void *p )
+{
+	return ( (uintp)p & ( STRTOOLS_PAGE_SIZE - 1 ) ) <= STRTOOLS_PAGE_SIZE - 16;
+}
+
+static inline int FirstSetBit( unsigned int nMask )
+{
+#ifdef _MSC_VER
+	unsigned long nIndex;
+	_BitScanForward( &nIndex, nMask );
+	return (int)nIndex;
+#else
+	return __builtin_ctz( nMask );
+#endif
+}
+
+// FoldASCII() on 16 bytes. Offsetting by 'A' + 128 moves 'A'..'Z' to the bottom
+// of the signed range, where a single signed compare picks them out.
+static inline __m128i FoldASCII16( __m128i v )
+{
+	__m128i shifted = _mm_sub_epi8( v, _mm_set1_epi8( (char)( 'A' + 128 ) ) );
+	__m128i upper = _mm_cmplt_epi8( shifted, _mm_set1_epi8( (char)( -128 + 26 ) ) );
+	return _mm_or_si128( v, _mm_and_si128( upper, _mm_set1_epi8( 'a' - 'A' ) ) );
+}
+
+// Mask of the bytes of v that are path separators
+static inline unsigned int PathSeparatorMask16( __m128i v )
+{
+	__m128i slashes = _mm_or_si128( _mm_cmpeq_epi8( v, _mm_set1_epi8( '/' ) ), _mm_cmpeq_epi8( v, _mm_set1_epi8( '\\' ) ) );
+	return _mm_movemask_epi8( slashes );
+}
+
+#endif // STRTOOLS_SSE2
+
 void _V_memset (const char* file, int line, void *dest, int fill, int count)
 {
 	Assert( count >= 0 );
@@ -257,18 +325,8 @@ char *V_strnlwr(char *s, size_t count)
 	return pRet;
 }
 
-int V_stricmp( const char *str1, const char *str2 )
+static int V_stricmpFrom( const unsigned char *s1, const unsigned char *s2 )
 {
-	// It is not uncommon to compare a string to itself. See
-	// VPanelWrapper::GetPanel which does this a lot. Since stricmp
-	// is expensive and pointer comparison is cheap, this simple test
-	// can save a lot of cycles, and cache pollution.
-	if ( str1 == str2 )
-	{
-		return 0;
-	}
-	const unsigned char *s1 = (const unsigned char*)str1;
-	const unsigned char *s2 = (const unsigned char*)str2;
 	for ( ; *s1; ++s1, ++s2 )
 	{
 		if ( *s1 != *s2 )
@@ -290,10 +348,59 @@ int V_stricmp( const char *str1, const char *str2 )
 	return *s2 ? -1 : 0;
 }
 
-int V_strnicmp( const char *str1, const char *str2, int n )
+int V_stricmp( const char *str1, const char *str2 )
 {
+	// It is not uncommon to compare a string to itself. See
+	// VPanelWrapper::GetPanel which does this a lot. Since stricmp
+	// is expensive and pointer comparison is cheap, this simple test
+	// can save a lot of cycles, and cache pollution.
+	if ( str1 == str2 )
+	{
+		return 0;
+	}
 	const unsigned char *s1 = (const unsigned char*)str1;
 	const unsigned char *s2 = (const unsigned char*)str2;
+
+#ifdef STRTOOLS_SSE2
+	if ( StrToolsHasSSE2() )
+	{
+		// Skip the folded-equal prefix 16 bytes at a time, then let the byte
+		// loop work out the result from the first difference or terminator.
+		const __m128i zero = _mm_setzero_si128();
+		for ( ;; )
+		{
+			if ( !CanLoad16( s1 ) || !CanLoad16( s2 ) )
+			{
+				// Step a byte at a time past the end of the page
+				if ( !*s1 || FoldASCII( *s1 ) != FoldASCII( *s2 ) )
+					break;
+				++s1;
+				++s2;
+				continue;
+			}
+
+			__m128i a = _mm_loadu_si128( (const __m128i *)s1 );
+			__m128i b = _mm_loadu_si128( (const __m128i *)s2 );
+			unsigned int nEqual = _mm_movemask_epi8( _mm_cmpeq_epi8( FoldASCII16( a ), FoldASCII16( b ) ) );
+			unsigned int nStop = ( ~nEqual & 0xFFFF ) | _mm_movemask_epi8( _mm_cmpeq_epi8( a, zero ) );
+			if ( nStop )
+			{
+				int i = FirstSetBit( nStop );
+				s1 += i;
+				s2 += i;
+				break;
+			}
+			s1 += 16;
+			s2 += 16;
+		}
+	}
+#endif
+
+	return V_stricmpFrom( s1, s2 );
+}
+
+static int V_strnicmpFrom( const unsigned char *s1, const unsigned char *s2, int n )
+{
 	for ( ; n > 0 && *s1; --n, ++s1, ++s2 )
 	{
 		if ( *s1 != *s2 )
@@ -315,6 +422,50 @@ int V_strnicmp( const char *str1, const char *str2, int n )
 	return (n > 0 && *s2) ? -1 : 0;
 }
 
+int V_strnicmp( const char *str1, const char *str2, int n )
+{
+	const unsigned char *s1 = (const unsigned char*)str1;
+	const unsigned char *s2 = (const unsigned char*)str2;
+
+#ifdef STRTOOLS_SSE2
+	if ( StrToolsHasSSE2() )
+	{
+		// Same as V_stricmp, while at least 16 bytes remain to be compared
+		const __m128i zero = _mm_setzero_si128();
+		while ( n >= 16 )
+		{
+			if ( !CanLoad16( s1 ) || !CanLoad16( s2 ) )
+			{
+				if ( !*s1 || FoldASCII( *s1 ) != FoldASCII( *s2 ) )
+					break;
+				++s1;
+				++s2;
+				--n;
+				continue;
+			}
+
+			__m128i a = _mm_loadu_si128( (const __m128i *)s1 );
+			__m128i b = _mm_loadu_si128( (const __m128i *)s2 );
+			unsigned int nEqual = _mm_movemask_epi8( _mm_cmpeq_epi8( FoldASCII16( a ), FoldASCII16( b ) ) );
+			unsigned int nStop = ( ~nEqual & 0xFFFF ) | _mm_movemask_epi8( _mm_cmpeq_epi8( a, zero ) );
+			if ( nStop )
+			{
+				int i = FirstSetBit( nStop );
+				s1 += i;
+				s2 += i;
+				n -= i;
+				break;
+			}
+			s1 += 16;
+			s2 += 16;
+			n -= 16;
+		}
+	}
+#endif
+
+	return V_strnicmpFrom( s1, s2, n );
+}
+
 int V_strncmp( const char *s1, const char *s2, int count )
 {
 	Assert( count >= 0 );
@@ -611,6 +762,73 @@ void V_normalizeFloatString( char* pFloat )
 }
 
 
+#ifdef STRTOOLS_SSE2
+//-----------------------------------------------------------------------------
+// V_stristr for an ASCII first search character: finds candidate positions 16
+// bytes at a time, then checks the rest of the search string at each.
+//-----------------------------------------------------------------------------
+static char const* V_stristrSSE2( char const* pStr, char const* pSearch )
+{
+	unsigned char cLower = FoldASCII( *pSearch );
+	unsigned char cUpper = ( (unsigned char)( cLower - 'a' ) <= ( 'z' - 'a' ) ) ? cLower - ( 'a' - 'A' ) : cLower;
+	const __m128i lower = _mm_set1_epi8( cLower );
+	const __m128i upper = _mm_set1_epi8( cUpper );
+	const __m128i zero = _mm_setzero_si128();
+
+	for ( char const* pLetter = pStr; ; )
+	{
+		unsigned int nCandidates, nEnd;
+		int nStep;
+		if ( CanLoad16( pLetter ) )
+		{
+			__m128i v = _mm_loadu_si128( (const __m128i *)pLetter );
+			nCandidates = _mm_movemask_epi8( _mm_or_si128( _mm_cmpeq_epi8( v, lower ), _mm_cmpeq_epi8( v, upper ) ) );
+			nEnd = _mm_movemask_epi8( _mm_cmpeq_epi8( v, zero ) );
+			nStep = 16;
+		}
+		else
+		{
+			nCandidates = ( (unsigned char)*pLetter == cLower || (unsigned char)*pLetter == cUpper );
+			nEnd = ( *pLetter == 0 );
+			nStep = 1;
+		}
+
+		if ( nEnd )
+		{
+			// Only candidates before the terminator count
+			nCandidates &= ( nEnd & ( 0u - nEnd ) ) - 1;
+		}
+
+		for ( ; nCandidates; nCandidates &= nCandidates - 1 )
+		{
+			char const* pCandidate = pLetter + FirstSetBit( nCandidates );
+			char const* pMatch = pCandidate + 1;
+			char const* pTest = pSearch + 1;
+			while ( *pTest != 0 )
+			{
+				// We've run off the end; no later candidate can match either.
+				if ( *pMatch == 0 )
+					return 0;
+
+				if ( FastToLower( *pMatch ) != FastToLower( *pTest ) )
+					break;
+
+				++pMatch;
+				++pTest;
+			}
+
+			if ( *pTest == 0 )
+				return pCandidate;
+		}
+
+		if ( nEnd )
+			return 0;
+
+		pLetter += nStep;
+	}
+}
+#endif
+
 //-----------------------------------------------------------------------------
 // Finds a string in another string with a case insensitive test
 //-----------------------------------------------------------------------------
@@ -622,6 +840,12 @@ char const* V_stristr( char const* pStr, char const* pSearch )
 	if (!pStr || !pSearch) 
 		return 0;
 
+#ifdef STRTOOLS_SSE2
+	// Non-ASCII first characters fold through the CRT, leave those to the byte loop
+	if ( StrToolsHasSSE2() && *pSearch && (unsigned char)*pSearch < 0x80 )
+		return V_stristrSSE2( pStr, pSearch );
+#endif
+
 	char const* pLetter = pStr;
 
 	// Check the entire string
@@ -1864,6 +2088,30 @@ void  V_StripFilename (char *path)
 //-----------------------------------------------------------------------------
 void V_FixSlashes( char *pname, char separator /* = CORRECT_PATH_SEPARATOR */ )
 {
+#ifdef STRTOOLS_SSE2
+	if ( StrToolsHasSSE2() )
+	{
+		// Whole 16 byte chunks before the terminator. Only those are stored to,
+		// the chunk holding the terminator is left to the byte loop.
+		const __m128i zero = _mm_setzero_si128();
+		const __m128i sep = _mm_set1_epi8( separator );
+		while ( CanLoad16( pname ) )
+		{
+			__m128i v = _mm_loadu_si128( (const __m128i *)pname );
+			if ( _mm_movemask_epi8( _mm_cmpeq_epi8( v, zero ) ) )
+				break;
+
+			__m128i slashes = _mm_or_si128( _mm_cmpeq_epi8( v, _mm_set1_epi8( '/' ) ), _mm_cmpeq_epi8( v, _mm_set1_epi8( '\\' ) ) );
+			if ( _mm_movemask_epi8( slashes ) )
+			{
+				v = _mm_or_si128( _mm_and_si128( slashes, sep ), _mm_andnot_si128( slashes, v ) );
+				_mm_storeu_si128( (__m128i *)pname, v );
+			}
+			pname += 16;
+		}
+	}
+#endif
+
 	while ( *pname )
 	{
 		if ( *pname == INCORRECT_PATH_SEPARATOR || *pname == CORRECT_PATH_SEPARATOR )
@@ -1881,17 +2129,63 @@ void V_FixSlashes( char *pname, char separator /* = CORRECT_PATH_SEPARATOR */ )
 void V_FixDoubleSlashes( char *pStr )
 {
 	int len = V_strlen( pStr );
+	if ( len < 3 )
+		return;
 
-	for ( int i=1; i < len-1; i++ )
-	{
-		if ( (pStr[i] == '/' || pStr[i] == '\\') && (pStr[i+1] == '/' || pStr[i+1] == '\\') )
+	// This means there's a double slash somewhere past the start of the filename. That 
+	// can happen in Hammer if they use a material in the root directory. You'll get a filename 
+	// that looks like 'materials\\blah.vmt'
+	//
+	// Compacts in one pass. Gives the same result as removing the first slash of each pair in
+	// place and moving on, so the kept slash is never paired with the character after it.
+	int nRead = 1;
+	int nWrite = 1;
+	while ( nRead < len - 1 )
+	{
+#ifdef STRTOOLS_SSE2
+		if ( StrToolsHasSSE2() )
+		{
+			// Copy the run up to the next slash in 16 byte steps. Stays inside the string.
+			int nRun = 0;
+			while ( nRead + nRun + 16 <= len - 1 )
+			{
+				unsigned int nSlashes = PathSeparatorMask16( _mm_loadu_si128( (const __m128i *)( pStr + nRead + nRun ) ) );
+				if ( nSlashes )
+				{
+					nRun += FirstSetBit( nSlashes );
+					break;
+				}
+				nRun += 16;
+			}
+
+			if ( nRun )
+			{
+				if ( nWrite != nRead )
+				{
+					V_memmove( pStr + nWrite, pStr + nRead, nRun );
+				}
+				nRead += nRun;
+				nWrite += nRun;
+				continue;
+			}
+		}
+#endif
+
+		if ( PATHSEPARATOR( pStr[nRead] ) && PATHSEPARATOR( pStr[nRead + 1] ) )
 		{
-			// This means there's a double slash somewhere past the start of the filename. That 
-			// can happen in Hammer if they use a material in the root directory. You'll get a filename 
-			// that looks like 'materials\\blah.vmt'
-			V_memmove( &pStr[i], &pStr[i+1], len - i );
-			--len;
+			pStr[nWrite++] = pStr[nRead + 1];
+			nRead += 2;
 		}
+		else
+		{
+			pStr[nWrite++] = pStr[nRead++];
+		}
+	}
+
+	// The rest, including the terminator
+	if ( nWrite != nRead )
+	{
+		V_memmove( pStr + nWrite, pStr + nRead, len + 1 - nRead );
 	}
 }
 
@@ -0,0 +1,204 @@
+//========= Copyright Valve Corporation, All rights reserved. ============//
+//
+// Purpose:
+//
+// $NoKeywords: $
+//
+// A Fixed-allocation class for maintaining a 1d or 2d or 3d array of data in a structure-of-arrays
+// (SOA) sse-friendly manner.
+// =============================================================================//
+
+#include "tier1/utlsoacontainer.h"
+#include "vstdlib/random.h"
+#include <stdarg.h>
+
+// memdbgon must be the last include file in a .cpp file!!!
+#include "tier0/memdbgon.h"
+
+
+// bytes used by one quad (4 elements) of each EAttributeDataType
+static size_t s_nDataTypeQuadSize[] =
+{
+	sizeof( fltx4 ),										// ATTRDATATYPE_FLOAT
+	sizeof( FourVectors ),									// ATTRDATATYPE_4V
+	sizeof( fltx4 ),										// ATTRDATATYPE_INT
+	4 * sizeof( void * ),									// ATTRDATATYPE_POINTER
+};
+
+
+CSOAContainer::CSOAContainer( int nCols, int nRows, ... )
+{
+	Init();
+	va_list args;
+	va_start( args, nRows );
+	for(;;)
+	{
+		int nAttrIdx = va_arg( args, int );
+		if ( nAttrIdx == -1 )
+			break;
+		EAttributeDataType nDataType = ( EAttributeDataType )va_arg( args, int );
+		SetAttributeType( nAttrIdx, nDataType );
+	}
+	va_end( args );
+	AllocateData( nCols, nRows );
+}
+
+
+CSOAContainer::~CSOAContainer( void )
+{
+	Purge();
+}
+
+
+void CSOAContainer::Purge( void )
+{
+	if ( m_pDataMemory )
+	{
+		MemAlloc_FreeAligned( m_pDataMemory );
+	}
+	Init();
+}
+
+
+size_t CSOAContainer::ElementSize( void ) const
+{
+	size_t nRet = 0;
+	for( int i = 0; i < MAX_SOA_FIELDS; i++ )
+	{
+		if ( m_nFieldPresentMask & ( 1 << i ) )
+		{
+			nRet += s_nDataTypeQuadSize[m_nDataType[i]] / 4;
+		}
+	}
+	return nRet;
+}
+
+
+void CSOAContainer::AllocateData( int nNCols, int nNRows, int nSlices )
+{
+	Assert( !m_pDataMemory );
+	m_nColumns = nNCols;
+	m_nRows = nNRows;
+	m_nSlices = nSlices;
+	m_nPaddedColumns = ( nNCols + 3 ) & ~3;
+	m_nNumQuadsPerRow = m_nPaddedColumns / 4;
+
+	size_t nMemoryRequired = 0;
+	for( int i = 0; i < MAX_SOA_FIELDS; i++ )
+	{
+		if ( m_nFieldPresentMask & ( 1 << i ) )
+		{
+			m_nStrideInBytes[i] = s_nDataTypeQuadSize[m_nDataType[i]];
+			m_nRowStrideInBytes[i] = m_nStrideInBytes[i] * m_nNumQuadsPerRow;
+			m_nSliceStrideInBytes[i] = m_nRowStrideInBytes[i] * m_nRows;
+			nMemoryRequired += m_nSliceStrideInBytes[i] * m_nSlices;
+		}
+		else
+		{
+			m_nStrideInBytes[i] = 0;
+			m_nRowStrideInBytes[i] = 0;
+			m_nSliceStrideInBytes[i] = 0;
+			m_pAttributePtrs[i] = NULL;
+		}
+	}
+
+	if ( !nMemoryRequired )
+		return;
+
+	m_pDataMemory = ( uint8 * )MemAlloc_AllocAligned( nMemoryRequired, 16 );
+	memset( m_pDataMemory, 0, nMemoryRequired );
+
+	uint8 *pBase = m_pDataMemory;
+	for( int i = 0; i < MAX_SOA_FIELDS; i++ )
+	{
+		if ( m_nFieldPresentMask & ( 1 << i ) )
+		{
+			m_pAttributePtrs[i] = pBase;
+			pBase += m_nSliceStrideInBytes[i] * m_nSlices;
+		}
+	}
+}
+
+
+void CSOAContainer::CopyAttrFrom( CSOAContainer const &other, int nAttributeIdx )
+{
+	Assert( other.m_nColumns == m_nColumns );
+	Assert( other.m_nRows == m_nRows );
+	Assert( other.m_nSlices == m_nSlices );
+	Assert( other.m_nDataType[nAttributeIdx] == m_nDataType[nAttributeIdx] );
+	memcpy( RowPtr( nAttributeIdx, 0 ), other.ConstRowPtr( nAttributeIdx, 0 ),
+			m_nSliceStrideInBytes[nAttributeIdx] * m_nSlices );
+}
+
+
+void CSOAContainer::CopyAttrToAttr( int nSrcAttributeIndex, int nDestAttributeIndex )
+{
+	Assert( m_nDataType[nSrcAttributeIndex] == m_nDataType[nDestAttributeIndex] );
+	memcpy( RowPtr( nDestAttributeIndex, 0 ), ConstRowPtr( nSrcAttributeIndex, 0 ),
+			m_nSliceStrideInBytes[nSrcAttributeIndex] * m_nSlices );
+}
+
+
+void CSOAContainer::RandomizeAttribute( int nAttr, float flMin, float flMax ) const
+{
+	Assert( m_nDataType[nAttr] == ATTRDATATYPE_FLOAT );
+	for( int nS = 0; nS < m_nSlices; nS++ )
+	{
+		for( int nR = 0; nR < m_nRows; nR++ )
+		{
+			float *pOut = ( float * )RowPtr( nAttr, nR, nS );
+			for( int nC = 0; nC < m_nColumns; nC++ )
+			{
+				pOut[nC] = RandomFloat( flMin, flMax );
+			}
+		}
+	}
+}
+
+
+void CSOAContainer::FillAttrWithInterpolatedValues( int nAttr, float flValue00, float flValue10, float flValue01, float flValue11 ) const
+{
+	Assert( m_nDataType[nAttr] == ATTRDATATYPE_FLOAT );
+	float flXScale = ( m_nColumns > 1 ) ? 1.0f / ( m_nColumns - 1 ) : 0.0f;
+	float flYScale = ( m_nRows > 1 ) ? 1.0f / ( m_nRows - 1 ) : 0.0f;
+	for( int nS = 0; nS < m_nSlices; nS++ )
+	{
+		for( int nR = 0; nR < m_nRows; nR++ )
+		{
+			float flY = nR * flYScale;
+			float flLeft = flValue00 + flY * ( flValue01 - flValue00 );
+			float flRight = flValue10 + flY * ( flValue11 - flValue10 );
+			float *pOut = ( float * )RowPtr( nAttr, nR, nS );
+			for( int nC = 0; nC < m_nColumns; nC++ )
+			{
+				pOut[nC] = flLeft + ( nC * flXScale ) * ( flRight - flLeft );
+			}
+		}
+	}
+}
+
+
+void CSOAContainer::FillAttrWithInterpolatedValues( int nAttr, Vector flValue00, Vector flValue10,
+													Vector const &flValue01, Vector const &flValue11 ) const
+{
+	Assert( m_nDataType[nAttr] == ATTRDATATYPE_4V );
+	float flXScale = ( m_nColumns > 1 ) ? 1.0f / ( m_nColumns - 1 ) : 0.0f;
+	float flYScale = ( m_nRows > 1 ) ? 1.0f / ( m_nRows - 1 ) : 0.0f;
+	for( int nS = 0; nS < m_nSlices; nS++ )
+	{
+		for( int nR = 0; nR < m_nRows; nR++ )
+		{
+			float flY = nR * flYScale;
+			Vector vecLeft = flValue00 + flY * ( flValue01 - flValue00 );
+			Vector vecRight = flValue10 + flY * ( flValue11 - flValue10 );
+			FourVectors *pOut = ( FourVectors * )RowPtr( nAttr, nR, nS );
+			for( int nC = 0; nC < m_nColumns; nC++ )
+			{
+				Vector vecValue = vecLeft + ( nC * flXScale ) * ( vecRight - vecLeft );
+				pOut[nC >> 2].X( nC & 3 ) = vecValue.x;
+				pOut[nC >> 2].Y( nC & 3 ) = vecValue.y;
+				pOut[nC >> 2].Z( nC & 3 ) = vecValue.z;
+			}
+		}
+	}
+}
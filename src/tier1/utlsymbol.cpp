@@ -15,6 +15,7 @@
 #include "stringpool.h"
 #include "utlhashtable.h"
 #include "utlstring.h"
+#include "generichash.h"
 
 // Ensure that everybody has the right compiler version installed. The version
 // number can be obtained by looking at the compiler output when you type 'cl'
@@ -44,7 +45,7 @@
 // globals
 //-----------------------------------------------------------------------------
 
-CUtlSymbolTableMT* CUtlSymbol::s_pSymbolTable = 0; 
+CUtlSymbolTableHashMT* CUtlSymbol::s_pSymbolTable = 0; 
 bool CUtlSymbol::s_bAllowStaticSymbolTable = true;
 
 
@@ -63,7 +64,7 @@ void CUtlSymbol::Initialize()
 	static bool symbolsInitialized = false;
 	if (!symbolsInitialized)
 	{
-		s_pSymbolTable = new CUtlSymbolTableMT;
+		s_pSymbolTable = new CUtlSymbolTableHashMT;
 		symbolsInitialized = true;
 	}
 }
@@ -83,7 +84,7 @@ public:
 
 static CCleanupUtlSymbolTable g_CleanupSymbolTable;
 
-CUtlSymbolTableMT* CUtlSymbol::CurrTable()
+CUtlSymbolTableHashMT* CUtlSymbol::CurrTable()
 {
 	Initialize();
 	return s_pSymbolTable; 
@@ -288,6 +289,228 @@ void CUtlSymbolTable::RemoveAll()
 }
 
 
+//-----------------------------------------------------------------------------
+// Hashed symbol table
+//-----------------------------------------------------------------------------
+
+#define HASH_SLOT_EMPTY		0xFFFFFFFF
+#define HASH_SLOT_SYMBOL( slot )	( (UtlSymId_t)( (slot) & 0xFFFF ) )
+#define HASH_SLOT_TAG( hash )		( (hash) & 0xFFFF0000 )
+
+CUtlSymbolTableHash::CUtlSymbolTableHash( int initSize, bool caseInsensitive ) : 
+	m_nSymbols( 0 ), m_bInsensitive( caseInsensitive ), m_pPoolCursor( NULL ), m_nPoolSpaceLeft( 0 )
+{
+	// Keep the table at most half full
+	int nSlots = 16;
+	while ( nSlots < initSize * 2 )
+	{
+		nSlots <<= 1;
+	}
+	m_pSlotArray = AllocSlotArray( nSlots );
+	memset( (void *)m_pSymbolBlocks, 0, sizeof( m_pSymbolBlocks ) );
+}
+
+CUtlSymbolTableHash::~CUtlSymbolTableHash()
+{
+	RemoveAll();
+	free( m_pSlotArray );
+}
+
+CUtlSymbolTableHash::SlotArray_t *CUtlSymbolTableHash::AllocSlotArray( int nSlots )
+{
+	SlotArray_t *pArray = (SlotArray_t *)malloc( sizeof( SlotArray_t ) + ( nSlots - 1 ) * sizeof( uint32 ) );
+	pArray->m_nMask = nSlots - 1;
+	memset( pArray->m_Slots, 0xFF, nSlots * sizeof( uint32 ) );
+	return pArray;
+}
+
+// The caseless hash folds ASCII case the same way V_stricmp does. Both finish with
+// a full avalanche, so the low bits (slot) and high bits (tag) are independent.
+unsigned int CUtlSymbolTableHash::HashString( const char *pString ) const
+{
+	return m_bInsensitive ? HashStringFastCaseless( pString ) : HashStringFast( pString );
+}
+
+inline bool CUtlSymbolTableHash::StringsMatch( const char *pString, UtlSymId_t id ) const
+{
+	const char *pSymbolString = m_pSymbolBlocks[id >> SYMBOL_BLOCK_SHIFT][id & ( SYMBOL_BLOCK_SIZE - 1 )];
+	return m_bInsensitive ? !V_stricmp( pString, pSymbolString ) : !V_strcmp( pString, pSymbolString );
+}
+
+UtlSymId_t CUtlSymbolTableHash::FindHashed( const char *pString, unsigned int nHash ) const
+{
+	const SlotArray_t *pArray = m_pSlotArray;
+	ThreadMemoryBarrier();
+
+	uint32 nTag = HASH_SLOT_TAG( nHash );
+	for ( int i = nHash & pArray->m_nMask; ; i = ( i + 1 ) & pArray->m_nMask )
+	{
+		uint32 nSlot = *(volatile const uint32 *)&pArray->m_Slots[i];
+		if ( nSlot == HASH_SLOT_EMPTY )
+			return UTL_INVAL_SYMBOL;
+
+		if ( HASH_SLOT_TAG( nSlot ) == nTag && StringsMatch( pString, HASH_SLOT_SYMBOL( nSlot ) ) )
+			return HASH_SLOT_SYMBOL( nSlot );
+	}
+}
+
+CUtlSymbol CUtlSymbolTableHash::Find( const char* pString ) const
+{
+	if ( !pString )
+		return CUtlSymbol();
+
+	return CUtlSymbol( FindHashed( pString, HashString( pString ) ) );
+}
+
+const char *CUtlSymbolTableHash::CopyString( const char *pString )
+{
+	int len = V_strlen( pString ) + 1;
+	if ( len > m_nPoolSpaceLeft )
+	{
+		int newPoolSize = max( len, MIN_STRING_POOL_SIZE );
+		m_pPoolCursor = (char *)malloc( newPoolSize );
+		m_nPoolSpaceLeft = newPoolSize;
+		m_StringPools.AddToTail( m_pPoolCursor );
+	}
+
+	char *pCopy = m_pPoolCursor;
+	memcpy( pCopy, pString, len );
+	m_pPoolCursor += len;
+	m_nPoolSpaceLeft -= len;
+	return pCopy;
+}
+
+void CUtlSymbolTableHash::Grow()
+{
+	SlotArray_t *pOld = m_pSlotArray;
+	SlotArray_t *pNew = AllocSlotArray( ( pOld->m_nMask + 1 ) * 2 );
+
+	for ( int i = 0; i <= pOld->m_nMask; ++i )
+	{
+		uint32 nSlot = pOld->m_Slots[i];
+		if ( nSlot == HASH_SLOT_EMPTY )
+			continue;
+
+		UtlSymId_t id = HASH_SLOT_SYMBOL( nSlot );
+		unsigned int nHash = HashString( m_pSymbolBlocks[id >> SYMBOL_BLOCK_SHIFT][id & ( SYMBOL_BLOCK_SIZE - 1 )] );
+		int j = nHash & pNew->m_nMask;
+		while ( pNew->m_Slots[j] != HASH_SLOT_EMPTY )
+		{
+			j = ( j + 1 ) & pNew->m_nMask;
+		}
+		pNew->m_Slots[j] = nSlot;
+	}
+
+	// Readers may still be probing the old array, so it stays around until RemoveAll
+	ThreadMemoryBarrier();
+	m_pSlotArray = pNew;
+	m_RetiredSlotArrays.AddToTail( pOld );
+}
+
+CUtlSymbol CUtlSymbolTableHash::Insert( const char *pString, unsigned int nHash )
+{
+	// UTL_INVAL_SYMBOL is the last id, so a full table has one less than that
+	if ( m_nSymbols >= UTL_INVAL_SYMBOL )
+	{
+		AssertMsg( false, "CUtlSymbolTableHash is full\n" );
+		return CUtlSymbol();
+	}
+
+	if ( ( m_nSymbols + 1 ) * 2 > m_pSlotArray->m_nMask + 1 )
+	{
+		Grow();
+	}
+
+	UtlSymId_t id = (UtlSymId_t)m_nSymbols;
+	const char **pBlock = m_pSymbolBlocks[id >> SYMBOL_BLOCK_SHIFT];
+	if ( !pBlock )
+	{
+		pBlock = (const char **)malloc( SYMBOL_BLOCK_SIZE * sizeof( const char * ) );
+		m_pSymbolBlocks[id >> SYMBOL_BLOCK_SHIFT] = pBlock;
+	}
+	pBlock[id & ( SYMBOL_BLOCK_SIZE - 1 )] = CopyString( pString );
+
+	// Publish the string before the slot that refers to it
+	ThreadMemoryBarrier();
+
+	SlotArray_t *pArray = m_pSlotArray;
+	int i = nHash & pArray->m_nMask;
+	while ( pArray->m_Slots[i] != HASH_SLOT_EMPTY )
+	{
+		i = ( i + 1 ) & pArray->m_nMask;
+	}
+	*(volatile uint32 *)&pArray->m_Slots[i] = HASH_SLOT_TAG( nHash ) | id;
+	m_nSymbols = m_nSymbols + 1;
+
+	return CUtlSymbol( id );
+}
+
+CUtlSymbol CUtlSymbolTableHash::AddString( const char* pString )
+{
+	if ( !pString )
+		return CUtlSymbol( UTL_INVAL_SYMBOL );
+
+	unsigned int nHash = HashString( pString );
+	UtlSymId_t id = FindHashed( pString, nHash );
+	if ( id != UTL_INVAL_SYMBOL )
+		return CUtlSymbol( id );
+
+	return Insert( pString, nHash );
+}
+
+const char* CUtlSymbolTableHash::String( CUtlSymbol id ) const
+{
+	if ( !id.IsValid() )
+		return "";
+
+	Assert( (UtlSymId_t)id < m_nSymbols );
+	return m_pSymbolBlocks[(UtlSymId_t)id >> SYMBOL_BLOCK_SHIFT][(UtlSymId_t)id & ( SYMBOL_BLOCK_SIZE - 1 )];
+}
+
+void CUtlSymbolTableHash::RemoveAll()
+{
+	memset( m_pSlotArray->m_Slots, 0xFF, ( m_pSlotArray->m_nMask + 1 ) * sizeof( uint32 ) );
+
+	for ( int i = 0; i < m_RetiredSlotArrays.Count(); i++ )
+		free( m_RetiredSlotArrays[i] );
+	m_RetiredSlotArrays.RemoveAll();
+
+	for ( int i = 0; i < SYMBOL_BLOCK_COUNT; i++ )
+	{
+		free( (void *)m_pSymbolBlocks[i] );
+		m_pSymbolBlocks[i] = NULL;
+	}
+
+	for ( int i = 0; i < m_StringPools.Count(); i++ )
+		free( m_StringPools[i] );
+	m_StringPools.RemoveAll();
+	m_pPoolCursor = NULL;
+	m_nPoolSpaceLeft = 0;
+
+	m_nSymbols = 0;
+}
+
+CUtlSymbol CUtlSymbolTableHashMT::AddString( const char* pString )
+{
+	if ( !pString )
+		return CUtlSymbol( UTL_INVAL_SYMBOL );
+
+	// Most strings are already in the table, so look without the lock first
+	unsigned int nHash = HashString( pString );
+	UtlSymId_t id = FindHashed( pString, nHash );
+	if ( id != UTL_INVAL_SYMBOL )
+		return CUtlSymbol( id );
+
+	AUTO_LOCK( m_mutex );
+	id = FindHashed( pString, nHash );
+	if ( id != UTL_INVAL_SYMBOL )
+		return CUtlSymbol( id );
+
+	return Insert( pString, nHash );
+}
+
+
+
 
 class CUtlFilenameSymbolTable::HashTable : public CUtlStableHashtable<CUtlConstString>
 {
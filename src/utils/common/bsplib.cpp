@@ -28,6 +28,7 @@
 #include "vtf/vtf.h"
 #include "lzma/lzma.h"
 #include "tier1/lzmaDecoder.h"
+#include "tier1/compressedstreamreader.h"
 
 //=============================================================================
 
@@ -4440,6 +4441,35 @@ int SortLumpsByOffset( const SortedLump_t *pSortedLumpA, const SortedLump_t *pSo
 	return 0;
 }
 
+//-----------------------------------------------------------------------------
+// Decompresses an LZMA lump of nCompressedSize bytes, appending it to output.
+// Never reads past the end of the lump, even if its header is corrupt.
+//-----------------------------------------------------------------------------
+static bool DecompressLZMALump( byte *pCompressedLump, unsigned int nCompressedSize, CUtlBuffer &output )
+{
+	if ( nCompressedSize < sizeof( lzma_header_t ) )
+		return false;
+
+	unsigned int nActualSize = CLZMA::GetActualSize( pCompressedLump );
+	CUtlBuffer input( pCompressedLump, nCompressedSize, CUtlBuffer::READ_ONLY );
+	CLZMAStream stream;
+	while ( !stream.IsFinished() )
+	{
+		int nGet = input.TellGet();
+		int nPut = output.TellPut();
+		if ( !stream.Read( input, output, nActualSize ) )
+			return false;
+
+		if ( input.TellGet() == nGet && output.TellPut() == nPut )
+		{
+			// Ran out of lump
+			return false;
+		}
+	}
+
+	return true;
+}
+
 bool CompressGameLump( dheader_t *pInBSPHeader, dheader_t *pOutBSPHeader, CUtlBuffer &outputBuffer, CompressFunc_t pCompressFunc )
 {
 	CByteswap	byteSwap;
@@ -4486,10 +4516,12 @@ bool CompressGameLump( dheader_t *pInBSPHeader, dheader_t *pOutBSPHeader, CUtlBu
 				byte *pCompressedLump = ((byte *)pInBSPHeader) + pInGameLump[i].fileofs;
 				if ( CLZMA::IsCompressed( pCompressedLump ) )
 				{
-					inputBuffer.EnsureCapacity( CLZMA::GetActualSize( pCompressedLump ) );
-					unsigned int outSize = CLZMA::Uncompress( pCompressedLump, (unsigned char *)inputBuffer.Base() );
-					inputBuffer.SeekPut( CUtlBuffer::SEEK_CURRENT, outSize );
-					if ( outSize != CLZMA::GetActualSize( pCompressedLump ) )
+					// Compressed game lumps are followed by at least the dummy terminal lump, whose
+					// offset ends this one.
+					unsigned int nCompressedSize = ( i + 1 < pInGameLumpHeader->lumpCount ) ?
+						pInGameLump[i + 1].fileofs - pInGameLump[i].fileofs :
+						sizeof( lzma_header_t ) + LittleLong( ((lzma_header_t *)pCompressedLump)->lzmaSize );
+					if ( !DecompressLZMALump( pCompressedLump, nCompressedSize, inputBuffer ) )
 					{
 						Warning( "Decompressed size differs from header, BSP may be corrupt\n" );
 					}
@@ -4640,10 +4672,8 @@ bool RepackBSP( CUtlBuffer &inputBuffer, CUtlBuffer &outputBuffer, CompressFunc_
 				byte *pCompressedLump = ((byte *)pInBSPHeader) + pSortedLump->pLump->fileofs;
 				if ( CLZMA::IsCompressed( pCompressedLump ) && pSortedLump->pLump->uncompressedSize == CLZMA::GetActualSize( pCompressedLump ) )
 				{
-					inputBuffer.EnsureCapacity( CLZMA::GetActualSize( pCompressedLump ) );
-					unsigned int outSize = CLZMA::Uncompress( pCompressedLump, (unsigned char *)inputBuffer.Base() );
-					inputBuffer.SeekPut( CUtlBuffer::SEEK_CURRENT, outSize );
-					if ( outSize != pSortedLump->pLump->uncompressedSize )
+					if ( !DecompressLZMALump( pCompressedLump, pSortedLump->pLump->filelen, inputBuffer ) ||
+					     inputBuffer.TellPut() != pSortedLump->pLump->uncompressedSize )
 					{
 						Warning( "Decompressed size differs from header, BSP may be corrupt\n" );
 					}
@@ -4969,6 +4999,52 @@ bool SwapBSPFile( const char *pInFilename, const char *pOutFilename, bool bSwapO
 	return true;
 }
 
+//-----------------------------------------------------------------------------
+// Feeds a lump of an open BSP to a CCompressedStreamReader
+//-----------------------------------------------------------------------------
+class CLumpStreamSource : public ICompressedStreamSource
+{
+public:
+	CLumpStreamSource( FileHandle_t hFile, unsigned int nSize ) : m_hFile( hFile ), m_nBytesLeft( nSize ) {}
+
+	virtual int ReadCompressed( void *pDest, int nMaxBytes )
+	{
+		unsigned int nBytes = Min( (unsigned int)nMaxBytes, m_nBytesLeft );
+		if ( !nBytes )
+			return 0;
+
+		int nRead = g_pFileSystem->Read( pDest, nBytes, m_hFile );
+		if ( nRead <= 0 )
+			return -1;
+
+		m_nBytesLeft -= nRead;
+		return nRead;
+	}
+
+private:
+	FileHandle_t	m_hFile;
+	unsigned int	m_nBytesLeft;
+};
+
+//-----------------------------------------------------------------------------
+// Reads a lump from an open BSP into pDest, which must hold the lump's
+// uncompressed size. Compressed lumps are decoded as they are read.
+//-----------------------------------------------------------------------------
+static bool ReadLumpFromFile( FileHandle_t hFile, const lump_t &lump, void *pDest )
+{
+	g_pFileSystem->Seek( hFile, lump.fileofs, FILESYSTEM_SEEK_HEAD );
+	if ( !lump.uncompressedSize )
+	{
+		return g_pFileSystem->Read( pDest, lump.filelen, hFile ) == lump.filelen;
+	}
+
+	CLumpStreamSource source( hFile, lump.filelen );
+	CCompressedStreamReader reader( &source, COMPRESSED_STREAM_LZMA );
+	CUtlBuffer output;
+	output.SetExternalBuffer( pDest, lump.uncompressedSize, 0 );
+	return reader.ReadAll( output ) && output.TellPut() == lump.uncompressedSize;
+}
+
 //-----------------------------------------------------------------------------
 // Get the pak lump from a BSP
 //-----------------------------------------------------------------------------
@@ -4977,29 +5053,54 @@ bool GetPakFileLump( const char *pBSPFilename, void **pPakData, int *pPakSize )
 	*pPakData = NULL;
 	*pPakSize = 0;
 
-	if ( !g_pFileSystem->FileExists( pBSPFilename ) )
+	FileHandle_t hFile = g_pFileSystem->Open( pBSPFilename, "rb" );
+	if ( !hFile )
 	{
 		Warning( "Error! Couldn't open file %s!\n", pBSPFilename ); 
 		return false;
 	}
 
-	// determine endian nature
-	dheader_t *pHeader;
-	LoadFile( pBSPFilename, (void **)&pHeader );
-	bool bSwap = ( pHeader->ident == BigLong( IDBSPHEADER ) );
-	free( pHeader );
+	// Only the header and the pak lump are read, not the whole BSP
+	dheader_t header;
+	if ( g_pFileSystem->Read( &header, sizeof( header ), hFile ) != sizeof( header ) )
+	{
+		g_pFileSystem->Close( hFile );
+		Warning( "Error! Couldn't read header of %s!\n", pBSPFilename );
+		return false;
+	}
 
+	// determine endian nature
+	bool bSwap = ( header.ident == BigLong( IDBSPHEADER ) );
 	g_bSwapOnLoad = bSwap;
 	g_bSwapOnWrite = !bSwap;
 
-	OpenBSPFile( pBSPFilename );
-	
-	if ( g_pBSPHeader->lumps[LUMP_PAKFILE].filelen )
+	if ( g_bSwapOnLoad )
 	{
-		*pPakSize = CopyVariableLump<byte>( FIELD_CHARACTER, LUMP_PAKFILE, pPakData );
+		g_Swap.ActivateByteSwapping( true );
+		g_Swap.SwapFieldsToTargetEndian( &header );
 	}
 
-	CloseBSPFile();
+	ValidateHeader( pBSPFilename, &header );
+	g_MapRevision = header.mapRevision;
+
+	const lump_t &lump = header.lumps[LUMP_PAKFILE];
+	if ( lump.filelen )
+	{
+		int nSize = lump.uncompressedSize ? lump.uncompressedSize : lump.filelen;
+		void *pData = malloc( nSize );
+		if ( !ReadLumpFromFile( hFile, lump, pData ) )
+		{
+			free( pData );
+			g_pFileSystem->Close( hFile );
+			Warning( "Error! Couldn't read pak lump of %s!\n", pBSPFilename );
+			return false;
+		}
+
+		*pPakData = pData;
+		*pPakSize = nSize;
+	}
+
+	g_pFileSystem->Close( hFile );
 
 	return true;
 }